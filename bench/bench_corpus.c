@@ -0,0 +1,417 @@
+#include "nbt.h"
+#include "nbt_def.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/resource.h>
+
+/* Generates a fixed set of synthetic documents shaped like the data the
+ * library sees in practice (wide compounds, deep nesting, huge long arrays,
+ * chunk sections, entity lists, string-heavy documents) and times parsing,
+ * freeing and writing each one, raw and gzip-compressed. Besides MB/s and
+ * nodes/s it reports malloc calls per node and the peak RSS reached while
+ * parsing. The generator is seeded, so every run sees the same bytes.
+ *
+ *   bench_corpus [iterations] [-o dir]   (-o also saves the corpus as .nbt
+ *                                         and .nbt.gz files in dir) */
+
+#define DEFAULT_ITERS (5)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* malloc counting: the library is linked statically, so defining the
+ * allocator here catches every allocation it makes */
+static unsigned long allocs;
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) { ++allocs; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { ++allocs; return __libc_calloc(n, size); }
+void *realloc(void *ptr, size_t size) { ++allocs; return __libc_realloc(ptr, size); }
+#define HAVE_ALLOC_COUNT 1
+#else
+#define HAVE_ALLOC_COUNT 0
+#endif
+
+/* Peak RSS in KiB. On Linux the high-water mark can be reset (by writing 5
+ * to clear_refs), so each phase gets its own peak; elsewhere this is the
+ * peak of the whole process so far. */
+static void reset_peak_rss(void) {
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (!fp) return;
+    fputs("5", fp);
+    fclose(fp);
+}
+
+static long peak_rss(void) {
+    char line[128];
+    long kb = -1;
+
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp) {
+        while (fgets(line, sizeof(line), fp))
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+        fclose(fp);
+    }
+
+    if (kb < 0) {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        kb = ru.ru_maxrss;
+    }
+    return kb;
+}
+
+/* xorshift64*, fixed seed per corpus */
+static uint64_t rng_state;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static unsigned rng_below(unsigned n) {
+    return (unsigned)(rng() % n);
+}
+
+/* big-endian emitter into a growable buffer */
+static struct nbt_buffer out;
+
+static unsigned char *grow(size_t n) {
+    if (nbt_buffer_reserve(&out, n) < 0) {
+        fprintf(stderr, "out of memory generating corpus\n");
+        exit(1);
+    }
+    out.length += n;
+    return out.data + out.length - n;
+}
+
+static void put8(unsigned v) { *grow(1) = (unsigned char)v; }
+static void put16(unsigned v) { put8(v >> 8); put8(v); }
+static void put32(uint32_t v) { put16(v >> 16); put16(v & 0xffff); }
+static void put64(uint64_t v) { put32((uint32_t)(v >> 32)); put32((uint32_t)v); }
+static void putf32(float f) { uint32_t v; memcpy(&v, &f, 4); put32(v); }
+static void putf64(double d) { uint64_t v; memcpy(&v, &d, 8); put64(v); }
+
+static void putstr(const char *s, size_t len) {
+    put16((unsigned)len);
+    memcpy(grow(len), s, len);
+}
+
+static void putname(const char *name) { putstr(name, strlen(name)); }
+static void tag(unsigned type, const char *name) { put8(type); putname(name); }
+
+static void putrandstr(unsigned maxlen) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_:.0123456789";
+    unsigned len = rng_below(maxlen + 1);
+    put16(len);
+    unsigned char *p = grow(len);
+    for (unsigned i = 0; i < len; ++i) p[i] = alphabet[rng_below(sizeof(alphabet) - 1)];
+}
+
+/* Each generator writes the payload of the root compound. */
+
+/* one compound with 200k scalar and string entries */
+static void gen_wide(void) {
+    char name[32];
+    for (unsigned i = 0; i < 200000; ++i) {
+        snprintf(name, sizeof(name), "key_%u", i);
+        switch (i % 4) {
+            case 0: tag(NBT_TAG_INT, name); put32((uint32_t)rng()); break;
+            case 1: tag(NBT_TAG_DOUBLE, name); putf64((double)rng_below(1000000) / 7.0); break;
+            case 2: tag(NBT_TAG_BYTE, name); put8(rng_below(256)); break;
+            case 3: tag(NBT_TAG_STRING, name); putrandstr(16); break;
+        }
+    }
+    put8(NBT_TAG_END);
+}
+
+static void deep_compound(int depth) {
+    tag(NBT_TAG_INT, "depth"); put32((uint32_t)depth);
+    tag(NBT_TAG_STRING, "id"); putrandstr(12);
+    if (depth > 0) {
+        tag(NBT_TAG_COMPOUND, "child");
+        deep_compound(depth - 1);
+    }
+    put8(NBT_TAG_END);
+}
+
+/* 2000 chains of compounds 128 deep */
+static void gen_deep(void) {
+    tag(NBT_TAG_LIST, "chains"); put8(NBT_TAG_COMPOUND); put32(2000);
+    for (int i = 0; i < 2000; ++i) deep_compound(127);
+    put8(NBT_TAG_END);
+}
+
+/* 16 long arrays of 128k entries: bulk payload, almost no nodes */
+static void gen_long_arrays(void) {
+    char name[32];
+    for (unsigned i = 0; i < 16; ++i) {
+        snprintf(name, sizeof(name), "heightmap_%u", i);
+        tag(NBT_TAG_LONG_ARRAY, name); put32(131072);
+        for (unsigned j = 0; j < 131072; ++j) put64(rng());
+    }
+    put8(NBT_TAG_END);
+}
+
+static const char *const block_names[] = {
+    "minecraft:stone", "minecraft:dirt", "minecraft:grass_block", "minecraft:deepslate",
+    "minecraft:water", "minecraft:oak_log", "minecraft:iron_ore", "minecraft:air",
+};
+
+/* 64 chunks of 24 sections each, as in a region's chunk NBT */
+static void gen_sections(void) {
+    tag(NBT_TAG_LIST, "chunks"); put8(NBT_TAG_COMPOUND); put32(64);
+    for (int c = 0; c < 64; ++c) {
+        tag(NBT_TAG_INT, "xPos"); put32((uint32_t)(c % 8));
+        tag(NBT_TAG_INT, "zPos"); put32((uint32_t)(c / 8));
+        tag(NBT_TAG_STRING, "Status"); putname("minecraft:full");
+        tag(NBT_TAG_LIST, "sections"); put8(NBT_TAG_COMPOUND); put32(24);
+        for (int s = 0; s < 24; ++s) {
+            tag(NBT_TAG_BYTE, "Y"); put8((unsigned)(s - 4));
+
+            tag(NBT_TAG_COMPOUND, "block_states");
+            unsigned npalette = 1 + rng_below(8);
+            tag(NBT_TAG_LIST, "palette"); put8(NBT_TAG_COMPOUND); put32(npalette);
+            for (unsigned p = 0; p < npalette; ++p) {
+                tag(NBT_TAG_STRING, "Name"); putname(block_names[p]);
+                if (p % 3 == 2) {
+                    tag(NBT_TAG_COMPOUND, "Properties");
+                    tag(NBT_TAG_STRING, "axis"); putname("y");
+                    put8(NBT_TAG_END);
+                }
+                put8(NBT_TAG_END);
+            }
+            tag(NBT_TAG_LONG_ARRAY, "data"); put32(256);
+            for (int i = 0; i < 256; ++i) put64(rng());
+            put8(NBT_TAG_END);
+
+            tag(NBT_TAG_COMPOUND, "biomes");
+            tag(NBT_TAG_LIST, "palette"); put8(NBT_TAG_STRING); put32(1);
+            putname("minecraft:plains");
+            put8(NBT_TAG_END);
+
+            tag(NBT_TAG_BYTE_ARRAY, "BlockLight"); put32(2048);
+            for (int i = 0; i < 2048; ++i) put8(rng_below(16));
+            tag(NBT_TAG_BYTE_ARRAY, "SkyLight"); put32(2048);
+            for (int i = 0; i < 2048; ++i) put8(rng_below(16));
+            put8(NBT_TAG_END);
+        }
+        put8(NBT_TAG_END);
+    }
+    put8(NBT_TAG_END);
+}
+
+/* 20000 mob entities with the usual small lists and attribute compounds */
+static void gen_entities(void) {
+    tag(NBT_TAG_LIST, "Entities"); put8(NBT_TAG_COMPOUND); put32(20000);
+    for (int e = 0; e < 20000; ++e) {
+        tag(NBT_TAG_STRING, "id"); putname(e % 2 ? "minecraft:zombie" : "minecraft:cow");
+        tag(NBT_TAG_LIST, "Pos"); put8(NBT_TAG_DOUBLE); put32(3);
+        for (int i = 0; i < 3; ++i) putf64((double)rng_below(100000) / 16.0);
+        tag(NBT_TAG_LIST, "Motion"); put8(NBT_TAG_DOUBLE); put32(3);
+        for (int i = 0; i < 3; ++i) putf64(0.0);
+        tag(NBT_TAG_LIST, "Rotation"); put8(NBT_TAG_FLOAT); put32(2);
+        putf32((float)rng_below(360)); putf32(0.0f);
+        tag(NBT_TAG_INT_ARRAY, "UUID"); put32(4);
+        for (int i = 0; i < 4; ++i) put32((uint32_t)rng());
+        tag(NBT_TAG_FLOAT, "Health"); putf32(20.0f);
+        tag(NBT_TAG_SHORT, "Air"); put16(300);
+        tag(NBT_TAG_BYTE, "OnGround"); put8(1);
+        tag(NBT_TAG_LIST, "Tags"); put8(NBT_TAG_STRING); put32(2);
+        putrandstr(10); putrandstr(10);
+        tag(NBT_TAG_LIST, "Attributes"); put8(NBT_TAG_COMPOUND); put32(3);
+        for (int i = 0; i < 3; ++i) {
+            tag(NBT_TAG_STRING, "Name"); putname("minecraft:generic.movement_speed");
+            tag(NBT_TAG_DOUBLE, "Base"); putf64(0.25);
+            put8(NBT_TAG_END);
+        }
+        put8(NBT_TAG_END);
+    }
+    put8(NBT_TAG_END);
+}
+
+/* 100k named strings plus a list of 100k more, lengths 0-96 */
+static void gen_strings(void) {
+    char name[32];
+    for (unsigned i = 0; i < 100000; ++i) {
+        snprintf(name, sizeof(name), "text_%u", i);
+        tag(NBT_TAG_STRING, name); putrandstr(96);
+    }
+    tag(NBT_TAG_LIST, "lines"); put8(NBT_TAG_STRING); put32(100000);
+    for (unsigned i = 0; i < 100000; ++i) putrandstr(96);
+    put8(NBT_TAG_END);
+}
+
+static const struct corpus {
+    const char *name;
+    void (*gen)(void);
+} corpora[] = {
+    { "wide",        gen_wide },
+    { "deep",        gen_deep },
+    { "long_arrays", gen_long_arrays },
+    { "sections",    gen_sections },
+    { "entities",    gen_entities },
+    { "strings",     gen_strings },
+};
+
+static long count_nodes(nbt_type type, nbt_value value) {
+    long n = 1;
+    if (type == NBT_TAG_COMPOUND) {
+        for (struct nbt_compound_entry *cur = value.tag_compound->first; cur; cur = cur->next)
+            n += count_nodes(cur->tag.type, cur->tag.value);
+    } else if (type == NBT_TAG_LIST) {
+        for (nbt_int i = 0; i < value.tag_list->length; ++i)
+            n += count_nodes(value.tag_list->type, nbt_list_get(value.tag_list, i));
+    }
+    return n;
+}
+
+struct timing {
+    double parse, free, write;
+    unsigned long allocs;
+    long rss;
+};
+
+/* `path` is read with nbt_read_file() if set, else `data` with nbt_read(). */
+static int run(const unsigned char *data, size_t len, const char *path, int compression, int iters, struct timing *t) {
+    struct nbt_write_options wopts = { .compression = compression };
+    struct nbt_buffer buf = { 0 };
+    struct nbt_parsed nbt;
+
+    memset(t, 0, sizeof(*t));
+    for (int i = 0; i < iters; ++i) {
+        reset_peak_rss();
+        unsigned long before = allocs;
+        double start = now();
+
+        int ret;
+        if (path) {
+            FILE *fp = fopen(path, "rb");
+            ret = nbt_read_file(fp, &nbt);
+            fclose(fp);
+        } else {
+            ret = nbt_read(data, len, &nbt);
+        }
+        if (ret < 0) {
+            fprintf(stderr, "read: %s\n", nbt_error());
+            return -1;
+        }
+
+        double parsed = now();
+        t->parse += parsed - start;
+        t->allocs = allocs - before;
+        long rss = peak_rss();
+        if (rss > t->rss) t->rss = rss;
+
+        start = now();
+        buf.length = 0;
+        if (nbt_write(&nbt, &buf, &wopts) < 0) {
+            fprintf(stderr, "write: %s\n", nbt_error());
+            return -1;
+        }
+        t->write += now() - start;
+
+        start = now();
+        nbt_free_parsed(&nbt);
+        t->free += now() - start;
+    }
+
+    nbt_buffer_free(&buf);
+    return 0;
+}
+
+static void report(const char *corpus, const char *form, size_t len, long nodes, int iters, const struct timing *t) {
+    double mb = len / 1e6;
+    printf("%-12s %-5s %8.1f MB/s %7.2f Mnodes/s  free %7.2f Mnodes/s  write %8.1f MB/s",
+           corpus, form, mb * iters / t->parse, nodes * iters / t->parse / 1e6,
+           nodes * iters / t->free / 1e6, mb * iters / t->write);
+    if (HAVE_ALLOC_COUNT)
+        printf("  %5.2f allocs/node", (double)t->allocs / nodes);
+    printf("  peak RSS %6ld MB\n", t->rss / 1024);
+}
+
+int main(int argc, char **argv) {
+    int iters = DEFAULT_ITERS;
+    const char *outdir = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outdir = argv[++i];
+        else iters = atoi(argv[i]);
+    }
+    if (iters < 1) iters = 1;
+
+    printf("%d iterations per corpus (inflating with %s)\n", iters, nbt_decompressor());
+
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); ++c) {
+        const struct corpus *corpus = &corpora[c];
+
+        rng_state = 0x9E3779B97F4A7C15ull + c;
+        out.length = 0;
+        put8(NBT_TAG_COMPOUND);
+        putname("");
+        corpus->gen();
+
+        struct nbt_parsed nbt;
+        if (nbt_read(out.data, out.length, &nbt) < 0) {
+            fprintf(stderr, "%s: %s\n", corpus->name, nbt_error());
+            return 1;
+        }
+        nbt_value root = { .tag_compound = nbt.root };
+        long nodes = count_nodes(NBT_TAG_COMPOUND, root);
+
+        struct nbt_write_options gzopts = { .compression = NBT_COMPRESSION_GZIP };
+        struct nbt_buffer gz = { 0 };
+        if (nbt_write(&nbt, &gz, &gzopts) < 0) {
+            fprintf(stderr, "%s: %s\n", corpus->name, nbt_error());
+            return 1;
+        }
+        nbt_free_parsed(&nbt);
+
+        printf("%s: %zu bytes raw, %zu gzip, %ld nodes\n", corpus->name, out.length, gz.length, nodes);
+
+        char gzpath[] = "/tmp/nbt_corpus_XXXXXX";
+        FILE *fp = fdopen(mkstemp(gzpath), "wb");
+        fwrite(gz.data, 1, gz.length, fp);
+        fclose(fp);
+
+        if (outdir) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s.nbt", outdir, corpus->name);
+            if ((fp = fopen(path, "wb"))) {
+                fwrite(out.data, 1, out.length, fp);
+                fclose(fp);
+            }
+            snprintf(path, sizeof(path), "%s/%s.nbt.gz", outdir, corpus->name);
+            if ((fp = fopen(path, "wb"))) {
+                fwrite(gz.data, 1, gz.length, fp);
+                fclose(fp);
+            }
+        }
+
+        struct timing t;
+        if (run(out.data, out.length, NULL, NBT_COMPRESSION_NONE, iters, &t) < 0) return 1;
+        report(corpus->name, "raw", out.length, nodes, iters, &t);
+        if (run(NULL, 0, gzpath, NBT_COMPRESSION_GZIP, iters, &t) < 0) return 1;
+        report(corpus->name, "gzip", out.length, nodes, iters, &t);
+
+        remove(gzpath);
+        nbt_buffer_free(&gz);
+    }
+
+    nbt_buffer_free(&out);
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_json.h"
+#include "nbt_snbt.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Times JSON export straight off the decoder, and import, on a document
+ * of chunk-sized long, int and byte arrays, in each array and long
+ * encoding. Export rates are in MB of NBT read, import rates in MB of JSON
+ * read. */
+
+#define DEFAULT_ITERS (5)
+#define SECTIONS (256)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* xorshift64*, fixed seed */
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static struct nbt_buffer text;
+
+static void put(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void put(const char *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(NULL, 0, fmt, va);
+    va_end(va);
+
+    if (nbt_buffer_reserve(&text, (size_t)len + 1) < 0) {
+        fprintf(stderr, "out of memory generating SNBT\n");
+        exit(1);
+    }
+
+    va_start(va, fmt);
+    vsnprintf((char *)text.data + text.length, (size_t)len + 1, fmt, va);
+    va_end(va);
+    text.length += (size_t)len;
+}
+
+/* The document as raw NBT, by way of SNBT. */
+static int generate(struct nbt_buffer *nbt) {
+    struct nbt_parsed parsed;
+
+    put("{Sections:[");
+    for (int s = 0; s < SECTIONS; ++s) {
+        put("%s{Y:%db,BlockStates:[L;", s ? "," : "", s % 24 - 4);
+        for (int i = 0; i < 4096; ++i) put("%s%lldL", i ? "," : "", (long long)rng());
+        put("],Biomes:[I;");
+        for (int i = 0; i < 1024; ++i) put("%s%d", i ? "," : "", (int)(rng() % 64));
+        put("],SkyLight:[B;");
+        for (int i = 0; i < 2048; ++i) put("%s%db", i ? "," : "", (int)(int8_t)rng());
+        put("],Heights:[");
+        for (int i = 0; i < 256; ++i) put("%s%ds", i ? "," : "", (int)(rng() % 384));
+        put("]}");
+    }
+    put("]}");
+
+    if (nbt_snbt_read((const char *)text.data, text.length, &parsed, NULL) < 0 || nbt_write(&parsed, nbt, NULL) < 0) {
+        fprintf(stderr, "generating NBT: %s\n", nbt_error());
+        return -1;
+    }
+
+    nbt_free_parsed(&parsed);
+    nbt_buffer_free(&text);
+    return 0;
+}
+
+static void report(const char *mode, const char *what, double secs, int iters, size_t len) {
+    printf("%-26s %-7s %8.3f ms %9.1f MB/s\n", mode, what, secs * 1e3 / iters, len * iters / secs / 1e6);
+}
+
+static int bench(const char *mode, const struct nbt_buffer *nbt, const struct nbt_json_options *options, int iters) {
+    struct nbt_buffer out = { NULL, 0, 0 };
+    struct nbt_parsed parsed;
+
+    double start = now();
+    for (int i = 0; i < iters; ++i) {
+        out.length = 0;
+        if (nbt_json_write(nbt->data, nbt->length, &out, options) < 0) {
+            fprintf(stderr, "nbt_json_write: %s\n", nbt_error());
+            return -1;
+        }
+    }
+    report(mode, "export", now() - start, iters, nbt->length);
+
+    start = now();
+    for (int i = 0; i < iters; ++i) {
+        if (nbt_json_read((const char *)out.data, out.length, &parsed, options) < 0) {
+            fprintf(stderr, "nbt_json_read: %s\n", nbt_error());
+            return -1;
+        }
+        nbt_free_parsed(&parsed);
+    }
+    report(mode, "import", now() - start, iters, out.length);
+    printf("%-26s %zu bytes of JSON\n", mode, out.length);
+
+    nbt_buffer_free(&out);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int iters = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERS;
+    struct nbt_buffer nbt = { NULL, 0, 0 };
+
+    if (generate(&nbt) < 0) return 1;
+    printf("%d sections: %zu bytes of NBT\n", SECTIONS, nbt.length);
+
+    static const struct {
+        const char *name;
+        struct nbt_json_options options;
+    } modes[] = {
+        { "plain, numbers", { .arrays = NBT_JSON_ARRAY_NUMBERS } },
+        { "plain, numbers, longs \"\"", { .arrays = NBT_JSON_ARRAY_NUMBERS, .longs = NBT_JSON_LONG_STRING } },
+        { "plain, base64", { .arrays = NBT_JSON_ARRAY_BASE64 } },
+        { "typed, numbers", { .typed = true, .arrays = NBT_JSON_ARRAY_NUMBERS } },
+        { "typed, base64", { .typed = true, .arrays = NBT_JSON_ARRAY_BASE64 } },
+    };
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i)
+        if (bench(modes[i].name, &nbt, &modes[i].options, iters) < 0) return 1;
+
+    nbt_buffer_free(&nbt);
+    return 0;
+}
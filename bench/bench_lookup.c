@@ -0,0 +1,96 @@
+#include "nbt.h"
+#include "nbt_def.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Compares a strcmp walk of the entry list (what callers had to do before
+ * nbt_compound_get existed) against nbt_compound_get on compounds of
+ * increasing width. */
+
+#define LOOKUPS (1 << 20)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* root: TAG_Compound "" { TAG_Int "key0" .. TAG_Int "key<width-1>" } */
+static unsigned char *wide_compound(int width, size_t *len) {
+    unsigned char *buf = malloc(4 + (size_t)width * 24), *p = buf;
+
+    *p++ = 0x0a; *p++ = 0x00; *p++ = 0x00;
+    for (int i = 0; i < width; ++i) {
+        char name[16];
+        int namelen = snprintf(name, sizeof(name), "key%d", i);
+        *p++ = 0x03;
+        *p++ = 0x00; *p++ = (unsigned char)namelen;
+        memcpy(p, name, namelen);
+        p += namelen;
+        *p++ = 0x00; *p++ = 0x00; *p++ = (unsigned char)(i >> 8); *p++ = (unsigned char)i;
+    }
+    *p++ = 0x00;
+
+    *len = p - buf;
+    return buf;
+}
+
+static struct nbt_tag *linear_get(struct nbt_compound *compound, const char *name) {
+    for (struct nbt_compound_entry *cur = compound->first; cur; cur = cur->next)
+        if (strcmp(cur->name, name) == 0) return &cur->tag;
+    return NULL;
+}
+
+int main(void) {
+    static const int widths[] = { 4, 16, 64, 256, 1024, 4096 };
+
+    printf("%8s %14s %14s\n", "width", "linear ns/op", "hashed ns/op");
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        int width = widths[w];
+        size_t len;
+        unsigned char *data = wide_compound(width, &len);
+
+        struct nbt_parsed nbt;
+        if (nbt_read(data, len, &nbt) < 0) {
+            fprintf(stderr, "nbt_read: %s\n", nbt_error());
+            return 1;
+        }
+
+        char (*names)[16] = malloc(sizeof(*names) * width);
+        for (int i = 0; i < width; ++i) snprintf(names[i], sizeof(names[i]), "key%d", i);
+
+        unsigned seed = 12345;
+        long sum = 0;
+        double start = now();
+        for (int i = 0; i < LOOKUPS; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            sum += linear_get(nbt.root, names[(seed >> 8) % width])->value.tag_int;
+        }
+        double linear = now() - start;
+
+        seed = 12345;
+        start = now();
+        for (int i = 0; i < LOOKUPS; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            const char *name = names[(seed >> 8) % width];
+            sum -= nbt_compound_get(nbt.root, name, (nbt_strlen)strlen(name))->value.tag_int;
+        }
+        double hashed = now() - start;
+
+        if (sum != 0) {
+            fprintf(stderr, "lookup mismatch\n");
+            return 1;
+        }
+
+        printf("%8d %14.1f %14.1f\n", width, linear * 1e9 / LOOKUPS, hashed * 1e9 / LOOKUPS);
+
+        nbt_free_parsed(&nbt);
+        free(names);
+        free(data);
+    }
+
+    return 0;
+}
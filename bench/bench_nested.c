@@ -0,0 +1,151 @@
+#include "nbt.h"
+#include "nbt_def.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Parse and free throughput in nodes/second on deeply nested documents,
+ * where the per-node overhead of walking the tree dominates, from a bushy
+ * shallow tree down to chains 10000 levels deep. */
+
+#define ITERS (50)
+#define MAX_DEPTH (1u << 20)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct out {
+    unsigned char *p;
+};
+
+static void put8(struct out *o, unsigned v) { *o->p++ = (unsigned char)v; }
+static void put16(struct out *o, unsigned v) { put8(o, v >> 8); put8(o, v); }
+static void put32(struct out *o, unsigned v) { put16(o, v >> 16); put16(o, v); }
+static void putname(struct out *o, const char *name) {
+    size_t len = strlen(name);
+    put16(o, (unsigned)len);
+    memcpy(o->p, name, len);
+    o->p += len;
+}
+
+/* compound payload nested `depth` levels deep: { v: int, s: string, n: { ... } } */
+static void nested_compound(struct out *o, int depth) {
+    put8(o, 0x03); putname(o, "v"); put32(o, (unsigned)depth);
+    put8(o, 0x08); putname(o, "s"); putname(o, "abc");
+    if (depth > 0) {
+        put8(o, 0x0a); putname(o, "n");
+        nested_compound(o, depth - 1);
+    }
+    put8(o, 0x00);
+}
+
+/* list payload nested `depth` levels deep: [[[... [1, 2, 3] ...]]] */
+static void nested_list(struct out *o, int depth) {
+    if (depth == 0) {
+        put8(o, 0x03); put32(o, 3);
+        put32(o, 1); put32(o, 2); put32(o, 3);
+        return;
+    }
+    put8(o, 0x09); put32(o, 2);
+    nested_list(o, depth - 1);
+    nested_list(o, depth - 1);
+}
+
+/* chain of single-element lists nested `depth` levels deep: [[[... [1, 2, 3] ...]]] */
+static void chained_list(struct out *o, int depth) {
+    for (int i = 0; i < depth; ++i) {
+        put8(o, 0x09); put32(o, 1);
+    }
+    put8(o, 0x03); put32(o, 3);
+    put32(o, 1); put32(o, 2); put32(o, 3);
+}
+
+static int run(const char *what, const unsigned char *data, size_t len) {
+    struct nbt_stats stats = {0};
+    struct nbt_read_options opts = { .stats = &stats, .limits.max_depth = MAX_DEPTH };
+    struct nbt_parsed nbt;
+    if (nbt_read_ex(data, len, &nbt, &opts) < 0) {
+        fprintf(stderr, "%s: %s\n", what, nbt_error());
+        return -1;
+    }
+    nbt_free_parsed(&nbt);
+
+    long nodes = 0;
+    for (int i = 0; i <= NBT_TAG_LONG_ARRAY; ++i) nodes += (long)stats.nodes[i];
+    opts.stats = NULL;
+
+    double readsecs = 0, freesecs = 0;
+    for (int i = 0; i < ITERS; ++i) {
+        double start = now();
+        nbt_read_ex(data, len, &nbt, &opts);
+        double mid = now();
+        nbt_free_parsed(&nbt);
+        readsecs += mid - start;
+        freesecs += now() - mid;
+    }
+
+    /* with an arena, allocation drops out and the decoder itself is measured */
+    struct nbt_arena *arena = nbt_arena_new(0);
+    opts.arena = arena;
+    double start = now();
+    for (int i = 0; i < ITERS; ++i) {
+        nbt_read_ex(data, len, &nbt, &opts);
+        nbt_arena_reset(arena);
+    }
+    double arenasecs = now() - start;
+    nbt_arena_free(arena);
+
+    printf("%-26s %8ld nodes, depth %5u: read %7.2f, free %7.2f, arena read %7.2f Mnodes/s\n",
+           what, nodes, stats.max_depth, nodes * (double)ITERS / readsecs / 1e6,
+           nodes * (double)ITERS / freesecs / 1e6, nodes * (double)ITERS / arenasecs / 1e6);
+    return 0;
+}
+
+int main(void) {
+    unsigned char *buf = malloc(64u << 20);
+    struct out o;
+    int ret = 0;
+
+    /* 256 chains of 256 nested compounds */
+    o.p = buf;
+    put8(&o, 0x0a); putname(&o, "");
+    put8(&o, 0x09); putname(&o, "chains"); put8(&o, 0x0a); put32(&o, 256);
+    for (int i = 0; i < 256; ++i) nested_compound(&o, 256);
+    put8(&o, 0x00);
+    if (run("compounds, depth 256", buf, o.p - buf) < 0) ret = 1;
+
+    /* binary tree of lists, depth 16 */
+    o.p = buf;
+    put8(&o, 0x0a); putname(&o, "");
+    put8(&o, 0x09); putname(&o, "tree");
+    nested_list(&o, 16);
+    put8(&o, 0x00);
+    if (run("lists, depth 16 (binary)", buf, o.p - buf) < 0) ret = 1;
+
+    /* one chain of 4096 nested compounds */
+    o.p = buf;
+    put8(&o, 0x0a); putname(&o, "");
+    nested_compound(&o, 4096);
+    if (run("compounds, depth 4096", buf, o.p - buf) < 0) ret = 1;
+
+    /* the same 10000 levels deep, as compounds and as lists */
+    o.p = buf;
+    put8(&o, 0x0a); putname(&o, "");
+    nested_compound(&o, 10000);
+    if (run("compounds, depth 10000", buf, o.p - buf) < 0) ret = 1;
+
+    o.p = buf;
+    put8(&o, 0x0a); putname(&o, "");
+    put8(&o, 0x09); putname(&o, "chain");
+    chained_list(&o, 10000);
+    put8(&o, 0x00);
+    if (run("lists, depth 10000", buf, o.p - buf) < 0) ret = 1;
+
+    free(buf);
+    return ret;
+}
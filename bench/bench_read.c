@@ -0,0 +1,245 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_flat.h"
+#include "nbt_lazy.h"
+#include "nbt_push.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+/* Scales up a sample document by wrapping N copies of its root compound in a
+ * list, then times nbt_read() on the in-memory buffer (with and without an
+ * arena, and filtered down to one field per copy), a push-parser read fed
+ * in segment-sized pieces, a flat-document read and clone, and a lazy lookup of one field of the last copy against nbt_read_file() on raw and gzip-compressed
+ * copies of the same bytes and a zero-copy nbt_read_file_mapped() of the raw
+ * copy. Each timing includes freeing the tree. */
+
+#define DEFAULT_COPIES (4096)
+#define DEFAULT_ITERS  (20)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *slurp(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    size_t cap = 4096, n = 0;
+    unsigned char *buf = malloc(cap);
+    size_t nread;
+    while ((nread = fread(buf + n, 1, cap - n, fp)) > 0) {
+        n += nread;
+        if (n == cap) buf = realloc(buf, cap *= 2);
+    }
+    fclose(fp);
+
+    *len = n;
+    return buf;
+}
+
+/* root: TAG_Compound "" { TAG_List "copies" [TAG_Compound x copies] } */
+static unsigned char *scale(const unsigned char *in, size_t inlen, int copies, size_t *outlen) {
+    size_t namelen = ((size_t)in[1] << 8) | in[2];
+    const unsigned char *payload = in + 3 + namelen;
+    size_t paylen = inlen - 3 - namelen;
+
+    static const unsigned char head[] = {
+        0x0a, 0x00, 0x00,
+        0x09, 0x00, 0x06, 'c', 'o', 'p', 'i', 'e', 's', 0x0a
+    };
+
+    *outlen = sizeof(head) + 4 + paylen * copies + 1;
+    unsigned char *out = malloc(*outlen), *p = out;
+
+    memcpy(p, head, sizeof(head));
+    p += sizeof(head);
+    *p++ = (unsigned char)(copies >> 24);
+    *p++ = (unsigned char)(copies >> 16);
+    *p++ = (unsigned char)(copies >> 8);
+    *p++ = (unsigned char)copies;
+    for (int i = 0; i < copies; ++i, p += paylen)
+        memcpy(p, payload, paylen);
+    *p = 0x00;
+
+    return out;
+}
+
+static void report(const char *what, double secs, int iters, size_t len) {
+    printf("%-24s %8.3f ms/parse %9.1f MB/s\n", what, secs * 1e3 / iters, len * iters / secs / 1e6);
+}
+
+static int bench_file(const char *what, const char *path, int iters, size_t len) {
+    struct nbt_parsed nbt;
+    double start = now();
+    for (int i = 0; i < iters; ++i) {
+        FILE *fp = fopen(path, "rb");
+        if (nbt_read_file(fp, &nbt) < 0) {
+            fprintf(stderr, "%s: %s\n", what, nbt_error());
+            fclose(fp);
+            return -1;
+        }
+        fclose(fp);
+        nbt_free_parsed(&nbt);
+    }
+    report(what, now() - start, iters, len);
+    return 0;
+}
+
+static int bench_mapped(const char *what, const char *path, int iters, size_t len) {
+    struct nbt_arena *arena = nbt_arena_new(0);
+    struct nbt_read_options opts = { .arena = arena };
+    struct nbt_parsed nbt;
+    double start = now();
+    for (int i = 0; i < iters; ++i) {
+        FILE *fp = fopen(path, "rb");
+        if (nbt_read_file_mapped(fp, &nbt, &opts) < 0) {
+            fprintf(stderr, "%s: %s\n", what, nbt_error());
+            fclose(fp);
+            nbt_arena_free(arena);
+            return -1;
+        }
+        fclose(fp);
+        nbt_free_parsed(&nbt);
+        nbt_arena_reset(arena);
+    }
+    report(what, now() - start, iters, len);
+    nbt_arena_free(arena);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <uncompressed.nbt> [copies] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int copies = argc > 2 ? atoi(argv[2]) : DEFAULT_COPIES;
+    int iters = argc > 3 ? atoi(argv[3]) : DEFAULT_ITERS;
+
+    size_t inlen, len;
+    unsigned char *in = slurp(argv[1], &inlen);
+    if (!in || inlen < 4 || in[0] != 0x0a) {
+        fprintf(stderr, "%s: not an uncompressed NBT file\n", argv[1]);
+        return 1;
+    }
+
+    unsigned char *data = scale(in, inlen, copies, &len);
+    printf("input: %d copies of %s, %zu bytes (inflating with %s)\n", copies, argv[1], len, nbt_decompressor());
+
+    char rawpath[] = "/tmp/nbt_bench_XXXXXX";
+    char gzpath[] = "/tmp/nbt_bench_gz_XXXXXX";
+    FILE *fp = fdopen(mkstemp(rawpath), "wb");
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+
+    gzFile gz = gzdopen(mkstemp(gzpath), "wb");
+    gzwrite(gz, data, (unsigned)len);
+    gzclose(gz);
+
+    struct nbt_parsed nbt;
+    double start = now();
+    for (int i = 0; i < iters; ++i) {
+        if (nbt_read(data, len, &nbt) < 0) {
+            fprintf(stderr, "nbt_read: %s\n", nbt_error());
+            return 1;
+        }
+        nbt_free_parsed(&nbt);
+    }
+    report("nbt_read (memory)", now() - start, iters, len);
+
+    struct nbt_arena *arena = nbt_arena_new(0);
+    struct nbt_read_options opts = { .arena = arena };
+    start = now();
+    for (int i = 0; i < iters; ++i) {
+        if (nbt_read_ex(data, len, &nbt, &opts) < 0) {
+            fprintf(stderr, "nbt_read_ex: %s\n", nbt_error());
+            return 1;
+        }
+        nbt_arena_reset(arena);
+    }
+    report("nbt_read (arena)", now() - start, iters, len);
+
+    /* the same tree built from input arriving in TCP-segment-sized pieces */
+    struct nbt_push *push = nbt_push_new_tree(&opts);
+    start = now();
+    for (int i = 0; i < iters; ++i) {
+        int r = NBT_PUSH_MORE;
+        for (size_t off = 0; off < len && r == NBT_PUSH_MORE; off += 1460) {
+            size_t used;
+            r = nbt_push_feed(push, data + off, len - off < 1460 ? len - off : 1460, &used);
+        }
+        if (r != NBT_PUSH_DONE || nbt_push_result(push, &nbt) < 0) {
+            fprintf(stderr, "nbt_push_feed: %s\n", nbt_error());
+            return 1;
+        }
+        nbt_push_reset(push);
+        nbt_arena_reset(arena);
+    }
+    report("nbt_push (arena)", now() - start, iters, len);
+    nbt_push_free(push);
+    nbt_arena_free(arena);
+
+    struct nbt_flat *flat = NULL;
+    start = now();
+    for (int i = 0; i < iters; ++i) {
+        nbt_flat_free(flat);
+        if (!(flat = nbt_flat_read(data, len, NULL))) {
+            fprintf(stderr, "nbt_flat_read: %s\n", nbt_error());
+            return 1;
+        }
+    }
+    report("nbt_flat_read", now() - start, iters, len);
+
+    start = now();
+    for (int i = 0; i < iters; ++i)
+        nbt_flat_free(nbt_flat_clone(flat));
+    report("nbt_flat_clone", now() - start, iters, len);
+    printf("flat document: %u nodes, %zu bytes resident\n", flat->nnodes, flat->footprint);
+    nbt_flat_free(flat);
+
+    /* one scalar per copy; every other value is skipped undecoded */
+    static const char *const paths[] = { "copies.intTest" };
+    struct nbt_read_options filtered = { .paths = paths, .npaths = 1 };
+    start = now();
+    for (int i = 0; i < iters; ++i) {
+        if (nbt_read_ex(data, len, &nbt, &filtered) < 0) {
+            fprintf(stderr, "nbt_read_ex: %s\n", nbt_error());
+            return 1;
+        }
+        nbt_free_parsed(&nbt);
+    }
+    report("nbt_read (filtered)", now() - start, iters, len);
+
+    /* time to first field: open lazily and decode a single scalar */
+    char lastfield[64];
+    snprintf(lastfield, sizeof(lastfield), "copies[%d].intTest", copies - 1);
+    start = now();
+    for (int i = 0; i < iters; ++i) {
+        struct nbt_lazy *doc = nbt_lazy_open(data, len, NULL);
+        if (!doc || !nbt_lazy_get(doc, lastfield)) {
+            fprintf(stderr, "nbt_lazy_get: %s\n", nbt_error());
+            return 1;
+        }
+        nbt_lazy_close(doc);
+    }
+    report("nbt_lazy_get (one field)", now() - start, iters, len);
+
+    int ret = 0;
+    if (bench_file("nbt_read_file (raw)", rawpath, iters, len) < 0) ret = 1;
+    if (bench_file("nbt_read_file (gzip)", gzpath, iters, len) < 0) ret = 1;
+    if (bench_mapped("nbt_read_file_mapped", rawpath, iters, len) < 0) ret = 1;
+
+    remove(rawpath);
+    remove(gzpath);
+    free(data);
+    free(in);
+
+    return ret;
+}
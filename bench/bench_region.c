@@ -0,0 +1,203 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_pool.h"
+#include "nbt_region.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+/* Writes a synthetic region file of 1024 zlib-compressed chunks shaped like
+ * real ones (24 sections with block state palettes and packed long arrays,
+ * light arrays, heightmaps) and times nbt_region_read_all() on it with
+ * pools of 1, 2, 4, ... threads up to the CPU count. */
+
+#define ITERS    (3)
+#define SECTIONS (24)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct out {
+    unsigned char *p;
+};
+
+static void put8(struct out *o, unsigned v) { *o->p++ = (unsigned char)v; }
+static void put16(struct out *o, unsigned v) { put8(o, v >> 8); put8(o, v); }
+static void put32(struct out *o, unsigned v) { put16(o, v >> 16); put16(o, v); }
+static void put64(struct out *o, unsigned long long v) { put32(o, (unsigned)(v >> 32)); put32(o, (unsigned)v); }
+static void putname(struct out *o, const char *name) {
+    size_t len = strlen(name);
+    put16(o, (unsigned)len);
+    memcpy(o->p, name, len);
+    o->p += len;
+}
+static void tag(struct out *o, unsigned type, const char *name) { put8(o, type); putname(o, name); }
+
+static unsigned long long rng = 0x9e3779b97f4a7c15ull;
+static unsigned long long next(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/* packed palette indices: a few bits of entropy per entry, like terrain */
+static void long_array(struct out *o, const char *name, int len) {
+    tag(o, 0x0c, name);
+    put32(o, (unsigned)len);
+    for (int i = 0; i < len; ++i)
+        put64(o, next() & 0x1111111111111111ull);
+}
+
+static void byte_array(struct out *o, const char *name, int len) {
+    tag(o, 0x07, name);
+    put32(o, (unsigned)len);
+    for (int i = 0; i < len; ++i)
+        put8(o, (unsigned)(next() & 0x0f));
+}
+
+static void chunk(struct out *o, int x, int z) {
+    static const char *const blocks[] = {
+        "minecraft:stone", "minecraft:dirt", "minecraft:grass_block", "minecraft:deepslate",
+        "minecraft:water", "minecraft:coal_ore", "minecraft:iron_ore", "minecraft:air",
+    };
+
+    tag(o, 0x0a, "");
+    tag(o, 0x03, "DataVersion"); put32(o, 3465);
+    tag(o, 0x03, "xPos"); put32(o, (unsigned)x);
+    tag(o, 0x03, "zPos"); put32(o, (unsigned)z);
+    tag(o, 0x08, "Status"); putname(o, "minecraft:full");
+    tag(o, 0x04, "LastUpdate"); put64(o, 123456789);
+
+    tag(o, 0x09, "sections");
+    put8(o, 0x0a); put32(o, SECTIONS);
+    for (int s = 0; s < SECTIONS; ++s) {
+        tag(o, 0x01, "Y"); put8(o, (unsigned)(s - 4));
+
+        tag(o, 0x0a, "block_states");
+        tag(o, 0x09, "palette");
+        put8(o, 0x0a); put32(o, 8);
+        for (int b = 0; b < 8; ++b) {
+            tag(o, 0x08, "Name"); putname(o, blocks[b]);
+            put8(o, 0x00);
+        }
+        long_array(o, "data", 256);
+        put8(o, 0x00);
+
+        tag(o, 0x0a, "biomes");
+        tag(o, 0x09, "palette");
+        put8(o, 0x08); put32(o, 2);
+        putname(o, "minecraft:plains");
+        putname(o, "minecraft:river");
+        long_array(o, "data", 1);
+        put8(o, 0x00);
+
+        byte_array(o, "BlockLight", 2048);
+        byte_array(o, "SkyLight", 2048);
+        put8(o, 0x00);
+    }
+
+    tag(o, 0x0a, "Heightmaps");
+    long_array(o, "MOTION_BLOCKING", 37);
+    long_array(o, "WORLD_SURFACE", 37);
+    put8(o, 0x00);
+
+    put8(o, 0x00);
+}
+
+static int write_region(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return -1;
+
+    unsigned char header[2 * NBT_REGION_SECTOR_SIZE] = { 0 };
+    unsigned char *raw = malloc(1 << 20);
+    unsigned char *packed = malloc(compressBound(1 << 20) + 5);
+    unsigned sector = 2;
+
+    fseek(fp, sizeof(header), SEEK_SET);
+    for (int i = 0; i < NBT_REGION_CHUNKS; ++i) {
+        struct out o = { raw };
+        chunk(&o, i % 32, i / 32);
+
+        uLongf packedlen = compressBound(1 << 20);
+        compress2(packed + 5, &packedlen, raw, (uLong)(o.p - raw), Z_DEFAULT_COMPRESSION);
+
+        struct out h = { packed };
+        put32(&h, (unsigned)packedlen + 1);
+        put8(&h, NBT_REGION_ZLIB);
+
+        size_t sectors = (packedlen + 5 + NBT_REGION_SECTOR_SIZE - 1) / NBT_REGION_SECTOR_SIZE;
+        memset(packed + 5 + packedlen, 0, sectors * NBT_REGION_SECTOR_SIZE - packedlen - 5);
+        fwrite(packed, 1, sectors * NBT_REGION_SECTOR_SIZE, fp);
+
+        struct out loc = { header + 4 * i };
+        put32(&loc, (sector << 8) | (unsigned)sectors);
+        struct out ts = { header + NBT_REGION_SECTOR_SIZE + 4 * i };
+        put32(&ts, 1700000000u + (unsigned)i);
+        sector += (unsigned)sectors;
+    }
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), fp);
+    fclose(fp);
+
+    free(raw);
+    free(packed);
+    return 0;
+}
+
+int main(void) {
+    char path[] = "/tmp/nbt_bench_region_XXXXXX";
+    close(mkstemp(path));
+
+    if (write_region(path) < 0) {
+        fprintf(stderr, "%s: cannot write synthetic region\n", path);
+        return 1;
+    }
+
+    struct nbt_region *region = nbt_region_open(path, NULL);
+    if (!region) {
+        fprintf(stderr, "%s\n", nbt_error());
+        return 1;
+    }
+
+    struct nbt_parsed *results = calloc(NBT_REGION_CHUNKS, sizeof(struct nbt_parsed));
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int ret = 0;
+
+    for (long threads = 1; threads <= ncpu; threads = threads < ncpu && threads * 2 > ncpu ? ncpu : threads * 2) {
+        struct nbt_pool *pool = nbt_pool_new((unsigned)threads);
+        struct nbt_region_batch_options opts = { .pool = pool };
+        double secs = 0;
+
+        for (int i = 0; i < ITERS; ++i) {
+            double start = now();
+            int failed = nbt_region_read_all(region, results, &opts);
+            secs += now() - start;
+
+            if (failed) {
+                fprintf(stderr, "%d chunk(s) failed: %s\n", failed, nbt_error());
+                ret = 1;
+            }
+            for (int c = 0; c < NBT_REGION_CHUNKS; ++c)
+                nbt_free_parsed(&results[c]);
+        }
+
+        printf("%2ld thread(s) %10.0f chunks/s\n", threads, NBT_REGION_CHUNKS * ITERS / secs);
+        nbt_pool_free(pool);
+    }
+
+    free(results);
+    nbt_region_close(region);
+    remove(path);
+
+    return ret;
+}
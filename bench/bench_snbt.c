@@ -0,0 +1,138 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_snbt.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Times SNBT output (compact and pretty) and parsing on two generated
+ * documents: an entity list, which is mostly keys, small numbers and
+ * floats, and a set of chunk-sized long, int and byte arrays, which is
+ * all integer formatting. Rates are in MB of SNBT text. */
+
+#define DEFAULT_ITERS (10)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* xorshift64*, fixed seed */
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static struct nbt_buffer text;
+
+static void put(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void put(const char *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(NULL, 0, fmt, va);
+    va_end(va);
+
+    if (nbt_buffer_reserve(&text, (size_t)len + 1) < 0) {
+        fprintf(stderr, "out of memory generating SNBT\n");
+        exit(1);
+    }
+
+    va_start(va, fmt);
+    vsnprintf((char *)text.data + text.length, (size_t)len + 1, fmt, va);
+    va_end(va);
+    text.length += (size_t)len;
+}
+
+static void gen_entities(void) {
+    static const char *const ids[] = { "minecraft:zombie", "minecraft:cow", "minecraft:item", "minecraft:arrow" };
+
+    put("{Entities:[");
+    for (int i = 0; i < 20000; ++i) {
+        put("%s{id:\"%s\",Pos:[%.3fd,%.1fd,%.3fd],Motion:[0.0d,%.4fd,0.0d],Rotation:[%.2ff,%.2ff],",
+            i ? "," : "", ids[rng() % 4], (double)(rng() % 100000) / 37.0, (double)(rng() % 256),
+            (double)(rng() % 100000) / 41.0, -(double)(rng() % 1000) / 1e4, (double)(rng() % 36000) / 100.0,
+            (double)(rng() % 18000) / 100.0 - 90.0);
+        put("Health:%df,Fire:-1s,Air:300s,OnGround:%db,UUID:[I;%d,%d,%d,%d],Tags:[\"spawned\",\"wave_%d\"]}",
+            (int)(rng() % 20) + 1, (int)(rng() % 2), (int32_t)rng(), (int32_t)rng(), (int32_t)rng(),
+            (int32_t)rng(), (int)(rng() % 10));
+    }
+    put("]}");
+}
+
+static void gen_arrays(void) {
+    put("{Sections:[");
+    for (int s = 0; s < 24; ++s) {
+        put("%s{Y:%db,BlockStates:[L;", s ? "," : "", s - 4);
+        for (int i = 0; i < 4096; ++i) put("%s%lldL", i ? "," : "", (long long)rng());
+        put("],Biomes:[I;");
+        for (int i = 0; i < 1024; ++i) put("%s%d", i ? "," : "", (int)(rng() % 64));
+        put("],SkyLight:[B;");
+        for (int i = 0; i < 2048; ++i) put("%s%db", i ? "," : "", (int)(int8_t)rng());
+        put("]}");
+    }
+    put("]}");
+}
+
+static void report(const char *doc, const char *what, double secs, int iters, size_t len) {
+    printf("%-9s %-16s %8.3f ms %9.1f MB/s\n", doc, what, secs * 1e3 / iters, len * iters / secs / 1e6);
+}
+
+static int bench(const char *doc, int iters) {
+    struct nbt_parsed nbt;
+    struct nbt_buffer out = { NULL, 0, 0 };
+    size_t len = text.length;
+
+    double start = now();
+    for (int i = 0; i < iters; ++i) {
+        if (nbt_snbt_read((const char *)text.data, len, &nbt, NULL) < 0) {
+            fprintf(stderr, "nbt_snbt_read: %s\n", nbt_error());
+            return -1;
+        }
+        if (i + 1 < iters) nbt_free_parsed(&nbt);
+    }
+    report(doc, "read", now() - start, iters, len);
+
+    static const struct nbt_snbt_options compact = { .pretty = false }, pretty = { .pretty = true };
+    const struct nbt_snbt_options *modes[] = { &compact, &pretty };
+    for (int m = 0; m < 2; ++m) {
+        start = now();
+        for (int i = 0; i < iters; ++i) {
+            out.length = 0;
+            if (nbt_snbt_write(&nbt, &out, modes[m]) < 0) {
+                fprintf(stderr, "nbt_snbt_write: %s\n", nbt_error());
+                return -1;
+            }
+        }
+        report(doc, m ? "write (pretty)" : "write (compact)", now() - start, iters, out.length);
+    }
+
+    nbt_buffer_free(&out);
+    nbt_free_parsed(&nbt);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int iters = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERS;
+
+    gen_entities();
+    printf("entities: %zu bytes of SNBT\n", text.length);
+    if (bench("entities", iters) < 0) return 1;
+
+    text.length = 0;
+    gen_arrays();
+    printf("arrays: %zu bytes of SNBT\n", text.length);
+    if (bench("arrays", iters) < 0) return 1;
+
+    nbt_buffer_free(&text);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "nbt_endian.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Per-element nbt_endian_be2h_* calls against the bulk array kernel, on an
+ * 8 MiB buffer (the size of a large TAG_Long_Array). */
+
+#define BUF_BYTES (8u << 20)
+#define ROUNDS    (50)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define O(_ctype, _bits)                                                 \
+static void per_element_ ## _bits(void *buf, size_t count) {             \
+    _ctype *p = buf;                                                     \
+    for (size_t i = 0; i < count; ++i)                                   \
+        p[i] = nbt_endian_be2h_ ## _bits(p[i]);                          \
+}
+
+O(int16_t, s16)
+O(int32_t, s32)
+O(int64_t, s64)
+#undef O
+
+static void report(const char *what, size_t width, double secs) {
+    printf("%-22s %zu-bit %8.2f GB/s\n", what, width * 8, (double)BUF_BYTES * ROUNDS / secs / 1e9);
+}
+
+int main(void) {
+    unsigned char *buf = malloc(BUF_BYTES);
+    for (size_t i = 0; i < BUF_BYTES; ++i) buf[i] = (unsigned char)(i * 131);
+
+    static void (*const per_element[])(void *, size_t) = { per_element_s16, per_element_s32, per_element_s64 };
+    static const size_t widths[] = { 2, 4, 8 };
+
+    printf("bulk kernel: %s\n", nbt_endian_array_impl());
+    unsigned long check = 0;
+    for (int w = 0; w < 3; ++w) {
+        size_t count = BUF_BYTES / widths[w];
+
+        double start = now();
+        for (int r = 0; r < ROUNDS; ++r) per_element[w](buf, count);
+        report("per-element", widths[w], now() - start);
+        check += buf[w];
+
+        start = now();
+        for (int r = 0; r < ROUNDS; ++r) nbt_endian_be2h_array(buf, count, widths[w]);
+        report("nbt_endian_be2h_array", widths[w], now() - start);
+        check += buf[w];
+    }
+
+    /* keeps the loops from being optimized away */
+    printf("checksum %lu\n", check);
+    free(buf);
+    return 0;
+}
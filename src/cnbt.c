@@ -1,69 +1,321 @@
 #include "nbt.h"
+#include "nbt_batch.h"
 #include "nbt_def.h"
+#include "nbt_json.h"
+#include "nbt_pool.h"
+#include "nbt_snbt.h"
 
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-void print_tag(nbt_type type, nbt_value value) {
-    switch (type) {
-        case NBT_TAG_BYTE:
-            printf("TAG_BYTE\n");
-            break;
-        case NBT_TAG_SHORT:
-            printf("TAG_SHORT\n");
-            break;
-        case NBT_TAG_INT:
-            printf("TAG_INT\n");
-            break;
-        case NBT_TAG_LONG:
-            printf("TAG_LONG\n");
-            break;
-        case NBT_TAG_FLOAT:
-            printf("TAG_FLOAT\n");
-            break;
-        case NBT_TAG_DOUBLE:
-            printf("TAG_DOUBLE\n");
-            break;
-        case NBT_TAG_BYTE_ARRAY:
-            printf("TAG_BYTE_ARRAY\n");
-            break;
-        case NBT_TAG_STRING:
-            printf("TAG_STRING\n");
-            break;
-        case NBT_TAG_LIST:
-            printf("TAG_LIST (%02hhx %d)\n", value.tag_list->type, value.tag_list->length);
-            break;
-        case NBT_TAG_COMPOUND:
-            printf("TAG_COMPOUND\n");
-            for (struct nbt_compound_entry *cur = value.tag_compound->first; cur; cur = cur->next) {
-                printf("%s : ", cur->name);
-                print_tag(cur->tag.type, cur->tag.value);
+#include <sys/stat.h>
+
+/* Binary NBT starts with a type byte or a compression header, SNBT with
+ * a '{' after any whitespace. */
+bool is_snbt(FILE *file) {
+    int c;
+    while ((c = getc(file)) == ' ' || c == '\t' || c == '\n' || c == '\r');
+    rewind(file);
+    return c == '{';
+}
+
+int print_snbt(const struct nbt_parsed *nbt, bool pretty) {
+    struct nbt_snbt_options options = { .pretty = pretty };
+    struct nbt_buffer buf = { NULL, 0, 0 };
+
+    if (nbt_snbt_write(nbt, &buf, &options) < 0 || nbt_buffer_reserve(&buf, 1) < 0) {
+        fprintf(stderr, "%s\n", nbt_error());
+        nbt_buffer_free(&buf);
+        return 1;
+    }
+    buf.data[buf.length++] = '\n';
+
+    fwrite(buf.data, 1, buf.length, stdout);
+    nbt_buffer_free(&buf);
+    return 0;
+}
+
+/* cnbt to-json [options] <in.nbt> [out.json]: streams the file out as JSON
+ * without building a tree. */
+int to_json(int argc, char **argv) {
+    struct nbt_json_options options = { .pretty = true };
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (strcmp(argv[arg], "--typed") == 0) options.typed = true;
+        else if (strcmp(argv[arg], "--base64") == 0) options.arrays = NBT_JSON_ARRAY_BASE64;
+        else if (strcmp(argv[arg], "--long-strings") == 0) options.longs = NBT_JSON_LONG_STRING;
+        else if (strcmp(argv[arg], "--compact") == 0) options.pretty = false;
+        else break;
+    }
+
+    if (arg >= argc) {
+        fprintf(stderr, "usage: cnbt to-json [--typed] [--base64] [--long-strings] [--compact] <in.nbt> [out.json]\n");
+        return 2;
+    }
+
+    FILE *in = fopen(argv[arg], "rb");
+    if (!in) {
+        perror(argv[arg]);
+        return 1;
+    }
+
+    FILE *out = arg + 1 < argc ? fopen(argv[arg + 1], "wb") : stdout;
+    if (!out) {
+        perror(argv[arg + 1]);
+        fclose(in);
+        return 1;
+    }
+
+    int ret = nbt_json_write_file(in, out, &options);
+    if (ret < 0) fprintf(stderr, "%s: %s\n", argv[arg], nbt_error());
+    else fputc('\n', out);
+
+    fclose(in);
+    if (out != stdout) fclose(out);
+    return ret < 0 ? 1 : 0;
+}
+
+/* cnbt from-json [--typed] <in.json> <out.nbt> */
+int from_json(int argc, char **argv) {
+    struct nbt_json_options options = { 0 };
+    int arg = 1;
+
+    if (arg < argc && strcmp(argv[arg], "--typed") == 0) {
+        options.typed = true;
+        ++arg;
+    }
+
+    if (arg + 1 >= argc) {
+        fprintf(stderr, "usage: cnbt from-json [--typed] <in.json> <out.nbt>\n");
+        return 2;
+    }
+
+    FILE *in = fopen(argv[arg], "rb");
+    if (!in) {
+        perror(argv[arg]);
+        return 1;
+    }
+
+    struct nbt_parsed nbt;
+    int ret = nbt_json_read_file(in, &nbt, &options);
+    fclose(in);
+
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s\n", argv[arg], nbt_error());
+        return 1;
+    }
+
+    struct nbt_write_options wopts = { .compression = NBT_COMPRESSION_GZIP };
+    FILE *out = fopen(argv[arg + 1], "wb");
+    if (!out) {
+        perror(argv[arg + 1]);
+        ret = -1;
+    } else {
+        ret = nbt_write_file(out, &nbt, &wopts);
+        if (ret < 0) fprintf(stderr, "%s: %s\n", argv[arg + 1], nbt_error());
+        fclose(out);
+    }
+
+    nbt_free_parsed(&nbt);
+    return ret < 0 ? 1 : 0;
+}
+
+struct load_stats {
+    atomic_size_t bytes;
+    atomic_size_t failed;
+};
+
+void load_done(void *user, struct nbt_batch_item *item) {
+    struct load_stats *stats = user;
+
+    atomic_fetch_add(&stats->bytes, item->size);
+    if (item->ret < 0) {
+        /* keep the first few failures readable */
+        if (atomic_fetch_add(&stats->failed, 1) < 10)
+            fprintf(stderr, "%s: %s\n", item->path, item->error.message);
+        return;
+    }
+
+    nbt_free_parsed(&item->result);
+}
+
+/* Loads every regular file in `dir` on `threads` threads (0 for one per
+ * CPU) and reports the throughput. */
+int load_directory(const char *dir, unsigned threads) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return 1;
+    }
+
+    char **paths = NULL;
+    size_t count = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        struct stat st;
+        char *path = malloc(strlen(dir) + strlen(ent->d_name) + 2);
+        if (!path) break;
+        sprintf(path, "%s/%s", dir, ent->d_name);
+
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **temp = realloc(paths, cap * sizeof(char *));
+            if (!temp) {
+                free(path);
+                break;
             }
-            printf("TAG_END\n");
-            break;
-        case NBT_TAG_INT_ARRAY:
-            printf("TAG_INT_ARRAY\n");
-            break;
-        case NBT_TAG_LONG_ARRAY:
-            printf("TAG_LONG_ARRAY\n");
-            break;
+            paths = temp;
+        }
+        paths[count++] = path;
     }
+    closedir(d);
+
+    struct nbt_pool *pool = nbt_pool_new(threads);
+    if (!pool) {
+        fprintf(stderr, "%s\n", nbt_error());
+        return 1;
+    }
+
+    struct load_stats stats = { 0 };
+    struct nbt_batch_options options = {
+        .pool = pool,
+        .callback = &load_done,
+        .user = &stats,
+    };
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t failed = nbt_batch_load_paths((const char *const *)paths, count, &options);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    double mb = (double)atomic_load(&stats.bytes) / (1024.0 * 1024.0);
+    printf("%zu files (%zu failed), %.1f MB in %.3f s on %u threads: %.0f files/s, %.1f MB/s\n",
+           count, failed, mb, secs, nbt_pool_threads(pool),
+           secs > 0 ? (double)count / secs : 0.0, secs > 0 ? mb / secs : 0.0);
+
+    nbt_pool_free(pool);
+    for (size_t i = 0; i < count; ++i) free(paths[i]);
+    free(paths);
+
+    return failed ? 1 : 0;
+}
+
+static const char *const trace_events[] = { "inflate", "parse", "free" };
+
+void trace(void *user, int event, bool begin, size_t bytes) {
+    struct timespec ts;
+    (void)user;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    fprintf(stderr, "[%ld.%09ld] %s %s (%zu bytes)\n", (long)ts.tv_sec, ts.tv_nsec,
+            trace_events[event], begin ? "begin" : "end", bytes);
+}
+
+void print_stats(const struct nbt_stats *stats) {
+    static const char *const names[] = {
+        "end", "byte", "short", "int", "long", "float", "double",
+        "byte_array", "string", "list", "compound", "int_array", "long_array",
+    };
+
+    size_t total = 0;
+    for (int i = 0; i <= NBT_TAG_LONG_ARRAY; ++i) total += stats->nodes[i];
+
+    printf("bytes: %zu read, %zu inflated, %zu parsed\n", stats->bytes_read, stats->bytes_inflated, stats->bytes_parsed);
+    printf("time: %.3f ms read, %.3f ms inflate, %.3f ms decode\n",
+           stats->read_ns / 1e6, stats->inflate_ns / 1e6, stats->decode_ns / 1e6);
+    printf("nodes: %zu (max depth %u)\n", total, stats->max_depth);
+    for (int i = 1; i <= NBT_TAG_LONG_ARRAY; ++i)
+        if (stats->nodes[i]) printf("  %-10s %zu\n", names[i], stats->nodes[i]);
+    printf("allocations: %zu, %zu bytes\n", stats->allocs, stats->alloc_bytes);
 }
 
 int main(int argc, char **argv) {
-    FILE *file = fopen(argv[1], "rb");
+    struct nbt_stats stats = { 0 };
+    struct nbt_read_options options = { 0 };
+    const char *output = NULL;
+    bool pretty = true;
+    struct stat st;
+    int arg = 1;
+
+    if (argc > 1 && strcmp(argv[1], "to-json") == 0) return to_json(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "from-json") == 0) return from_json(argc - 1, argv + 1);
+
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (strcmp(argv[arg], "--stats") == 0) {
+            options.stats = &stats;
+        } else if (strcmp(argv[arg], "--trace") == 0) {
+            if (nbt_set_trace_hook(&trace, NULL) < 0) {
+                fprintf(stderr, "%s\n", nbt_error());
+                return 2;
+            }
+        } else if (strcmp(argv[arg], "--compact") == 0) {
+            pretty = false;
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            output = argv[++arg];
+        } else {
+            break;
+        }
+    }
+
+    if (arg >= argc) {
+        fprintf(stderr, "usage: %s [--stats] [--trace] [--compact] [-o out.nbt] <file>\n"
+                        "       %s [--trace] <directory> [threads]\n"
+                        "       %s to-json [--typed] [--base64] [--long-strings] [--compact] <in.nbt> [out.json]\n"
+                        "       %s from-json [--typed] <in.json> <out.nbt>\n"
+                        "Prints an NBT or SNBT file as SNBT, or with -o writes it as gzipped NBT.\n",
+                argv[0], argv[0], argv[0], argv[0]);
+        return 2;
+    }
+
+    if (stat(argv[arg], &st) == 0 && S_ISDIR(st.st_mode))
+        return load_directory(argv[arg], arg + 1 < argc ? (unsigned)strtoul(argv[arg + 1], NULL, 10) : 0);
+
+    FILE *file = fopen(argv[arg], "rb");
+    if (!file) {
+        perror(argv[arg]);
+        return 1;
+    }
+
     struct nbt_parsed nbt;
-    int ret = nbt_read_file(file, &nbt);
+    int ret = is_snbt(file) ? nbt_snbt_read_file(file, &nbt, &options) : nbt_read_file_ex(file, &nbt, &options);
     fclose(file);
 
-    printf("%d %s\n", ret, nbt_error());
-    if (ret < 0) return 0;
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s\n", argv[arg], nbt_error());
+        return 1;
+    }
 
-    nbt_value val = {.tag_compound = nbt.root};
-    print_tag(NBT_TAG_COMPOUND, val);
+    if (output) {
+        struct nbt_write_options wopts = { .compression = NBT_COMPRESSION_GZIP };
+        FILE *out = fopen(output, "wb");
+        if (!out) {
+            perror(output);
+            ret = 1;
+        } else {
+            if (nbt_write_file(out, &nbt, &wopts) < 0) {
+                fprintf(stderr, "%s: %s\n", output, nbt_error());
+                ret = 1;
+            }
+            fclose(out);
+        }
+    } else if (options.stats) {
+        print_stats(&stats);
+    } else {
+        ret = print_snbt(&nbt, pretty);
+    }
 
-    free(nbt.name);
-    nbt_free_compound(nbt.root);
+    nbt_free_parsed(&nbt);
 
-    return 0;
+    return ret;
 }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h> /* for FILE */
 #include <stdbool.h>
+#include <stddef.h> /* for size_t */
 
 #include "nbt_def.h"
 
@@ -18,12 +19,182 @@ void nbt_free_long_array(struct nbt_long_array *array);
 
 void nbt_free_tag(struct nbt_tag *tag);
 
+/* Frees everything owned by `parsed`. Trees read into an arena are released
+ * by resetting or freeing the arena instead; this only forgets them. */
+void nbt_free_parsed(struct nbt_parsed *parsed);
+
+/* Bump allocator for parsed trees. Every node, name and payload of a tree
+ * read with nbt_read_options.arena set comes from the arena, so the whole
+ * tree is released at once by nbt_arena_reset() (which keeps the blocks for
+ * the next parse) or nbt_arena_free(). Do not pass arena-backed nodes to
+ * the nbt_free_* functions. */
+struct nbt_arena;
+
+struct nbt_arena *nbt_arena_new(size_t blocksize); /* 0 for the default */
+void *nbt_arena_alloc(struct nbt_arena *arena, size_t size);
+void nbt_arena_reset(struct nbt_arena *arena);
+void nbt_arena_free(struct nbt_arena *arena);
+
+/* Size of the C representation of a value of `type` (the element width of
+ * list storage), or 0 for TAG_End and unknown types. */
+size_t nbt_type_size(nbt_type type);
+
+nbt_int nbt_list_length(const struct nbt_list *list);
+nbt_value nbt_list_get(const struct nbt_list *list, nbt_int index); /* zero value if out of range */
+
+/* Name lookup. Compounds with at least NBT_COMPOUND_INDEX_MIN entries get a
+ * hash index, built on the first lookup (or at parse time for trees read
+ * into an arena); smaller ones are scanned comparing precomputed hashes.
+ * The lazy build writes to the compound, so call nbt_compound_build_index()
+ * up front if a tree is going to be shared between threads. Entries added
+ * by hand must have `hash` set, and the index must be rebuilt afterwards. */
+#define NBT_COMPOUND_INDEX_MIN (8)
+
+uint32_t nbt_hash_name(const char *name, nbt_strlen namelen);
+
+struct nbt_tag *nbt_compound_get(struct nbt_compound *compound, const char *name, nbt_strlen namelen);
+int nbt_compound_build_index(struct nbt_compound *compound);
+
+#define NBT_ERROR_MSG_SZ  (256)
+#define NBT_ERROR_PATH_SZ (256)
+
+/* Details of a failed call, filled in when the options of that call point
+ * at one. Nothing here is shared, so concurrent parses each get their own. */
+struct nbt_error {
+    size_t offset;                  /* byte offset into the (inflated) input */
+    char path[NBT_ERROR_PATH_SZ];   /* tag being decoded, e.g. "Level.Sections[3]", or "" */
+    char message[NBT_ERROR_MSG_SZ];
+};
+
+/* Message of the last failure on the calling thread. */
 const char *nbt_error(void);
 
+/* Where the time and memory of a read went. Reads given one through
+ * nbt_read_options.stats add to it, so zero it first; one struct can total
+ * any number of reads. Counts cover the values the tree reader decodes
+ * (entries dropped by a path filter are not counted). Times are wall-clock
+ * nanoseconds. */
+struct nbt_stats {
+    size_t bytes_read;       /* file bytes, as stored */
+    size_t bytes_inflated;   /* produced by decompression; 0 for raw input */
+    size_t bytes_parsed;     /* consumed by the decoder */
+    /* values decoded, by tag type; a list of numbers counts as one */
+    size_t nodes[NBT_TAG_LONG_ARRAY + 1];
+    size_t allocs;           /* allocations made for the tree */
+    size_t alloc_bytes;
+    unsigned max_depth;      /* nesting of compounds and lists; the root is 1 */
+    uint64_t read_ns;
+    uint64_t inflate_ns;
+    uint64_t decode_ns;
+};
+
+/* Default limit on the nesting of compounds and lists, the root being level
+ * 1; the same as Minecraft's own. */
+#define NBT_DEFAULT_MAX_DEPTH (512)
+
+/* Caps for parsing untrusted input, checked before anything is allocated
+ * for the value in question; 0 leaves a cap off (max_depth: the default).
+ * Length prefixes are also checked against the input that is left, so
+ * even without caps a short document cannot claim a huge list or array. */
+struct nbt_limits {
+    /* Deeper input fails to parse. The tree reader (with or without
+     * paths), lazy scans, nbt_write*() and nbt_free_*() keep their own
+     * stack on the heap, so any limit is safe there; the SAX, flat, SNBT
+     * and JSON code still recurses once per level. */
+    unsigned max_depth;
+
+    size_t max_alloc_bytes;    /* for the tree, and again for inflated input */
+    size_t max_nodes;          /* values; a list of numbers counts as one */
+    nbt_int max_array_length;  /* elements of a byte, int or long array */
+    nbt_int max_list_length;   /* elements of any list */
+};
+
+struct nbt_read_options {
+    struct nbt_arena *arena;  /* allocate the tree from here instead of malloc */
+    struct nbt_error *error;  /* filled in on failure if non-NULL */
+
+    /* If non-NULL, only these dotted key paths below the root compound are
+     * read, e.g. "DataVersion" or "Level.Sections.Y" (a path steps through
+     * lists into their compound elements). Compounds on the way are kept
+     * with just the selected entries; everything else is skipped without
+     * being decoded or allocated. */
+    const char *const *paths;
+    size_t npaths;
+
+    struct nbt_stats *stats;  /* added to if non-NULL */
+
+    /* honoured by the tree readers (nbt_read*(), regions, batches and push
+     * parsers building trees); flat and lazy documents take max_depth */
+    struct nbt_limits limits;
+};
+
 int nbt_read(const unsigned char *data, size_t length, struct nbt_parsed *result);
+int nbt_read_ex(const unsigned char *data, size_t length, struct nbt_parsed *result, const struct nbt_read_options *options);
 
 int nbt_read_file(FILE *file, struct nbt_parsed *result);
+int nbt_read_file_ex(FILE *file, struct nbt_parsed *result, const struct nbt_read_options *options);
+
+/* Zero-copy read of an uncompressed file: maps the whole of `file` (from
+ * offset 0) and points string values, byte arrays and byte lists into the
+ * mapping instead of copying them; int/long arrays and other numeric lists
+ * are borrowed too on big-endian hosts when aligned. Borrowed string values
+ * are not NUL-terminated (names still are). The mapping is copy-on-write,
+ * so values may be modified in place, and it lives until nbt_free_parsed().
+ * Requires options->arena. Compressed files fall back to nbt_read_file_ex(). */
+int nbt_read_file_mapped(FILE *file, struct nbt_parsed *result, const struct nbt_read_options *options);
+
+/* Growable output buffer. Zero-initialize before first use; writers append
+ * at `length` and grow `data` as needed. */
+struct nbt_buffer {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+};
+
+int nbt_buffer_reserve(struct nbt_buffer *buf, size_t extra);
+void nbt_buffer_free(struct nbt_buffer *buf);
+
+enum {
+    NBT_COMPRESSION_NONE = 0,
+    NBT_COMPRESSION_GZIP,
+    NBT_COMPRESSION_ZLIB,
+};
+
+/* Guesses the NBT_COMPRESSION_* of `data` from its first bytes. Files are
+ * recognized this way by nbt_read_file() and nbt_read_file_mapped(). */
+int nbt_detect_compression(const unsigned char *data, size_t length);
+
+/* Trace hooks, compiled in with the meson option nbt:trace (which defines
+ * NBT_TRACE). The hook is called as each decompression, parse and
+ * nbt_free_parsed() begins and ends, with the input size at the beginning
+ * and the output size at the end (0 for frees and failures). There is one
+ * hook for the whole process, called from whichever thread does the work;
+ * set it before starting any reads. Returns -1 if tracing is compiled out. */
+enum {
+    NBT_TRACE_INFLATE,
+    NBT_TRACE_PARSE,
+    NBT_TRACE_FREE,
+};
+
+typedef void (*nbt_trace_hook)(void *user, int event, bool begin, size_t bytes);
+int nbt_set_trace_hook(nbt_trace_hook hook, void *user);
+
+/* Library that inflates compressed input: "zlib", "zlib-ng" or "libdeflate"
+ * (chosen with the meson option nbt:decompressor). */
+const char *nbt_decompressor(void);
+
+struct nbt_write_options {
+    int compression;         /* NBT_COMPRESSION_* */
+    int level;               /* zlib level 1-9, or 0 for zlib's default */
+    struct nbt_error *error; /* filled in on failure if non-NULL */
+};
+
+/* Exact size of the uncompressed encoding of `parsed`, or 0 (with the error
+ * set) if the tree cannot be encoded. */
+size_t nbt_write_size(const struct nbt_parsed *parsed);
 
-/* TODO: write */
+/* Appends the encoding of `parsed` to `out`. NULL options write raw NBT. */
+int nbt_write(const struct nbt_parsed *parsed, struct nbt_buffer *out, const struct nbt_write_options *options);
+int nbt_write_file(FILE *file, const struct nbt_parsed *parsed, const struct nbt_write_options *options);
 
 #endif /* include guard */
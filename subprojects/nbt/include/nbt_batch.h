@@ -0,0 +1,50 @@
+#ifndef LIBNBT_BATCH_H_INCLUDED
+#define LIBNBT_BATCH_H_INCLUDED
+
+#include <stddef.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_pool.h"
+
+/* Loading many standalone files (player .dat files, ...) at once. Each file
+ * is read, inflated and decoded on one of the pool's threads, as
+ * nbt_read_file_ex() would, and handed to the callback as soon as it is
+ * done, so results arrive in completion order rather than input order.
+ * Threads pick up the next unclaimed file whenever they finish one, so a
+ * few large files do not hold up the rest. */
+
+struct nbt_batch_item {
+    size_t index;              /* position in the paths or fds given */
+    const char *path;          /* NULL when loading descriptors */
+    int fd;                    /* -1 when loading paths */
+    size_t size;               /* bytes read from the file, before inflating */
+
+    int ret;                   /* 0, or -1 with `error` filled in */
+    struct nbt_parsed result;  /* malloc'd tree, owned by the callback */
+    struct nbt_error error;
+};
+
+/* Called once per file, concurrently from the pool's threads. The callback
+ * must release item->result with nbt_free_parsed() (or keep it); the rest
+ * of the item is only valid during the call. */
+typedef void (*nbt_batch_callback)(void *user, struct nbt_batch_item *item);
+
+struct nbt_batch_options {
+    struct nbt_pool *pool;    /* NULL: load on the calling thread */
+
+    /* as in nbt_read_options */
+    const char *const *paths;
+    size_t npaths;
+    struct nbt_limits limits;
+
+    nbt_batch_callback callback;
+    void *user;
+};
+
+/* Load `count` files and return how many failed. Descriptors are read from
+ * their current offset and left open. */
+size_t nbt_batch_load_paths(const char *const *paths, size_t count, const struct nbt_batch_options *options);
+size_t nbt_batch_load_fds(const int *fds, size_t count, const struct nbt_batch_options *options);
+
+#endif /* include guard */
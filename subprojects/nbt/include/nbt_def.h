@@ -87,38 +87,53 @@ struct nbt_tag {
     nbt_value value;
 };
 
-struct nbt_list_entry;
-
+/* Elements are stored packed in one buffer as their C type, so a list of
+ * doubles is a plain double[] and a list of compounds is an array of
+ * pointers. Use the member matching `type`, e.g. data.tag_double[i]. */
 struct nbt_list {
     nbt_type type;
     nbt_int length;
-    struct nbt_list_entry *first;
-};
+    union {
+        void *raw;
+#define O(_ctype, _uname, _lname) \
+        _ctype *tag_ ## _lname;
 
-struct nbt_list_entry {
-    nbt_value value;
-    struct nbt_list_entry *next;
+        NBT_FOREACH_TYPE(O)
+#undef O
+    } data;
 };
 
 struct nbt_compound_entry;
 
 struct nbt_compound {
     uint32_t size; /* extension */
+    uint32_t indexmask; /* extension: slots in `index` minus one, 0 if not built */
     struct nbt_compound_entry *first;
+    struct nbt_compound_entry **index; /* extension: open-addressing hash index */
 };
 
 struct nbt_compound_entry {
     nbt_strlen namelen;
+    uint32_t hash; /* extension: nbt_hash_name(name, namelen) */
     char *name;
     struct nbt_tag tag;
     struct nbt_compound_entry *next;
 };
 
+struct nbt_arena;
+
 struct nbt_parsed {
     nbt_strlen namelen;
     char *name;
 
     struct nbt_compound *root;
+
+    struct nbt_arena *arena; /* non-NULL if the tree lives in an arena */
+
+    /* file mapping the tree borrows strings and arrays from
+     * (nbt_read_file_mapped); unmapped by nbt_free_parsed() */
+    void *map;
+    size_t maplen;
 };
 
 #endif /* include guard */
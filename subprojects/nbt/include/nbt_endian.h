@@ -1,12 +1,12 @@
 #ifndef LIBNBT_ENDIAN_H_INCLUDED
 #define LIBNBT_ENDIAN_H_INCLUDED
 
+#include <stddef.h>
 #include <stdint.h>
 #include "nbt_def.h"
 
-/* TODO: replace all of this with something else */
-
-int nbt_endian(void);
+/* Byte order is fixed at compile time, so every conversion below inlines
+ * to a single bswap (or to nothing on big-endian hosts). */
 
 enum {
     _NBT_ENDIAN_LITTLE = 0x01,
@@ -14,17 +14,71 @@ enum {
     _NBT_ENDIAN_WTF = 0x99,
 };
 
-#define NBT_ENDIAN_LITTLE (nbt_endian() == _NBT_ENDIAN_LITTLE)
-#define NBT_ENDIAN_BIG    (nbt_endian() == _NBT_ENDIAN_BIG)
-#define NBT_ENDIAN_WTF    (nbt_endian() == _NBT_ENDIAN_WTF)
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define _NBT_ENDIAN_HOST _NBT_ENDIAN_LITTLE
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define _NBT_ENDIAN_HOST _NBT_ENDIAN_BIG
+#elif defined(_WIN32)
+#define _NBT_ENDIAN_HOST _NBT_ENDIAN_LITTLE
+#else
+#error "libnbt: unsupported or unknown byte order"
+#endif
+
+static inline int nbt_endian(void) {
+    return _NBT_ENDIAN_HOST;
+}
+
+#define NBT_ENDIAN_LITTLE (_NBT_ENDIAN_HOST == _NBT_ENDIAN_LITTLE)
+#define NBT_ENDIAN_BIG    (_NBT_ENDIAN_HOST == _NBT_ENDIAN_BIG)
+#define NBT_ENDIAN_WTF    (_NBT_ENDIAN_HOST == _NBT_ENDIAN_WTF)
+
+#if defined(__GNUC__) || defined(__clang__)
+static inline uint64_t nbt_endian_swap_u64(uint64_t in) { return __builtin_bswap64(in); }
+static inline uint32_t nbt_endian_swap_u32(uint32_t in) { return __builtin_bswap32(in); }
+static inline uint16_t nbt_endian_swap_u16(uint16_t in) { return __builtin_bswap16(in); }
+#else
+/* compilers without the builtins still recognize these as bswap/rotate */
+static inline uint64_t nbt_endian_swap_u64(uint64_t in) {
+    return (in >> 56)
+        | (in & 0x00FF000000000000ull) >> 40
+        | (in & 0x0000FF0000000000ull) >> 24
+        | (in & 0x000000FF00000000ull) >> 8
+        | (in & 0x00000000FF000000ull) << 8
+        | (in & 0x0000000000FF0000ull) << 24
+        | (in & 0x000000000000FF00ull) << 40
+        | (in << 56);
+}
+
+static inline uint32_t nbt_endian_swap_u32(uint32_t in) {
+    return (in >> 24)
+        | (in & 0x00FF0000u) >> 8
+        | (in & 0x0000FF00u) << 8
+        | (in << 24);
+}
 
-uint64_t nbt_endian_h2be_u64(uint64_t in);
-uint32_t nbt_endian_h2be_u32(uint32_t in);
-uint16_t nbt_endian_h2be_u16(uint16_t in);
+static inline uint16_t nbt_endian_swap_u16(uint16_t in) {
+    return (uint16_t)((in >> 8) | (in << 8));
+}
+#endif
 
-int64_t nbt_endian_h2be_s64(int64_t in);
-int32_t nbt_endian_h2be_s32(int32_t in);
-int16_t nbt_endian_h2be_s16(int16_t in);
+/* signed variants swap the two's complement bit pattern */
+static inline int64_t nbt_endian_swap_s64(int64_t in) { return (int64_t)nbt_endian_swap_u64((uint64_t)in); }
+static inline int32_t nbt_endian_swap_s32(int32_t in) { return (int32_t)nbt_endian_swap_u32((uint32_t)in); }
+static inline int16_t nbt_endian_swap_s16(int16_t in) { return (int16_t)nbt_endian_swap_u16((uint16_t)in); }
+
+#define O(_ct, _bits)                                              \
+static inline _ct nbt_endian_h2be_ ## _bits(_ct in) {              \
+    return NBT_ENDIAN_LITTLE ? nbt_endian_swap_ ## _bits(in) : in; \
+}
+
+O(uint64_t, u64)
+O(uint32_t, u32)
+O(uint16_t, u16)
+
+O(int64_t, s64)
+O(int32_t, s32)
+O(int16_t, s16)
+#undef O
 
 #define nbt_endian_be2h_u64 nbt_endian_h2be_u64
 #define nbt_endian_be2h_u32 nbt_endian_h2be_u32
@@ -34,6 +88,15 @@ int16_t nbt_endian_h2be_s16(int16_t in);
 #define nbt_endian_be2h_s32 nbt_endian_h2be_s32
 #define nbt_endian_be2h_s16 nbt_endian_h2be_s16
 
+/* In-place conversion of `count` big-endian elements of `width` bytes (1, 2,
+ * 4 or 8) to host order, using SIMD where the CPU has it. Converting back
+ * is the same operation. */
+void nbt_endian_be2h_array(void *buf, size_t count, size_t width);
+#define nbt_endian_h2be_array nbt_endian_be2h_array
+
+/* Name of the kernel nbt_endian_be2h_array uses on this CPU. */
+const char *nbt_endian_array_impl(void);
+
 /* with NBT lowercase type names */
 #define nbt_endian_h2be_long(_in)  (nbt_endian_h2be_s64(_in))
 #define nbt_endian_h2be_int(_in)   (nbt_endian_h2be_s32(_in))
@@ -0,0 +1,102 @@
+#ifndef LIBNBT_FLAT_H_INCLUDED
+#define LIBNBT_FLAT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+
+/* Flat documents: a whole tree in one allocation, as an array of fixed-size
+ * nodes in pre-order followed by a blob holding every name and payload.
+ * Nodes refer to each other and to the blob by index and offset only, and
+ * the header holds no pointers: nodes and blob are found from the address
+ * of the document itself. So a document can be copied with memcpy() (as
+ * nbt_flat_clone() does) or written out and mapped back as it is, at any
+ * 8-aligned address. The layout is the host's (byte order, sizeof(size_t))
+ * and is not checked when mapped back, so only map documents this build
+ * wrote. Copies are released however they were made; nbt_flat_free() is
+ * for the documents this library allocates.
+ *
+ * Node 0 is the root compound. The children of a compound or list come
+ * right after it, and each node records the size of its subtree, so a
+ * sibling is one addition away and whole subtrees are skipped in O(1).
+ * Lists of numbers have no child nodes; their elements are a payload like
+ * an array's. Payloads are in host byte order and aligned for their
+ * element type; names and strings are NUL-terminated in the blob.
+ *
+ * A document is immutable and may be shared between threads. */
+
+struct nbt_flat_node {
+    nbt_type type;
+    nbt_type elemtype;     /* lists: type of the elements */
+    nbt_strlen namelen;    /* compound entries (and the root): name length */
+    uint32_t name;         /* blob offset of the name */
+    uint32_t size;         /* nodes in this subtree, this one included */
+    uint32_t length;       /* entries, elements, or bytes of a string */
+    union {
+#define O(_ctype, _uname, _lname) \
+        _ctype tag_ ## _lname;
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        uint64_t offset;   /* strings, arrays and lists of numbers: blob offset of the payload */
+    } value;
+};
+
+/* Header of the document; the nodes and then the blob follow it. */
+struct nbt_flat {
+    uint32_t nnodes;
+    size_t bloblen;
+    size_t footprint;      /* bytes of the whole document, header included */
+};
+
+/* the nodes follow the header, 8-aligned, and the blob follows them */
+#define NBT_FLAT_HEADER_SIZE ((sizeof(struct nbt_flat) + 7) & ~(size_t)7)
+
+#define NBT_FLAT_NONE (UINT32_MAX)
+
+/* Decodes uncompressed NBT. `options->arena` and `options->paths` are
+ * ignored. Returns NULL on failure. */
+struct nbt_flat *nbt_flat_read(const unsigned char *data, size_t length, const struct nbt_read_options *options);
+struct nbt_flat *nbt_flat_clone(const struct nbt_flat *flat);
+void nbt_flat_free(struct nbt_flat *flat);
+
+/* Child of `compound` with the given name, or NBT_FLAT_NONE. */
+uint32_t nbt_flat_find(const struct nbt_flat *flat, uint32_t compound, const char *name, nbt_strlen namelen);
+
+/* Element `index` of a list of strings, arrays, lists or compounds, or
+ * NBT_FLAT_NONE. */
+uint32_t nbt_flat_list_get(const struct nbt_flat *flat, uint32_t list, uint32_t index);
+
+/* Node at a path in nbt_lazy_get()'s syntax ("Level.Sections[3].Y", or ""
+ * for the root), or NBT_FLAT_NONE with the error set. */
+uint32_t nbt_flat_get(const struct nbt_flat *flat, const char *path);
+
+static inline const struct nbt_flat_node *nbt_flat_nodes(const struct nbt_flat *flat) {
+    return (const struct nbt_flat_node *)((const unsigned char *)flat + NBT_FLAT_HEADER_SIZE);
+}
+
+static inline const unsigned char *nbt_flat_blob(const struct nbt_flat *flat) {
+    return (const unsigned char *)(nbt_flat_nodes(flat) + flat->nnodes);
+}
+
+static inline const char *nbt_flat_name(const struct nbt_flat *flat, uint32_t node) {
+    return (const char *)nbt_flat_blob(flat) + nbt_flat_nodes(flat)[node].name;
+}
+
+/* String bytes, array elements or the elements of a list of numbers. */
+static inline const void *nbt_flat_payload(const struct nbt_flat *flat, uint32_t node) {
+    return nbt_flat_blob(flat) + nbt_flat_nodes(flat)[node].value.offset;
+}
+
+/* Index of the node after the subtree of `node`: its next sibling, if any. */
+static inline uint32_t nbt_flat_next(const struct nbt_flat *flat, uint32_t node) {
+    return node + nbt_flat_nodes(flat)[node].size;
+}
+
+#define NBT_FLAT_FOREACH_CHILD(_flat, _parent, _child)                       \
+    for (uint32_t _child = (_parent) + 1;                                   \
+         _child < nbt_flat_next(_flat, _parent);                            \
+         _child = nbt_flat_next(_flat, _child))
+
+#endif /* include guard */
@@ -0,0 +1,82 @@
+#ifndef LIBNBT_JSON_H_INCLUDED
+#define LIBNBT_JSON_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h> /* for FILE */
+
+#include "nbt.h"
+#include "nbt_def.h"
+
+/* JSON export and import. Export runs off the SAX decoder (nbt_sax.h), so
+ * no tree is built: each value is formatted as it is decoded, and file
+ * output is flushed every NBT_JSON_FLUSH_BYTES.
+ *
+ * Plain JSON maps compounds to objects, lists and arrays to arrays, and
+ * numbers to numbers, dropping the tag types and the root name:
+ *
+ *   {"Name": "Steve", "Pos": [0.5, 64.0, 0.5], "Seen": [1, 2, 3]}
+ *
+ * Importing it guesses the types back: integers become ints (longs if they
+ * do not fit), other numbers doubles, true and false bytes, and arrays
+ * lists of the widest number type they hold.
+ *
+ * Typed JSON keeps every type, and reads back exactly. Each value is an
+ * object naming its type, lists also their element type; a list inside a
+ * list is the same object without "type", and the root carries its name:
+ *
+ *   {"type": "compound", "name": "", "value": {
+ *       "Health": {"type": "float", "value": 20.0},
+ *       "Pos": {"type": "list", "element": "double", "value": [0.5, 64.0, 0.5]}}}
+ *
+ * Type names are those of cnbt --stats ("byte", "int_array", ...; "end" for
+ * the elements of an empty list). The fields must come in that order.
+ *
+ * Either way, NaN and the infinities are written as the strings "NaN",
+ * "Infinity" and "-Infinity", and NBT strings (modified UTF-8) as proper
+ * JSON: U+0000 and surrogates are written as \u escapes. */
+
+#define NBT_JSON_FLUSH_BYTES (65536)
+
+/* nbt_json_options.arrays: how byte, int and long arrays are written */
+enum {
+    NBT_JSON_ARRAY_NUMBERS = 0,  /* [1, 2, 3] */
+    NBT_JSON_ARRAY_BASE64,       /* the big-endian elements, as stored in NBT, in base64 */
+};
+
+/* nbt_json_options.longs: how longs are written, in arrays of numbers too */
+enum {
+    NBT_JSON_LONG_NUMBER = 0,    /* 123 */
+    NBT_JSON_LONG_STRING,        /* "123", for readers that keep numbers as doubles */
+};
+
+struct nbt_json_options {
+    bool pretty;             /* one entry or compound per line, indented */
+    unsigned indent;         /* pretty: spaces per level, 0 for 4 */
+    bool typed;              /* write, or expect, typed JSON */
+    int arrays;              /* NBT_JSON_ARRAY_* */
+    int longs;               /* NBT_JSON_LONG_* */
+
+    /* import: as nbt_read_options.limits; export: max_alloc_bytes caps the
+     * inflated input of nbt_json_write_file() */
+    struct nbt_limits limits;
+
+    struct nbt_error *error; /* filled in on failure if non-NULL */
+};
+
+/* Appends the JSON of an uncompressed NBT document to `out`. NULL options
+ * write compact plain JSON. On failure `out` is left as it was. */
+int nbt_json_write(const unsigned char *data, size_t length, struct nbt_buffer *out, const struct nbt_json_options *options);
+
+/* Converts an NBT file (compressed or not) to JSON written to `out`. On
+ * failure, output already flushed stays written. */
+int nbt_json_write_file(FILE *in, FILE *out, const struct nbt_json_options *options);
+
+/* Parses a JSON object, plain or typed as options->typed says, into a tree
+ * as nbt_read_ex() builds it. Error offsets count bytes of `text`. Typed
+ * arrays may be given as numbers or base64, and typed longs as strings,
+ * whatever options->arrays and options->longs say. */
+int nbt_json_read(const char *text, size_t length, struct nbt_parsed *result, const struct nbt_json_options *options);
+int nbt_json_read_file(FILE *file, struct nbt_parsed *result, const struct nbt_json_options *options);
+
+#endif /* include guard */
@@ -0,0 +1,37 @@
+#ifndef LIBNBT_LAZY_H_INCLUDED
+#define LIBNBT_LAZY_H_INCLUDED
+
+#include <stddef.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+
+/* On-demand access to a document. Opening one only checks the root header.
+ * The first lookup through a compound scans it once, recording each
+ * entry's name, type and offset while skipping over the values; a list
+ * indexed into is scanned the same way. Only the value a path names is
+ * decoded, into the usual tree types, and it is cached for later lookups.
+ *
+ * Paths are dotted names below the root compound with optional list
+ * indices, e.g. "Level.Sections[3].Y"; "" names the root itself. Indexing
+ * works on lists of strings, arrays, lists and compounds; take lists of
+ * numbers whole. Names containing '.' or '[' cannot be looked up.
+ *
+ * The input is borrowed and must outlive the document. Decoded values live
+ * in options->arena if given (else in an arena the document owns) until
+ * nbt_lazy_close(); do not free them. A document is not thread-safe. */
+
+struct nbt_lazy;
+
+/* `options->paths` is ignored. Returns NULL on failure. */
+struct nbt_lazy *nbt_lazy_open(const unsigned char *data, size_t length, const struct nbt_read_options *options);
+void nbt_lazy_close(struct nbt_lazy *doc);
+
+/* Root tag name (not NUL-terminated). */
+const char *nbt_lazy_name(const struct nbt_lazy *doc, nbt_strlen *namelen);
+
+/* Decodes (once) and returns the value at `path`, or NULL if there is none
+ * or the input is malformed along the way (see nbt_error()). */
+struct nbt_tag *nbt_lazy_get(struct nbt_lazy *doc, const char *path);
+
+#endif /* include guard */
@@ -0,0 +1,16 @@
+#ifndef LIBNBT_POOL_H_INCLUDED
+#define LIBNBT_POOL_H_INCLUDED
+
+/* Worker threads for the batch APIs (nbt_region_read_all(), ...). A pool can
+ * be shared by any number of batches; batches submitted to the same pool
+ * from several threads run one after another. */
+
+struct nbt_pool;
+
+/* `threads` counts every thread that decodes, including the one that
+ * submits a batch; 0 means one per online CPU. Returns NULL on failure. */
+struct nbt_pool *nbt_pool_new(unsigned threads);
+unsigned nbt_pool_threads(const struct nbt_pool *pool);
+void nbt_pool_free(struct nbt_pool *pool);
+
+#endif /* include guard */
@@ -0,0 +1,56 @@
+#ifndef LIBNBT_PUSH_H_INCLUDED
+#define LIBNBT_PUSH_H_INCLUDED
+
+#include <stddef.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_sax.h"
+
+/* Incremental parsing of uncompressed NBT that arrives piecemeal (from a
+ * socket, a decompressor, ...). Input is fed in chunks split anywhere, even
+ * inside a number or a name; the parser decodes as far as each chunk goes
+ * and keeps its place, with an explicit stack rather than recursion, so
+ * nothing has to be buffered beyond the one field that is cut off.
+ *
+ * A push parser either delivers the nbt_sax.h events, exactly as
+ * nbt_sax_parse() would for the whole document (except that array chunks
+ * can be smaller than NBT_SAX_CHUNK_BYTES where the input was split), or
+ * builds the same tree nbt_read_ex() would. Error offsets count bytes from
+ * the start of the document. */
+
+/* nbt_push_feed() results besides NBT_SAX_ABORT and -1 */
+enum {
+    NBT_PUSH_DONE = 0,  /* the document is complete */
+    NBT_PUSH_MORE = 3,  /* everything fed was consumed; more is needed */
+};
+
+struct nbt_push;
+
+/* Delivers events to `handler`, which must outlive the parser. `error` (if
+ * non-NULL) is filled in whenever a call fails. Nesting is limited to
+ * NBT_DEFAULT_MAX_DEPTH. Returns NULL on failure. */
+struct nbt_push *nbt_push_new(const struct nbt_sax_handler *handler, struct nbt_error *error);
+
+/* Builds a tree, from options->arena if set and within options->limits.
+ * `options->paths` and `options->stats` are ignored. Returns NULL on
+ * failure. */
+struct nbt_push *nbt_push_new_tree(const struct nbt_read_options *options);
+
+void nbt_push_free(struct nbt_push *push);
+
+/* Consumes input until the document ends or the input runs out. `*used`
+ * is set to the number of bytes consumed, which is less than `length` only
+ * when the document ended inside the chunk: the rest belongs to whatever
+ * follows it. Once a feed returns -1 or NBT_SAX_ABORT the parser stays
+ * failed until reset. */
+int nbt_push_feed(struct nbt_push *push, const unsigned char *data, size_t length, size_t *used);
+
+/* Tree parsers: moves the finished tree into `result`, to be released with
+ * nbt_free_parsed(). Fails unless the last feed returned NBT_PUSH_DONE. */
+int nbt_push_result(struct nbt_push *push, struct nbt_parsed *result);
+
+/* Starts over for a new document, dropping any partial one. */
+void nbt_push_reset(struct nbt_push *push);
+
+#endif /* include guard */
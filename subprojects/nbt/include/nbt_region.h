@@ -0,0 +1,87 @@
+#ifndef LIBNBT_REGION_H_INCLUDED
+#define LIBNBT_REGION_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_pool.h"
+
+/* Anvil region files (.mca): 32x32 chunks, each a compressed NBT document
+ * stored in 4 KiB sectors. The file starts with a table of chunk locations
+ * (sector offset and count) followed by a table of modification times. */
+
+#define NBT_REGION_CHUNKS      (1024)
+#define NBT_REGION_SECTOR_SIZE (4096)
+
+/* Index of the chunk at chunk coordinates (x, z), world or region-local. */
+#define NBT_REGION_INDEX(_x, _z) ((unsigned)(((_x) & 31) + ((_z) & 31) * 32))
+
+/* Chunk compression types */
+#define NBT_REGION_GZIP         (1)
+#define NBT_REGION_ZLIB         (2)
+#define NBT_REGION_UNCOMPRESSED (3)
+
+struct nbt_region;
+
+/* Maps the file read-only. Returns NULL on failure (see nbt_error()). */
+struct nbt_region *nbt_region_open(const char *path, struct nbt_error *error);
+void nbt_region_close(struct nbt_region *region);
+
+int nbt_region_has_chunk(const struct nbt_region *region, unsigned index);
+uint32_t nbt_region_timestamp(const struct nbt_region *region, unsigned index); /* seconds since the epoch */
+
+/* Decodes one chunk as nbt_read_ex() would; `options->stats` also counts
+ * the chunk as stored and its decompression. Fails for absent chunks. */
+int nbt_region_read_chunk(const struct nbt_region *region, unsigned index, struct nbt_parsed *result, const struct nbt_read_options *options);
+
+struct nbt_region_batch_options {
+    struct nbt_pool *pool;    /* NULL: decode on the calling thread */
+
+    /* as in nbt_read_options, for each chunk */
+    const char *const *paths;
+    size_t npaths;
+    struct nbt_limits limits;
+
+    /* NBT_REGION_CHUNKS entries, filled in for the chunks that fail; or NULL */
+    struct nbt_error *errors;
+};
+
+/* Decodes every chunk into results[index] (NBT_REGION_CHUNKS entries).
+ * Absent and failed chunks are left with a NULL root; the others are
+ * malloc'd trees to release with nbt_free_parsed(). Returns the number of
+ * chunks that failed. */
+int nbt_region_read_all(const struct nbt_region *region, struct nbt_parsed *results, const struct nbt_region_batch_options *options);
+
+/* Rewriting a region: queue chunk updates, then commit them all at once.
+ * The committed file is written next to the old one and renamed over it,
+ * so readers see either the old region or the new one, never a mix; the
+ * file and then its directory are synced, so the new one survives a crash.
+ * Unchanged chunks keep their sectors and are copied as they are; updated
+ * chunks go to the first hole they fit in (sectors freed by removed or
+ * rewritten chunks) or else are appended. */
+
+struct nbt_region_writer;
+
+/* `path` need not exist yet. Returns NULL on failure. */
+struct nbt_region_writer *nbt_region_writer_new(const char *path, struct nbt_error *error);
+void nbt_region_writer_free(struct nbt_region_writer *writer);
+
+/* Queues `chunk` for `index`, replacing whatever is there; it is borrowed
+ * until the commit. A timestamp of 0 means the time of the commit. */
+int nbt_region_writer_put(struct nbt_region_writer *writer, unsigned index, const struct nbt_parsed *chunk, uint32_t timestamp);
+int nbt_region_writer_remove(struct nbt_region_writer *writer, unsigned index);
+
+struct nbt_region_write_options {
+    struct nbt_pool *pool;    /* NULL: compress on the calling thread */
+    int level;                /* zlib level 1-9, or 0 for zlib's default */
+    struct nbt_error *error;  /* filled in on failure if non-NULL */
+};
+
+/* Compresses the queued chunks and replaces the file. On failure the file
+ * is left untouched and the queue is kept, unless only the final sync of
+ * the directory failed: the file has been replaced by then. */
+int nbt_region_writer_commit(struct nbt_region_writer *writer, const struct nbt_region_write_options *options);
+
+#endif /* include guard */
@@ -0,0 +1,59 @@
+#ifndef LIBNBT_SAX_H_INCLUDED
+#define LIBNBT_SAX_H_INCLUDED
+
+#include <stddef.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+
+/* Event-driven parsing: walks a document and reports what it finds through
+ * callbacks, without building a tree. Every callback returns one of the
+ * NBT_SAX_* codes below; unset callbacks count as NBT_SAX_CONTINUE.
+ *
+ * Event order for `root: {a: 1b, b: [I; 1, 2]}`:
+ *   key(COMPOUND, "root") begin_compound
+ *     key(BYTE, "a") scalar(BYTE, 1)
+ *     key(INT_ARRAY, "b") begin_array(INT_ARRAY, 2) array_chunk(INT, {1, 2}, 2) end(INT_ARRAY)
+ *   end(COMPOUND)
+ *
+ * Returning NBT_SAX_SKIP from key() skips the value entirely; from a begin_*
+ * callback it skips the contents and the matching end() is not delivered.
+ * NBT_SAX_ABORT stops the parse at once. */
+
+enum {
+    NBT_SAX_CONTINUE = 0,
+    NBT_SAX_SKIP,
+    NBT_SAX_ABORT,
+};
+
+/* Elements of arrays and of lists of numbers are delivered in chunks of at
+ * most this many bytes, converted to host order. */
+#define NBT_SAX_CHUNK_BYTES (8192)
+
+struct nbt_sax_handler {
+    /* before each compound entry (and the root): its type and name */
+    int (*key)(void *user, nbt_type type, const char *name, nbt_strlen namelen);
+
+    /* numbers and strings; a string's value.tag_string points into the input
+     * and is only valid during the call (its buf is not NUL-terminated) */
+    int (*scalar)(void *user, nbt_type type, nbt_value value);
+
+    int (*begin_compound)(void *user);
+    int (*begin_list)(void *user, nbt_type elemtype, nbt_int length);
+    int (*begin_array)(void *user, nbt_type type, nbt_int length);
+
+    /* `count` elements of `elemtype` (BYTE, INT or LONG for arrays; any
+     * numeric type for lists); `data` is only valid during the call */
+    int (*array_chunk)(void *user, nbt_type elemtype, const void *data, size_t count);
+
+    /* closes a compound, list or array; `type` says which */
+    int (*end)(void *user, nbt_type type);
+
+    void *user;
+};
+
+/* Returns 0 once the whole document was walked, NBT_SAX_ABORT if a callback
+ * aborted, or -1 on malformed input (with `error` filled in if non-NULL). */
+int nbt_sax_parse(const unsigned char *data, size_t length, const struct nbt_sax_handler *handler, struct nbt_error *error);
+
+#endif /* include guard */
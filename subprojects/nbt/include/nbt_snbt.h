@@ -0,0 +1,47 @@
+#ifndef LIBNBT_SNBT_H_INCLUDED
+#define LIBNBT_SNBT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h> /* for FILE */
+
+#include "nbt.h"
+#include "nbt_def.h"
+
+/* SNBT ("stringified NBT"), the text form Minecraft uses in commands:
+ *
+ *   {Name:"Steve",Pos:[0.5d,64.0d,0.5d],Health:20.0f,Seen:[I;1,2,3]}
+ *
+ * Numbers carry a suffix for their type (b, s, L, f, d; none for ints) and
+ * arrays a prefix (B;, I;, L;). Keys are left bare when they only contain
+ * [0-9A-Za-z_.+-], string values are always quoted. The root name is not
+ * part of SNBT: it is never written, and read back as "".
+ *
+ * String bytes pass through as they are; quotes, backslashes and control
+ * characters are escaped, as \n and the like or else as \xHH, which reads
+ * back as that byte. Floats read back exactly, with 6 (doubles: 15)
+ * significant digits where that is enough and 9 (17) otherwise; NaN and
+ * the infinities are written as NaNf, Infinityd, -Infinityd, which only
+ * this library reads back. Empty lists come back as lists of TAG_End. */
+
+struct nbt_snbt_options {
+    bool pretty;             /* one entry or compound per line, indented */
+    unsigned indent;         /* pretty: spaces per level, 0 for 4 */
+    struct nbt_error *error; /* filled in on failure if non-NULL */
+};
+
+/* Appends the SNBT of the root compound of `parsed` to `out`. NULL options
+ * write compact SNBT. On failure `out` is left as it was. */
+int nbt_snbt_write(const struct nbt_parsed *parsed, struct nbt_buffer *out, const struct nbt_snbt_options *options);
+
+/* The same for any value, e.g. one entry of a compound. */
+int nbt_snbt_write_value(nbt_type type, nbt_value value, struct nbt_buffer *out, const struct nbt_snbt_options *options);
+
+/* Parses an SNBT compound, allowing whitespace around it, into a tree as
+ * nbt_read_ex() builds it. Keys may be quoted with ' or ", and strings
+ * unquoted where that is unambiguous; `true` and `false` are bytes. Error
+ * offsets count bytes of `text`. `options->paths` is ignored. */
+int nbt_snbt_read(const char *text, size_t length, struct nbt_parsed *result, const struct nbt_read_options *options);
+int nbt_snbt_read_file(FILE *file, struct nbt_parsed *result, const struct nbt_read_options *options);
+
+#endif /* include guard */
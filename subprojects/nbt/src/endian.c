@@ -1,81 +1,135 @@
 #include "nbt_endian.h"
 
+#include <stddef.h>
 #include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h> /* for abort(3) */
+#include <string.h>
 
-int nbt_endian_invalid(void) {
-    fprintf(stderr, "Unsupported endianness %u :(\n", nbt_endian());
-    abort();
-    return 0;
+/* Bulk conversion of big-endian arrays (TAG_Int_Array, TAG_Long_Array, numeric
+ * lists). On x86 the kernel is picked on first use from what the CPU
+ * supports: AVX2 vpshufb, SSSE3 pshufb, or the scalar bswap loop. */
+
+/* memcpy keeps these safe on unaligned buffers; it compiles to plain loads */
+#define O(_bits)                                                         \
+void nbt_endian_swap_array_scalar_ ## _bits(void *buf, size_t count) {   \
+    unsigned char *p = buf;                                              \
+    for (size_t i = 0; i < count; ++i, p += _bits / 8) {                 \
+        uint ## _bits ## _t v;                                           \
+        memcpy(&v, p, sizeof(v));                                        \
+        v = nbt_endian_swap_u ## _bits(v);                               \
+        memcpy(p, &v, sizeof(v));                                        \
+    }                                                                    \
 }
 
-int nbt_endian(void) {
-    uint32_t t = 0x02999801u;
-    int endian = (int)*((uint8_t *)&t);
-    if (endian == _NBT_ENDIAN_WTF) return nbt_endian_invalid();
+O(16)
+O(32)
+O(64)
+#undef O
 
-    return endian;
-}
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NBT_ENDIAN_X86_KERNELS
+#include <immintrin.h>
 
-/* below functions are optimized by gcc into just bswap or bitwise rotate */
-uint64_t nbt_endian_swap_u64(uint64_t in) {
-    return (in >> 56)
-        | (in & 0x00FF000000000000ull) >> 40
-        | (in & 0x0000FF0000000000ull) >> 24
-        | (in & 0x000000FF00000000ull) >> 8
-        | (in & 0x00000000FF000000)    << 8
-        | (in & 0x0000000000FF0000)    << 24
-        | (in & 0x000000000000FF00)    << 40
-        | (in << 56);
-}
+/* pshufb masks reversing the bytes of every 2/4/8-byte lane */
+#define NBT_SHUF_MASK_16 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1
+#define NBT_SHUF_MASK_32 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+#define NBT_SHUF_MASK_64 8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7
 
-int64_t nbt_endian_swap_s64(int64_t in) {
-    return ((in >> 56) & 0xFF) /* remove sign-extension */
-        | (in & 0x00FF000000000000ull) >> 40
-        | (in & 0x0000FF0000000000ull) >> 24
-        | (in & 0x000000FF00000000ull) >> 8
-        | (in & 0x00000000FF000000)    << 8
-        | (in & 0x0000000000FF0000)    << 24
-        | (in & 0x000000000000FF00)    << 40
-        | (in << 56);
+#define O(_bits)                                                                         \
+__attribute__((target("ssse3")))                                                         \
+void nbt_endian_swap_array_ssse3_ ## _bits(void *buf, size_t count) {                    \
+    const __m128i mask = _mm_set_epi8(NBT_SHUF_MASK_ ## _bits);                          \
+    unsigned char *p = buf;                                                              \
+    size_t nbytes = count * (_bits / 8), i = 0;                                          \
+    for (; i + 16 <= nbytes; i += 16) {                                                  \
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));                           \
+        _mm_storeu_si128((__m128i *)(p + i), _mm_shuffle_epi8(v, mask));                 \
+    }                                                                                    \
+    nbt_endian_swap_array_scalar_ ## _bits(p + i, (nbytes - i) / (_bits / 8));           \
+}                                                                                        \
+                                                                                         \
+__attribute__((target("avx2")))                                                          \
+void nbt_endian_swap_array_avx2_ ## _bits(void *buf, size_t count) {                     \
+    const __m256i mask = _mm256_set_epi8(NBT_SHUF_MASK_ ## _bits, NBT_SHUF_MASK_ ## _bits); \
+    unsigned char *p = buf;                                                              \
+    size_t nbytes = count * (_bits / 8), i = 0;                                          \
+    for (; i + 64 <= nbytes; i += 64) {                                                  \
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));                        \
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 32));                   \
+        _mm256_storeu_si256((__m256i *)(p + i), _mm256_shuffle_epi8(a, mask));           \
+        _mm256_storeu_si256((__m256i *)(p + i + 32), _mm256_shuffle_epi8(b, mask));      \
+    }                                                                                    \
+    for (; i + 32 <= nbytes; i += 32) {                                                  \
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));                        \
+        _mm256_storeu_si256((__m256i *)(p + i), _mm256_shuffle_epi8(a, mask));           \
+    }                                                                                    \
+    nbt_endian_swap_array_scalar_ ## _bits(p + i, (nbytes - i) / (_bits / 8));           \
 }
 
-uint32_t nbt_endian_swap_u32(uint32_t in) {
-    return (in >> 24)
-        | (in & 0x00FF0000) >> 8
-        | (in & 0x0000FF00) << 8
-        | (in << 24);
-}
+O(16)
+O(32)
+O(64)
+#undef O
+#endif
 
-int32_t nbt_endian_swap_s32(int32_t in) {
-    return ((in >> 24) & 0xFF) /* remove sign-extension */
-        | (in & 0x00FF0000) >> 8
-        | (in & 0x0000FF00) << 8
-        | (in << 24);
-}
+typedef void (*nbt_swap_array_func)(void *buf, size_t count);
 
-uint16_t nbt_endian_swap_u16(uint16_t in) {
-    return (in >> 8) | (in << 8);
-}
+struct nbt_swap_kernels {
+    const char *name;
+    nbt_swap_array_func swap16;
+    nbt_swap_array_func swap32;
+    nbt_swap_array_func swap64;
+};
 
-int16_t nbt_endian_swap_s16(int16_t in) {
-    return ((in >> 8) & 0xFF) | (in << 8);
-}
+static const struct nbt_swap_kernels nbt_swap_kernels_scalar = {
+    "scalar", nbt_endian_swap_array_scalar_16, nbt_endian_swap_array_scalar_32, nbt_endian_swap_array_scalar_64
+};
 
-#define SWAP_FUNC(_ct, _bits)                                    \
-_ct nbt_endian_h2be_ ## _bits(_ct in) {                          \
-    if (NBT_ENDIAN_LITTLE) return nbt_endian_swap_ ## _bits(in); \
-    else if (NBT_ENDIAN_BIG) return in;                          \
-    return nbt_endian_invalid();                                 \
+#ifdef NBT_ENDIAN_X86_KERNELS
+static const struct nbt_swap_kernels nbt_swap_kernels_ssse3 = {
+    "ssse3", nbt_endian_swap_array_ssse3_16, nbt_endian_swap_array_ssse3_32, nbt_endian_swap_array_ssse3_64
+};
+
+static const struct nbt_swap_kernels nbt_swap_kernels_avx2 = {
+    "avx2", nbt_endian_swap_array_avx2_16, nbt_endian_swap_array_avx2_32, nbt_endian_swap_array_avx2_64
+};
+#endif
+
+static const struct nbt_swap_kernels *nbt_swap_kernels = NULL;
+
+/* Every thread computes the same answer, so a racing first call is harmless. */
+static const struct nbt_swap_kernels *nbt_endian_kernels(void) {
+    const struct nbt_swap_kernels *kernels = __atomic_load_n(&nbt_swap_kernels, __ATOMIC_RELAXED);
+    if (kernels) return kernels;
+
+    kernels = &nbt_swap_kernels_scalar;
+#ifdef NBT_ENDIAN_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels = &nbt_swap_kernels_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        kernels = &nbt_swap_kernels_ssse3;
+#endif
+
+    __atomic_store_n(&nbt_swap_kernels, kernels, __ATOMIC_RELAXED);
+    return kernels;
 }
 
-SWAP_FUNC(uint64_t, u64)
-SWAP_FUNC(uint32_t, u32)
-SWAP_FUNC(uint16_t, u16)
+const char *nbt_endian_array_impl(void) {
+    return nbt_endian_kernels()->name;
+}
 
-SWAP_FUNC(int64_t, s64)
-SWAP_FUNC(int32_t, s32)
-SWAP_FUNC(int16_t, s16)
+void nbt_endian_be2h_array(void *buf, size_t count, size_t width) {
+    if (NBT_ENDIAN_BIG) return;
 
-#undef SWAP_FUNC
+    switch (width) {
+        case 2:
+            nbt_endian_kernels()->swap16(buf, count);
+            break;
+        case 4:
+            nbt_endian_kernels()->swap32(buf, count);
+            break;
+        case 8:
+            nbt_endian_kernels()->swap64(buf, count);
+            break;
+    }
+}
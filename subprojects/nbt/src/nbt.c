@@ -1,25 +1,43 @@
 #include "nbt.h"
 #include "nbt_def.h"
 #include "nbt_endian.h"
+#include "nbt_internal.h"
 
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <limits.h>
+#include <errno.h>
 
-#include <setjmp.h>
-
-#include <zlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+/* Per thread, so concurrent callers can't clobber each other's messages. */
 #define NBT_ERROR_BUF_SZ (512)
-char nbt_error_buf[NBT_ERROR_BUF_SZ] = { '\0' };
+_Thread_local char nbt_error_buf[NBT_ERROR_BUF_SZ] = { '\0' };
 
 const char *nbt_error(void) {
     return nbt_error_buf;
 }
 
+#ifdef NBT_TRACE
+nbt_trace_hook nbt_trace_fn = NULL;
+void *nbt_trace_user = NULL;
+#endif
+
+int nbt_set_trace_hook(nbt_trace_hook hook, void *user) {
+#ifdef NBT_TRACE
+    nbt_trace_fn = hook;
+    nbt_trace_user = user;
+    return 0;
+#else
+    (void)hook;
+    (void)user;
+    nbt_set_error("libnbt was built without tracing (meson option nbt:trace)");
+    return -1;
+#endif
+}
+
 void nbt_copy_error(const char *buf) {
     strncpy(nbt_error_buf, buf, NBT_ERROR_BUF_SZ);
     nbt_error_buf[NBT_ERROR_BUF_SZ-1] = '\0';
@@ -34,357 +52,797 @@ void nbt_set_error(const char *fmt, ...) {
     nbt_error_buf[NBT_ERROR_BUF_SZ-1] = '\0';
 }
 
-#define GZ_MAGIC_0 (0x1F)
-#define GZ_MAGIC_1 (0x8B)
+void nbt_fill_error(struct nbt_error *err, size_t offset, const char *path) {
+    if (!err) return;
 
-#if 0
-int nbt_read(const unsigned char *data, size_t length, struct nbt_parsed *result) {
+    err->offset = offset;
+    snprintf(err->path, NBT_ERROR_PATH_SZ, "%s", path);
+    strncpy(err->message, nbt_error_buf, NBT_ERROR_MSG_SZ - 1);
+    err->message[NBT_ERROR_MSG_SZ-1] = '\0';
+}
 
+void nbt_reader_error(struct nbt_reader *rd, const char *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(rd->err.message, NBT_ERROR_MSG_SZ, fmt, va);
+    va_end(va);
+
+    /* nbt_reader_alloc() refused: say it was the limit, not the system */
+    if (rd->allocated > rd->alloclimit && len >= 0 && len < NBT_ERROR_MSG_SZ)
+        snprintf(rd->err.message + len, NBT_ERROR_MSG_SZ - len, " (over the limit of %zu bytes)", rd->alloclimit);
+
+    rd->err.offset = (size_t)(rd->cur - rd->start);
+    rd->err.pathlen = 0;
+    rd->err.truncated = false;
 }
-#endif
 
-#define NBT_READ_EXCEPTION(_ex, _fmt, ...) \
-do {                                       \
-    nbt_set_error(_fmt, ## __VA_ARGS__);   \
-    longjmp(_ex, 1);                       \
-} while (0)
+/* Prepends one path segment, e.g. "Level" or "[3]", adding a '.' between
+ * a name and whatever follows it. */
+void nbt_reader_error_path(struct nbt_reader *rd, const char *seg, size_t seglen) {
+    struct nbt_read_error *err = &rd->err;
+    const char *rest = err->path + NBT_ERROR_PATH_SZ - err->pathlen;
+    bool dot = err->pathlen > 0 && rest[0] != '[';
+
+    size_t need = seglen + (dot ? 1 : 0);
+    if (err->truncated || need > NBT_ERROR_PATH_SZ - 1 - err->pathlen) {
+        err->truncated = true;
+        return;
+    }
+
+    err->pathlen += need;
+    char *p = err->path + NBT_ERROR_PATH_SZ - err->pathlen;
+    memcpy(p, seg, seglen);
+    if (dot) p[seglen] = '.';
+}
+
+void nbt_reader_error_name(struct nbt_reader *rd, const char *name, nbt_strlen namelen) {
+    nbt_reader_error_path(rd, name, namelen);
+}
 
-/* How to use NBT_HANDLE_EX:
- *
- * NBT_HANDLE_EX(newex) {
- *     ... run if NBT_TRY's contents cause an exception ...
- * } NBT_TRY(oldex) {
- *     ... code to run safely (pass newex to functions here) ...
- * } NBT_TRY_END
- */
+void nbt_reader_error_index(struct nbt_reader *rd, nbt_int index) {
+    char seg[16];
+    int seglen = snprintf(seg, sizeof(seg), "[%d]", index);
+    nbt_reader_error_path(rd, seg, (size_t)seglen);
+}
 
-#define NBT_HANDLE_EX(_newex)      \
-{                                  \
-    jmp_buf _newex;                \
-    if (setjmp(_newex) != 0) { do
+int nbt_read_string(struct nbt_reader *rd, char **out, nbt_strlen *len);
 
-#define NBT_TRY(_oldex) while (0); longjmp(_oldex, 1); } do
+/* Publishes a reader failure to the caller's struct nbt_error and to the
+ * thread's nbt_error() string. */
+void nbt_reader_report(struct nbt_reader *rd, struct nbt_error *out) {
+    const struct nbt_read_error *err = &rd->err;
+    const char *path = err->path + NBT_ERROR_PATH_SZ - err->pathlen;
+    const char *ellipsis = err->truncated ? "..." : "";
 
-#define NBT_TRY_END while (0); }
+    if (err->pathlen > 0)
+        nbt_set_error("%s (at byte %zu, in %s%.*s)", err->message, err->offset, ellipsis, (int)err->pathlen, path);
+    else
+        nbt_set_error("%s (at byte %zu)", err->message, err->offset);
 
-nbt_type nbt_read_type(gzFile file, jmp_buf ex);
-nbt_strlen nbt_read_strlen(gzFile file, jmp_buf ex);
-char *nbt_read_string(gzFile file, nbt_strlen *len, jmp_buf ex);
+    if (out) {
+        out->offset = err->offset;
+        snprintf(out->path, NBT_ERROR_PATH_SZ, "%s%.*s", ellipsis, (int)err->pathlen, path);
+        snprintf(out->message, NBT_ERROR_MSG_SZ, "%s", err->message);
+    }
+}
 
-nbt_value nbt_read_value(gzFile file, nbt_type type, jmp_buf ex);
+int nbt_read(const unsigned char *data, size_t length, struct nbt_parsed *result) {
+    return nbt_read_ex(data, length, result, NULL);
+}
 
-int nbt_read_file(FILE *file, struct nbt_parsed *result) {
-    gzFile gzfp;
+void nbt_reader_init(struct nbt_reader *rd, const unsigned char *data, size_t length, const struct nbt_read_options *options) {
+    *rd = (struct nbt_reader){
+        .start = data,
+        .cur = data,
+        .end = data + length,
+        .arena = options ? options->arena : NULL,
+        .filter = {
+            .paths = options ? options->paths : NULL,
+            .npaths = options ? options->npaths : 0,
+            .prefix = "",
+            .active = options && options->paths,
+        },
+        .stats = options ? options->stats : NULL,
+        .depthlimit = NBT_DEFAULT_MAX_DEPTH,
+        .alloclimit = SIZE_MAX,
+        .nodelimit = SIZE_MAX,
+        .arraylimit = INT32_MAX,
+        .listlimit = INT32_MAX,
+    };
+
+    if (!options) return;
+
+    const struct nbt_limits *limits = &options->limits;
+    if (limits->max_depth) rd->depthlimit = limits->max_depth;
+    if (limits->max_alloc_bytes) rd->alloclimit = limits->max_alloc_bytes;
+    if (limits->max_nodes) rd->nodelimit = limits->max_nodes;
+    if (limits->max_array_length) rd->arraylimit = limits->max_array_length;
+    if (limits->max_list_length) rd->listlimit = limits->max_list_length;
+}
 
-    int fd = dup(fileno(file));
-    gzfp = gzdopen(fd, "rb");
+int nbt_read_document(struct nbt_reader *rd, struct nbt_parsed *result, struct nbt_error *error) {
+    nbt_type roottype;
+    nbt_value root;
+    uint64_t start = rd->stats ? nbt_now_ns() : 0;
+    int ret = -1;
 
-    gzbuffer(gzfp, 32768); /* 32K buffer */
+    NBT_TRACE_EVENT(NBT_TRACE_PARSE, true, (size_t)(rd->end - rd->start));
 
     result->namelen = 0;
     result->name = NULL;
     result->root = NULL;
+    result->arena = rd->arena;
+    result->map = NULL;
+    result->maplen = 0;
 
-    jmp_buf exjmp;
-    if (setjmp(exjmp) != 0) {
-        /* parsing exception */
+    if (nbt_read_type(rd, &roottype) < 0)
         goto parse_error_cleanup;
-    }
 
-    nbt_type roottype = nbt_read_type(gzfp, exjmp);
     if (roottype != NBT_TAG_COMPOUND) {
-        NBT_READ_EXCEPTION(exjmp, "Root tag is not TAG_COMPOUND (%#02hhx)", roottype);
+        nbt_reader_error(rd, "Root tag is not TAG_COMPOUND (%#02hhx)", roottype);
+        goto parse_error_cleanup;
     }
 
-    result->name = nbt_read_string(gzfp, &result->namelen, exjmp);
-
-    result->root = nbt_read_value(gzfp, roottype, exjmp).tag_compound;
+    if (nbt_read_string(rd, &result->name, &result->namelen) < 0)
+        goto parse_error_cleanup;
 
-    gzclose(gzfp);
+    if (nbt_read_value(rd, roottype, &root) < 0)
+        goto parse_error_cleanup;
 
-    return 0;
+    result->root = root.tag_compound;
+    ret = 0;
+    goto parse_done;
 
 parse_error_cleanup:
-    gzclose(gzfp);
+    nbt_reader_report(rd, error);
 
-    free(result->name);
-    nbt_free_compound(result->root);
+    if (!rd->arena) free(result->name);
 
-    return -1;
-}
+    result->namelen = 0;
+    result->name = NULL;
 
-nbt_type nbt_read_type(gzFile file, jmp_buf ex) {
-    nbt_type ret;
-    if (gzread(file, &ret, 1) < 1) NBT_READ_EXCEPTION(ex, "Failed to read NBT type: I/O error or EOF");
+parse_done:
+    if (rd->stats) {
+        rd->stats->decode_ns += nbt_now_ns() - start;
+        rd->stats->bytes_parsed += (size_t)(rd->cur - rd->start);
+        if (rd->maxdepth > rd->stats->max_depth) rd->stats->max_depth = rd->maxdepth;
+    }
+
+    NBT_TRACE_EVENT(NBT_TRACE_PARSE, false, ret < 0 ? 0 : (size_t)(rd->cur - rd->start));
     return ret;
 }
 
-nbt_strlen nbt_read_strlen(gzFile file, jmp_buf ex) {
-    uint16_t ret;
-    if (gzread(file, &ret, 2) < 2) NBT_READ_EXCEPTION(ex, "Failed to read NBT u16: I/O error or EOF");
-    return nbt_endian_be2h_u16(ret);
+int nbt_read_ex(const unsigned char *data, size_t length, struct nbt_parsed *result, const struct nbt_read_options *options) {
+    struct nbt_reader rd;
+
+    nbt_reader_init(&rd, data, length, options);
+    return nbt_read_document(&rd, result, options ? options->error : NULL);
 }
 
-char *nbt_read_string(gzFile file, nbt_strlen *len, jmp_buf ex) {
-    *len = nbt_read_strlen(file, ex);
+#define NBT_READ_CHUNK (65536)
 
-    char *str = (char *)malloc(*len + 1);
-    if (!str) NBT_READ_EXCEPTION(ex, "Failed to allocate space for NBT string: malloc() returned NULL");
+/* Reads the rest of `file` into a single malloc'd buffer, presized from the
+ * file size when there is one. */
+int nbt_read_whole_file(FILE *file, unsigned char **data, size_t *length) {
+    struct stat st;
 
-    int nread;
-    if ((nread = gzread(file, str, *len)) < *len) {
-        free(str);
-        NBT_READ_EXCEPTION(ex, "Partial read on NBT string: %d < %hu", nread, *len);
+    size_t cap = NBT_READ_CHUNK;
+    if (fstat(fileno(file), &st) == 0 && st.st_size > 0 && (uintmax_t)st.st_size < SIZE_MAX / 2)
+        while (cap <= (size_t)st.st_size) cap *= 2;
+
+    unsigned char *buf = malloc(cap);
+    size_t len = 0;
+    if (!buf) {
+        nbt_set_error("Unable to allocate %zu bytes for NBT data", cap);
+        return -1;
     }
-    str[*len] = '\0';
 
-    return str;
+    while (true) {
+        if (len == cap) {
+            unsigned char *temp = realloc(buf, cap * 2);
+            if (!temp) {
+                nbt_set_error("Unable to allocate %zu bytes for NBT data", cap * 2);
+                free(buf);
+                return -1;
+            }
+            buf = temp;
+            cap *= 2;
+        }
+
+        size_t nread = fread(buf + len, 1, cap - len, file);
+        len += nread;
+        if (nread == 0) break;
+    }
+
+    if (ferror(file)) {
+        nbt_set_error("Failed to read NBT data: %s", strerror(errno));
+        free(buf);
+        return -1;
+    }
+
+    *data = buf;
+    *length = len;
+    return 0;
 }
 
-nbt_byte nbt_read_byte(gzFile file, jmp_buf ex);
-nbt_short nbt_read_short(gzFile file, jmp_buf ex);
-nbt_int nbt_read_int(gzFile file, jmp_buf ex);
-nbt_long nbt_read_long(gzFile file, jmp_buf ex);
+int nbt_read_file(FILE *file, struct nbt_parsed *result) {
+    return nbt_read_file_ex(file, result, NULL);
+}
 
-nbt_float nbt_read_float(gzFile file, jmp_buf ex);
-nbt_double nbt_read_double(gzFile, jmp_buf ex);
+/* nbt_decompress() held to the options' allocation limit, and timed into
+ * their stats if there are any */
+int nbt_decompress_counted(const unsigned char *in, size_t inlen, int format, unsigned char **data, size_t *length, const struct nbt_read_options *options) {
+    struct nbt_stats *stats = options ? options->stats : NULL;
+    size_t limit = options ? options->limits.max_alloc_bytes : 0;
+    if (!stats) return nbt_decompress(in, inlen, format, limit, data, length);
+
+    uint64_t start = nbt_now_ns();
+    int ret = nbt_decompress(in, inlen, format, limit, data, length);
+    stats->inflate_ns += nbt_now_ns() - start;
+    if (ret == 0) stats->bytes_inflated += *length;
+    return ret;
+}
 
-struct nbt_byte_array *nbt_read_byte_array(gzFile file, jmp_buf ex);
-struct nbt_string *nbt_read_tag_string(gzFile file, jmp_buf ex);
-struct nbt_list *nbt_read_list(gzFile file, jmp_buf ex);
-struct nbt_compound *nbt_read_compound(gzFile file, jmp_buf ex);
-struct nbt_int_array *nbt_read_int_array(gzFile file, jmp_buf ex);
-struct nbt_long_array *nbt_read_long_array(gzFile file, jmp_buf ex);
+int nbt_read_file_ex(FILE *file, struct nbt_parsed *result, const struct nbt_read_options *options) {
+    struct nbt_stats *stats = options ? options->stats : NULL;
+    unsigned char *data, *inflated;
+    size_t length, inflatedlen;
 
-nbt_value nbt_read_value(gzFile file, nbt_type type, jmp_buf ex) {
-    nbt_value ret;
-    
-    switch (type) {
-        case NBT_TAG_BYTE:
-            ret.tag_byte = nbt_read_byte(file, ex);
-            break;
-        case NBT_TAG_SHORT:
-            ret.tag_short = nbt_read_short(file, ex);
-            break;
-        case NBT_TAG_INT:
-            ret.tag_int = nbt_read_int(file, ex);
-            break;
-        case NBT_TAG_LONG:
-            ret.tag_long = nbt_read_long(file, ex);
-            break;
-        case NBT_TAG_FLOAT:
-            ret.tag_float = nbt_read_float(file, ex);
-            break;
-        case NBT_TAG_DOUBLE:
-            ret.tag_double = nbt_read_double(file, ex);
-            break;
-        case NBT_TAG_BYTE_ARRAY:
-            ret.tag_byte_array = nbt_read_byte_array(file, ex);
-            break;
-        case NBT_TAG_STRING:
-            ret.tag_string = nbt_read_tag_string(file, ex);
-            break;
-        case NBT_TAG_LIST:
-            ret.tag_list = nbt_read_list(file, ex);
-            break;
-        case NBT_TAG_COMPOUND:
-            ret.tag_compound = nbt_read_compound(file, ex);
-            break;
-        case NBT_TAG_INT_ARRAY:
-            ret.tag_int_array = nbt_read_int_array(file, ex);
-            break;
-        case NBT_TAG_LONG_ARRAY:
-            ret.tag_long_array = nbt_read_long_array(file, ex);
-            break;
+    uint64_t start = stats ? nbt_now_ns() : 0;
+    if (nbt_read_whole_file(file, &data, &length) < 0)
+        goto file_error;
+
+    if (stats) {
+        stats->read_ns += nbt_now_ns() - start;
+        stats->bytes_read += length;
     }
 
+    int format = nbt_detect_compression(data, length);
+    if (format != NBT_COMPRESSION_NONE) {
+        int ret = nbt_decompress_counted(data, length, format, &inflated, &inflatedlen, options);
+        free(data);
+        if (ret < 0) goto file_error;
+
+        data = inflated;
+        length = inflatedlen;
+    }
+
+    int ret = nbt_read_ex(data, length, result, options);
+    free(data);
+
     return ret;
-}
 
-#define O(_ctype, _uname, _lname)                                                                       \
-_ctype nbt_read_ ## _lname(gzFile file, jmp_buf ex) {                                                   \
-    _ctype ret;                                                                                         \
-    int nread;                                                                                          \
-    if ((nread = gzread(file, &ret, sizeof(_ctype))) < sizeof(_ctype))                                  \
-        NBT_READ_EXCEPTION(ex, "Partial read on NBT " #_lname ": %d < %d", nread, (int)sizeof(_ctype)); \
-    return nbt_endian_be2h_ ## _lname(ret);                                                             \
+file_error:
+    nbt_fill_error(options ? options->error : NULL, 0, "");
+    result->namelen = 0;
+    result->name = NULL;
+    result->root = NULL;
+    result->arena = NULL;
+    result->map = NULL;
+    result->maplen = 0;
+    return -1;
 }
 
-NBT_FOREACH_INT_TYPE(O)
-#undef O
+int nbt_read_file_mapped(FILE *file, struct nbt_parsed *result, const struct nbt_read_options *options) {
+    struct nbt_error *error = options ? options->error : NULL;
+    struct stat st;
+
+    result->namelen = 0;
+    result->name = NULL;
+    result->root = NULL;
+    result->arena = NULL;
+    result->map = NULL;
+    result->maplen = 0;
+
+    if (!options || !options->arena) {
+        nbt_set_error("Zero-copy reads need an arena (nbt_read_options.arena)");
+        nbt_fill_error(error, 0, "");
+        return -1;
+    }
+
+    /* empty and unmappable files get nbt_read_file_ex()'s diagnostics */
+    if (fstat(fileno(file), &st) < 0 || st.st_size <= 0 || (uintmax_t)st.st_size > SIZE_MAX)
+        return nbt_read_file_ex(file, result, options);
+
+    size_t length = (size_t)st.st_size;
+    unsigned char *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+    if (map == MAP_FAILED)
+        return nbt_read_file_ex(file, result, options);
+
+    /* pages come in as the decoder touches them, so that is where the
+     * reading time shows up */
+    if (options->stats) options->stats->bytes_read += length;
+
+    /* compressed: inflate straight from the mapping, then read normally */
+    int format = nbt_detect_compression(map, length);
+    if (format != NBT_COMPRESSION_NONE) {
+        unsigned char *inflated;
+        size_t inflatedlen;
+
+        int ret = nbt_decompress_counted(map, length, format, &inflated, &inflatedlen, options);
+        munmap(map, length);
+        if (ret < 0) {
+            nbt_fill_error(error, 0, "");
+            return -1;
+        }
+
+        ret = nbt_read_ex(inflated, inflatedlen, result, options);
+        free(inflated);
+        return ret;
+    }
+
+    struct nbt_reader rd;
+    nbt_reader_init(&rd, map, length, options);
+    rd.borrow = true;
+
+    if (nbt_read_document(&rd, result, error) < 0) {
+        munmap(map, length);
+        return -1;
+    }
 
-#define O(_ctype, _uname, _lname)                                                                       \
-_ctype nbt_read_ ## _lname(gzFile file, jmp_buf ex) {                                                   \
-    _ctype ret;                                                                                         \
-    int nread;                                                                                          \
-    if ((nread = gzread(file, &ret, sizeof(_ctype))) < sizeof(_ctype))                                  \
-        NBT_READ_EXCEPTION(ex, "Partial read on NBT " #_lname ": %d < %d", nread, (int)sizeof(_ctype)); \
-    return ret;                                                                                         \
+    result->map = map;
+    result->maplen = length;
+    return 0;
 }
 
-NBT_FOREACH_FP_TYPE(O)
-#undef O
+int nbt_read_string(struct nbt_reader *rd, char **out, nbt_strlen *len) {
+    if (nbt_read_strlen(rd, len) < 0) return -1;
+    NBT_READER_NEED(rd, *len, "string");
+
+    char *str = (char *)nbt_reader_alloc(rd, *len + 1);
+    if (!str) NBT_READ_FAIL(rd, "Failed to allocate space for NBT string");
+
+    memcpy(str, rd->cur, *len);
+    rd->cur += *len;
+    str[*len] = '\0';
+
+    *out = str;
+    return 0;
+}
 
 #define NBT_READ_ARRAY(_t) \
-struct nbt_ ## _t ## _array *nbt_read_ ## _t ## _array(gzFile file, jmp_buf ex) {                                                     \
-    struct nbt_ ## _t ## _array *ret = malloc(sizeof(struct nbt_ ## _t ## _array));                                                   \
-    if (!ret)                                                                                                                         \
-        NBT_READ_EXCEPTION(ex, "Unable to allocate memory for new NBT " #_t "_array");                                                \
-                                                                                                                                      \
-    memset(ret, 0, sizeof(struct nbt_ ## _t ## _array));                                                                              \
-                                                                                                                                      \
-    NBT_HANDLE_EX(newex) {                                                                                                            \
-        nbt_free_ ## _t ## _array(ret);                                                                                               \
-    } NBT_TRY(ex) {                                                                                                                   \
-        ret->len = nbt_read_int(file, newex);                                                                                         \
-                                                                                                                                      \
-        if (ret->len < 0)                                                                                                             \
-            NBT_READ_EXCEPTION(newex, "NBT " #_t " array has negative length: %d", ret->len);                                         \
-        else if (ret->len == 0)                                                                                                       \
-            ret->buf = NULL;                                                                                                          \
-        else {                                                                                                                        \
-            size_t readlen = ret->len * sizeof(nbt_ ## _t);                                                                           \
-            if (readlen > UINT_MAX)                                                                                                   \
-                NBT_READ_EXCEPTION(newex, "Unable to allocate %zu bytes for nbt_" #_t "_array: length does not fit in unsigned int"); \
-            unsigned int nread;                                                                                                       \
-            ret->buf = malloc(readlen);                                                                                               \
-            if (!ret->buf)                                                                                                            \
-                NBT_READ_EXCEPTION(newex, "Unable to allocate %zu bytes for nbt_" #_t "_array buffer", readlen);                      \
-                                                                                                                                      \
-            if ((nread = gzread(file, ret->buf, readlen)) < readlen)                                                                  \
-                NBT_READ_EXCEPTION(newex, "Partial read on NBT " #_t "_array: %lu < %zu", nread, readlen);                            \
-        }                                                                                                                             \
-    } NBT_TRY_END                                                                                                                     \
-    return ret;                                                                                                                       \
+int nbt_read_ ## _t ## _array(struct nbt_reader *rd, struct nbt_ ## _t ## _array **out) {                  \
+    struct nbt_ ## _t ## _array *ret = nbt_reader_alloc(rd, sizeof(struct nbt_ ## _t ## _array));         \
+    if (!ret)                                                                                              \
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT " #_t "_array");                          \
+                                                                                                           \
+    memset(ret, 0, sizeof(struct nbt_ ## _t ## _array));                                                   \
+                                                                                                           \
+    if (nbt_read_int(rd, &ret->len) < 0)                                                                   \
+        goto array_error_cleanup;                                                                          \
+                                                                                                           \
+    if (ret->len < 0) {                                                                                    \
+        nbt_reader_error(rd, "NBT " #_t " array has negative length: %d", ret->len);                       \
+        goto array_error_cleanup;                                                                          \
+    } else if (ret->len > rd->arraylimit) {                                                                \
+        nbt_reader_error(rd, "NBT " #_t " array is longer than the limit of %d: %d", rd->arraylimit,       \
+                         ret->len);                                                                        \
+        goto array_error_cleanup;                                                                          \
+    } else if (ret->len > 0) {                                                                             \
+        size_t readlen = (size_t)ret->len * sizeof(nbt_ ## _t);                                            \
+        if (NBT_READER_LEFT(rd) < readlen) {                                                               \
+            nbt_reader_error(rd, "Unexpected end of input reading NBT " #_t "_array: %zu < %zu",           \
+                             NBT_READER_LEFT(rd), readlen);                                                \
+            goto array_error_cleanup;                                                                      \
+        }                                                                                                  \
+                                                                                                           \
+        ret->buf = (nbt_ ## _t *)nbt_reader_borrow(rd, sizeof(nbt_ ## _t));                                \
+        if (!ret->buf) {                                                                                   \
+            ret->buf = nbt_reader_alloc(rd, readlen);                                                      \
+            if (!ret->buf) {                                                                               \
+                nbt_reader_error(rd, "Unable to allocate %zu bytes for nbt_" #_t "_array buffer",          \
+                                 readlen);                                                                 \
+                goto array_error_cleanup;                                                                  \
+            }                                                                                              \
+                                                                                                           \
+            memcpy(ret->buf, rd->cur, readlen);                                                            \
+            nbt_endian_be2h_array(ret->buf, ret->len, sizeof(nbt_ ## _t));                                 \
+        }                                                                                                  \
+        rd->cur += readlen;                                                                                \
+    }                                                                                                      \
+                                                                                                           \
+    *out = ret;                                                                                            \
+    return 0;                                                                                              \
+                                                                                                           \
+array_error_cleanup:                                                                                       \
+    NBT_READER_FREE(rd, _t ## _array, ret);                                                                \
+    return -1;                                                                                             \
 }
 
 NBT_READ_ARRAY(byte)
 
-#if 0
-struct nbt_byte_array *nbt_read_byte_array(gzFile file, jmp_buf ex) {
-    struct nbt_byte_array *ret = malloc(sizeof(struct nbt_byte_array));
+int nbt_read_tag_string(struct nbt_reader *rd, struct nbt_string **out) {
+    struct nbt_string *ret = nbt_reader_alloc(rd, sizeof(struct nbt_string));
     if (!ret)
-        NBT_READ_EXCEPTION(ex, "Unable to allocate memory for new NBT byte_array");
-    
-    memset(ret, 0, sizeof(struct nbt_byte_array));
-
-    NBT_HANDLE_EX(newex) {
-        nbt_free_byte_array(ret);
-    } NBT_TRY(ex) {
-        ret->len = nbt_read_int(file, newex);
-
-        if (ret->len < 0)
-            NBT_READ_EXCEPTION(newex, "NBT byte array has negative length: %d", ret->len);
-        else if (ret->len == 0)
-            ret->buf = NULL;
-        else {
-            size_t readlen = ret->len * sizeof(nbt_byte);
-            unsigned int nread;
-            ret->buf = malloc(readlen);
-            if (!ret->buf)
-                NBT_READ_EXCEPTION(newex, "Unable to allocate %zu bytes for nbt_byte buffer", readlen);
-
-            if ((nread = gzread(file, ret->buf, readlen)) < readlen)
-                NBT_READ_EXCEPTION(newex, "Partial read on NBT byte_array: %lu < %zu", nread, readlen);
-        }
-    } NBT_TRY_END
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT string");
+
+    if (rd->borrow) {
+        /* arena-backed, so nothing to free on failure */
+        if (nbt_read_strlen(rd, &ret->len) < 0) return -1;
+        NBT_READER_NEED(rd, ret->len, "string");
+        ret->buf = (char *)rd->cur;
+        rd->cur += ret->len;
+    } else if (nbt_read_string(rd, &ret->buf, &ret->len) < 0) {
+        if (!rd->arena) free(ret);
+        return -1;
+    }
 
-    return ret;
+    *out = ret;
+    return 0;
 }
-#endif
 
-struct nbt_string *nbt_read_tag_string(gzFile file, jmp_buf ex) {
-    struct nbt_string *ret = malloc(sizeof(struct nbt_string));
+/* Reads a list's header and, for lists of numbers, its elements. Lists of
+ * anything else get a zeroed pointer array for nbt_read_value() to fill. */
+int nbt_read_list_open(struct nbt_reader *rd, struct nbt_list **out) {
+    struct nbt_list *ret = nbt_reader_alloc(rd, sizeof(struct nbt_list));
     if (!ret)
-        NBT_READ_EXCEPTION(ex, "Unable to allocate memory for new NBT string");
-    
-    memset(ret, 0, sizeof(struct nbt_string));
-    
-    NBT_HANDLE_EX(newex) {
-        nbt_free_string(ret);
-    } NBT_TRY(ex) {
-        ret->buf = nbt_read_string(file, &ret->len, newex);
-    } NBT_TRY_END
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT list");
 
-    return ret;
-}
+    memset(ret, 0, sizeof(struct nbt_list));
 
-struct nbt_list *nbt_read_list(gzFile file, jmp_buf ex) {
-    struct nbt_list *ret = malloc(sizeof(struct nbt_list));
-    if (!ret)
-        NBT_READ_EXCEPTION(ex, "Unable to allocate memory for new NBT list");
+    if (nbt_read_type(rd, &ret->type) < 0 || nbt_read_int(rd, &ret->length) < 0)
+        goto list_error_cleanup;
+
+    if (ret->length < 0) {
+        nbt_reader_error(rd, "NBT list has negative length: %d", ret->length);
+        goto list_error_cleanup;
+    } else if (ret->length > rd->listlimit) {
+        nbt_reader_error(rd, "NBT list is longer than the limit of %d: %d", rd->listlimit, ret->length);
+        goto list_error_cleanup;
+    } else if (ret->length > 0) {
+        if (ret->type == NBT_TAG_END) {
+            nbt_reader_error(rd, "NBT list has %d (> 0) value(s) of type NBT_TAG_END", ret->length);
+            goto list_error_cleanup;
+        }
 
-    memset(ret, 0, sizeof(struct nbt_list));
-    
-    NBT_HANDLE_EX(newex) {
-        nbt_free_list(ret);
-    } NBT_TRY(ex) {
-        ret->type = nbt_read_type(file, newex);
-        ret->length = nbt_read_int(file, newex);
-
-        if (ret->length < 0)
-            NBT_READ_EXCEPTION(newex, "NBT list has negative length: %d", ret->length);
-        else if (ret->length == 0)
-            ret->first = NULL;
-        else {
-            if (ret->type == NBT_TAG_END)
-                NBT_READ_EXCEPTION(newex, "NBT list has %d (> 0) value(s) of type NBT_TAG_END", ret->length);
-
-            struct nbt_list_entry **entry = &ret->first;
-            for (nbt_int i = 0; i < ret->length; ++i) {
-                *entry = malloc(sizeof(struct nbt_list_entry));
-                if (!(*entry))
-                    NBT_READ_EXCEPTION(newex, "Unable to allocate memory for NBT list entry");
-                
-                memset(*entry, 0, sizeof(struct nbt_list_entry));
-
-                (*entry)->value = nbt_read_value(file, ret->type, newex);
-                entry = &(*entry)->next;
-            }
-            *entry = NULL;
+        size_t elemsize = nbt_type_size(ret->type);
+        if (elemsize == 0) {
+            nbt_reader_error(rd, "NBT list has invalid element type %#02hhx", ret->type);
+            goto list_error_cleanup;
+        }
+        if ((size_t)ret->length > SIZE_MAX / elemsize) {
+            nbt_reader_error(rd, "NBT list is too long: %d", ret->length);
+            goto list_error_cleanup;
         }
-    } NBT_TRY_END
 
-    return ret;
-}
+        size_t datalen = (size_t)ret->length * elemsize;
 
-struct nbt_compound *nbt_read_compound(gzFile file, jmp_buf ex) {
-    struct nbt_compound *ret = malloc(sizeof(struct nbt_compound));
-    if (!ret)
-        NBT_READ_EXCEPTION(ex, "Unable to allocate memory for new NBT compound");
-    
-    memset(ret, 0, sizeof(struct nbt_compound));
-    
-    NBT_HANDLE_EX(newex) {
-        nbt_free_compound(ret);
-    } NBT_TRY(ex) {
-        struct nbt_compound_entry **entry = &ret->first;
-        nbt_type elemtype;
-        ret->first = NULL;
-        ret->size = 0;
-
-        while (true) {
-            *entry = malloc(sizeof(struct nbt_compound_entry));
-            if (!(*entry))
-                NBT_READ_EXCEPTION(newex, "Unable to allocate memory for NBT compound entry");
-
-            memset(*entry, 0, sizeof(struct nbt_compound_entry));
-
-            elemtype = nbt_read_byte(file, newex);
-            if (elemtype == NBT_TAG_END) break;
-
-            (*entry)->name = nbt_read_string(file, &(*entry)->namelen, newex);
-            (*entry)->tag.type = elemtype;
-            (*entry)->tag.value = nbt_read_value(file, elemtype, newex);
-            entry = &(*entry)->next;
-            ++ret->size;
+        switch (ret->type) {
+            /* fixed-width scalars: one bounds check, then swap in place */
+#define O(_ctype, _uname, _lname) \
+            case NBT_TAG_ ## _uname:
+
+            NBT_FOREACH_NUM_TYPE(O)
+#undef O
+                if (NBT_READER_LEFT(rd) < datalen) {
+                    nbt_reader_error(rd, "Unexpected end of input reading NBT numeric list: %zu < %zu",
+                                     NBT_READER_LEFT(rd), datalen);
+                    goto list_error_cleanup;
+                }
+
+                ret->data.raw = (void *)nbt_reader_borrow(rd, elemsize);
+                if (!ret->data.raw) {
+                    ret->data.raw = nbt_reader_alloc(rd, datalen);
+                    if (!ret->data.raw) {
+                        nbt_reader_error(rd, "Unable to allocate %zu bytes for NBT list", datalen);
+                        goto list_error_cleanup;
+                    }
+
+                    memcpy(ret->data.raw, rd->cur, datalen);
+                    nbt_endian_be2h_array(ret->data.raw, ret->length, elemsize);
+                }
+                rd->cur += datalen;
+                break;
+
+            default:
+                /* every element takes some input, so a length the rest of
+                 * the input cannot hold fails before anything is allocated */
+                if ((size_t)ret->length > NBT_READER_LEFT(rd) / nbt_type_min_size(ret->type)) {
+                    nbt_reader_error(rd, "Unexpected end of input reading NBT list: %zu < %zu", NBT_READER_LEFT(rd),
+                                     (size_t)ret->length * nbt_type_min_size(ret->type));
+                    goto list_error_cleanup;
+                }
+
+                /* pointer elements: zeroed first so a partial list can be freed */
+                ret->data.raw = nbt_reader_alloc(rd, datalen);
+                if (!ret->data.raw) {
+                    nbt_reader_error(rd, "Unable to allocate %zu bytes for NBT list", datalen);
+                    goto list_error_cleanup;
+                }
+                memset(ret->data.raw, 0, datalen);
+                break;
         }
-    } NBT_TRY_END;
+    }
 
-    return ret;
+    *out = ret;
+    return 0;
+
+list_error_cleanup:
+    NBT_READER_FREE(rd, list, ret);
+    return -1;
+}
+
+/* Called once every entry is read. */
+int nbt_read_compound_close(struct nbt_reader *rd, struct nbt_compound *compound) {
+    /* arena trees are never freed node by node, so a lazily malloc'd
+     * index would leak; build it from the arena now instead */
+    if (rd->arena && compound->size >= NBT_COMPOUND_INDEX_MIN) {
+        size_t indexlen = nbt_compound_index_slots(compound->size) * sizeof(struct nbt_compound_entry *);
+        struct nbt_compound_entry **index = nbt_reader_alloc(rd, indexlen);
+        if (!index)
+            NBT_READ_FAIL(rd, "Unable to allocate %zu bytes for NBT compound index", indexlen);
+
+        memset(index, 0, indexlen);
+        nbt_compound_fill_index(compound, index);
+    }
+
+    return 0;
+}
+
+/* Builders for the text parsers (SNBT, JSON), which gather a value before
+ * it becomes a node. */
+int nbt_reader_make_string(struct nbt_reader *rd, const void *s, size_t len, struct nbt_string **out) {
+    struct nbt_string *str = nbt_reader_alloc(rd, sizeof(struct nbt_string));
+    if (!str)
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT string");
+
+    str->buf = nbt_reader_alloc(rd, len + 1);
+    if (!str->buf) {
+        if (!rd->arena) free(str);
+        NBT_READ_FAIL(rd, "Failed to allocate space for NBT string");
+    }
+
+    memcpy(str->buf, s, len);
+    str->buf[len] = '\0';
+    str->len = (nbt_strlen)len;
+    *out = str;
+    return 0;
 }
 
+#define NBT_MAKE_ARRAY(_t)                                                                      \
+do {                                                                                            \
+    size_t size = (size_t)count * sizeof(nbt_ ## _t);                                           \
+    struct nbt_ ## _t ## _array *arr = nbt_reader_alloc(rd, sizeof(struct nbt_ ## _t ## _array)); \
+    if (!arr)                                                                                   \
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT " #_t "_array");              \
+                                                                                                \
+    arr->len = count;                                                                           \
+    arr->buf = NULL;                                                                            \
+    if (count > 0) {                                                                            \
+        arr->buf = nbt_reader_alloc(rd, size);                                                  \
+        if (!arr->buf) {                                                                        \
+            if (!rd->arena) free(arr);                                                          \
+            NBT_READ_FAIL(rd, "Unable to allocate %zu bytes for nbt_" #_t "_array buffer", size); \
+        }                                                                                       \
+        memcpy(arr->buf, data, size);                                                           \
+    }                                                                                           \
+    out->tag_ ## _t ## _array = arr;                                                            \
+} while (0)
+
+/* `count` elements of `type`'s width, in host order */
+int nbt_reader_make_array(struct nbt_reader *rd, nbt_type type, const void *data, nbt_int count, nbt_value *out) {
+    if (type == NBT_TAG_BYTE_ARRAY) NBT_MAKE_ARRAY(byte);
+    else if (type == NBT_TAG_INT_ARRAY) NBT_MAKE_ARRAY(int);
+    else NBT_MAKE_ARRAY(long);
+    return 0;
+}
+
+#undef NBT_MAKE_ARRAY
+
 NBT_READ_ARRAY(int)
 NBT_READ_ARRAY(long)
 
 #undef NBT_READ_ARRAY
+
+/* Scalars, strings and arrays: values without children. */
+int nbt_read_leaf(struct nbt_reader *rd, nbt_type type, nbt_value *out) {
+    switch (type) {
+#define O(_ctype, _uname, _lname)                              \
+        case NBT_TAG_ ## _uname:                               \
+            return nbt_read_ ## _lname(rd, &out->tag_ ## _lname);
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        case NBT_TAG_BYTE_ARRAY:
+            return nbt_read_byte_array(rd, &out->tag_byte_array);
+        case NBT_TAG_STRING:
+            return nbt_read_tag_string(rd, &out->tag_string);
+        case NBT_TAG_INT_ARRAY:
+            return nbt_read_int_array(rd, &out->tag_int_array);
+        case NBT_TAG_LONG_ARRAY:
+            return nbt_read_long_array(rd, &out->tag_long_array);
+        default:
+            NBT_READ_FAIL(rd, "Invalid NBT tag type %#02hhx", type);
+    }
+}
+
+/* A compound or list being filled by nbt_read_value(). */
+struct nbt_read_frame {
+    nbt_type type;
+    union {
+        struct nbt_compound *compound;
+        struct nbt_list *list;
+    } node;
+
+    /* compounds */
+    struct nbt_compound_entry **tail;   /* where the next entry is linked */
+    struct nbt_compound_entry *entry;   /* entry whose value is being read */
+    struct nbt_read_filter filter;      /* in effect for every entry */
+
+    /* lists of strings, arrays, lists or compounds */
+    nbt_int index;                      /* element being read */
+};
+
+/* Frames kept on the C stack; deeper documents move them to the heap. */
+#define NBT_READ_FRAMES (32)
+
+/* Links a value into the open container on top of the stack (or into
+ * `out` at the bottom). Containers are linked as soon as they are
+ * allocated, so after a failure everything read so far hangs off the
+ * bottom frame and is freed with it. */
+static inline void nbt_read_link(struct nbt_read_frame *top, nbt_value *out, nbt_type type, nbt_value value) {
+    if (!top) {
+        *out = value;
+    } else if (top->type == NBT_TAG_COMPOUND) {
+        top->entry->tag.type = type;
+        top->entry->tag.value = value;
+    } else {
+        /* elements here are all pointers */
+        memcpy((unsigned char *)top->node.list->data.raw + (size_t)top->index * sizeof(void *), &value, sizeof(void *));
+    }
+}
+
+/* The tree is walked with an explicit stack of open compounds and lists
+ * rather than by recursion, so nesting is bounded by rd->depthlimit and
+ * heap, not by the stack of the calling thread. */
+int nbt_read_value(struct nbt_reader *rd, nbt_type type, nbt_value *out) {
+    struct nbt_read_frame frames[NBT_READ_FRAMES];
+    struct nbt_read_frame *stack = frames, *top = NULL;
+    size_t depth = 0, capacity = NBT_READ_FRAMES;
+    nbt_value value;
+    int ret = -1;
+
+    while (true) {
+        /* read a value of `type` into the top frame, or open it */
+        if (rd->stats && type <= NBT_TAG_LONG_ARRAY) ++rd->stats->nodes[type];
+
+        if (++rd->nodes > rd->nodelimit) {
+            nbt_reader_error(rd, "NBT data has more than the limit of %zu values", rd->nodelimit);
+            goto read_error_cleanup;
+        }
+
+        if (type == NBT_TAG_COMPOUND || type == NBT_TAG_LIST) {
+            if (nbt_reader_enter(rd) < 0) goto read_error_cleanup;
+
+            if (depth == capacity) {
+                struct nbt_read_frame *temp = stack == frames ? malloc(capacity * 2 * sizeof(struct nbt_read_frame))
+                                                              : realloc(stack, capacity * 2 * sizeof(struct nbt_read_frame));
+                if (!temp) {
+                    nbt_reader_error(rd, "Unable to allocate memory for NBT reader stack");
+                    nbt_reader_leave(rd);
+                    goto read_error_cleanup;
+                }
+                if (stack == frames) memcpy(temp, frames, sizeof(frames));
+                stack = temp;
+                capacity *= 2;
+                top = &stack[depth - 1];
+            }
+
+            if (type == NBT_TAG_COMPOUND) {
+                value.tag_compound = nbt_reader_alloc(rd, sizeof(struct nbt_compound));
+                if (!value.tag_compound) {
+                    nbt_reader_error(rd, "Unable to allocate memory for new NBT compound");
+                    nbt_reader_leave(rd);
+                    goto read_error_cleanup;
+                }
+                memset(value.tag_compound, 0, sizeof(struct nbt_compound));
+                nbt_read_link(top, out, type, value);
+
+                top = &stack[depth++];
+                top->type = NBT_TAG_COMPOUND;
+                top->node.compound = value.tag_compound;
+                top->tail = &value.tag_compound->first;
+                top->entry = NULL;
+                top->filter = rd->filter;
+            } else {
+                if (nbt_read_list_open(rd, &value.tag_list) < 0) {
+                    nbt_reader_leave(rd);
+                    goto read_error_cleanup;
+                }
+                nbt_read_link(top, out, type, value);
+
+                if (value.tag_list->length > 0 && value.tag_list->type > NBT_TAG_DOUBLE) {
+                    top = &stack[depth++];
+                    top->type = NBT_TAG_LIST;
+                    top->node.list = value.tag_list;
+                    top->index = 0;
+                    type = value.tag_list->type;
+                    continue;
+                }
+
+                /* numbers or nothing: already complete */
+                nbt_reader_leave(rd);
+            }
+        } else {
+            if (nbt_read_leaf(rd, type, &value) < 0) goto read_error_cleanup;
+            nbt_read_link(top, out, type, value);
+        }
+
+        /* find the next value to read: an element of the top list or the
+         * next entry of the top compound, closing finished containers */
+        while (depth > 0) {
+            if (top->type == NBT_TAG_LIST) {
+                if (++top->index < top->node.list->length) {
+                    type = top->node.list->type;
+                    break;
+                }
+            } else {
+                top->entry = NULL;
+                rd->filter = top->filter;
+
+                nbt_type elemtype;
+                if (nbt_read_type(rd, &elemtype) < 0) goto read_error_cleanup;
+
+                if (elemtype != NBT_TAG_END) {
+                    if (rd->filter.active) {
+                        int r = nbt_filter_entry(rd, elemtype);
+                        if (r < 0) goto read_error_cleanup;
+                        if (r > 0) continue;
+                    }
+
+                    struct nbt_compound_entry *entry = nbt_reader_alloc(rd, sizeof(struct nbt_compound_entry));
+                    if (!entry) {
+                        nbt_reader_error(rd, "Unable to allocate memory for NBT compound entry");
+                        goto read_error_cleanup;
+                    }
+
+                    /* TAG_End until its value is linked */
+                    memset(entry, 0, sizeof(struct nbt_compound_entry));
+                    *top->tail = entry;
+                    top->tail = &entry->next;
+                    ++top->node.compound->size;
+
+                    if (nbt_read_string(rd, &entry->name, &entry->namelen) < 0)
+                        goto read_error_cleanup;
+
+                    entry->hash = nbt_hash_name(entry->name, entry->namelen);
+                    top->entry = entry;
+                    type = elemtype;
+                    break;
+                }
+
+                if (nbt_read_compound_close(rd, top->node.compound) < 0) goto read_error_cleanup;
+            }
+
+            nbt_reader_leave(rd);
+            top = --depth > 0 ? &stack[depth - 1] : NULL;
+        }
+
+        if (depth == 0) break;
+    }
+
+    ret = 0;
+    goto read_done;
+
+read_error_cleanup:
+    /* the path of the failure, innermost first, as recursion would */
+    for (size_t i = depth; i-- > 0; ) {
+        if (stack[i].type == NBT_TAG_LIST)
+            nbt_reader_error_index(rd, stack[i].index);
+        else if (stack[i].entry)
+            nbt_reader_error_name(rd, stack[i].entry->name, stack[i].entry->namelen);
+    }
+
+    if (depth > 0) {
+        if (stack[0].type == NBT_TAG_COMPOUND)
+            NBT_READER_FREE(rd, compound, stack[0].node.compound);
+        else
+            NBT_READER_FREE(rd, list, stack[0].node.list);
+    }
+
+    rd->depth -= (unsigned)depth;
+
+read_done:
+    if (stack != frames) free(stack);
+    return ret;
+}
@@ -0,0 +1,338 @@
+#ifndef LIBNBT_INTERNAL_H_INCLUDED
+#define LIBNBT_INTERNAL_H_INCLUDED
+
+/* Helpers shared between libnbt translation units; not installed. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_endian.h"
+#include "nbt_region.h"
+
+/* Sets the calling thread's nbt_error() message. */
+void nbt_set_error(const char *fmt, ...);
+
+/* Copies the calling thread's message into `err` (if non-NULL) with the
+ * given context; how entry points hand failures back to their caller. */
+void nbt_fill_error(struct nbt_error *err, size_t offset, const char *path);
+
+/* Inflates a whole NBT_COMPRESSION_GZIP or _ZLIB buffer into a malloc'd one
+ * with the configured backend (nbtinflate.c). Fails if the output would be
+ * larger than `limit` bytes, unless that is 0. */
+int nbt_decompress(const unsigned char *in, size_t inlen, int format, size_t limit, unsigned char **data, size_t *length);
+
+#ifdef NBT_TRACE
+extern nbt_trace_hook nbt_trace_fn;
+extern void *nbt_trace_user;
+
+#define NBT_TRACE_EVENT(_event, _begin, _bytes)                             \
+do {                                                                        \
+    if (nbt_trace_fn) nbt_trace_fn(nbt_trace_user, _event, _begin, _bytes); \
+} while (0)
+#else
+#define NBT_TRACE_EVENT(_event, _begin, _bytes) do { } while (0)
+#endif
+
+static inline uint64_t nbt_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Calls fn(ctx, i, thread) for every i in [0, count) on the pool's threads
+ * (or just the calling one if `pool` is NULL) and returns once all calls are
+ * done. `thread` is below nbt_pool_threads() (1 without a pool) and is the
+ * same for every call made on one thread, for per-thread scratch space. */
+struct nbt_pool;
+typedef void (*nbt_pool_fn)(void *ctx, size_t index, unsigned thread);
+void nbt_pool_run(struct nbt_pool *pool, size_t count, nbt_pool_fn fn, void *ctx);
+
+/* Number of index slots for a compound of `size` entries (a power of two). */
+size_t nbt_compound_index_slots(uint32_t size);
+
+/* Fills `index` (of nbt_compound_index_slots(compound->size) zeroed slots)
+ * from the entry list and attaches it to the compound. */
+void nbt_compound_fill_index(struct nbt_compound *compound, struct nbt_compound_entry **index);
+
+#define NBT_REGION_HEADER_SIZE (2 * NBT_REGION_SECTOR_SIZE)
+
+/* A mapped region file (nbt_region.h) */
+struct nbt_region {
+    const unsigned char *map; /* NULL for an empty file */
+    size_t length;
+};
+
+static inline uint32_t nbt_region_u32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return nbt_endian_be2h_u32(v);
+}
+
+/* The cursor and fixed-width primitives are shared by every decoder (the
+ * tree reader, the SAX parser, ...) and inlined into each of them. */
+
+/* Per-parse error context. The tag path is built while unwinding, so a
+ * successful parse never touches it. */
+struct nbt_read_error {
+    size_t offset;
+    size_t pathlen;  /* path occupies the last `pathlen` bytes of `path` */
+    bool truncated;
+    char path[NBT_ERROR_PATH_SZ];
+    char message[NBT_ERROR_MSG_SZ];
+};
+
+/* State of nbt_read_options.paths while reading. `prefix` holds the first
+ * `prefixlen` bytes of the path to the compound being read (a prefix of
+ * every selected path below it); `active` turns off inside a selected
+ * value, which is then read whole. */
+struct nbt_read_filter {
+    const char *const *paths;
+    size_t npaths;
+    const char *prefix;
+    size_t prefixlen;
+    bool active;
+};
+
+/* Cursor over an in-memory NBT document. Every field is bounds-checked once
+ * against `end` before it is decoded. Readers return 0 on success and -1 on
+ * failure, after recording the failure in `err`. */
+struct nbt_reader {
+    const unsigned char *start;
+    const unsigned char *cur;
+    const unsigned char *end;
+
+    struct nbt_arena *arena; /* NULL: nodes are malloc'd individually */
+    struct nbt_read_filter filter;
+    bool borrow;             /* point values into the input (arena only) */
+
+    struct nbt_stats *stats; /* counted into if non-NULL */
+    unsigned depth;          /* compounds and lists currently open */
+    unsigned maxdepth;
+
+    /* nbt_read_options.limits, with the caps that are off at their maximum,
+     * and what counts against them */
+    unsigned depthlimit;
+    size_t alloclimit;
+    size_t nodelimit;
+    nbt_int arraylimit;
+    nbt_int listlimit;
+    size_t allocated;
+    size_t nodes;
+
+    struct nbt_read_error err;
+};
+
+/* Going over limits.max_alloc_bytes fails like running out of memory;
+ * nbt_reader_error() tells the two apart in its message. */
+static inline void *nbt_reader_alloc(struct nbt_reader *rd, size_t size) {
+    if (rd->stats) {
+        ++rd->stats->allocs;
+        rd->stats->alloc_bytes += size;
+    }
+
+    rd->allocated += size;
+    if (rd->allocated > rd->alloclimit) return NULL;
+
+    return rd->arena ? nbt_arena_alloc(rd->arena, size) : malloc(size);
+}
+
+/* In borrowing mode, returns the cursor for use in place of a copy of
+ * elements `width` bytes wide, or NULL if they have to be copied: wider
+ * elements can only be borrowed when already in host order and aligned. */
+static inline const void *nbt_reader_borrow(const struct nbt_reader *rd, size_t width) {
+    if (!rd->borrow) return NULL;
+    if (width == 1) return rd->cur;
+    if (nbt_endian() == NBT_ENDIAN_BIG && ((uintptr_t)rd->cur & (width - 1)) == 0) return rd->cur;
+    return NULL;
+}
+
+/* Arena-backed nodes are never freed one by one; a failed parse leaves them
+ * in the arena until it is reset. */
+#define NBT_READER_FREE(_rd, _t, _ptr) \
+do {                                  \
+    if (!(_rd)->arena)                \
+        nbt_free_ ## _t(_ptr);        \
+} while (0)
+
+void nbt_reader_init(struct nbt_reader *rd, const unsigned char *data, size_t length, const struct nbt_read_options *options);
+
+void nbt_reader_error(struct nbt_reader *rd, const char *fmt, ...);
+void nbt_reader_error_path(struct nbt_reader *rd, const char *seg, size_t seglen);
+void nbt_reader_error_name(struct nbt_reader *rd, const char *name, nbt_strlen namelen);
+void nbt_reader_error_index(struct nbt_reader *rd, nbt_int index);
+void nbt_reader_report(struct nbt_reader *rd, struct nbt_error *out);
+
+#define NBT_READ_FAIL(_rd, _fmt, ...)                 \
+do {                                                  \
+    nbt_reader_error(_rd, _fmt, ## __VA_ARGS__);      \
+    return -1;                                        \
+} while (0)
+
+#define NBT_READER_LEFT(_rd) ((size_t)((_rd)->end - (_rd)->cur))
+
+#define NBT_READER_NEED(_rd, _n, _what)                                                      \
+do {                                                                                         \
+    if (NBT_READER_LEFT(_rd) < (size_t)(_n))                                                 \
+        NBT_READ_FAIL(_rd, "Unexpected end of input reading NBT " _what ": %zu < %zu",      \
+                      NBT_READER_LEFT(_rd), (size_t)(_n));                                   \
+} while (0)
+
+static inline int nbt_read_type(struct nbt_reader *rd, nbt_type *out) {
+    NBT_READER_NEED(rd, 1, "type");
+    *out = *rd->cur++;
+    return 0;
+}
+
+static inline int nbt_read_strlen(struct nbt_reader *rd, nbt_strlen *out) {
+    uint16_t ret;
+    NBT_READER_NEED(rd, 2, "u16");
+    memcpy(&ret, rd->cur, 2);
+    rd->cur += 2;
+    *out = nbt_endian_be2h_u16(ret);
+    return 0;
+}
+
+#define O(_ctype, _uname, _lname)                                           \
+static inline int nbt_read_ ## _lname(struct nbt_reader *rd, _ctype *out) { \
+    _ctype ret;                                                             \
+    NBT_READER_NEED(rd, sizeof(_ctype), #_lname);                           \
+    memcpy(&ret, rd->cur, sizeof(_ctype));                                  \
+    rd->cur += sizeof(_ctype);                                              \
+    *out = nbt_endian_be2h_ ## _lname(ret);                                 \
+    return 0;                                                               \
+}
+
+NBT_FOREACH_INT_TYPE(O)
+#undef O
+
+/* floats travel as big-endian IEEE 754 bit patterns */
+static inline int nbt_read_float(struct nbt_reader *rd, nbt_float *out) {
+    uint32_t bits;
+    NBT_READER_NEED(rd, sizeof(bits), "float");
+    memcpy(&bits, rd->cur, sizeof(bits));
+    rd->cur += sizeof(bits);
+    bits = nbt_endian_be2h_u32(bits);
+    memcpy(out, &bits, sizeof(*out));
+    return 0;
+}
+
+static inline int nbt_read_double(struct nbt_reader *rd, nbt_double *out) {
+    uint64_t bits;
+    NBT_READER_NEED(rd, sizeof(bits), "double");
+    memcpy(&bits, rd->cur, sizeof(bits));
+    rd->cur += sizeof(bits);
+    bits = nbt_endian_be2h_u64(bits);
+    memcpy(out, &bits, sizeof(*out));
+    return 0;
+}
+
+/* Fewest bytes of input a value of `type` can take, e.g. an empty string
+ * or compound; 0 for invalid types. */
+static inline size_t nbt_type_min_size(nbt_type type) {
+    switch (type) {
+        case NBT_TAG_STRING:
+            return 2;
+        case NBT_TAG_LIST:
+            return 5;
+        case NBT_TAG_COMPOUND:
+            return 1;
+        case NBT_TAG_BYTE_ARRAY:
+        case NBT_TAG_INT_ARRAY:
+        case NBT_TAG_LONG_ARRAY:
+            return 4;
+        default:
+            return nbt_type_size(type);
+    }
+}
+
+/* Opens a compound or list, failing if that nests deeper than allowed. */
+static inline int nbt_reader_enter(struct nbt_reader *rd) {
+    if (rd->depth >= rd->depthlimit)
+        NBT_READ_FAIL(rd, "NBT data is nested deeper than %u levels", rd->depthlimit);
+    if (++rd->depth > rd->maxdepth) rd->maxdepth = rd->depth;
+    return 0;
+}
+
+static inline void nbt_reader_leave(struct nbt_reader *rd) {
+    --rd->depth;
+}
+
+/* Decodes one value of `type` into tree nodes, iteratively. */
+int nbt_read_value(struct nbt_reader *rd, nbt_type type, nbt_value *out);
+
+/* Finishes a compound once every entry is in: arena trees get their index. */
+int nbt_read_compound_close(struct nbt_reader *rd, struct nbt_compound *compound);
+
+/* Reads the rest of `file` into one malloc'd buffer. */
+int nbt_read_whole_file(FILE *file, unsigned char **data, size_t *length);
+
+/* nbt_decompress() held to options->limits.max_alloc_bytes, and timed into
+ * options->stats; `options` may be NULL. */
+int nbt_decompress_counted(const unsigned char *in, size_t inlen, int format, unsigned char **data, size_t *length, const struct nbt_read_options *options);
+
+/* Nodes for the text parsers, allocated as the reader allocates. Arrays
+ * take `count` elements in host order. */
+int nbt_reader_make_string(struct nbt_reader *rd, const void *s, size_t len, struct nbt_string **out);
+int nbt_reader_make_array(struct nbt_reader *rd, nbt_type type, const void *data, nbt_int count, nbt_value *out);
+
+/* Number formatting shared by the SNBT and JSON writers (nbtsnbt.c). Each
+ * returns the end of its output. nbt_format_double() writes the fewest
+ * digits that read back as the same float (`single`) or double, and needs
+ * NBT_FORMAT_DOUBLE_CHARS bytes at `p`: the longest output
+ * ("-2.2250738585072014e-308") plus the NUL snprintf() insists on. */
+#define NBT_FORMAT_DOUBLE_CHARS (32)
+
+char *nbt_format_u64(char *p, uint64_t v);
+char *nbt_format_i64(char *p, int64_t v);
+char *nbt_format_double(char *p, double v, bool single);
+
+/* Code points are stored as modified UTF-8, like every NBT string: U+0000
+ * as two bytes, and the rest of the astral planes as surrogate pairs.
+ * Writes at most 6 bytes. */
+static inline unsigned char *nbt_put_mutf8(unsigned char *p, uint32_t cp) {
+    if (cp >= 0x10000) {
+        cp -= 0x10000;
+        p = nbt_put_mutf8(p, 0xd800 + (cp >> 10));
+        return nbt_put_mutf8(p, 0xdc00 + (cp & 0x3ff));
+    }
+
+    if (cp != 0 && cp < 0x80) {
+        *p++ = (unsigned char)cp;
+    } else if (cp < 0x800) {
+        *p++ = (unsigned char)(0xc0 | (cp >> 6));
+        *p++ = (unsigned char)(0x80 | (cp & 0x3f));
+    } else {
+        *p++ = (unsigned char)(0xe0 | (cp >> 12));
+        *p++ = (unsigned char)(0x80 | ((cp >> 6) & 0x3f));
+        *p++ = (unsigned char)(0x80 | (cp & 0x3f));
+    }
+    return p;
+}
+
+/* Skippers (nbtskip.c): advance past a value using its length prefixes only. */
+int nbt_skip_value(struct nbt_reader *rd, nbt_type type);
+int nbt_skip_elements(struct nbt_reader *rd, nbt_type elemtype, nbt_int count);
+
+/* Reads and validates a list's element type and length. */
+int nbt_skip_list_header(struct nbt_reader *rd, nbt_type *elemtype, nbt_int *length);
+
+enum {
+    NBT_FILTER_DROP,
+    NBT_FILTER_DESCEND,
+    NBT_FILTER_KEEP,
+};
+
+int nbt_filter_match(const struct nbt_read_filter *f, const char *name, nbt_strlen namelen, const char **next);
+
+/* Called with the cursor on a compound entry's name while the filter is
+ * active. Skips an unselected entry and returns 1; otherwise leaves the
+ * cursor in place, narrows rd->filter for the entry's value and returns 0. */
+int nbt_filter_entry(struct nbt_reader *rd, nbt_type type);
+
+#endif /* include guard */
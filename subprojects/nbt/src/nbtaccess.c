@@ -0,0 +1,110 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t nbt_type_sizes[] = {
+    [NBT_TAG_END] = 0,
+#define O(_ctype, _uname, _lname) \
+    [NBT_TAG_ ## _uname] = sizeof(_ctype),
+
+    NBT_FOREACH_TYPE(O)
+#undef O
+};
+
+size_t nbt_type_size(nbt_type type) {
+    if (type >= sizeof(nbt_type_sizes) / sizeof(nbt_type_sizes[0])) return 0;
+    return nbt_type_sizes[type];
+}
+
+nbt_int nbt_list_length(const struct nbt_list *list) {
+    return list ? list->length : 0;
+}
+
+nbt_value nbt_list_get(const struct nbt_list *list, nbt_int index) {
+    nbt_value ret;
+    memset(&ret, 0, sizeof(ret));
+
+    if (!list || index < 0 || index >= list->length) return ret;
+
+    switch (list->type) {
+#define O(_ctype, _uname, _lname)                                  \
+        case NBT_TAG_ ## _uname:                                   \
+            ret.tag_ ## _lname = list->data.tag_ ## _lname[index]; \
+            break;
+
+        NBT_FOREACH_TYPE(O)
+#undef O
+    }
+
+    return ret;
+}
+
+/* 32-bit FNV-1a */
+uint32_t nbt_hash_name(const char *name, nbt_strlen namelen) {
+    uint32_t hash = 2166136261u;
+    for (nbt_strlen i = 0; i < namelen; ++i) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* at most half full, so probe sequences stay short */
+size_t nbt_compound_index_slots(uint32_t size) {
+    size_t slots = 16;
+    while (slots < (size_t)size * 2) slots *= 2;
+    return slots;
+}
+
+void nbt_compound_fill_index(struct nbt_compound *compound, struct nbt_compound_entry **index) {
+    size_t mask = nbt_compound_index_slots(compound->size) - 1;
+
+    /* inserting in list order means a probe meets the first of any duplicate
+     * names first, matching what a linear scan would return */
+    for (struct nbt_compound_entry *cur = compound->first; cur; cur = cur->next) {
+        size_t slot = cur->hash & mask;
+        while (index[slot]) slot = (slot + 1) & mask;
+        index[slot] = cur;
+    }
+
+    compound->index = index;
+    compound->indexmask = (uint32_t)mask;
+}
+
+int nbt_compound_build_index(struct nbt_compound *compound) {
+    if (!compound || compound->index) return 0;
+
+    struct nbt_compound_entry **index = calloc(nbt_compound_index_slots(compound->size), sizeof(struct nbt_compound_entry *));
+    if (!index) return -1;
+
+    nbt_compound_fill_index(compound, index);
+    return 0;
+}
+
+struct nbt_tag *nbt_compound_get(struct nbt_compound *compound, const char *name, nbt_strlen namelen) {
+    if (!compound) return NULL;
+
+    uint32_t hash = nbt_hash_name(name, namelen);
+
+    if (!compound->index && compound->size >= NBT_COMPOUND_INDEX_MIN)
+        nbt_compound_build_index(compound); /* on failure, fall back to scanning */
+
+    if (compound->index) {
+        for (size_t slot = hash & compound->indexmask; compound->index[slot]; slot = (slot + 1) & compound->indexmask) {
+            struct nbt_compound_entry *cur = compound->index[slot];
+            if (cur->hash == hash && cur->namelen == namelen && memcmp(cur->name, name, namelen) == 0)
+                return &cur->tag;
+        }
+        return NULL;
+    }
+
+    for (struct nbt_compound_entry *cur = compound->first; cur; cur = cur->next) {
+        if (cur->hash == hash && cur->namelen == namelen && memcmp(cur->name, name, namelen) == 0)
+            return &cur->tag;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,99 @@
+#include "nbt.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NBT_ARENA_DEFAULT_BLOCK (65536)
+#define NBT_ARENA_ALIGN         (_Alignof(max_align_t))
+
+struct nbt_arena_block {
+    struct nbt_arena_block *next;
+    size_t size;
+    _Alignas(max_align_t) unsigned char data[];
+};
+
+/* Blocks are kept in a singly linked chain. `cur` is the block being bumped
+ * from; blocks after it are either fresh or left over from before the last
+ * reset, and are reused in order before anything new is malloc'd. */
+struct nbt_arena {
+    size_t blocksize;
+    struct nbt_arena_block *first;
+    struct nbt_arena_block *cur;
+    unsigned char *ptr;
+    unsigned char *end;
+};
+
+struct nbt_arena *nbt_arena_new(size_t blocksize) {
+    struct nbt_arena *arena = malloc(sizeof(struct nbt_arena));
+    if (!arena) return NULL;
+
+    arena->blocksize = blocksize ? blocksize : NBT_ARENA_DEFAULT_BLOCK;
+    arena->first = NULL;
+    arena->cur = NULL;
+    arena->ptr = NULL;
+    arena->end = NULL;
+
+    return arena;
+}
+
+void *nbt_arena_alloc_slow(struct nbt_arena *arena, size_t size) {
+    struct nbt_arena_block *block = arena->cur ? arena->cur->next : arena->first;
+
+    /* skip leftover blocks that are too small for this request */
+    while (block && block->size < size) block = block->next;
+
+    if (!block) {
+        size_t blocksize = size > arena->blocksize ? size : arena->blocksize;
+        block = malloc(sizeof(struct nbt_arena_block) + blocksize);
+        if (!block) return NULL;
+
+        block->size = blocksize;
+        if (arena->cur) {
+            block->next = arena->cur->next;
+            arena->cur->next = block;
+        } else {
+            block->next = arena->first;
+            arena->first = block;
+        }
+    }
+
+    arena->cur = block;
+    arena->ptr = block->data + size;
+    arena->end = block->data + block->size;
+
+    return block->data;
+}
+
+void *nbt_arena_alloc(struct nbt_arena *arena, size_t size) {
+    /* rounding up, or the block header on the slow path, would wrap */
+    if (size > SIZE_MAX - sizeof(struct nbt_arena_block) - NBT_ARENA_ALIGN) return NULL;
+
+    size = (size + NBT_ARENA_ALIGN - 1) & ~(NBT_ARENA_ALIGN - 1);
+
+    if ((size_t)(arena->end - arena->ptr) < size)
+        return nbt_arena_alloc_slow(arena, size);
+
+    void *ret = arena->ptr;
+    arena->ptr += size;
+    return ret;
+}
+
+void nbt_arena_reset(struct nbt_arena *arena) {
+    if (!arena) return;
+
+    arena->cur = NULL;
+    arena->ptr = NULL;
+    arena->end = NULL;
+}
+
+void nbt_arena_free(struct nbt_arena *arena) {
+    if (!arena) return;
+
+    for (struct nbt_arena_block *cur = arena->first, *temp; cur; cur = temp) {
+        temp = cur->next;
+        free(cur);
+    }
+
+    free(arena);
+}
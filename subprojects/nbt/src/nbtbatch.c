@@ -0,0 +1,149 @@
+#include "nbt_batch.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#define NBT_BATCH_READ_MIN (65536)
+
+struct nbt_batch {
+    const char *const *paths;
+    const int *fds;
+    const struct nbt_batch_options *options;
+
+    /* one per pool thread, reused from file to file */
+    struct nbt_buffer *scratch;
+    atomic_size_t failed;
+};
+
+/* Reads the rest of `fd` into `buf`, replacing its contents. */
+int nbt_batch_read_fd(int fd, struct nbt_buffer *buf) {
+    struct stat st;
+    size_t want = NBT_BATCH_READ_MIN;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && (uintmax_t)st.st_size < SIZE_MAX - 1)
+        want = (size_t)st.st_size + 1; /* +1 so the read hitting EOF needs no growth */
+
+    buf->length = 0;
+    while (true) {
+        if (nbt_buffer_reserve(buf, buf->length == 0 ? want : NBT_BATCH_READ_MIN) < 0) {
+            nbt_set_error("Unable to allocate memory for NBT data");
+            return -1;
+        }
+
+        ssize_t nread = read(fd, buf->data + buf->length, buf->capacity - buf->length);
+        if (nread < 0) {
+            if (errno == EINTR) continue;
+            nbt_set_error("Failed to read NBT data: %s", strerror(errno));
+            return -1;
+        }
+        if (nread == 0) break;
+        buf->length += (size_t)nread;
+    }
+
+    return 0;
+}
+
+int nbt_batch_load(struct nbt_batch_item *item, struct nbt_buffer *buf, const struct nbt_read_options *opts) {
+    int fd = item->fd;
+    if (item->path) {
+        fd = open(item->path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            nbt_set_error("Failed to open %s: %s", item->path, strerror(errno));
+            return -1;
+        }
+    }
+
+    int ret = nbt_batch_read_fd(fd, buf);
+    if (item->path) close(fd);
+    if (ret < 0) return -1;
+
+    item->size = buf->length;
+
+    int format = nbt_detect_compression(buf->data, buf->length);
+    if (format == NBT_COMPRESSION_NONE)
+        return nbt_read_ex(buf->data, buf->length, &item->result, opts);
+
+    unsigned char *inflated;
+    size_t inflatedlen;
+    if (nbt_decompress_counted(buf->data, buf->length, format, &inflated, &inflatedlen, opts) < 0)
+        return -1;
+
+    ret = nbt_read_ex(inflated, inflatedlen, &item->result, opts);
+    free(inflated);
+    return ret;
+}
+
+void nbt_batch_file(void *ctx, size_t index, unsigned thread) {
+    struct nbt_batch *batch = ctx;
+    const struct nbt_batch_options *options = batch->options;
+    struct nbt_batch_item item;
+
+    memset(&item, 0, sizeof(item));
+    item.index = index;
+    item.path = batch->paths ? batch->paths[index] : NULL;
+    item.fd = batch->fds ? batch->fds[index] : -1;
+
+    struct nbt_read_options opts = {
+        .error = &item.error,
+        .paths = options->paths,
+        .npaths = options->npaths,
+        .limits = options->limits,
+    };
+
+    item.ret = nbt_batch_load(&item, &batch->scratch[thread], &opts);
+    if (item.ret < 0) {
+        /* nbt_read_ex() fills in its own failures; the rest land here */
+        if (item.error.message[0] == '\0') nbt_fill_error(&item.error, 0, "");
+        memset(&item.result, 0, sizeof(item.result));
+        atomic_fetch_add_explicit(&batch->failed, 1, memory_order_relaxed);
+    }
+
+    options->callback(options->user, &item);
+}
+
+size_t nbt_batch_run(struct nbt_batch *batch, size_t count) {
+    struct nbt_pool *pool = batch->options->pool;
+    unsigned nthreads = pool ? nbt_pool_threads(pool) : 1;
+
+    batch->scratch = calloc(nthreads, sizeof(struct nbt_buffer));
+    if (!batch->scratch) {
+        nbt_set_error("Unable to allocate memory for batch");
+        return count;
+    }
+
+    nbt_pool_run(pool, count, &nbt_batch_file, batch);
+
+    for (unsigned i = 0; i < nthreads; ++i)
+        nbt_buffer_free(&batch->scratch[i]);
+    free(batch->scratch);
+
+    return atomic_load(&batch->failed);
+}
+
+size_t nbt_batch_load_paths(const char *const *paths, size_t count, const struct nbt_batch_options *options) {
+    struct nbt_batch batch = {
+        .paths = paths,
+        .options = options,
+    };
+
+    return nbt_batch_run(&batch, count);
+}
+
+size_t nbt_batch_load_fds(const int *fds, size_t count, const struct nbt_batch_options *options) {
+    struct nbt_batch batch = {
+        .fds = fds,
+        .options = options,
+    };
+
+    return nbt_batch_run(&batch, count);
+}
@@ -0,0 +1,35 @@
+#include "nbt.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define NBT_BUFFER_MIN (4096)
+
+int nbt_buffer_reserve(struct nbt_buffer *buf, size_t extra) {
+    if (extra > SIZE_MAX - buf->length) return -1;
+    if (buf->capacity - buf->length >= extra) return 0;
+
+    size_t cap = buf->capacity ? buf->capacity : NBT_BUFFER_MIN;
+    while (cap - buf->length < extra) {
+        if (cap > SIZE_MAX / 2) {
+            cap = buf->length + extra;
+            break;
+        }
+        cap *= 2;
+    }
+
+    unsigned char *temp = realloc(buf->data, cap);
+    if (!temp) return -1;
+
+    buf->data = temp;
+    buf->capacity = cap;
+    return 0;
+}
+
+void nbt_buffer_free(struct nbt_buffer *buf) {
+    if (!buf) return;
+    free(buf->data);
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+}
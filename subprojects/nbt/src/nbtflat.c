@@ -0,0 +1,363 @@
+#include "nbt_flat.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_endian.h"
+#include "nbt_internal.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes and blob are built in two growable buffers, then packed behind the
+ * document header in a single allocation. Nodes are referred to by index
+ * while building, since the node buffer moves as it grows. */
+struct nbt_flat_builder {
+    struct nbt_reader rd;
+    struct nbt_buffer nodes;
+    struct nbt_buffer blob;
+};
+
+#define NBT_FLAT_NODE(_b, _i) (((struct nbt_flat_node *)(_b)->nodes.data)[_i])
+#define NBT_FLAT_NNODES(_b) ((uint32_t)((_b)->nodes.length / sizeof(struct nbt_flat_node)))
+
+/* Appends `len` bytes (plus a NUL if `nul`) at the next multiple of `align`. */
+int nbt_flat_blob_add(struct nbt_flat_builder *b, const void *src, size_t len, size_t align, bool nul, uint64_t *offset) {
+    size_t pad = (align - (b->blob.length & (align - 1))) & (align - 1);
+
+    if (nbt_buffer_reserve(&b->blob, pad + len + nul) < 0)
+        NBT_READ_FAIL(&b->rd, "Unable to allocate memory for flat NBT payload");
+
+    memset(b->blob.data + b->blob.length, 0, pad);
+    b->blob.length += pad;
+    *offset = b->blob.length;
+
+    if (len) memcpy(b->blob.data + b->blob.length, src, len);
+    b->blob.length += len;
+    if (nul) b->blob.data[b->blob.length++] = '\0';
+
+    if (b->blob.length > UINT32_MAX)
+        NBT_READ_FAIL(&b->rd, "Flat NBT document is too large");
+    return 0;
+}
+
+int nbt_flat_add_node(struct nbt_flat_builder *b, nbt_type type, const char *name, nbt_strlen namelen, uint32_t *index) {
+    uint64_t nameoff = 0;
+
+    if (NBT_FLAT_NNODES(b) == NBT_FLAT_NONE - 1)
+        NBT_READ_FAIL(&b->rd, "Flat NBT document has too many nodes");
+    if (name && nbt_flat_blob_add(b, name, namelen, 1, true, &nameoff) < 0)
+        return -1;
+    if (nbt_buffer_reserve(&b->nodes, sizeof(struct nbt_flat_node)) < 0)
+        NBT_READ_FAIL(&b->rd, "Unable to allocate memory for flat NBT node");
+
+    *index = NBT_FLAT_NNODES(b);
+    b->nodes.length += sizeof(struct nbt_flat_node);
+
+    struct nbt_flat_node *node = &NBT_FLAT_NODE(b, *index);
+    memset(node, 0, sizeof(struct nbt_flat_node));
+    node->type = type;
+    node->namelen = name ? namelen : 0;
+    node->name = (uint32_t)nameoff;
+    return 0;
+}
+
+/* Copies `count` big-endian elements of `width` bytes to the blob in host
+ * order and points the node at them. */
+int nbt_flat_payload_add(struct nbt_flat_builder *b, uint32_t index, nbt_int count, size_t width, const char *what) {
+    struct nbt_reader *rd = &b->rd;
+    size_t len = (size_t)count * width;
+    uint64_t offset;
+
+    if (NBT_READER_LEFT(rd) < len)
+        NBT_READ_FAIL(rd, "Unexpected end of input reading NBT %s: %zu < %zu", what, NBT_READER_LEFT(rd), len);
+    if (nbt_flat_blob_add(b, rd->cur, len, width, false, &offset) < 0)
+        return -1;
+
+    nbt_endian_be2h_array(b->blob.data + offset, (size_t)count, width);
+    rd->cur += len;
+
+    NBT_FLAT_NODE(b, index).value.offset = offset;
+    NBT_FLAT_NODE(b, index).length = (uint32_t)count;
+    return 0;
+}
+
+int nbt_flat_value(struct nbt_flat_builder *b, uint32_t index, nbt_type type);
+
+int nbt_flat_compound(struct nbt_flat_builder *b, uint32_t index) {
+    struct nbt_reader *rd = &b->rd;
+    uint32_t count = 0;
+
+    while (true) {
+        nbt_type type;
+        nbt_strlen namelen;
+        uint32_t child;
+
+        if (nbt_read_type(rd, &type) < 0) return -1;
+        if (type == NBT_TAG_END) break;
+
+        if (nbt_read_strlen(rd, &namelen) < 0) return -1;
+        NBT_READER_NEED(rd, namelen, "name");
+
+        const char *name = (const char *)rd->cur;
+        rd->cur += namelen;
+
+        if (nbt_flat_add_node(b, type, name, namelen, &child) < 0 || nbt_flat_value(b, child, type) < 0) {
+            nbt_reader_error_name(rd, name, namelen);
+            return -1;
+        }
+        ++count;
+    }
+
+    NBT_FLAT_NODE(b, index).length = count;
+    return 0;
+}
+
+int nbt_flat_list(struct nbt_flat_builder *b, uint32_t index) {
+    struct nbt_reader *rd = &b->rd;
+    nbt_type elemtype;
+    nbt_int length;
+
+    if (nbt_skip_list_header(rd, &elemtype, &length) < 0) return -1;
+    NBT_FLAT_NODE(b, index).elemtype = elemtype;
+
+    switch (elemtype) {
+#define O(_ctype, _uname, _lname)                                                  \
+        case NBT_TAG_ ## _uname:                                                   \
+            return nbt_flat_payload_add(b, index, length, sizeof(_ctype), "list");
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        default:
+            break;
+    }
+
+    for (nbt_int i = 0; i < length; ++i) {
+        uint32_t child;
+        if (nbt_flat_add_node(b, elemtype, NULL, 0, &child) < 0 || nbt_flat_value(b, child, elemtype) < 0) {
+            nbt_reader_error_index(rd, i);
+            return -1;
+        }
+    }
+
+    NBT_FLAT_NODE(b, index).length = (uint32_t)length;
+    return 0;
+}
+
+int nbt_flat_value(struct nbt_flat_builder *b, uint32_t index, nbt_type type) {
+    struct nbt_reader *rd = &b->rd;
+    struct nbt_flat_node *node = &NBT_FLAT_NODE(b, index);
+    nbt_strlen len16;
+    nbt_int len;
+    int ret;
+
+    switch (type) {
+#define O(_ctype, _uname, _lname)                                       \
+        case NBT_TAG_ ## _uname:                                        \
+            ret = nbt_read_ ## _lname(rd, &node->value.tag_ ## _lname); \
+            break;
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        case NBT_TAG_STRING:
+            if (nbt_read_strlen(rd, &len16) < 0) return -1;
+            NBT_READER_NEED(rd, len16, "string");
+            ret = nbt_flat_blob_add(b, rd->cur, len16, 1, true, &node->value.offset);
+            rd->cur += len16;
+            NBT_FLAT_NODE(b, index).length = len16;
+            break;
+        case NBT_TAG_LIST:
+        case NBT_TAG_COMPOUND:
+            if (nbt_reader_enter(rd) < 0) return -1;
+            ret = type == NBT_TAG_LIST ? nbt_flat_list(b, index) : nbt_flat_compound(b, index);
+            nbt_reader_leave(rd);
+            break;
+#define NBT_FLAT_ARRAY(_t, _uname)                                                              \
+        case NBT_TAG_ ## _uname ## _ARRAY:                                                      \
+            if (nbt_read_int(rd, &len) < 0) return -1;                                          \
+            if (len < 0)                                                                        \
+                NBT_READ_FAIL(rd, "NBT " #_t " array has negative length: %d", len);            \
+            ret = nbt_flat_payload_add(b, index, len, sizeof(nbt_ ## _t), #_t "_array");        \
+            break;
+
+        NBT_FLAT_ARRAY(byte, BYTE)
+        NBT_FLAT_ARRAY(int, INT)
+        NBT_FLAT_ARRAY(long, LONG)
+#undef NBT_FLAT_ARRAY
+        default:
+            NBT_READ_FAIL(rd, "Invalid NBT tag type %#02hhx", type);
+    }
+
+    if (ret < 0) return -1;
+
+    NBT_FLAT_NODE(b, index).size = NBT_FLAT_NNODES(b) - index;
+    return 0;
+}
+
+struct nbt_flat *nbt_flat_pack(struct nbt_flat_builder *b) {
+    size_t nodelen = b->nodes.length;
+    size_t footprint = NBT_FLAT_HEADER_SIZE + nodelen + b->blob.length;
+
+    unsigned char *mem = malloc(footprint);
+    if (!mem) {
+        nbt_reader_error(&b->rd, "Unable to allocate %zu bytes for flat NBT document", footprint);
+        return NULL;
+    }
+
+    /* padding included, so documents written out are reproducible */
+    memset(mem, 0, NBT_FLAT_HEADER_SIZE);
+    memcpy(mem + NBT_FLAT_HEADER_SIZE, b->nodes.data, nodelen);
+    if (b->blob.length) memcpy(mem + NBT_FLAT_HEADER_SIZE + nodelen, b->blob.data, b->blob.length);
+
+    struct nbt_flat *flat = (struct nbt_flat *)mem;
+    flat->nnodes = NBT_FLAT_NNODES(b);
+    flat->bloblen = b->blob.length;
+    flat->footprint = footprint;
+    return flat;
+}
+
+struct nbt_flat *nbt_flat_read(const unsigned char *data, size_t length, const struct nbt_read_options *options) {
+    struct nbt_flat_builder b;
+    struct nbt_flat *flat = NULL;
+    struct nbt_read_options opts = { 0 };
+    nbt_type roottype;
+    nbt_strlen namelen;
+    uint32_t root;
+
+    /* the builder allocates its own arrays, so only the depth applies */
+    if (options) {
+        opts.error = options->error;
+        opts.limits.max_depth = options->limits.max_depth;
+    }
+
+    memset(&b, 0, sizeof(b));
+    nbt_reader_init(&b.rd, data, length, &opts);
+
+    if (nbt_read_type(&b.rd, &roottype) < 0)
+        goto read_cleanup;
+
+    if (roottype != NBT_TAG_COMPOUND) {
+        nbt_reader_error(&b.rd, "Root tag is not TAG_COMPOUND (%#02hhx)", roottype);
+        goto read_cleanup;
+    }
+
+    if (nbt_read_strlen(&b.rd, &namelen) < 0)
+        goto read_cleanup;
+    if (NBT_READER_LEFT(&b.rd) < namelen) {
+        nbt_reader_error(&b.rd, "Unexpected end of input reading NBT name: %zu < %zu", NBT_READER_LEFT(&b.rd), (size_t)namelen);
+        goto read_cleanup;
+    }
+
+    const char *name = (const char *)b.rd.cur;
+    b.rd.cur += namelen;
+
+    /* about one node per 16 bytes of input is typical; saves most regrowth */
+    if (nbt_buffer_reserve(&b.nodes, (length / 16 + 1) * sizeof(struct nbt_flat_node)) < 0 ||
+        nbt_buffer_reserve(&b.blob, length / 2 + 1) < 0) {
+        nbt_reader_error(&b.rd, "Unable to allocate memory for flat NBT document");
+        goto read_cleanup;
+    }
+
+    if (nbt_flat_add_node(&b, NBT_TAG_COMPOUND, name, namelen, &root) < 0 ||
+        nbt_flat_value(&b, root, NBT_TAG_COMPOUND) < 0)
+        goto read_cleanup;
+
+    flat = nbt_flat_pack(&b);
+
+read_cleanup:
+    if (!flat) nbt_reader_report(&b.rd, opts.error);
+    nbt_buffer_free(&b.nodes);
+    nbt_buffer_free(&b.blob);
+    return flat;
+}
+
+struct nbt_flat *nbt_flat_clone(const struct nbt_flat *flat) {
+    unsigned char *mem = malloc(flat->footprint);
+    if (!mem) {
+        nbt_set_error("Unable to allocate %zu bytes for flat NBT document", flat->footprint);
+        return NULL;
+    }
+
+    memcpy(mem, flat, flat->footprint);
+    return (struct nbt_flat *)mem;
+}
+
+void nbt_flat_free(struct nbt_flat *flat) {
+    free(flat);
+}
+
+uint32_t nbt_flat_find(const struct nbt_flat *flat, uint32_t compound, const char *name, nbt_strlen namelen) {
+    const struct nbt_flat_node *nodes = nbt_flat_nodes(flat);
+    if (nodes[compound].type != NBT_TAG_COMPOUND) return NBT_FLAT_NONE;
+
+    NBT_FLAT_FOREACH_CHILD(flat, compound, child) {
+        const struct nbt_flat_node *node = &nodes[child];
+        if (node->namelen == namelen && memcmp(nbt_flat_name(flat, child), name, namelen) == 0)
+            return child;
+    }
+
+    return NBT_FLAT_NONE;
+}
+
+uint32_t nbt_flat_list_get(const struct nbt_flat *flat, uint32_t list, uint32_t index) {
+    const struct nbt_flat_node *node = &nbt_flat_nodes(flat)[list];
+    if (node->type != NBT_TAG_LIST || index >= node->length || node->size == 1) return NBT_FLAT_NONE;
+
+    uint32_t child = list + 1;
+    while (index--) child = nbt_flat_next(flat, child);
+    return child;
+}
+
+uint32_t nbt_flat_get(const struct nbt_flat *flat, const char *path) {
+    uint32_t node = 0;
+    const char *p = path;
+
+    while (*p) {
+        if (p != path && *p++ != '.') goto malformed;
+
+        size_t namelen = strcspn(p, ".[");
+        if (namelen == 0 || namelen > UINT16_MAX) goto malformed;
+        if (nbt_flat_nodes(flat)[node].type != NBT_TAG_COMPOUND) {
+            nbt_set_error("%.*s is not a compound", (int)(p - 1 - path), path);
+            return NBT_FLAT_NONE;
+        }
+
+        uint32_t next = nbt_flat_find(flat, node, p, (nbt_strlen)namelen);
+        if (next == NBT_FLAT_NONE) {
+            nbt_set_error("No tag named %.*s", (int)namelen, p);
+            return NBT_FLAT_NONE;
+        }
+
+        node = next;
+        p += namelen;
+
+        while (*p == '[') {
+            char *end;
+            long index = strtol(p + 1, &end, 10);
+            if (end == p + 1 || *end != ']') goto malformed;
+
+            const struct nbt_flat_node *list = &nbt_flat_nodes(flat)[node];
+            if (list->type != NBT_TAG_LIST) {
+                nbt_set_error("%.*s is not a list", (int)(p - path), path);
+                return NBT_FLAT_NONE;
+            }
+            if (index < 0 || index >= (long)list->length) {
+                nbt_set_error("Index %ld out of range for %.*s (length %u)", index, (int)(p - path), path, list->length);
+                return NBT_FLAT_NONE;
+            }
+            if (list->size == 1) {
+                nbt_set_error("%.*s is a list of numbers; read it through nbt_flat_payload()", (int)(p - path), path);
+                return NBT_FLAT_NONE;
+            }
+
+            node = nbt_flat_list_get(flat, node, (uint32_t)index);
+            p = end + 1;
+        }
+    }
+
+    return node;
+
+malformed:
+    nbt_set_error("Malformed NBT path \"%s\"", path);
+    return NBT_FLAT_NONE;
+}
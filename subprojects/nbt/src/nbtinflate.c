@@ -0,0 +1,225 @@
+#include "nbt.h"
+#include "nbt_internal.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Whole-buffer decompression behind one interface. The backend is picked
+ * at build time (meson option nbt:decompressor):
+ *   NBT_INFLATE_LIBDEFLATE  one-shot libdeflate into a presized buffer
+ *   NBT_INFLATE_ZLIB_NG     streaming inflate with zlib-ng's native API
+ *   (neither)               streaming inflate with zlib */
+
+#if defined(NBT_INFLATE_LIBDEFLATE)
+#include <libdeflate.h>
+#elif defined(NBT_INFLATE_ZLIB_NG)
+#include <zlib-ng.h>
+#define z_stream    zng_stream
+#define inflateInit2 zng_inflateInit2
+#define inflate      zng_inflate
+#define inflateReset zng_inflateReset
+#define inflateEnd   zng_inflateEnd
+#else
+#include <zlib.h>
+#endif
+
+#define GZ_MAGIC_0 (0x1F)
+#define GZ_MAGIC_1 (0x8B)
+
+#define NBT_INFLATE_MIN (65536)
+
+/* deflate cannot expand data by more than about 1032:1 */
+#define NBT_INFLATE_MAX_RATIO (1032)
+
+const char *nbt_decompressor(void) {
+#if defined(NBT_INFLATE_LIBDEFLATE)
+    return "libdeflate";
+#elif defined(NBT_INFLATE_ZLIB_NG)
+    return "zlib-ng";
+#else
+    return "zlib";
+#endif
+}
+
+int nbt_detect_compression(const unsigned char *data, size_t length) {
+    if (length >= 2 && data[0] == GZ_MAGIC_0 && data[1] == GZ_MAGIC_1)
+        return NBT_COMPRESSION_GZIP;
+
+    /* zlib: CM = 8 (deflate), window <= 32K, header checksum. Raw NBT
+     * starts with the root tag type (0x0a), which never matches. */
+    if (length >= 2 && (data[0] & 0x0f) == 8 && (data[0] >> 4) <= 7 && ((data[0] << 8) | data[1]) % 31 == 0)
+        return NBT_COMPRESSION_ZLIB;
+
+    return NBT_COMPRESSION_NONE;
+}
+
+static inline int nbt_is_gzip(const unsigned char *data, size_t length) {
+    return length >= 2 && data[0] == GZ_MAGIC_0 && data[1] == GZ_MAGIC_1;
+}
+
+/* First guess at the output size. A gzip member ends with its inflated size
+ * mod 2^32 (ISIZE), which is exact for any sane NBT file; it is still only a
+ * hint, clamped to what deflate could possibly produce and to `limit`. */
+size_t nbt_inflate_size_hint(const unsigned char *in, size_t inlen, int format, size_t limit) {
+    size_t hint = inlen * 4;
+
+    if (format == NBT_COMPRESSION_GZIP && inlen >= 18) {
+        const unsigned char *t = in + inlen - 4;
+        hint = (size_t)t[0] | (size_t)t[1] << 8 | (size_t)t[2] << 16 | (size_t)t[3] << 24;
+    }
+
+    if (inlen < SIZE_MAX / NBT_INFLATE_MAX_RATIO && hint > inlen * NBT_INFLATE_MAX_RATIO)
+        hint = inlen * NBT_INFLATE_MAX_RATIO;
+    if (hint < NBT_INFLATE_MIN)
+        hint = NBT_INFLATE_MIN;
+    if (hint > limit)
+        hint = limit;
+
+    return hint;
+}
+
+int nbt_inflate_grow(unsigned char **buf, size_t *cap, size_t limit) {
+    if (*cap >= limit) {
+        nbt_set_error("Inflated NBT data is larger than the limit of %zu bytes", limit);
+        return -1;
+    }
+    if (*cap > SIZE_MAX / 2) {
+        nbt_set_error("Inflated NBT data is too large");
+        return -1;
+    }
+
+    size_t newcap = *cap * 2 > limit ? limit : *cap * 2;
+    unsigned char *temp = realloc(*buf, newcap);
+    if (!temp) {
+        nbt_set_error("Unable to allocate %zu bytes for inflated NBT data", newcap);
+        return -1;
+    }
+
+    *buf = temp;
+    *cap = newcap;
+    return 0;
+}
+
+#if defined(NBT_INFLATE_LIBDEFLATE)
+
+int nbt_inflate_whole(const unsigned char *in, size_t inlen, int format, size_t limit, unsigned char **data, size_t *length) {
+    struct libdeflate_decompressor *d = libdeflate_alloc_decompressor();
+    if (!d) {
+        nbt_set_error("Unable to allocate libdeflate decompressor");
+        return -1;
+    }
+
+    size_t cap = nbt_inflate_size_hint(in, inlen, format, limit);
+    size_t len = 0;
+    unsigned char *buf = malloc(cap);
+    if (!buf) {
+        nbt_set_error("Unable to allocate %zu bytes for inflated NBT data", cap);
+        goto inflate_error_cleanup;
+    }
+
+    /* one call per gzip member; the output must fit in one go, so a
+     * wrong guess means growing and starting the member over */
+    while (true) {
+        size_t used, produced;
+        enum libdeflate_result res = format == NBT_COMPRESSION_GZIP
+            ? libdeflate_gzip_decompress_ex(d, in, inlen, buf + len, cap - len, &used, &produced)
+            : libdeflate_zlib_decompress_ex(d, in, inlen, buf + len, cap - len, &used, &produced);
+
+        if (res == LIBDEFLATE_INSUFFICIENT_SPACE) {
+            if (nbt_inflate_grow(&buf, &cap, limit) < 0) goto inflate_error_cleanup;
+            continue;
+        } else if (res != LIBDEFLATE_SUCCESS) {
+            nbt_set_error("Failed to inflate NBT data: %s", res == LIBDEFLATE_BAD_DATA ? "invalid or truncated data" : "unexpected end of output");
+            goto inflate_error_cleanup;
+        }
+
+        len += produced;
+        in += used;
+        inlen -= used;
+
+        if (format != NBT_COMPRESSION_GZIP || !nbt_is_gzip(in, inlen)) break;
+    }
+
+    libdeflate_free_decompressor(d);
+    *data = buf;
+    *length = len;
+    return 0;
+
+inflate_error_cleanup:
+    libdeflate_free_decompressor(d);
+    free(buf);
+    return -1;
+}
+
+#else /* zlib and zlib-ng */
+
+int nbt_inflate_whole(const unsigned char *in, size_t inlen, int format, size_t limit, unsigned char **data, size_t *length) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    /* 32: accept both zlib and gzip headers */
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+        nbt_set_error("Failed to initialize inflate: %s", zs.msg ? zs.msg : "unknown error");
+        return -1;
+    }
+
+    size_t cap = nbt_inflate_size_hint(in, inlen, format, limit);
+    size_t len = 0;
+    unsigned char *buf = malloc(cap);
+    if (!buf) {
+        nbt_set_error("Unable to allocate %zu bytes for inflated NBT data", cap);
+        goto inflate_error_cleanup;
+    }
+
+    const unsigned char *cur = in, *end = in + inlen;
+    while (true) {
+        if (len == cap && nbt_inflate_grow(&buf, &cap, limit) < 0)
+            goto inflate_error_cleanup;
+
+        /* the stream counts in uInt, so feed very large buffers piecewise */
+        size_t inleft = (size_t)(end - cur);
+        size_t outleft = cap - len;
+        zs.next_in = (unsigned char *)cur;
+        zs.avail_in = inleft > UINT_MAX ? UINT_MAX : (unsigned)inleft;
+        zs.next_out = buf + len;
+        zs.avail_out = outleft > UINT_MAX ? UINT_MAX : (unsigned)outleft;
+
+        int ret = inflate(&zs, Z_NO_FLUSH);
+
+        cur = zs.next_in;
+        len = (size_t)(zs.next_out - buf);
+
+        if (ret == Z_STREAM_END) {
+            /* concatenated gzip members decode as one file, as with gzread() */
+            if (format != NBT_COMPRESSION_GZIP || !nbt_is_gzip(cur, (size_t)(end - cur))) break;
+            inflateReset(&zs);
+        } else if (ret == Z_BUF_ERROR && cur == end) {
+            nbt_set_error("Truncated compressed NBT data");
+            goto inflate_error_cleanup;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            nbt_set_error("Failed to inflate NBT data: %s", zs.msg ? zs.msg : "unknown error");
+            goto inflate_error_cleanup;
+        }
+    }
+
+    inflateEnd(&zs);
+    *data = buf;
+    *length = len;
+    return 0;
+
+inflate_error_cleanup:
+    inflateEnd(&zs);
+    free(buf);
+    return -1;
+}
+
+#endif
+
+int nbt_decompress(const unsigned char *in, size_t inlen, int format, size_t limit, unsigned char **data, size_t *length) {
+    NBT_TRACE_EVENT(NBT_TRACE_INFLATE, true, inlen);
+    int ret = nbt_inflate_whole(in, inlen, format, limit ? limit : SIZE_MAX, data, length);
+    NBT_TRACE_EVENT(NBT_TRACE_INFLATE, false, ret < 0 ? 0 : *length);
+    return ret;
+}
@@ -0,0 +1,1592 @@
+#include "nbt_json.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_endian.h"
+#include "nbt_internal.h"
+#include "nbt_sax.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const nbt_json_type_names[] = {
+    "end", "byte", "short", "int", "long", "float", "double",
+    "byte_array", "string", "list", "compound", "int_array", "long_array",
+};
+
+static const char nbt_hex_digits[16] = "0123456789abcdef";
+
+static const char nbt_base64_digits[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* base64 digit values, -1 for anything else */
+static const signed char nbt_base64_values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+/* Export is a SAX handler keeping one frame per open compound, list or
+ * array (the root document is frame 0, a compound with no brackets of its
+ * own). Like the SNBT writer it reserves the most a piece can take and
+ * writes through a raw pointer; a whole chunk of array elements is one
+ * piece. */
+
+struct nbt_json_frame {
+    nbt_type type;      /* COMPOUND, LIST or an array type */
+    nbt_type elemtype;  /* lists */
+    nbt_int count;      /* entries or elements written so far */
+};
+
+struct nbt_json_writer {
+    struct nbt_buffer *out;
+    FILE *file;         /* flushed into when non-NULL */
+
+    bool pretty;
+    bool typed;
+    unsigned indent;
+    int arrays;
+    int longs;
+
+    unsigned depth;     /* index of the innermost frame */
+    struct nbt_json_frame frames[NBT_DEFAULT_MAX_DEPTH + 2];
+
+    /* base64: bytes of the array so far that do not make a whole group */
+    unsigned char carry[3];
+    size_t carrylen;
+
+    unsigned char chunk[NBT_SAX_CHUNK_BYTES]; /* array elements turned big-endian */
+};
+
+static inline char *nbt_json_reserve(struct nbt_json_writer *w, size_t n) {
+    if (nbt_buffer_reserve(w->out, n) < 0) {
+        nbt_set_error("Unable to allocate memory for JSON output");
+        return NULL;
+    }
+    return (char *)w->out->data + w->out->length;
+}
+
+static inline void nbt_json_commit(struct nbt_json_writer *w, char *p) {
+    w->out->length = (size_t)((unsigned char *)p - w->out->data);
+}
+
+static inline int nbt_json_put(struct nbt_json_writer *w, const char *s, size_t len) {
+    char *p = nbt_json_reserve(w, len);
+    if (!p) return -1;
+    memcpy(p, s, len);
+    nbt_json_commit(w, p + len);
+    return 0;
+}
+
+/* Pretty output: a line break and the indentation of the current depth. */
+int nbt_json_newline(struct nbt_json_writer *w) {
+    if (!w->pretty) return 0;
+
+    size_t spaces = (size_t)w->depth * w->indent;
+    char *p = nbt_json_reserve(w, 1 + spaces);
+    if (!p) return -1;
+
+    *p++ = '\n';
+    memset(p, ' ', spaces);
+    nbt_json_commit(w, p + spaces);
+    return 0;
+}
+
+/* ", " between the fields of a typed value and the elements of a line */
+static inline int nbt_json_comma(struct nbt_json_writer *w) {
+    return w->pretty ? nbt_json_put(w, ", ", 2) : nbt_json_put(w, ",", 1);
+}
+
+static inline char *nbt_json_escape_u(char *p, unsigned unit) {
+    *p++ = '\\';
+    *p++ = 'u';
+    *p++ = nbt_hex_digits[(unit >> 12) & 0xf];
+    *p++ = nbt_hex_digits[(unit >> 8) & 0xf];
+    *p++ = nbt_hex_digits[(unit >> 4) & 0xf];
+    *p++ = nbt_hex_digits[unit & 0xf];
+    return p;
+}
+
+/* Needs 6 * len + 2 bytes at `p`. Modified UTF-8 passes through except for
+ * what JSON text cannot hold raw: the two-byte U+0000 and the surrogates
+ * of astral characters, which become \u escapes (a pair of them reads back
+ * as the character). */
+char *nbt_json_quote(char *p, const char *s, size_t len) {
+    const unsigned char *q = (const unsigned char *)s, *end = q + len;
+
+    *p++ = '"';
+    while (q < end) {
+        unsigned char c = *q;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            if (c == 0xc0 && end - q >= 2 && q[1] == 0x80) {
+                p = nbt_json_escape_u(p, 0);
+                q += 2;
+            } else if (c == 0xed && end - q >= 3 && (q[1] & 0xe0) == 0xa0 && (q[2] & 0xc0) == 0x80) {
+                p = nbt_json_escape_u(p, 0xd000u | (unsigned)(q[1] & 0x3f) << 6 | (q[2] & 0x3f));
+                q += 3;
+            } else {
+                *p++ = (char)c;
+                ++q;
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '"':
+            case '\\':
+                *p++ = '\\';
+                *p++ = (char)c;
+                break;
+            case '\b': *p++ = '\\'; *p++ = 'b'; break;
+            case '\f': *p++ = '\\'; *p++ = 'f'; break;
+            case '\n': *p++ = '\\'; *p++ = 'n'; break;
+            case '\r': *p++ = '\\'; *p++ = 'r'; break;
+            case '\t': *p++ = '\\'; *p++ = 't'; break;
+            default:
+                p = nbt_json_escape_u(p, c);
+                break;
+        }
+        ++q;
+    }
+    *p++ = '"';
+    return p;
+}
+
+int nbt_json_string(struct nbt_json_writer *w, const char *s, size_t len) {
+    char *p = nbt_json_reserve(w, 6 * len + 2);
+    if (!p) return -1;
+    nbt_json_commit(w, nbt_json_quote(p, s, len));
+    return 0;
+}
+
+/* "name": */
+int nbt_json_field(struct nbt_json_writer *w, const char *name, size_t len) {
+    if (nbt_json_string(w, name, len) < 0) return -1;
+    return w->pretty ? nbt_json_put(w, ": ", 2) : nbt_json_put(w, ":", 1);
+}
+
+#define NBT_JSON_FIELD(_w, _name) nbt_json_field(_w, _name, sizeof(_name) - 1)
+
+/* Empty lists can claim any element type; an invalid one is written as
+ * "end". */
+int nbt_json_type_name(struct nbt_json_writer *w, nbt_type type) {
+    const char *name = nbt_json_type_names[type <= NBT_TAG_LONG_ARRAY ? type : NBT_TAG_END];
+    return nbt_json_string(w, name, strlen(name));
+}
+
+/* Needs NBT_FORMAT_DOUBLE_CHARS + 2 bytes at `p`. */
+static inline char *nbt_json_format_float(char *p, double v, bool single) {
+    if (isfinite(v)) return nbt_format_double(p, v, single);
+
+    *p++ = '"';
+    p = nbt_format_double(p, v, single);
+    *p++ = '"';
+    return p;
+}
+
+/* Most characters one number element can take, quotes included. */
+static inline size_t nbt_json_number_chars(nbt_type type) {
+    switch (type) {
+        case NBT_TAG_BYTE: return 4;   /* -128 */
+        case NBT_TAG_SHORT: return 6;  /* -32768 */
+        case NBT_TAG_INT: return 11;   /* -2147483648 */
+        case NBT_TAG_LONG: return 22;  /* "-9223372036854775808" */
+        default: return NBT_FORMAT_DOUBLE_CHARS + 2;
+    }
+}
+
+/* Elements of an array or a list of numbers, continuing the frame's line:
+ * one reservation for the whole chunk. */
+int nbt_json_numbers(struct nbt_json_writer *w, struct nbt_json_frame *f, nbt_type type, const void *data, size_t count) {
+    char *p = nbt_json_reserve(w, count * (nbt_json_number_chars(type) + 2));
+    if (!p) return -1;
+
+#define NBT_JSON_NUMBERS(_ctype, _format)         \
+    for (size_t i = 0; i < count; ++i) {          \
+        if (f->count++ > 0) {                     \
+            *p++ = ',';                           \
+            if (w->pretty) *p++ = ' ';            \
+        }                                         \
+        _ctype v = ((const _ctype *)data)[i];     \
+        _format;                                  \
+    }
+
+    switch (type) {
+        case NBT_TAG_BYTE:
+            NBT_JSON_NUMBERS(nbt_byte, p = nbt_format_i64(p, v))
+            break;
+        case NBT_TAG_SHORT:
+            NBT_JSON_NUMBERS(nbt_short, p = nbt_format_i64(p, v))
+            break;
+        case NBT_TAG_INT:
+            NBT_JSON_NUMBERS(nbt_int, p = nbt_format_i64(p, v))
+            break;
+        case NBT_TAG_LONG:
+            if (w->longs == NBT_JSON_LONG_STRING) {
+                NBT_JSON_NUMBERS(nbt_long, *p++ = '"'; p = nbt_format_i64(p, v); *p++ = '"')
+            } else {
+                NBT_JSON_NUMBERS(nbt_long, p = nbt_format_i64(p, v))
+            }
+            break;
+        case NBT_TAG_FLOAT:
+            NBT_JSON_NUMBERS(nbt_float, p = nbt_json_format_float(p, v, true))
+            break;
+        default:
+            NBT_JSON_NUMBERS(nbt_double, p = nbt_json_format_float(p, v, false))
+            break;
+    }
+
+#undef NBT_JSON_NUMBERS
+
+    nbt_json_commit(w, p);
+    return 0;
+}
+
+static inline char *nbt_json_base64_group(char *p, const unsigned char *in) {
+    uint32_t v = (uint32_t)in[0] << 16 | (uint32_t)in[1] << 8 | in[2];
+    *p++ = nbt_base64_digits[v >> 18];
+    *p++ = nbt_base64_digits[(v >> 12) & 0x3f];
+    *p++ = nbt_base64_digits[(v >> 6) & 0x3f];
+    *p++ = nbt_base64_digits[v & 0x3f];
+    return p;
+}
+
+/* Array elements as base64, in their big-endian byte order. A chunk need
+ * not end on a group of three bytes; the rest is carried to the next. */
+int nbt_json_base64(struct nbt_json_writer *w, const void *data, size_t count, size_t width) {
+    const unsigned char *in = data;
+    size_t n = count * width;
+
+    if (width > 1) {
+        memcpy(w->chunk, data, n);
+        nbt_endian_h2be_array(w->chunk, count, width);
+        in = w->chunk;
+    }
+
+    char *p = nbt_json_reserve(w, (w->carrylen + n) / 3 * 4);
+    if (!p) return -1;
+
+    while (w->carrylen > 0 && n > 0) {
+        w->carry[w->carrylen++] = *in++;
+        --n;
+        if (w->carrylen == 3) {
+            p = nbt_json_base64_group(p, w->carry);
+            w->carrylen = 0;
+        }
+    }
+
+    for (; n >= 3; n -= 3, in += 3) p = nbt_json_base64_group(p, in);
+
+    memcpy(w->carry + w->carrylen, in, n);
+    w->carrylen += n;
+
+    nbt_json_commit(w, p);
+    return 0;
+}
+
+int nbt_json_base64_end(struct nbt_json_writer *w) {
+    char *p = nbt_json_reserve(w, 5);
+    if (!p) return -1;
+
+    if (w->carrylen > 0) {
+        unsigned char last[3] = { w->carry[0], w->carrylen > 1 ? w->carry[1] : 0, 0 };
+        p = nbt_json_base64_group(p, last);
+        p[-1] = '=';
+        if (w->carrylen == 1) p[-2] = '=';
+        w->carrylen = 0;
+    }
+
+    *p++ = '"';
+    nbt_json_commit(w, p);
+    return 0;
+}
+
+/* Hands what is buffered to the output file once there is enough of it. */
+int nbt_json_flush(struct nbt_json_writer *w, bool all) {
+    if (!w->file || w->out->length == 0 || (!all && w->out->length < NBT_JSON_FLUSH_BYTES)) return 0;
+
+    if (fwrite(w->out->data, 1, w->out->length, w->file) != w->out->length) {
+        nbt_set_error("Unable to write JSON output");
+        return -1;
+    }
+    w->out->length = 0;
+    return 0;
+}
+
+/* Callback results: a failed write aborts the parse. */
+#define NBT_JSON_CHECK(_expr)                       \
+do {                                                \
+    if ((_expr) < 0) return NBT_SAX_ABORT;          \
+} while (0)
+
+/* Before every value: separates list elements, putting lists and compounds
+ * on lines of their own. Compound entries are separated by their key. */
+int nbt_json_element(struct nbt_json_writer *w) {
+    struct nbt_json_frame *f = &w->frames[w->depth];
+    if (f->type != NBT_TAG_LIST) return 0;
+
+    if (f->count++ > 0 && nbt_json_put(w, ",", 1) < 0) return -1;
+    if (f->elemtype == NBT_TAG_LIST || f->elemtype == NBT_TAG_COMPOUND) return nbt_json_newline(w);
+    if (f->count > 1 && w->pretty) return nbt_json_put(w, " ", 1);
+    return 0;
+}
+
+/* After every value: closes the typed object around a compound entry. */
+int nbt_json_done(struct nbt_json_writer *w) {
+    if (w->typed && w->frames[w->depth].type == NBT_TAG_COMPOUND && nbt_json_put(w, "}", 1) < 0) return -1;
+    return nbt_json_flush(w, false);
+}
+
+static inline int nbt_json_push(struct nbt_json_writer *w, nbt_type type, nbt_type elemtype) {
+    /* the SAX decoder stops nesting at NBT_DEFAULT_MAX_DEPTH */
+    struct nbt_json_frame *f = &w->frames[++w->depth];
+    f->type = type;
+    f->elemtype = elemtype;
+    f->count = 0;
+    return 0;
+}
+
+int nbt_json_on_key(void *user, nbt_type type, const char *name, nbt_strlen namelen) {
+    struct nbt_json_writer *w = user;
+    struct nbt_json_frame *f = &w->frames[w->depth];
+
+    /* the decoder rejects the value next */
+    if (type == NBT_TAG_END || type > NBT_TAG_LONG_ARRAY) return NBT_SAX_CONTINUE;
+
+    if (w->depth == 0) {
+        /* the root: its name only has a place in typed JSON */
+        if (w->typed) {
+            NBT_JSON_CHECK(nbt_json_put(w, "{", 1));
+            NBT_JSON_CHECK(NBT_JSON_FIELD(w, "type"));
+            NBT_JSON_CHECK(nbt_json_type_name(w, type));
+            NBT_JSON_CHECK(nbt_json_comma(w));
+            NBT_JSON_CHECK(NBT_JSON_FIELD(w, "name"));
+            NBT_JSON_CHECK(nbt_json_string(w, name, namelen));
+            NBT_JSON_CHECK(nbt_json_comma(w));
+            NBT_JSON_CHECK(NBT_JSON_FIELD(w, "value"));
+        }
+        return NBT_SAX_CONTINUE;
+    }
+
+    if (f->count++ > 0) NBT_JSON_CHECK(nbt_json_put(w, ",", 1));
+    NBT_JSON_CHECK(nbt_json_newline(w));
+    NBT_JSON_CHECK(nbt_json_field(w, name, namelen));
+
+    if (w->typed) {
+        NBT_JSON_CHECK(nbt_json_put(w, "{", 1));
+        NBT_JSON_CHECK(NBT_JSON_FIELD(w, "type"));
+        NBT_JSON_CHECK(nbt_json_type_name(w, type));
+        NBT_JSON_CHECK(nbt_json_comma(w));
+        /* a list's "value" follows its "element", in begin_list */
+        if (type != NBT_TAG_LIST) NBT_JSON_CHECK(NBT_JSON_FIELD(w, "value"));
+    }
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_json_on_scalar(void *user, nbt_type type, nbt_value value) {
+    struct nbt_json_writer *w = user;
+    char *p;
+
+    NBT_JSON_CHECK(nbt_json_element(w));
+
+    switch (type) {
+        case NBT_TAG_BYTE:
+        case NBT_TAG_SHORT:
+        case NBT_TAG_INT:
+        case NBT_TAG_LONG: {
+            nbt_long v = type == NBT_TAG_BYTE ? value.tag_byte
+                       : type == NBT_TAG_SHORT ? value.tag_short
+                       : type == NBT_TAG_INT ? value.tag_int
+                       : value.tag_long;
+            bool quoted = type == NBT_TAG_LONG && w->longs == NBT_JSON_LONG_STRING;
+            NBT_JSON_CHECK((p = nbt_json_reserve(w, 22)) ? 0 : -1);
+            if (quoted) *p++ = '"';
+            p = nbt_format_i64(p, v);
+            if (quoted) *p++ = '"';
+            nbt_json_commit(w, p);
+            break;
+        }
+        case NBT_TAG_FLOAT:
+        case NBT_TAG_DOUBLE:
+            NBT_JSON_CHECK((p = nbt_json_reserve(w, NBT_FORMAT_DOUBLE_CHARS + 2)) ? 0 : -1);
+            if (type == NBT_TAG_FLOAT) p = nbt_json_format_float(p, value.tag_float, true);
+            else p = nbt_json_format_float(p, value.tag_double, false);
+            nbt_json_commit(w, p);
+            break;
+        default:
+            NBT_JSON_CHECK(nbt_json_string(w, value.tag_string->buf, value.tag_string->len));
+            break;
+    }
+
+    NBT_JSON_CHECK(nbt_json_done(w));
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_json_on_begin_compound(void *user) {
+    struct nbt_json_writer *w = user;
+
+    NBT_JSON_CHECK(nbt_json_element(w));
+    NBT_JSON_CHECK(nbt_json_put(w, "{", 1));
+    nbt_json_push(w, NBT_TAG_COMPOUND, NBT_TAG_END);
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_json_on_begin_list(void *user, nbt_type elemtype, nbt_int length) {
+    struct nbt_json_writer *w = user;
+    (void)length;
+
+    NBT_JSON_CHECK(nbt_json_element(w));
+    if (w->typed) {
+        /* in a compound, the entry's typed object is already open */
+        if (w->frames[w->depth].type == NBT_TAG_LIST) NBT_JSON_CHECK(nbt_json_put(w, "{", 1));
+        NBT_JSON_CHECK(NBT_JSON_FIELD(w, "element"));
+        NBT_JSON_CHECK(nbt_json_type_name(w, elemtype));
+        NBT_JSON_CHECK(nbt_json_comma(w));
+        NBT_JSON_CHECK(NBT_JSON_FIELD(w, "value"));
+    }
+    NBT_JSON_CHECK(nbt_json_put(w, "[", 1));
+    nbt_json_push(w, NBT_TAG_LIST, elemtype);
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_json_on_begin_array(void *user, nbt_type type, nbt_int length) {
+    struct nbt_json_writer *w = user;
+    (void)length;
+
+    NBT_JSON_CHECK(nbt_json_element(w));
+    NBT_JSON_CHECK(nbt_json_put(w, w->arrays == NBT_JSON_ARRAY_BASE64 ? "\"" : "[", 1));
+    nbt_json_push(w, type, NBT_TAG_END);
+    w->carrylen = 0;
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_json_on_array_chunk(void *user, nbt_type elemtype, const void *data, size_t count) {
+    struct nbt_json_writer *w = user;
+    struct nbt_json_frame *f = &w->frames[w->depth];
+
+    if (f->type != NBT_TAG_LIST && w->arrays == NBT_JSON_ARRAY_BASE64)
+        NBT_JSON_CHECK(nbt_json_base64(w, data, count, nbt_type_size(elemtype)));
+    else
+        NBT_JSON_CHECK(nbt_json_numbers(w, f, elemtype, data, count));
+
+    NBT_JSON_CHECK(nbt_json_flush(w, false));
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_json_on_end(void *user, nbt_type type) {
+    struct nbt_json_writer *w = user;
+    struct nbt_json_frame *f = &w->frames[w->depth--];
+
+    switch (type) {
+        case NBT_TAG_COMPOUND:
+            if (f->count > 0) NBT_JSON_CHECK(nbt_json_newline(w));
+            NBT_JSON_CHECK(nbt_json_put(w, "}", 1));
+            break;
+        case NBT_TAG_LIST:
+            if (f->count > 0 && (f->elemtype == NBT_TAG_LIST || f->elemtype == NBT_TAG_COMPOUND))
+                NBT_JSON_CHECK(nbt_json_newline(w));
+            NBT_JSON_CHECK(nbt_json_put(w, "]", 1));
+            if (w->typed && w->frames[w->depth].type == NBT_TAG_LIST) NBT_JSON_CHECK(nbt_json_put(w, "}", 1));
+            break;
+        default:
+            if (w->arrays == NBT_JSON_ARRAY_BASE64) NBT_JSON_CHECK(nbt_json_base64_end(w));
+            else NBT_JSON_CHECK(nbt_json_put(w, "]", 1));
+            break;
+    }
+
+    NBT_JSON_CHECK(nbt_json_done(w));
+    return NBT_SAX_CONTINUE;
+}
+
+#undef NBT_JSON_CHECK
+
+/* Walks `data` into `out` (and `file`, if set). On failure the message is
+ * set and `err` filled in. */
+int nbt_json_convert(const unsigned char *data, size_t length, struct nbt_buffer *out, FILE *file, const struct nbt_json_options *options) {
+    struct nbt_error *err = options ? options->error : NULL;
+
+    struct nbt_json_writer *w = malloc(sizeof(struct nbt_json_writer));
+    if (!w) {
+        nbt_set_error("Unable to allocate memory for JSON writer");
+        nbt_fill_error(err, 0, "");
+        return -1;
+    }
+
+    w->out = out;
+    w->file = file;
+    w->pretty = options && options->pretty;
+    w->typed = options && options->typed;
+    w->indent = options && options->indent ? options->indent : 4;
+    w->arrays = options ? options->arrays : NBT_JSON_ARRAY_NUMBERS;
+    w->longs = options ? options->longs : NBT_JSON_LONG_NUMBER;
+    w->depth = 0;
+    w->frames[0] = (struct nbt_json_frame){ NBT_TAG_COMPOUND, NBT_TAG_END, 0 };
+    w->carrylen = 0;
+
+    struct nbt_sax_handler handler = {
+        .key = &nbt_json_on_key,
+        .scalar = &nbt_json_on_scalar,
+        .begin_compound = &nbt_json_on_begin_compound,
+        .begin_list = &nbt_json_on_begin_list,
+        .begin_array = &nbt_json_on_begin_array,
+        .array_chunk = &nbt_json_on_array_chunk,
+        .end = &nbt_json_on_end,
+        .user = w,
+    };
+
+    int ret = nbt_sax_parse(data, length, &handler, err);
+    if (ret == NBT_SAX_ABORT || (ret == 0 && nbt_json_flush(w, true) < 0)) {
+        nbt_fill_error(err, 0, "");
+        ret = -1;
+    }
+
+    free(w);
+    return ret;
+}
+
+int nbt_json_write(const unsigned char *data, size_t length, struct nbt_buffer *out, const struct nbt_json_options *options) {
+    size_t start = out->length;
+
+    if (nbt_json_convert(data, length, out, NULL, options) < 0) {
+        out->length = start;
+        return -1;
+    }
+    return 0;
+}
+
+int nbt_json_write_file(FILE *in, FILE *out, const struct nbt_json_options *options) {
+    struct nbt_read_options ropts = { .limits = options ? options->limits : (struct nbt_limits){ 0 } };
+    struct nbt_buffer buf = { NULL, 0, 0 };
+    unsigned char *data, *inflated;
+    size_t length, inflatedlen;
+
+    if (nbt_read_whole_file(in, &data, &length) < 0) goto file_error;
+
+    int format = nbt_detect_compression(data, length);
+    if (format != NBT_COMPRESSION_NONE) {
+        int ret = nbt_decompress_counted(data, length, format, &inflated, &inflatedlen, &ropts);
+        free(data);
+        if (ret < 0) goto file_error;
+
+        data = inflated;
+        length = inflatedlen;
+    }
+
+    if (nbt_buffer_reserve(&buf, NBT_JSON_FLUSH_BYTES) < 0) {
+        free(data);
+        nbt_set_error("Unable to allocate memory for JSON output");
+        goto file_error;
+    }
+
+    int ret = nbt_json_convert(data, length, &buf, out, options);
+    nbt_buffer_free(&buf);
+    free(data);
+    return ret;
+
+file_error:
+    nbt_fill_error(options ? options->error : NULL, 0, "");
+    return -1;
+}
+
+/* The parser is recursive descent over an nbt_reader, like the SNBT one,
+ * so it shares the tree reader's allocation, limits and error paths, and
+ * offsets are bytes of text. Typed JSON says what each value is before the
+ * value comes; plain JSON lists are gathered as tags and given the widest
+ * number type once they are complete. */
+
+struct nbt_json_parser {
+    struct nbt_reader rd;
+    struct nbt_buffer text;         /* unescaped contents of the last string */
+    const unsigned char *textpos;   /* its opening quote */
+    struct nbt_buffer num;          /* NUL-terminated copy of a number for strtod() */
+    bool typed;
+};
+
+struct nbt_json_number {
+    bool integral;  /* no fraction or exponent, and fits in 64 bits */
+    int64_t i;
+    double d;
+};
+
+static inline void nbt_json_skip_space(struct nbt_reader *rd) {
+    while (rd->cur < rd->end && (*rd->cur == ' ' || *rd->cur == '\n' || *rd->cur == '\t' || *rd->cur == '\r'))
+        ++rd->cur;
+}
+
+static inline bool nbt_json_at(struct nbt_reader *rd, unsigned char c) {
+    return rd->cur < rd->end && *rd->cur == c;
+}
+
+int nbt_json_unexpected(struct nbt_reader *rd, const char *expected) {
+    if (rd->cur == rd->end)
+        NBT_READ_FAIL(rd, "Unexpected end of JSON input, expected %s", expected);
+
+    unsigned char c = *rd->cur;
+    if (c >= 0x20 && c < 0x7f)
+        NBT_READ_FAIL(rd, "Unexpected '%c' in JSON input, expected %s", c, expected);
+    NBT_READ_FAIL(rd, "Unexpected byte %#02hhx in JSON input, expected %s", c, expected);
+}
+
+/* Skips whitespace and the expected punctuation. */
+static inline int nbt_json_expect(struct nbt_reader *rd, unsigned char c, const char *what) {
+    nbt_json_skip_space(rd);
+    if (!nbt_json_at(rd, c)) return nbt_json_unexpected(rd, what);
+    ++rd->cur;
+    return 0;
+}
+
+static inline int nbt_json_hex4(const unsigned char *p, uint32_t *out) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        unsigned char h = p[i];
+        unsigned d = h >= '0' && h <= '9' ? h - '0'
+                   : (h | 0x20) >= 'a' && (h | 0x20) <= 'f' ? (h | 0x20) - 'a' + 10
+                   : 16;
+        if (d == 16) return -1;
+        v = v << 4 | d;
+    }
+    *out = v;
+    return 0;
+}
+
+/* Unescapes the string under the cursor (on its opening quote) into
+ * jp->text. \u escapes are stored one UTF-16 unit at a time, which is how
+ * modified UTF-8 holds surrogate pairs anyway. There is no length limit
+ * here, as base64 arrays are strings too; see nbt_json_string_fits(). */
+int nbt_json_read_string(struct nbt_json_parser *jp) {
+    struct nbt_reader *rd = &jp->rd;
+    const unsigned char *open = rd->cur++;
+
+    jp->textpos = open;
+    jp->text.length = 0;
+    while (true) {
+        const unsigned char *run = rd->cur;
+        while (rd->cur < rd->end && *rd->cur != '"' && *rd->cur != '\\' && *rd->cur >= 0x20) ++rd->cur;
+
+        size_t runlen = (size_t)(rd->cur - run);
+        if (nbt_buffer_reserve(&jp->text, runlen + 6) < 0)
+            NBT_READ_FAIL(rd, "Unable to allocate memory for JSON string");
+        memcpy(jp->text.data + jp->text.length, run, runlen);
+        jp->text.length += runlen;
+
+        if (rd->cur == rd->end) {
+            rd->cur = open;
+            NBT_READ_FAIL(rd, "Unterminated JSON string");
+        } else if (*rd->cur == '"') {
+            ++rd->cur;
+            break;
+        } else if (*rd->cur < 0x20) {
+            NBT_READ_FAIL(rd, "Unescaped control character %#02hhx in JSON string", *rd->cur);
+        }
+
+        /* an escape */
+        const unsigned char *at = rd->cur++;
+        unsigned char *p = jp->text.data + jp->text.length;
+        unsigned char c = rd->cur < rd->end ? *rd->cur++ : 0;
+        uint32_t unit;
+
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                *p++ = c;
+                break;
+            case 'b': *p++ = '\b'; break;
+            case 'f': *p++ = '\f'; break;
+            case 'n': *p++ = '\n'; break;
+            case 'r': *p++ = '\r'; break;
+            case 't': *p++ = '\t'; break;
+            case 'u':
+                if (NBT_READER_LEFT(rd) < 4 || nbt_json_hex4(rd->cur, &unit) < 0) {
+                    rd->cur = at;
+                    NBT_READ_FAIL(rd, "Invalid \\u escape sequence in JSON string");
+                }
+                rd->cur += 4;
+                p = nbt_put_mutf8(p, unit);
+                break;
+            default:
+                rd->cur = at;
+                if (c >= 0x20 && c < 0x7f) NBT_READ_FAIL(rd, "Invalid escape sequence in JSON string: \\%c", c);
+                NBT_READ_FAIL(rd, "Unterminated escape sequence in JSON string");
+        }
+        jp->text.length = (size_t)(p - jp->text.data);
+    }
+
+    return 0;
+}
+
+/* For the last string read, when it is to become an NBT string or name. */
+static inline int nbt_json_string_fits(struct nbt_json_parser *jp) {
+    if (jp->text.length <= UINT16_MAX) return 0;
+
+    jp->rd.cur = jp->textpos;
+    NBT_READ_FAIL(&jp->rd, "JSON string is longer than 65535 bytes: %zu", jp->text.length);
+}
+
+/* Reads a string that must be there, e.g. a key. */
+static inline int nbt_json_expect_string(struct nbt_json_parser *jp, const char *what) {
+    nbt_json_skip_space(&jp->rd);
+    if (!nbt_json_at(&jp->rd, '"')) return nbt_json_unexpected(&jp->rd, what);
+    return nbt_json_read_string(jp);
+}
+
+/* A decimal integer, optionally negative, with no leading zeros; false if
+ * that is not what `s` holds or it does not fit in 64 bits. */
+bool nbt_json_parse_i64(const unsigned char *s, size_t len, int64_t *out) {
+    bool neg = len > 0 && *s == '-';
+    if (neg) {
+        ++s;
+        --len;
+    }
+    if (len == 0 || len > 19 + (s[0] == '1') || (len > 1 && s[0] == '0')) return false;
+
+    uint64_t max = (uint64_t)INT64_MAX + neg, v = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        if (v > (max - (uint64_t)(s[i] - '0')) / 10) return false;
+        v = v * 10 + (uint64_t)(s[i] - '0');
+    }
+
+    *out = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return true;
+}
+
+int nbt_json_read_number(struct nbt_json_parser *jp, struct nbt_json_number *num) {
+    struct nbt_reader *rd = &jp->rd;
+    const unsigned char *tok = rd->cur, *p = tok, *end = rd->end;
+    bool fraction = false;
+
+    if (p < end && *p == '-') ++p;
+    const unsigned char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9') ++p;
+    size_t intlen = (size_t)(p - digits);
+    if (intlen == 0 || (intlen > 1 && digits[0] == '0')) goto number_invalid;
+
+    if (p < end && *p == '.') {
+        const unsigned char *frac = ++p;
+        while (p < end && *p >= '0' && *p <= '9') ++p;
+        if (p == frac) goto number_invalid;
+        fraction = true;
+    }
+    if (p < end && (*p | 0x20) == 'e') {
+        ++p;
+        if (p < end && (*p == '+' || *p == '-')) ++p;
+        const unsigned char *expdigits = p;
+        while (p < end && *p >= '0' && *p <= '9') ++p;
+        if (p == expdigits) goto number_invalid;
+        fraction = true;
+    }
+
+    size_t len = (size_t)(p - tok);
+    rd->cur = p;
+
+    num->integral = !fraction && nbt_json_parse_i64(tok, len, &num->i);
+    if (num->integral) {
+        num->d = (double)num->i;
+        return 0;
+    }
+
+    if (nbt_buffer_reserve(&jp->num, len + 1) < 0) {
+        rd->cur = tok;
+        NBT_READ_FAIL(rd, "Unable to allocate memory for JSON number");
+    }
+    jp->num.length = 0;
+    memcpy(jp->num.data, tok, len);
+    jp->num.data[len] = '\0';
+    num->d = strtod((const char *)jp->num.data, NULL);
+    return 0;
+
+number_invalid:
+    if (p == tok || (*tok == '-' && p == tok + 1 && (p == end || *p < '0' || *p > '9')))
+        return nbt_json_unexpected(rd, "a value");
+    NBT_READ_FAIL(rd, "Invalid number in JSON input");
+}
+
+/* The strings that stand for NaN and the infinities. */
+static inline bool nbt_json_nonfinite(const unsigned char *s, size_t len, double *out) {
+    if (len == 3 && memcmp(s, "NaN", 3) == 0) *out = NAN;
+    else if (len == 8 && memcmp(s, "Infinity", 8) == 0) *out = INFINITY;
+    else if (len == 9 && memcmp(s, "-Infinity", 9) == 0) *out = -INFINITY;
+    else return false;
+    return true;
+}
+
+static inline bool nbt_json_literal(struct nbt_reader *rd, const char *word, size_t len) {
+    if (NBT_READER_LEFT(rd) < len || memcmp(rd->cur, word, len) != 0) return false;
+    rd->cur += len;
+    return true;
+}
+
+static inline int nbt_json_new_compound(struct nbt_reader *rd, struct nbt_compound **out) {
+    *out = nbt_reader_alloc(rd, sizeof(struct nbt_compound));
+    if (!*out)
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT compound");
+    memset(*out, 0, sizeof(struct nbt_compound));
+    return 0;
+}
+
+static inline int nbt_json_new_list(struct nbt_reader *rd, struct nbt_list **out) {
+    *out = nbt_reader_alloc(rd, sizeof(struct nbt_list));
+    if (!*out)
+        NBT_READ_FAIL(rd, "Unable to allocate memory for new NBT list");
+    memset(*out, 0, sizeof(struct nbt_list));
+    return 0;
+}
+
+/* Counts a value against limits.max_nodes and into the stats. Elements of
+ * lists of numbers are taken back off by nbt_json_uncount(), as the binary
+ * reader counts such a list as one value. */
+static inline int nbt_json_count(struct nbt_reader *rd, nbt_type type) {
+    if (++rd->nodes > rd->nodelimit)
+        NBT_READ_FAIL(rd, "NBT data has more than the limit of %zu values", rd->nodelimit);
+    if (rd->stats) ++rd->stats->nodes[type];
+    return 0;
+}
+
+static inline void nbt_json_uncount(struct nbt_reader *rd, nbt_type type) {
+    --rd->nodes;
+    if (rd->stats) --rd->stats->nodes[type];
+}
+
+int nbt_json_read_value(struct nbt_json_parser *jp, nbt_type *type, nbt_value *out);
+
+int nbt_json_read_compound(struct nbt_json_parser *jp, struct nbt_compound **out) {
+    struct nbt_reader *rd = &jp->rd;
+    struct nbt_compound_entry *entry = NULL;
+    struct nbt_compound *compound;
+
+    nbt_json_skip_space(rd);
+    if (!nbt_json_at(rd, '{')) return nbt_json_unexpected(rd, "'{'");
+
+    if (nbt_reader_enter(rd) < 0) return -1;
+    ++rd->cur;
+
+    if (nbt_json_new_compound(rd, &compound) < 0) {
+        nbt_reader_leave(rd);
+        return -1;
+    }
+    struct nbt_compound_entry **tail = &compound->first;
+
+    nbt_json_skip_space(rd);
+    if (nbt_json_at(rd, '}')) {
+        ++rd->cur;
+    } else {
+        while (true) {
+            if (nbt_json_expect_string(jp, "a key") < 0 || nbt_json_string_fits(jp) < 0) goto compound_error_cleanup;
+
+            char *name = nbt_reader_alloc(rd, jp->text.length + 1);
+            if (!name) {
+                nbt_reader_error(rd, "Failed to allocate space for NBT string");
+                goto compound_error_cleanup;
+            }
+            memcpy(name, jp->text.data, jp->text.length);
+            name[jp->text.length] = '\0';
+
+            entry = nbt_reader_alloc(rd, sizeof(struct nbt_compound_entry));
+            if (!entry) {
+                if (!rd->arena) free(name);
+                nbt_reader_error(rd, "Unable to allocate memory for NBT compound entry");
+                goto compound_error_cleanup;
+            }
+
+            /* TAG_End until its value is in */
+            memset(entry, 0, sizeof(struct nbt_compound_entry));
+            entry->name = name;
+            entry->namelen = (nbt_strlen)jp->text.length;
+            entry->hash = nbt_hash_name(name, entry->namelen);
+            *tail = entry;
+            tail = &entry->next;
+            ++compound->size;
+
+            if (nbt_json_expect(rd, ':', "':'") < 0) goto compound_error_cleanup;
+
+            nbt_type type;
+            nbt_value value;
+            if (nbt_json_read_value(jp, &type, &value) < 0) goto compound_error_cleanup;
+            entry->tag.type = type;
+            entry->tag.value = value;
+            entry = NULL;
+
+            nbt_json_skip_space(rd);
+            if (nbt_json_at(rd, ',')) {
+                ++rd->cur;
+            } else if (nbt_json_at(rd, '}')) {
+                ++rd->cur;
+                break;
+            } else {
+                nbt_json_unexpected(rd, "',' or '}'");
+                goto compound_error_cleanup;
+            }
+        }
+    }
+
+    if (nbt_read_compound_close(rd, compound) < 0) goto compound_error_cleanup;
+
+    nbt_reader_leave(rd);
+    *out = compound;
+    return 0;
+
+compound_error_cleanup:
+    if (entry) nbt_reader_error_name(rd, entry->name, entry->namelen);
+    NBT_READER_FREE(rd, compound, compound);
+    nbt_reader_leave(rd);
+    return -1;
+}
+
+/* Plain JSON */
+
+/* A number element of a list of `type` (the widest type in it). */
+static inline void nbt_json_store_number(unsigned char *p, nbt_type type, const struct nbt_tag *tag) {
+    int64_t i = tag->type == NBT_TAG_BYTE ? tag->value.tag_byte
+              : tag->type == NBT_TAG_INT ? tag->value.tag_int
+              : tag->type == NBT_TAG_LONG ? tag->value.tag_long
+              : 0;
+    double d = tag->type == NBT_TAG_DOUBLE ? tag->value.tag_double : (double)i;
+
+    switch (type) {
+        case NBT_TAG_BYTE: { nbt_byte v = (nbt_byte)i; memcpy(p, &v, sizeof(v)); break; }
+        case NBT_TAG_INT: { nbt_int v = (nbt_int)i; memcpy(p, &v, sizeof(v)); break; }
+        case NBT_TAG_LONG: memcpy(p, &i, sizeof(i)); break;
+        default: memcpy(p, &d, sizeof(d)); break;
+    }
+}
+
+int nbt_json_read_plain_list(struct nbt_json_parser *jp, struct nbt_list **out) {
+    struct nbt_reader *rd = &jp->rd;
+    struct nbt_buffer tags = { NULL, 0, 0 };
+    struct nbt_tag *tag;
+    struct nbt_list *list;
+    nbt_int count = 0;
+    nbt_type type = NBT_TAG_END;
+
+    if (nbt_reader_enter(rd) < 0) return -1;
+    ++rd->cur;
+
+    if (nbt_json_new_list(rd, &list) < 0) {
+        nbt_reader_leave(rd);
+        return -1;
+    }
+
+    nbt_json_skip_space(rd);
+    if (nbt_json_at(rd, ']')) {
+        ++rd->cur;
+    } else {
+        while (true) {
+            nbt_json_skip_space(rd);
+            const unsigned char *at = rd->cur;
+
+            if (count == rd->listlimit) {
+                nbt_reader_error(rd, "NBT list is longer than the limit of %d", rd->listlimit);
+                goto list_error_cleanup;
+            }
+            if (nbt_buffer_reserve(&tags, sizeof(struct nbt_tag)) < 0) {
+                nbt_reader_error(rd, "Unable to allocate memory for NBT list");
+                goto list_error_cleanup;
+            }
+
+            tag = (struct nbt_tag *)(tags.data + tags.length);
+            if (nbt_json_read_value(jp, &tag->type, &tag->value) < 0) {
+                nbt_reader_error_index(rd, count);
+                goto list_error_cleanup;
+            }
+            tags.length += sizeof(struct nbt_tag);
+            ++count;
+
+            /* numbers widen to whatever holds them all: BYTE < INT < LONG < DOUBLE */
+            if (count == 1) {
+                type = tag->type;
+            } else if (tag->type <= NBT_TAG_DOUBLE && type <= NBT_TAG_DOUBLE) {
+                if (tag->type > type) type = tag->type;
+            } else if (tag->type != type) {
+                rd->cur = at;
+                nbt_reader_error(rd, "JSON array mixes %s and %s values",
+                                 nbt_json_type_names[type], nbt_json_type_names[tag->type]);
+                nbt_reader_error_index(rd, count - 1);
+                goto list_error_cleanup;
+            }
+
+            if (tag->type <= NBT_TAG_DOUBLE) nbt_json_uncount(rd, tag->type);
+
+            nbt_json_skip_space(rd);
+            if (nbt_json_at(rd, ',')) {
+                ++rd->cur;
+            } else if (nbt_json_at(rd, ']')) {
+                ++rd->cur;
+                break;
+            } else {
+                nbt_json_unexpected(rd, "',' or ']'");
+                goto list_error_cleanup;
+            }
+        }
+
+        size_t width = nbt_type_size(type);
+        unsigned char *data = nbt_reader_alloc(rd, (size_t)count * width);
+        if (!data) {
+            nbt_reader_error(rd, "Unable to allocate %zu bytes for NBT list", (size_t)count * width);
+            goto list_error_cleanup;
+        }
+
+        tag = (struct nbt_tag *)tags.data;
+        for (nbt_int i = 0; i < count; ++i) {
+            if (type <= NBT_TAG_DOUBLE) nbt_json_store_number(data + (size_t)i * width, type, &tag[i]);
+            else memcpy(data + (size_t)i * width, &tag[i].value, width);
+        }
+
+        list->type = type;
+        list->length = count;
+        list->data.raw = data;
+    }
+
+    nbt_buffer_free(&tags);
+    nbt_reader_leave(rd);
+    *out = list;
+    return 0;
+
+list_error_cleanup:
+    if (!rd->arena) {
+        tag = (struct nbt_tag *)tags.data;
+        for (size_t i = 0; i < tags.length / sizeof(struct nbt_tag); ++i)
+            nbt_free_value(tag[i].type, tag[i].value);
+        free(list);
+    }
+    nbt_buffer_free(&tags);
+    nbt_reader_leave(rd);
+    return -1;
+}
+
+int nbt_json_read_plain(struct nbt_json_parser *jp, nbt_type *type, nbt_value *out) {
+    struct nbt_reader *rd = &jp->rd;
+    struct nbt_json_number num;
+
+    nbt_json_skip_space(rd);
+    if (rd->cur == rd->end) return nbt_json_unexpected(rd, "a value");
+
+    switch (*rd->cur) {
+        case '{':
+            *type = NBT_TAG_COMPOUND;
+            if (nbt_json_count(rd, *type) < 0) return -1;
+            return nbt_json_read_compound(jp, &out->tag_compound);
+        case '[':
+            *type = NBT_TAG_LIST;
+            if (nbt_json_count(rd, *type) < 0) return -1;
+            return nbt_json_read_plain_list(jp, &out->tag_list);
+        case '"':
+            *type = NBT_TAG_STRING;
+            if (nbt_json_count(rd, *type) < 0 || nbt_json_read_string(jp) < 0 || nbt_json_string_fits(jp) < 0) return -1;
+            return nbt_reader_make_string(rd, jp->text.data, jp->text.length, &out->tag_string);
+        case 't':
+        case 'f': {
+            bool v = nbt_json_literal(rd, "true", 4);
+            if (!v && !nbt_json_literal(rd, "false", 5)) return nbt_json_unexpected(rd, "a value");
+            *type = NBT_TAG_BYTE;
+            out->tag_byte = v;
+            return nbt_json_count(rd, *type);
+        }
+        case 'n':
+            if (nbt_json_literal(rd, "null", 4)) {
+                rd->cur -= 4;
+                NBT_READ_FAIL(rd, "JSON null has no NBT equivalent");
+            }
+            return nbt_json_unexpected(rd, "a value");
+        default:
+            if (nbt_json_read_number(jp, &num) < 0) return -1;
+            if (num.integral && num.i >= INT32_MIN && num.i <= INT32_MAX) {
+                *type = NBT_TAG_INT;
+                out->tag_int = (nbt_int)num.i;
+            } else if (num.integral) {
+                *type = NBT_TAG_LONG;
+                out->tag_long = num.i;
+            } else {
+                *type = NBT_TAG_DOUBLE;
+                out->tag_double = num.d;
+            }
+            return nbt_json_count(rd, *type);
+    }
+}
+
+/* Typed JSON */
+
+int nbt_json_read_typed(struct nbt_json_parser *jp, bool listonly, struct nbt_parsed *root, nbt_type *type, nbt_value *out);
+int nbt_json_read_value_as(struct nbt_json_parser *jp, nbt_type type, nbt_type elemtype, nbt_value *out);
+
+/* A type name, as a string under the cursor; TAG_End only if `end`. */
+int nbt_json_read_type(struct nbt_json_parser *jp, bool end, nbt_type *out) {
+    const unsigned char *at;
+
+    nbt_json_skip_space(&jp->rd);
+    at = jp->rd.cur;
+    if (nbt_json_expect_string(jp, "a type name") < 0) return -1;
+
+    for (nbt_type t = end ? NBT_TAG_END : NBT_TAG_BYTE; t <= NBT_TAG_LONG_ARRAY; ++t) {
+        const char *name = nbt_json_type_names[t];
+        if (strlen(name) == jp->text.length && memcmp(name, jp->text.data, jp->text.length) == 0) {
+            *out = t;
+            return 0;
+        }
+    }
+
+    jp->rd.cur = at;
+    NBT_READ_FAIL(&jp->rd, "Unknown NBT type in JSON input: \"%.*s\"", (int)jp->text.length, (const char *)jp->text.data);
+}
+
+/* Decodes jp->text as base64 into `elems`, in host order. */
+int nbt_json_decode_base64(struct nbt_json_parser *jp, const unsigned char *at, size_t width, struct nbt_buffer *elems) {
+    struct nbt_reader *rd = &jp->rd;
+    const unsigned char *s = jp->text.data;
+    size_t len = jp->text.length;
+
+    size_t pad = len >= 1 && s[len - 1] == '=' ? 1 + (len >= 2 && s[len - 2] == '=') : 0;
+    size_t bytes = len / 4 * 3 - pad;
+    if (len % 4 != 0 || bytes % width != 0) {
+        rd->cur = at;
+        NBT_READ_FAIL(rd, "Invalid base64 array in JSON input: %zu characters", len);
+    }
+
+    if (nbt_buffer_reserve(elems, bytes + 2) < 0)
+        NBT_READ_FAIL(rd, "Unable to allocate memory for NBT array");
+
+    unsigned char *p = elems->data;
+    for (size_t i = 0; i < len; i += 4) {
+        int a = nbt_base64_values[s[i]], b = nbt_base64_values[s[i + 1]];
+        int c = nbt_base64_values[s[i + 2]], d = nbt_base64_values[s[i + 3]];
+
+        /* padding only where `pad` says */
+        if (i + 4 == len && pad > 0) {
+            d = 0;
+            if (pad == 2) c = 0;
+        }
+        if ((a | b | c | d) < 0) {
+            rd->cur = at;
+            NBT_READ_FAIL(rd, "Invalid character in base64 array in JSON input");
+        }
+
+        uint32_t v = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | (uint32_t)d;
+        *p++ = (unsigned char)(v >> 16);
+        *p++ = (unsigned char)(v >> 8);
+        *p++ = (unsigned char)v;
+    }
+
+    elems->length = bytes;
+    if (width > 1) nbt_endian_be2h_array(elems->data, bytes / width, width);
+    return 0;
+}
+
+int nbt_json_read_typed_number(struct nbt_json_parser *jp, nbt_type type, nbt_value *out);
+
+/* [1, 2, 3] (long elements may be strings, as in lists), or a base64
+ * string of the big-endian elements. */
+int nbt_json_read_array(struct nbt_json_parser *jp, nbt_type type, nbt_value *out) {
+    struct nbt_reader *rd = &jp->rd;
+    struct nbt_buffer elems = { NULL, 0, 0 };
+    nbt_type elemtype = type == NBT_TAG_BYTE_ARRAY ? NBT_TAG_BYTE : type == NBT_TAG_INT_ARRAY ? NBT_TAG_INT : NBT_TAG_LONG;
+    const char *what = nbt_json_type_names[elemtype];
+    size_t width = nbt_type_size(elemtype);
+    nbt_int count = 0;
+
+    nbt_json_skip_space(rd);
+    const unsigned char *at = rd->cur;
+
+    if (nbt_json_at(rd, '"')) {
+        if (nbt_json_read_string(jp) < 0 || nbt_json_decode_base64(jp, at, width, &elems) < 0)
+            goto array_error_cleanup;
+
+        if (elems.length / width > (size_t)rd->arraylimit) {
+            rd->cur = at;
+            nbt_reader_error(rd, "NBT %s array is longer than the limit of %d", what, rd->arraylimit);
+            goto array_error_cleanup;
+        }
+        count = (nbt_int)(elems.length / width);
+    } else if (nbt_json_at(rd, '[')) {
+        ++rd->cur;
+        nbt_json_skip_space(rd);
+        if (nbt_json_at(rd, ']')) {
+            ++rd->cur;
+        } else {
+            while (true) {
+                nbt_value v;
+
+                nbt_json_skip_space(rd);
+                const unsigned char *tok = rd->cur;
+                if (nbt_json_read_typed_number(jp, elemtype, &v) < 0) goto array_error_cleanup;
+
+                if (count == rd->arraylimit) {
+                    rd->cur = tok;
+                    nbt_reader_error(rd, "NBT %s array is longer than the limit of %d", what, rd->arraylimit);
+                    goto array_error_cleanup;
+                }
+
+                if (nbt_buffer_reserve(&elems, width) < 0) {
+                    nbt_reader_error(rd, "Unable to allocate memory for NBT %s array", what);
+                    goto array_error_cleanup;
+                }
+
+                unsigned char *p = elems.data + elems.length;
+                if (width == 1) *p = (unsigned char)v.tag_byte;
+                else if (width == 4) memcpy(p, &v.tag_int, 4);
+                else memcpy(p, &v.tag_long, 8);
+                elems.length += width;
+                ++count;
+
+                nbt_json_skip_space(rd);
+                if (nbt_json_at(rd, ',')) {
+                    ++rd->cur;
+                } else if (nbt_json_at(rd, ']')) {
+                    ++rd->cur;
+                    break;
+                } else {
+                    nbt_json_unexpected(rd, "',' or ']'");
+                    goto array_error_cleanup;
+                }
+            }
+        }
+    } else {
+        nbt_json_unexpected(rd, "an array or a base64 string");
+        goto array_error_cleanup;
+    }
+
+    if (nbt_reader_make_array(rd, type, elems.data, count, out) < 0) goto array_error_cleanup;
+
+    nbt_buffer_free(&elems);
+    return 0;
+
+array_error_cleanup:
+    nbt_buffer_free(&elems);
+    return -1;
+}
+
+/* A number of `type`: integers as JSON integers (longs also as strings),
+ * floats as any number or one of the non-finite strings. */
+int nbt_json_read_typed_number(struct nbt_json_parser *jp, nbt_type type, nbt_value *out) {
+    struct nbt_reader *rd = &jp->rd;
+    struct nbt_json_number num;
+    const char *what = nbt_json_type_names[type];
+
+    nbt_json_skip_space(rd);
+    const unsigned char *at = rd->cur;
+
+    if (nbt_json_at(rd, '"')) {
+        if (nbt_json_read_string(jp) < 0) return -1;
+        if (type == NBT_TAG_FLOAT || type == NBT_TAG_DOUBLE) {
+            num.integral = false;
+            if (!nbt_json_nonfinite(jp->text.data, jp->text.length, &num.d)) goto number_invalid;
+        } else {
+            num.integral = type == NBT_TAG_LONG && nbt_json_parse_i64(jp->text.data, jp->text.length, &num.i);
+            if (!num.integral) goto number_invalid;
+        }
+    } else if (nbt_json_read_number(jp, &num) < 0) {
+        return -1;
+    }
+
+    switch (type) {
+        case NBT_TAG_BYTE:
+            if (!num.integral || num.i < INT8_MIN || num.i > INT8_MAX) goto number_invalid;
+            out->tag_byte = (nbt_byte)num.i;
+            break;
+        case NBT_TAG_SHORT:
+            if (!num.integral || num.i < INT16_MIN || num.i > INT16_MAX) goto number_invalid;
+            out->tag_short = (nbt_short)num.i;
+            break;
+        case NBT_TAG_INT:
+            if (!num.integral || num.i < INT32_MIN || num.i > INT32_MAX) goto number_invalid;
+            out->tag_int = (nbt_int)num.i;
+            break;
+        case NBT_TAG_LONG:
+            if (!num.integral) goto number_invalid;
+            out->tag_long = num.i;
+            break;
+        case NBT_TAG_FLOAT:
+            out->tag_float = (float)num.d;
+            break;
+        default:
+            out->tag_double = num.d;
+            break;
+    }
+    return 0;
+
+number_invalid:
+    rd->cur = at;
+    NBT_READ_FAIL(rd, "Invalid value for NBT %s in JSON input", what);
+}
+
+/* [...] of untyped elements of `elemtype` */
+int nbt_json_read_typed_list(struct nbt_json_parser *jp, nbt_type elemtype, struct nbt_list **out) {
+    struct nbt_reader *rd = &jp->rd;
+    struct nbt_buffer elems = { NULL, 0, 0 };
+    struct nbt_list *list;
+    size_t width = nbt_type_size(elemtype);
+
+    nbt_json_skip_space(rd);
+    if (!nbt_json_at(rd, '[')) return nbt_json_unexpected(rd, "'['");
+
+    if (nbt_reader_enter(rd) < 0) return -1;
+    ++rd->cur;
+
+    if (nbt_json_new_list(rd, &list) < 0) {
+        nbt_reader_leave(rd);
+        return -1;
+    }
+    list->type = elemtype;
+
+    nbt_json_skip_space(rd);
+    if (nbt_json_at(rd, ']')) {
+        ++rd->cur;
+    } else {
+        while (true) {
+            nbt_type type = elemtype;
+            nbt_value value;
+
+            nbt_json_skip_space(rd);
+            if (elemtype == NBT_TAG_END) {
+                nbt_reader_error(rd, "NBT list of TAG_End cannot have elements");
+                goto list_error_cleanup;
+            }
+            if (list->length == rd->listlimit) {
+                nbt_reader_error(rd, "NBT list is longer than the limit of %d", rd->listlimit);
+                goto list_error_cleanup;
+            }
+
+            int r = elemtype == NBT_TAG_LIST ? nbt_json_read_typed(jp, true, NULL, &type, &value)
+                                             : nbt_json_read_value_as(jp, elemtype, NBT_TAG_END, &value);
+            if (r < 0) {
+                nbt_reader_error_index(rd, list->length);
+                goto list_error_cleanup;
+            }
+
+            if (elemtype <= NBT_TAG_DOUBLE) nbt_json_uncount(rd, elemtype);
+
+            if (nbt_buffer_reserve(&elems, width) < 0) {
+                if (!rd->arena) nbt_free_value(elemtype, value);
+                nbt_reader_error(rd, "Unable to allocate memory for NBT list");
+                goto list_error_cleanup;
+            }
+            memcpy(elems.data + elems.length, &value, width);
+            elems.length += width;
+            ++list->length;
+
+            nbt_json_skip_space(rd);
+            if (nbt_json_at(rd, ',')) {
+                ++rd->cur;
+            } else if (nbt_json_at(rd, ']')) {
+                ++rd->cur;
+                break;
+            } else {
+                nbt_json_unexpected(rd, "',' or ']'");
+                goto list_error_cleanup;
+            }
+        }
+
+        list->data.raw = nbt_reader_alloc(rd, elems.length);
+        if (!list->data.raw) {
+            nbt_reader_error(rd, "Unable to allocate %zu bytes for NBT list", elems.length);
+            goto list_error_cleanup;
+        }
+        memcpy(list->data.raw, elems.data, elems.length);
+    }
+
+    nbt_buffer_free(&elems);
+    nbt_reader_leave(rd);
+    *out = list;
+    return 0;
+
+list_error_cleanup:
+    if (!rd->arena) {
+        /* hand the gathered elements to the list to be freed with it */
+        list->data.raw = elems.data;
+        elems.data = NULL;
+        nbt_free_list(list);
+    }
+    nbt_buffer_free(&elems);
+    nbt_reader_leave(rd);
+    return -1;
+}
+
+/* The "value" of a typed value of `type`, lists having `elemtype` elements */
+int nbt_json_read_value_as(struct nbt_json_parser *jp, nbt_type type, nbt_type elemtype, nbt_value *out) {
+    struct nbt_reader *rd = &jp->rd;
+
+    if (nbt_json_count(rd, type) < 0) return -1;
+
+    switch (type) {
+        case NBT_TAG_BYTE:
+        case NBT_TAG_SHORT:
+        case NBT_TAG_INT:
+        case NBT_TAG_LONG:
+        case NBT_TAG_FLOAT:
+        case NBT_TAG_DOUBLE:
+            return nbt_json_read_typed_number(jp, type, out);
+        case NBT_TAG_STRING:
+            if (nbt_json_expect_string(jp, "a string") < 0 || nbt_json_string_fits(jp) < 0) return -1;
+            return nbt_reader_make_string(rd, jp->text.data, jp->text.length, &out->tag_string);
+        case NBT_TAG_LIST:
+            return nbt_json_read_typed_list(jp, elemtype, &out->tag_list);
+        case NBT_TAG_COMPOUND:
+            return nbt_json_read_compound(jp, &out->tag_compound);
+        case NBT_TAG_BYTE_ARRAY:
+        case NBT_TAG_INT_ARRAY:
+        case NBT_TAG_LONG_ARRAY:
+            return nbt_json_read_array(jp, type, out);
+        default:
+            NBT_READ_FAIL(rd, "Invalid NBT tag type %#02hhx", type);
+    }
+}
+
+#define NBT_JSON_FIELD_IS(_jp, _name) \
+    ((_jp)->text.length == sizeof(_name) - 1 && memcmp((_jp)->text.data, _name, sizeof(_name) - 1) == 0)
+
+/* {"type": ..., "value": ...} with "element" for lists and, if `root` is
+ * set, an optional "name" to store in it; or with `listonly`, a list
+ * inside a list: {"element": ..., "value": [...]}. */
+int nbt_json_read_typed(struct nbt_json_parser *jp, bool listonly, struct nbt_parsed *root, nbt_type *type, nbt_value *out) {
+    struct nbt_reader *rd = &jp->rd;
+    nbt_type elemtype = NBT_TAG_END;
+    bool havetype = listonly, haveelem = false, havename = false;
+
+    if (nbt_json_expect(rd, '{', "a typed value") < 0) return -1;
+    if (listonly) *type = NBT_TAG_LIST;
+
+    while (true) {
+        nbt_json_skip_space(rd);
+        const unsigned char *at = rd->cur;
+        if (nbt_json_expect_string(jp, "a field") < 0 || nbt_json_expect(rd, ':', "':'") < 0) return -1;
+
+        if (!havetype && NBT_JSON_FIELD_IS(jp, "type")) {
+            if (nbt_json_read_type(jp, false, type) < 0) return -1;
+            havetype = true;
+        } else if (havetype && root && !havename && NBT_JSON_FIELD_IS(jp, "name")) {
+            if (nbt_json_expect_string(jp, "a string") < 0 || nbt_json_string_fits(jp) < 0) return -1;
+            root->name = nbt_reader_alloc(rd, jp->text.length + 1);
+            if (!root->name)
+                NBT_READ_FAIL(rd, "Failed to allocate space for NBT string");
+            memcpy(root->name, jp->text.data, jp->text.length);
+            root->name[jp->text.length] = '\0';
+            root->namelen = (nbt_strlen)jp->text.length;
+            havename = true;
+        } else if (havetype && *type == NBT_TAG_LIST && !haveelem && NBT_JSON_FIELD_IS(jp, "element")) {
+            if (nbt_json_read_type(jp, true, &elemtype) < 0) return -1;
+            haveelem = true;
+        } else if (havetype && (*type != NBT_TAG_LIST || haveelem) && NBT_JSON_FIELD_IS(jp, "value")) {
+            if (nbt_json_read_value_as(jp, *type, elemtype, out) < 0) return -1;
+            break;
+        } else {
+            rd->cur = at;
+            NBT_READ_FAIL(rd, "Unexpected field \"%.*s\" in typed JSON value", (int)jp->text.length, (const char *)jp->text.data);
+        }
+
+        if (nbt_json_expect(rd, ',', "','") < 0) return -1;
+    }
+
+    if (nbt_json_expect(rd, '}', "'}'") < 0) {
+        if (!rd->arena) nbt_free_value(*type, *out);
+        return -1;
+    }
+    return 0;
+}
+
+#undef NBT_JSON_FIELD_IS
+
+int nbt_json_read_value(struct nbt_json_parser *jp, nbt_type *type, nbt_value *out) {
+    return jp->typed ? nbt_json_read_typed(jp, false, NULL, type, out) : nbt_json_read_plain(jp, type, out);
+}
+
+int nbt_json_read(const char *text, size_t length, struct nbt_parsed *result, const struct nbt_json_options *options) {
+    struct nbt_read_options ropts = {
+        .error = options ? options->error : NULL,
+        .limits = options ? options->limits : (struct nbt_limits){ 0 },
+    };
+    struct nbt_json_parser jp;
+    struct nbt_reader *rd = &jp.rd;
+    nbt_type type;
+    nbt_value root = { .tag_compound = NULL };
+    int ret = -1;
+
+    nbt_reader_init(rd, (const unsigned char *)text, length, &ropts);
+    rd->filter.active = false;
+    jp.text = (struct nbt_buffer){ NULL, 0, 0 };
+    jp.num = (struct nbt_buffer){ NULL, 0, 0 };
+    jp.typed = options && options->typed;
+
+    NBT_TRACE_EVENT(NBT_TRACE_PARSE, true, length);
+    memset(result, 0, sizeof(struct nbt_parsed));
+
+    if (jp.typed) {
+        if (nbt_json_read_typed(&jp, false, result, &type, &root) < 0) goto parse_error_cleanup;
+        if (type != NBT_TAG_COMPOUND) {
+            if (!rd->arena) nbt_free_value(type, root);
+            rd->cur = rd->start;
+            nbt_reader_error(rd, "Root tag is not TAG_COMPOUND (%#02hhx)", type);
+            goto parse_error_cleanup;
+        }
+    } else {
+        nbt_json_skip_space(rd);
+        if (!nbt_json_at(rd, '{')) {
+            nbt_json_unexpected(rd, "'{'");
+            goto parse_error_cleanup;
+        }
+        if (nbt_json_read_plain(&jp, &type, &root) < 0) goto parse_error_cleanup;
+    }
+
+    nbt_json_skip_space(rd);
+    if (rd->cur != rd->end) {
+        nbt_json_unexpected(rd, "the end of input");
+        NBT_READER_FREE(rd, compound, root.tag_compound);
+        goto parse_error_cleanup;
+    }
+
+    if (!result->name) {
+        result->name = nbt_reader_alloc(rd, 1);
+        if (!result->name) {
+            NBT_READER_FREE(rd, compound, root.tag_compound);
+            nbt_reader_error(rd, "Failed to allocate space for NBT string");
+            goto parse_error_cleanup;
+        }
+        result->name[0] = '\0';
+    }
+
+    result->root = root.tag_compound;
+    ret = 0;
+    goto parse_done;
+
+parse_error_cleanup:
+    nbt_reader_report(rd, ropts.error);
+
+    if (!rd->arena) free(result->name);
+    result->name = NULL;
+    result->namelen = 0;
+
+parse_done:
+    nbt_buffer_free(&jp.text);
+    nbt_buffer_free(&jp.num);
+    NBT_TRACE_EVENT(NBT_TRACE_PARSE, false, ret < 0 ? 0 : (size_t)(rd->cur - rd->start));
+    return ret;
+}
+
+int nbt_json_read_file(FILE *file, struct nbt_parsed *result, const struct nbt_json_options *options) {
+    unsigned char *data;
+    size_t length;
+
+    if (nbt_read_whole_file(file, &data, &length) < 0) {
+        nbt_fill_error(options ? options->error : NULL, 0, "");
+        memset(result, 0, sizeof(struct nbt_parsed));
+        return -1;
+    }
+
+    int ret = nbt_json_read((const char *)data, length, result, options);
+    free(data);
+    return ret;
+}
@@ -0,0 +1,316 @@
+#include "nbt_lazy.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct nbt_lazy_entry;
+
+/* A value in the input. Compounds and lists are scanned (entries or
+ * elements located, values skipped) the first time a path goes through
+ * them; `tag` is filled in the first time the value itself is asked for. */
+struct nbt_lazy_node {
+    nbt_type type;
+    bool scanned;
+    const unsigned char *pos; /* first byte of the payload */
+    struct nbt_tag *tag;
+
+    nbt_type elemtype;        /* lists only */
+    uint32_t count;
+    struct nbt_lazy_entry *entries;
+    struct nbt_lazy_node *elems;
+};
+
+struct nbt_lazy_entry {
+    const char *name;         /* points into the input */
+    nbt_strlen namelen;
+    uint32_t hash;
+    struct nbt_lazy_node node;
+};
+
+struct nbt_lazy {
+    const unsigned char *data;
+    size_t length;
+
+    struct nbt_read_options options; /* arena always set, paths cleared */
+    bool ownarena;
+
+    const char *name;
+    nbt_strlen namelen;
+    struct nbt_lazy_node root;
+};
+
+#define NBT_LAZY_SCAN_MIN (16)
+
+int nbt_lazy_scan_compound(struct nbt_lazy *doc, struct nbt_reader *rd, struct nbt_lazy_node *node) {
+    struct nbt_lazy_entry *entries = NULL;
+    size_t count = 0, cap = 0;
+
+    rd->cur = node->pos;
+
+    while (true) {
+        nbt_type type;
+        nbt_strlen namelen;
+
+        if (nbt_read_type(rd, &type) < 0) goto scan_error_cleanup;
+        if (type == NBT_TAG_END) break;
+
+        if (nbt_read_strlen(rd, &namelen) < 0) goto scan_error_cleanup;
+        if (NBT_READER_LEFT(rd) < namelen) {
+            nbt_reader_error(rd, "Unexpected end of input reading NBT name: %zu < %zu", NBT_READER_LEFT(rd), (size_t)namelen);
+            goto scan_error_cleanup;
+        }
+
+        const char *name = (const char *)rd->cur;
+        rd->cur += namelen;
+
+        if (count == cap) {
+            size_t newcap = cap ? cap * 2 : NBT_LAZY_SCAN_MIN;
+            struct nbt_lazy_entry *temp = realloc(entries, newcap * sizeof(struct nbt_lazy_entry));
+            if (!temp) {
+                nbt_reader_error(rd, "Unable to allocate memory for NBT compound scan");
+                goto scan_error_cleanup;
+            }
+            entries = temp;
+            cap = newcap;
+        }
+
+        entries[count++] = (struct nbt_lazy_entry){
+            .name = name,
+            .namelen = namelen,
+            .hash = nbt_hash_name(name, namelen),
+            .node = { .type = type, .pos = rd->cur },
+        };
+
+        if (nbt_skip_value(rd, type) < 0) {
+            nbt_reader_error_name(rd, name, namelen);
+            goto scan_error_cleanup;
+        }
+    }
+
+    /* the scan is kept for the life of the document: move it to the arena */
+    if (count > 0) {
+        node->entries = nbt_arena_alloc(doc->options.arena, count * sizeof(struct nbt_lazy_entry));
+        if (!node->entries) {
+            nbt_reader_error(rd, "Unable to allocate memory for NBT compound scan");
+            goto scan_error_cleanup;
+        }
+        memcpy(node->entries, entries, count * sizeof(struct nbt_lazy_entry));
+    }
+
+    free(entries);
+    node->count = (uint32_t)count;
+    node->scanned = true;
+    return 0;
+
+scan_error_cleanup:
+    free(entries);
+    return -1;
+}
+
+int nbt_lazy_scan_list(struct nbt_lazy *doc, struct nbt_reader *rd, struct nbt_lazy_node *node) {
+    nbt_int length;
+
+    rd->cur = node->pos;
+    if (nbt_skip_list_header(rd, &node->elemtype, &length) < 0) return -1;
+
+    /* numbers have no nodes; such lists can only be taken whole */
+    if (length > 0 && node->elemtype > NBT_TAG_DOUBLE) {
+        /* every element takes at least one byte, so this bounds the allocation */
+        if (NBT_READER_LEFT(rd) < (size_t)length)
+            NBT_READ_FAIL(rd, "Unexpected end of input reading NBT list: %zu < %d", NBT_READER_LEFT(rd), length);
+
+        node->elems = nbt_arena_alloc(doc->options.arena, (size_t)length * sizeof(struct nbt_lazy_node));
+        if (!node->elems)
+            NBT_READ_FAIL(rd, "Unable to allocate memory for NBT list scan");
+
+        for (nbt_int i = 0; i < length; ++i) {
+            node->elems[i] = (struct nbt_lazy_node){ .type = node->elemtype, .pos = rd->cur };
+            if (nbt_skip_value(rd, node->elemtype) < 0) {
+                nbt_reader_error_index(rd, i);
+                return -1;
+            }
+        }
+    }
+
+    node->count = (uint32_t)length;
+    node->scanned = true;
+    return 0;
+}
+
+/* Scans `node` if it has not been yet; `path` names it, for errors. */
+int nbt_lazy_scan(struct nbt_lazy *doc, struct nbt_lazy_node *node, const char *path, size_t pathlen) {
+    struct nbt_reader rd;
+    int ret;
+
+    if (node->scanned) return 0;
+
+    nbt_reader_init(&rd, doc->data, doc->length, &doc->options);
+    ret = node->type == NBT_TAG_LIST ? nbt_lazy_scan_list(doc, &rd, node) : nbt_lazy_scan_compound(doc, &rd, node);
+
+    if (ret < 0) {
+        if (pathlen > 0) nbt_reader_error_path(&rd, path, pathlen);
+        nbt_reader_report(&rd, doc->options.error);
+    }
+
+    return ret;
+}
+
+struct nbt_lazy_node *nbt_lazy_find(struct nbt_lazy_node *node, const char *name, size_t namelen) {
+    uint32_t hash = nbt_hash_name(name, (nbt_strlen)namelen);
+
+    for (uint32_t i = 0; i < node->count; ++i) {
+        struct nbt_lazy_entry *entry = &node->entries[i];
+        if (entry->hash == hash && entry->namelen == namelen && memcmp(entry->name, name, namelen) == 0)
+            return &entry->node;
+    }
+
+    return NULL;
+}
+
+/* Fails a lookup for a reason that is not in the input. */
+#define NBT_LAZY_FAIL(_doc, _node, _path, _fmt, ...)                                   \
+do {                                                                                   \
+    nbt_set_error(_fmt, ## __VA_ARGS__);                                               \
+    nbt_fill_error((_doc)->options.error, (size_t)((_node)->pos - (_doc)->data), _path); \
+    return NULL;                                                                       \
+} while (0)
+
+struct nbt_lazy *nbt_lazy_open(const unsigned char *data, size_t length, const struct nbt_read_options *options) {
+    struct nbt_lazy *doc = malloc(sizeof(struct nbt_lazy));
+    struct nbt_reader rd;
+    nbt_type roottype;
+
+    if (!doc) {
+        nbt_set_error("Unable to allocate memory for lazy NBT document");
+        nbt_fill_error(options ? options->error : NULL, 0, "");
+        return NULL;
+    }
+
+    memset(doc, 0, sizeof(struct nbt_lazy));
+    doc->data = data;
+    doc->length = length;
+    if (options) doc->options = *options;
+    doc->options.paths = NULL;
+    doc->options.npaths = 0;
+    doc->options.stats = NULL;
+
+    if (!doc->options.arena) {
+        doc->options.arena = nbt_arena_new(0);
+        if (!doc->options.arena) {
+            nbt_set_error("Unable to allocate memory for lazy NBT document");
+            nbt_fill_error(doc->options.error, 0, "");
+            free(doc);
+            return NULL;
+        }
+        doc->ownarena = true;
+    }
+
+    nbt_reader_init(&rd, data, length, &doc->options);
+
+    if (nbt_read_type(&rd, &roottype) < 0)
+        goto open_error_cleanup;
+
+    if (roottype != NBT_TAG_COMPOUND) {
+        nbt_reader_error(&rd, "Root tag is not TAG_COMPOUND (%#02hhx)", roottype);
+        goto open_error_cleanup;
+    }
+
+    if (nbt_read_strlen(&rd, &doc->namelen) < 0)
+        goto open_error_cleanup;
+    if (NBT_READER_LEFT(&rd) < doc->namelen) {
+        nbt_reader_error(&rd, "Unexpected end of input reading NBT name: %zu < %zu", NBT_READER_LEFT(&rd), (size_t)doc->namelen);
+        goto open_error_cleanup;
+    }
+
+    doc->name = (const char *)rd.cur;
+    doc->root.type = NBT_TAG_COMPOUND;
+    doc->root.pos = rd.cur + doc->namelen;
+
+    return doc;
+
+open_error_cleanup:
+    nbt_reader_report(&rd, doc->options.error);
+    nbt_lazy_close(doc);
+    return NULL;
+}
+
+void nbt_lazy_close(struct nbt_lazy *doc) {
+    if (!doc) return;
+
+    if (doc->ownarena) nbt_arena_free(doc->options.arena);
+    free(doc);
+}
+
+const char *nbt_lazy_name(const struct nbt_lazy *doc, nbt_strlen *namelen) {
+    *namelen = doc->namelen;
+    return doc->name;
+}
+
+struct nbt_tag *nbt_lazy_get(struct nbt_lazy *doc, const char *path) {
+    struct nbt_lazy_node *node = &doc->root;
+    const char *p = path;
+
+    while (*p) {
+        if (p != path && *p++ != '.')
+            NBT_LAZY_FAIL(doc, node, path, "Malformed NBT path \"%s\"", path);
+
+        size_t namelen = strcspn(p, ".[");
+        if (namelen == 0 || namelen > UINT16_MAX)
+            NBT_LAZY_FAIL(doc, node, path, "Malformed NBT path \"%s\"", path);
+        if (node->type != NBT_TAG_COMPOUND)
+            NBT_LAZY_FAIL(doc, node, path, "%.*s is not a compound", (int)(p - 1 - path), path);
+        if (nbt_lazy_scan(doc, node, path, p > path ? (size_t)(p - 1 - path) : 0) < 0)
+            return NULL;
+
+        struct nbt_lazy_node *next = nbt_lazy_find(node, p, namelen);
+        if (!next)
+            NBT_LAZY_FAIL(doc, node, path, "No tag named %.*s", (int)namelen, p);
+
+        node = next;
+        p += namelen;
+
+        while (*p == '[') {
+            char *end;
+            long index = strtol(p + 1, &end, 10);
+            if (end == p + 1 || *end != ']')
+                NBT_LAZY_FAIL(doc, node, path, "Malformed NBT path \"%s\"", path);
+            if (node->type != NBT_TAG_LIST)
+                NBT_LAZY_FAIL(doc, node, path, "%.*s is not a list", (int)(p - path), path);
+            if (nbt_lazy_scan(doc, node, path, (size_t)(p - path)) < 0)
+                return NULL;
+            if (node->count > 0 && !node->elems)
+                NBT_LAZY_FAIL(doc, node, path, "%.*s is a list of numbers and can only be taken whole", (int)(p - path), path);
+            if (index < 0 || index >= (long)node->count)
+                NBT_LAZY_FAIL(doc, node, path, "Index %ld out of range for %.*s (length %u)", index, (int)(p - path), path, node->count);
+
+            node = &node->elems[index];
+            p = end + 1;
+        }
+    }
+
+    if (!node->tag) {
+        struct nbt_reader rd;
+        struct nbt_tag *tag = nbt_arena_alloc(doc->options.arena, sizeof(struct nbt_tag));
+        if (!tag)
+            NBT_LAZY_FAIL(doc, node, path, "Unable to allocate memory for NBT tag");
+
+        nbt_reader_init(&rd, doc->data, doc->length, &doc->options);
+        rd.cur = node->pos;
+
+        tag->type = node->type;
+        if (nbt_read_value(&rd, node->type, &tag->value) < 0) {
+            if (*path) nbt_reader_error_path(&rd, path, strlen(path));
+            nbt_reader_report(&rd, doc->options.error);
+            return NULL;
+        }
+
+        node->tag = tag;
+    }
+
+    return node->tag;
+}
@@ -1,29 +1,114 @@
 #include "nbt.h"
 #include "nbt_def.h"
+#include "nbt_internal.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <sys/mman.h>
+
+/* A compound or list whose children are being freed. */
+struct nbt_free_frame {
+    nbt_type type;
+    union {
+        struct nbt_compound *compound;
+        struct nbt_list *list;
+    } node;
+    struct nbt_compound_entry *next; /* compounds: next entry to free */
+    nbt_int index;                   /* lists: next element to free */
+};
+
+/* Frames kept on the C stack; deeper trees move them to the heap. */
+#define NBT_FREE_FRAMES (32)
+
+/* Walks the tree with an explicit stack instead of recursing, freeing each
+ * container after its children. If the stack cannot grow, the subtree that
+ * needed it is leaked rather than risking the C stack. */
 void nbt_free_value(nbt_type type, nbt_value value) {
-    switch (type) {
-        case NBT_TAG_BYTE_ARRAY:
-            nbt_free_byte_array(value.tag_byte_array);
-            break;
-        case NBT_TAG_STRING:
-            nbt_free_string(value.tag_string);
-            break;
-        case NBT_TAG_LIST:
-            nbt_free_list(value.tag_list);
-            break;
-        case NBT_TAG_COMPOUND:
-            nbt_free_compound(value.tag_compound);
-            break;
-        case NBT_TAG_INT_ARRAY:
-            nbt_free_int_array(value.tag_int_array);
-            break;
-        case NBT_TAG_LONG_ARRAY:
-            nbt_free_long_array(value.tag_long_array);
-            break;
+    struct nbt_free_frame frames[NBT_FREE_FRAMES];
+    struct nbt_free_frame *stack = frames, *top = NULL;
+    size_t depth = 0, capacity = NBT_FREE_FRAMES;
+
+    while (true) {
+        switch (type) {
+            case NBT_TAG_BYTE_ARRAY:
+                nbt_free_byte_array(value.tag_byte_array);
+                break;
+            case NBT_TAG_STRING:
+                nbt_free_string(value.tag_string);
+                break;
+            case NBT_TAG_INT_ARRAY:
+                nbt_free_int_array(value.tag_int_array);
+                break;
+            case NBT_TAG_LONG_ARRAY:
+                nbt_free_long_array(value.tag_long_array);
+                break;
+            case NBT_TAG_LIST:
+            case NBT_TAG_COMPOUND:
+                if (!value.tag_list) break;
+
+                /* numeric lists are a flat buffer; everything else is an array of pointers */
+                if (type == NBT_TAG_LIST && (value.tag_list->type < NBT_TAG_BYTE_ARRAY || !value.tag_list->data.raw)) {
+                    free(value.tag_list->data.raw);
+                    free(value.tag_list);
+                    break;
+                }
+
+                if (depth == capacity) {
+                    struct nbt_free_frame *temp = stack == frames ? malloc(capacity * 2 * sizeof(struct nbt_free_frame))
+                                                                  : realloc(stack, capacity * 2 * sizeof(struct nbt_free_frame));
+                    if (!temp) break;
+                    if (stack == frames) memcpy(temp, frames, sizeof(frames));
+                    stack = temp;
+                    capacity *= 2;
+                }
+
+                top = &stack[depth++];
+                *top = (struct nbt_free_frame){ .type = type };
+                if (type == NBT_TAG_LIST) {
+                    top->node.list = value.tag_list;
+                } else {
+                    top->node.compound = value.tag_compound;
+                    top->next = value.tag_compound->first;
+                }
+                break;
+        }
+
+        /* the next child of the top container, freeing finished ones */
+        while (depth > 0) {
+            if (top->type == NBT_TAG_LIST) {
+                struct nbt_list *list = top->node.list;
+                if (top->index < list->length) {
+                    type = list->type;
+                    value = nbt_list_get(list, top->index++);
+                    break;
+                }
+
+                free(list->data.raw);
+                free(list);
+            } else {
+                struct nbt_compound_entry *entry = top->next;
+                if (entry) {
+                    top->next = entry->next;
+                    type = entry->tag.type;
+                    value = entry->tag.value;
+                    free(entry->name);
+                    free(entry);
+                    break;
+                }
+
+                free(top->node.compound->index);
+                free(top->node.compound);
+            }
+
+            top = --depth > 0 ? &stack[depth - 1] : NULL;
+        }
+
+        if (depth == 0) break;
     }
+
+    if (stack != frames) free(stack);
 }
 
 void nbt_free_tag(struct nbt_tag *tag) {
@@ -45,27 +130,11 @@ void nbt_free_string(struct nbt_string *str) {
 }
 
 void nbt_free_list(struct nbt_list *list) {
-    if (!list) return;
-
-    for (struct nbt_list_entry *cur = list->first, *temp; cur; cur = temp) {
-        temp = cur->next;
-        nbt_free_value(list->type, cur->value);
-        free(cur);
-    }
-
-    free(list);
+    nbt_free_value(NBT_TAG_LIST, (nbt_value){ .tag_list = list });
 }
 
 void nbt_free_compound(struct nbt_compound *compound) {
-    if (!compound) return;
-    for (struct nbt_compound_entry *cur = compound->first, *temp; cur; cur = temp) {
-        temp = cur->next;
-        nbt_free_value(cur->tag.type, cur->tag.value);
-        free(cur->name);
-        free(cur);
-    }
-
-    free(compound);
+    nbt_free_value(NBT_TAG_COMPOUND, (nbt_value){ .tag_compound = compound });
 }
 
 void nbt_free_int_array(struct nbt_int_array *array) {
@@ -79,3 +148,25 @@ void nbt_free_long_array(struct nbt_long_array *array) {
     free(array->buf);
     free(array);
 }
+
+void nbt_free_parsed(struct nbt_parsed *parsed) {
+    if (!parsed) return;
+
+    NBT_TRACE_EVENT(NBT_TRACE_FREE, true, 0);
+
+    if (!parsed->arena) {
+        free(parsed->name);
+        nbt_free_compound(parsed->root);
+    }
+
+    if (parsed->map) munmap(parsed->map, parsed->maplen);
+
+    NBT_TRACE_EVENT(NBT_TRACE_FREE, false, 0);
+
+    parsed->namelen = 0;
+    parsed->name = NULL;
+    parsed->root = NULL;
+    parsed->arena = NULL;
+    parsed->map = NULL;
+    parsed->maplen = 0;
+}
@@ -0,0 +1,158 @@
+#include "nbt_pool.h"
+#include "nbt_internal.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* A batch is a range of indices handed out one at a time from an atomic
+ * counter, so fast and slow items balance across threads by themselves.
+ * The submitting thread works on the batch too. */
+struct nbt_pool_worker {
+    struct nbt_pool *pool;
+    pthread_t thread;
+    unsigned id;              /* 1..nworkers; the submitting thread is 0 */
+};
+
+struct nbt_pool {
+    unsigned nworkers;        /* threads spawned; one less than requested */
+    struct nbt_pool_worker *workers;
+
+    pthread_mutex_t submit;   /* one batch at a time */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+
+    /* current batch */
+    nbt_pool_fn fn;
+    void *ctx;
+    size_t count;
+    atomic_size_t next;
+    unsigned busy;            /* workers yet to finish it */
+    uint64_t generation;
+    bool stop;
+};
+
+void nbt_pool_work(struct nbt_pool *pool, unsigned thread) {
+    size_t i;
+    while ((i = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed)) < pool->count)
+        pool->fn(pool->ctx, i, thread);
+}
+
+void *nbt_pool_main(void *arg) {
+    struct nbt_pool_worker *worker = arg;
+    struct nbt_pool *pool = worker->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->stop && pool->generation == seen)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->stop) break;
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        nbt_pool_work(pool, worker->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+struct nbt_pool *nbt_pool_new(unsigned threads) {
+    if (threads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+
+    struct nbt_pool *pool = calloc(1, sizeof(struct nbt_pool));
+    if (!pool) {
+        nbt_set_error("Unable to allocate memory for thread pool");
+        return NULL;
+    }
+
+    pool->workers = calloc(threads, sizeof(struct nbt_pool_worker));
+    if (!pool->workers) {
+        nbt_set_error("Unable to allocate memory for thread pool");
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->submit, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (unsigned i = 0; i + 1 < threads; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i + 1;
+        if (pthread_create(&pool->workers[i].thread, NULL, &nbt_pool_main, &pool->workers[i]) != 0) {
+            nbt_set_error("Failed to start thread pool worker %u", i);
+            nbt_pool_free(pool);
+            return NULL;
+        }
+        ++pool->nworkers;
+    }
+
+    return pool;
+}
+
+unsigned nbt_pool_threads(const struct nbt_pool *pool) {
+    return pool->nworkers + 1;
+}
+
+void nbt_pool_free(struct nbt_pool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->nworkers; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->submit);
+
+    free(pool->workers);
+    free(pool);
+}
+
+void nbt_pool_run(struct nbt_pool *pool, size_t count, nbt_pool_fn fn, void *ctx) {
+    if (!pool) {
+        for (size_t i = 0; i < count; ++i) fn(ctx, i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->submit);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->count = count;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    pool->busy = pool->nworkers;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    nbt_pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->submit);
+}
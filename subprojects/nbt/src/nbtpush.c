@@ -0,0 +1,945 @@
+#include "nbt_push.h"
+#include "nbt_sax.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_endian.h"
+#include "nbt_internal.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The parser is a loop over `state`, where each state waits for one field
+ * (a type byte, a length, a name, a number, a run of array elements) and
+ * returns NBT_PUSH_MORE when the input ends first. A field cut off by the
+ * end of a feed is gathered in `partial` and finished by the next feed;
+ * everything else is decoded straight from the caller's buffer. Open
+ * compounds and lists live on `frames`, so nesting costs heap, not stack. */
+
+enum {
+    NBT_PUSH_ST_ROOT_TYPE,
+    NBT_PUSH_ST_ROOT_NAMELEN,
+    NBT_PUSH_ST_ROOT_NAME,
+    NBT_PUSH_ST_ENTRY_TYPE,
+    NBT_PUSH_ST_ENTRY_NAMELEN,
+    NBT_PUSH_ST_ENTRY_NAME,
+    NBT_PUSH_ST_VALUE,       /* start of a value of `type` */
+    NBT_PUSH_ST_STRING,      /* `namelen` bytes of string value */
+    NBT_PUSH_ST_ELEMENTS,    /* `left` bytes of array or numeric list elements */
+    NBT_PUSH_ST_DONE,
+    NBT_PUSH_ST_FAILED,
+};
+
+struct nbt_push_frame {
+    nbt_type type;           /* TAG_Compound or TAG_List */
+    nbt_type elemtype;       /* lists */
+    bool quiet;              /* skipped by the handler: no events inside */
+    bool haskey;             /* compounds: reading the value of the key */
+    nbt_int length;          /* lists: elements, and the one being read */
+    nbt_int index;
+    size_t keyoff;           /* the key in `keys`, for error paths */
+    nbt_strlen keylen;
+};
+
+struct nbt_push_tree;
+
+struct nbt_push {
+    const struct nbt_sax_handler *h;
+    struct nbt_error *error;
+
+    struct nbt_push_tree *tree; /* tree parsers: the builder behind `h` */
+    struct nbt_sax_handler treeh;
+
+    unsigned maxdepth;
+
+    int state;
+    nbt_type type;           /* value being read */
+    bool quiet;              /* ...and whether its events are suppressed */
+    nbt_strlen namelen;      /* name or string being read */
+
+    /* NBT_PUSH_ST_ELEMENTS */
+    nbt_type arraytype;      /* type for the end event */
+    nbt_type elemtype;
+    size_t width;
+    size_t left;
+
+    struct nbt_push_frame *frames;
+    size_t nframes;
+    size_t framecap;
+    struct nbt_buffer keys;
+
+    /* the current feed, and the bytes consumed by earlier ones */
+    const unsigned char *start;
+    const unsigned char *cur;
+    const unsigned char *end;
+    size_t base;
+
+    struct nbt_buffer partial;
+
+    struct nbt_read_error err;
+    unsigned char chunk[NBT_SAX_CHUNK_BYTES];
+};
+
+#define NBT_PUSH_LEFT(_p) ((size_t)((_p)->end - (_p)->cur))
+
+/* Evaluates to the callback's verdict, or NBT_SAX_CONTINUE if it is unset
+ * or the value is being skipped. */
+#define NBT_PUSH_CALL(_p, _quiet, _cb, ...) \
+    ((_quiet) || !(_p)->h->_cb ? NBT_SAX_CONTINUE : (_p)->h->_cb((_p)->h->user, ## __VA_ARGS__))
+
+#define NBT_PUSH_CHECK(_expr)                         \
+do {                                                  \
+    int _r = (_expr);                                 \
+    if (_r < 0 || _r == NBT_SAX_ABORT) return _r;     \
+} while (0)
+
+int nbt_push_fail(struct nbt_push *p, const char *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    vsnprintf(p->err.message, NBT_ERROR_MSG_SZ, fmt, va);
+    va_end(va);
+
+    p->err.offset = p->base + (size_t)(p->cur - p->start);
+    return -1;
+}
+
+/* Publishes the failure with the path of open frames, built innermost
+ * first as the recursive readers do while unwinding. */
+void nbt_push_report(struct nbt_push *p) {
+    struct nbt_reader rd;
+
+    memset(&rd, 0, sizeof(rd));
+    rd.err = p->err;
+    rd.err.pathlen = 0;
+    rd.err.truncated = false;
+
+    for (size_t i = p->nframes; i-- > 0; ) {
+        const struct nbt_push_frame *f = &p->frames[i];
+        if (f->type == NBT_TAG_LIST)
+            nbt_reader_error_index(&rd, f->index);
+        else if (f->haskey)
+            nbt_reader_error_name(&rd, (const char *)p->keys.data + f->keyoff, f->keylen);
+    }
+
+    nbt_reader_report(&rd, p->error);
+}
+
+/* Makes the next `n` bytes available contiguously at *out: in place when
+ * the current feed holds all of them, else gathered in `partial` across
+ * feeds. Returns false if the input runs out first. */
+bool nbt_push_take(struct nbt_push *p, size_t n, const unsigned char **out) {
+    if (p->partial.length == 0 && NBT_PUSH_LEFT(p) >= n) {
+        *out = p->cur;
+        p->cur += n;
+        return true;
+    }
+
+    size_t want = n - p->partial.length;
+    size_t got = NBT_PUSH_LEFT(p) < want ? NBT_PUSH_LEFT(p) : want;
+
+    /* reserved up front, so appending cannot fail; see nbt_push_need() */
+    memcpy(p->partial.data + p->partial.length, p->cur, got);
+    p->partial.length += got;
+    p->cur += got;
+
+    if (p->partial.length < n) return false;
+
+    *out = p->partial.data;
+    p->partial.length = 0;
+    return true;
+}
+
+/* Makes room for a cut-off field of `n` bytes before nbt_push_take(). */
+static inline int nbt_push_need(struct nbt_push *p, size_t n) {
+    if (p->partial.capacity >= n || NBT_PUSH_LEFT(p) >= n) return 0;
+    if (nbt_buffer_reserve(&p->partial, n - p->partial.length) < 0)
+        return nbt_push_fail(p, "Unable to allocate %zu bytes for NBT field", n);
+    return 0;
+}
+
+#define NBT_PUSH_TAKE(_p, _n, _out)                         \
+do {                                                        \
+    if (nbt_push_need(_p, _n) < 0) return -1;               \
+    if (!nbt_push_take(_p, _n, _out)) return NBT_PUSH_MORE; \
+} while (0)
+
+static inline uint16_t nbt_push_u16(const unsigned char *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return nbt_endian_be2h_u16(v);
+}
+
+static inline int32_t nbt_push_s32(const unsigned char *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return nbt_endian_be2h_s32(v);
+}
+
+int nbt_push_frame(struct nbt_push *p, nbt_type type, nbt_type elemtype, nbt_int length, bool quiet) {
+    if (p->nframes == p->framecap) {
+        size_t cap = p->framecap ? p->framecap * 2 : 16;
+        struct nbt_push_frame *temp = realloc(p->frames, cap * sizeof(struct nbt_push_frame));
+        if (!temp) return nbt_push_fail(p, "Unable to allocate memory for NBT parser stack");
+        p->frames = temp;
+        p->framecap = cap;
+    }
+
+    p->frames[p->nframes++] = (struct nbt_push_frame){
+        .type = type,
+        .elemtype = elemtype,
+        .quiet = quiet,
+        .length = length,
+        .keyoff = p->keys.length,
+    };
+    return 0;
+}
+
+/* Moves on from a finished value: to the next list element, the next
+ * compound entry, or the end of the document, closing finished lists. */
+int nbt_push_value_done(struct nbt_push *p) {
+    while (p->nframes > 0) {
+        struct nbt_push_frame *f = &p->frames[p->nframes - 1];
+
+        if (f->type == NBT_TAG_COMPOUND) {
+            f->haskey = false;
+            p->state = NBT_PUSH_ST_ENTRY_TYPE;
+            return NBT_SAX_CONTINUE;
+        }
+
+        if (++f->index < f->length) {
+            p->type = f->elemtype;
+            p->quiet = f->quiet;
+            p->state = NBT_PUSH_ST_VALUE;
+            return NBT_SAX_CONTINUE;
+        }
+
+        bool quiet = f->quiet;
+        --p->nframes;
+        if (NBT_PUSH_CALL(p, quiet, end, NBT_TAG_LIST) == NBT_SAX_ABORT) return NBT_SAX_ABORT;
+    }
+
+    p->state = NBT_PUSH_ST_DONE;
+    return NBT_SAX_CONTINUE;
+}
+
+/* Starts streaming `count` elements; also used for numeric lists. */
+int nbt_push_elements(struct nbt_push *p, nbt_type arraytype, nbt_type elemtype, nbt_int count, bool quiet) {
+    p->arraytype = arraytype;
+    p->elemtype = elemtype;
+    p->width = nbt_type_size(elemtype);
+    p->left = (size_t)count * p->width;
+    p->quiet = quiet;
+    p->state = NBT_PUSH_ST_ELEMENTS;
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_push_run_elements(struct nbt_push *p) {
+    const unsigned char *field;
+    size_t width = p->width;
+
+    while (p->left > 0) {
+        /* nobody is listening: step over the bytes */
+        if (p->quiet || !p->h->array_chunk) {
+            size_t n = NBT_PUSH_LEFT(p) < p->left ? NBT_PUSH_LEFT(p) : p->left;
+            p->cur += n;
+            p->left -= n;
+            if (p->left > 0) return NBT_PUSH_MORE;
+            break;
+        }
+
+        const void *data;
+        size_t n;
+
+        if (p->partial.length > 0 || NBT_PUSH_LEFT(p) < width) {
+            /* an element cut off by the end of a feed */
+            NBT_PUSH_TAKE(p, width, &field);
+            memcpy(p->chunk, field, width);
+            n = width;
+        } else {
+            n = NBT_PUSH_LEFT(p) < p->left ? NBT_PUSH_LEFT(p) : p->left;
+            if (n > NBT_SAX_CHUNK_BYTES) n = NBT_SAX_CHUNK_BYTES;
+            n -= n % width;
+
+            if (width > 1) memcpy(p->chunk, p->cur, n);
+            field = p->cur;
+            p->cur += n;
+        }
+
+        /* bytes need no conversion and are handed over in place */
+        if (width > 1) {
+            nbt_endian_be2h_array(p->chunk, n / width, width);
+            data = p->chunk;
+        } else {
+            data = field;
+        }
+
+        p->left -= n;
+        if (p->h->array_chunk(p->h->user, p->elemtype, data, n / width) == NBT_SAX_ABORT)
+            return NBT_SAX_ABORT;
+    }
+
+    if (NBT_PUSH_CALL(p, p->quiet, end, p->arraytype) == NBT_SAX_ABORT) return NBT_SAX_ABORT;
+    return nbt_push_value_done(p);
+}
+
+int nbt_push_run_value(struct nbt_push *p) {
+    const unsigned char *field;
+    nbt_value value;
+    nbt_int len;
+    int r;
+
+    switch (p->type) {
+#define O(_ctype, _uname, _lname)                                          \
+        case NBT_TAG_ ## _uname:                                           \
+            NBT_PUSH_TAKE(p, sizeof(_ctype), &field);                      \
+            memcpy(&value.tag_ ## _lname, field, sizeof(_ctype));          \
+            value.tag_ ## _lname = nbt_endian_be2h_ ## _lname(value.tag_ ## _lname); \
+            break;
+
+        NBT_FOREACH_INT_TYPE(O)
+#undef O
+        case NBT_TAG_FLOAT: {
+            uint32_t bits;
+            NBT_PUSH_TAKE(p, sizeof(bits), &field);
+            memcpy(&bits, field, sizeof(bits));
+            bits = nbt_endian_be2h_u32(bits);
+            memcpy(&value.tag_float, &bits, sizeof(bits));
+            break;
+        }
+        case NBT_TAG_DOUBLE: {
+            uint64_t bits;
+            NBT_PUSH_TAKE(p, sizeof(bits), &field);
+            memcpy(&bits, field, sizeof(bits));
+            bits = nbt_endian_be2h_u64(bits);
+            memcpy(&value.tag_double, &bits, sizeof(bits));
+            break;
+        }
+        case NBT_TAG_STRING:
+            NBT_PUSH_TAKE(p, 2, &field);
+            p->namelen = nbt_push_u16(field);
+            p->state = NBT_PUSH_ST_STRING;
+            return NBT_SAX_CONTINUE;
+
+#define NBT_PUSH_ARRAY(_uname, _elem)                                                    \
+        case NBT_TAG_ ## _uname ## _ARRAY:                                               \
+            NBT_PUSH_TAKE(p, 4, &field);                                                 \
+            len = nbt_push_s32(field);                                                   \
+            if (len < 0)                                                                 \
+                return nbt_push_fail(p, "NBT array has negative length: %d", len);       \
+            r = NBT_PUSH_CALL(p, p->quiet, begin_array, p->type, len);                   \
+            if (r == NBT_SAX_ABORT) return r;                                            \
+            return nbt_push_elements(p, p->type, NBT_TAG_ ## _elem, len, p->quiet || r == NBT_SAX_SKIP);
+
+        NBT_PUSH_ARRAY(BYTE, BYTE)
+        NBT_PUSH_ARRAY(INT, INT)
+        NBT_PUSH_ARRAY(LONG, LONG)
+#undef NBT_PUSH_ARRAY
+
+        case NBT_TAG_LIST: {
+            if (p->nframes >= p->maxdepth)
+                return nbt_push_fail(p, "NBT data is nested deeper than %u levels", p->maxdepth);
+
+            NBT_PUSH_TAKE(p, 5, &field);
+            nbt_type elemtype = field[0];
+            len = nbt_push_s32(field + 1);
+
+            if (len < 0)
+                return nbt_push_fail(p, "NBT list has negative length: %d", len);
+            if (len > 0 && elemtype == NBT_TAG_END)
+                return nbt_push_fail(p, "NBT list has %d (> 0) value(s) of type NBT_TAG_END", len);
+            if (len > 0 && nbt_type_size(elemtype) == 0)
+                return nbt_push_fail(p, "NBT list has invalid element type %#02hhx", elemtype);
+
+            r = NBT_PUSH_CALL(p, p->quiet, begin_list, elemtype, len);
+            if (r == NBT_SAX_ABORT) return r;
+            bool quiet = p->quiet || r == NBT_SAX_SKIP;
+
+            if (len > 0 && elemtype <= NBT_TAG_DOUBLE)
+                return nbt_push_elements(p, NBT_TAG_LIST, elemtype, len, quiet);
+
+            if (len == 0) {
+                if (NBT_PUSH_CALL(p, quiet, end, NBT_TAG_LIST) == NBT_SAX_ABORT) return NBT_SAX_ABORT;
+                return nbt_push_value_done(p);
+            }
+
+            if (nbt_push_frame(p, NBT_TAG_LIST, elemtype, len, quiet) < 0) return -1;
+            p->type = elemtype;
+            p->quiet = quiet;
+            return NBT_SAX_CONTINUE;
+        }
+        case NBT_TAG_COMPOUND:
+            if (p->nframes >= p->maxdepth)
+                return nbt_push_fail(p, "NBT data is nested deeper than %u levels", p->maxdepth);
+
+            r = NBT_PUSH_CALL(p, p->quiet, begin_compound);
+            if (r == NBT_SAX_ABORT) return r;
+            if (nbt_push_frame(p, NBT_TAG_COMPOUND, NBT_TAG_END, 0, p->quiet || r == NBT_SAX_SKIP) < 0) return -1;
+            p->state = NBT_PUSH_ST_ENTRY_TYPE;
+            return NBT_SAX_CONTINUE;
+        default:
+            return nbt_push_fail(p, "Invalid NBT tag type %#02hhx", p->type);
+    }
+
+    if (NBT_PUSH_CALL(p, p->quiet, scalar, p->type, value) == NBT_SAX_ABORT) return NBT_SAX_ABORT;
+    return nbt_push_value_done(p);
+}
+
+int nbt_push_run(struct nbt_push *p) {
+    const unsigned char *field;
+    struct nbt_push_frame *f;
+    struct nbt_string str;
+    nbt_value value;
+    int r;
+
+    while (true) {
+        switch (p->state) {
+            case NBT_PUSH_ST_ROOT_TYPE:
+                NBT_PUSH_TAKE(p, 1, &field);
+                if (field[0] != NBT_TAG_COMPOUND)
+                    return nbt_push_fail(p, "Root tag is not TAG_COMPOUND (%#02hhx)", field[0]);
+                p->state = NBT_PUSH_ST_ROOT_NAMELEN;
+                break;
+
+            case NBT_PUSH_ST_ROOT_NAMELEN:
+                NBT_PUSH_TAKE(p, 2, &field);
+                p->namelen = nbt_push_u16(field);
+                p->state = NBT_PUSH_ST_ROOT_NAME;
+                break;
+
+            case NBT_PUSH_ST_ROOT_NAME:
+                NBT_PUSH_TAKE(p, p->namelen, &field);
+                r = NBT_PUSH_CALL(p, false, key, NBT_TAG_COMPOUND, (const char *)field, p->namelen);
+                if (r == NBT_SAX_ABORT) return r;
+                p->type = NBT_TAG_COMPOUND;
+                p->quiet = r == NBT_SAX_SKIP;
+                p->state = NBT_PUSH_ST_VALUE;
+                break;
+
+            case NBT_PUSH_ST_ENTRY_TYPE:
+                NBT_PUSH_TAKE(p, 1, &field);
+                if (field[0] != NBT_TAG_END) {
+                    p->type = field[0];
+                    p->state = NBT_PUSH_ST_ENTRY_NAMELEN;
+                    break;
+                }
+
+                f = &p->frames[--p->nframes];
+                if (NBT_PUSH_CALL(p, f->quiet, end, NBT_TAG_COMPOUND) == NBT_SAX_ABORT) return NBT_SAX_ABORT;
+                NBT_PUSH_CHECK(nbt_push_value_done(p));
+                break;
+
+            case NBT_PUSH_ST_ENTRY_NAMELEN:
+                NBT_PUSH_TAKE(p, 2, &field);
+                p->namelen = nbt_push_u16(field);
+                p->state = NBT_PUSH_ST_ENTRY_NAME;
+                break;
+
+            case NBT_PUSH_ST_ENTRY_NAME:
+                NBT_PUSH_TAKE(p, p->namelen, &field);
+                f = &p->frames[p->nframes - 1];
+
+                /* kept for error paths until the value is done; one spare
+                 * byte so `data` exists even when every name is empty */
+                p->keys.length = f->keyoff;
+                if (nbt_buffer_reserve(&p->keys, (size_t)p->namelen + 1) < 0)
+                    return nbt_push_fail(p, "Unable to allocate memory for NBT name");
+                memcpy(p->keys.data + p->keys.length, field, p->namelen);
+                p->keys.length += p->namelen;
+                f->keylen = p->namelen;
+                f->haskey = true;
+
+                r = NBT_PUSH_CALL(p, f->quiet, key, p->type, (const char *)field, p->namelen);
+                if (r == NBT_SAX_ABORT) return r;
+                p->quiet = f->quiet || r == NBT_SAX_SKIP;
+                p->state = NBT_PUSH_ST_VALUE;
+                break;
+
+            case NBT_PUSH_ST_VALUE:
+                NBT_PUSH_CHECK(r = nbt_push_run_value(p));
+                if (r == NBT_PUSH_MORE) return r;
+                break;
+
+            case NBT_PUSH_ST_STRING:
+                NBT_PUSH_TAKE(p, p->namelen, &field);
+                str.len = p->namelen;
+                str.buf = (char *)field;
+                value.tag_string = &str;
+                if (NBT_PUSH_CALL(p, p->quiet, scalar, NBT_TAG_STRING, value) == NBT_SAX_ABORT) return NBT_SAX_ABORT;
+                NBT_PUSH_CHECK(nbt_push_value_done(p));
+                break;
+
+            case NBT_PUSH_ST_ELEMENTS:
+                NBT_PUSH_CHECK(r = nbt_push_run_elements(p));
+                if (r == NBT_PUSH_MORE) return r;
+                break;
+
+            case NBT_PUSH_ST_DONE:
+                return NBT_PUSH_DONE;
+
+            default:
+                return nbt_push_fail(p, "NBT push parser used after a failure");
+        }
+    }
+}
+
+/* Tree building: a handler that turns the events back into the nodes
+ * nbt_read_ex() makes. Lists and arrays grow as their elements arrive
+ * instead of trusting the declared length up front. */
+
+struct nbt_push_node {
+    nbt_type type;                    /* compound, list or array type */
+    void *node;
+    size_t cap;                       /* lists and arrays: elements allocated */
+    struct nbt_compound_entry **tail; /* compounds: where the next entry goes */
+    struct nbt_compound_entry *entry; /* compounds: entry awaiting its value */
+};
+
+struct nbt_push_tree {
+    struct nbt_arena *arena;
+    struct nbt_parsed result;
+    bool failed;
+    char message[NBT_ERROR_MSG_SZ];
+
+    /* options->limits, as in struct nbt_reader */
+    size_t alloclimit;
+    size_t nodelimit;
+    nbt_int arraylimit;
+    nbt_int listlimit;
+    size_t allocated;
+    size_t nodes;
+
+    struct nbt_push_node *stack;
+    size_t depth;
+    size_t cap;
+};
+
+/* Counts `size` against limits.max_alloc_bytes, failing past it. */
+bool nbt_push_tree_charge(struct nbt_push_tree *t, size_t size) {
+    t->allocated += size;
+    if (t->allocated <= t->alloclimit) return true;
+
+    snprintf(t->message, sizeof(t->message), "NBT tree is larger than the limit of %zu bytes", t->alloclimit);
+    t->failed = true;
+    return false;
+}
+
+void *nbt_push_tree_alloc(struct nbt_push_tree *t, size_t size) {
+    if (!nbt_push_tree_charge(t, size)) return NULL;
+
+    void *ret = t->arena ? nbt_arena_alloc(t->arena, size) : malloc(size);
+    if (!ret) {
+        snprintf(t->message, sizeof(t->message), "Unable to allocate %zu bytes for NBT tree", size);
+        t->failed = true;
+    }
+    return ret;
+}
+
+/* Makes room for `count` more elements of `width` bytes in *buf. */
+int nbt_push_tree_grow(struct nbt_push_tree *t, struct nbt_push_node *n, void **buf, size_t length, size_t count, size_t width) {
+    if (length + count <= n->cap) return 0;
+
+    size_t cap = n->cap ? n->cap * 2 : 16;
+    if (cap < length + count) cap = length + count;
+    if (cap > SIZE_MAX / width) {
+        snprintf(t->message, sizeof(t->message), "NBT list or array is too long");
+        t->failed = true;
+        return -1;
+    }
+
+    /* arena buffers are not reused when they grow, so they cost in full */
+    if (!nbt_push_tree_charge(t, (cap - (t->arena ? 0 : n->cap)) * width))
+        return -1;
+
+    void *temp;
+    if (t->arena) {
+        temp = nbt_arena_alloc(t->arena, cap * width);
+        if (temp && length) memcpy(temp, *buf, length * width);
+    } else {
+        temp = realloc(*buf, cap * width);
+    }
+
+    if (!temp) {
+        snprintf(t->message, sizeof(t->message), "Unable to allocate %zu bytes for NBT list or array", cap * width);
+        t->failed = true;
+        return -1;
+    }
+
+    *buf = temp;
+    n->cap = cap;
+    return 0;
+}
+
+/* Attaches a finished or newly opened value to its parent, or frees it. */
+int nbt_push_tree_place(struct nbt_push_tree *t, nbt_type type, nbt_value value) {
+    if (++t->nodes > t->nodelimit) {
+        snprintf(t->message, sizeof(t->message), "NBT data has more than the limit of %zu values", t->nodelimit);
+        t->failed = true;
+        goto place_error_cleanup;
+    }
+
+    if (t->depth == 0) {
+        t->result.root = value.tag_compound;
+        return NBT_SAX_CONTINUE;
+    }
+
+    struct nbt_push_node *top = &t->stack[t->depth - 1];
+    if (top->type == NBT_TAG_COMPOUND) {
+        top->entry->tag.type = type;
+        top->entry->tag.value = value;
+        return NBT_SAX_CONTINUE;
+    }
+
+    struct nbt_list *list = top->node;
+    size_t width = nbt_type_size(type);
+    if (nbt_push_tree_grow(t, top, &list->data.raw, (size_t)list->length, 1, width) < 0)
+        goto place_error_cleanup;
+
+    memcpy((unsigned char *)list->data.raw + (size_t)list->length * width, &value, width);
+    ++list->length;
+    return NBT_SAX_CONTINUE;
+
+place_error_cleanup:
+    if (!t->arena) nbt_free_value(type, value);
+    return NBT_SAX_ABORT;
+}
+
+int nbt_push_tree_open(struct nbt_push_tree *t, nbt_type type, void *node) {
+    if (t->depth == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 16;
+        struct nbt_push_node *temp = realloc(t->stack, cap * sizeof(struct nbt_push_node));
+        if (!temp) {
+            snprintf(t->message, sizeof(t->message), "Unable to allocate memory for NBT tree stack");
+            t->failed = true;
+            return NBT_SAX_ABORT;
+        }
+        t->stack = temp;
+        t->cap = cap;
+    }
+
+    t->stack[t->depth++] = (struct nbt_push_node){
+        .type = type,
+        .node = node,
+        .tail = type == NBT_TAG_COMPOUND ? &((struct nbt_compound *)node)->first : NULL,
+    };
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_push_tree_key(void *user, nbt_type type, const char *name, nbt_strlen namelen) {
+    struct nbt_push_tree *t = user;
+
+    char *copy = nbt_push_tree_alloc(t, (size_t)namelen + 1);
+    if (!copy) return NBT_SAX_ABORT;
+    memcpy(copy, name, namelen);
+    copy[namelen] = '\0';
+
+    if (t->depth == 0) {
+        t->result.name = copy;
+        t->result.namelen = namelen;
+        return NBT_SAX_CONTINUE;
+    }
+
+    struct nbt_push_node *top = &t->stack[t->depth - 1];
+    struct nbt_compound_entry *entry = nbt_push_tree_alloc(t, sizeof(struct nbt_compound_entry));
+    if (!entry) {
+        if (!t->arena) free(copy);
+        return NBT_SAX_ABORT;
+    }
+
+    /* TAG_End until the value is placed, so a partial tree frees cleanly */
+    memset(entry, 0, sizeof(struct nbt_compound_entry));
+    entry->name = copy;
+    entry->namelen = namelen;
+    entry->hash = nbt_hash_name(copy, namelen);
+    (void)type;
+
+    *top->tail = entry;
+    top->tail = &entry->next;
+    top->entry = entry;
+    ++((struct nbt_compound *)top->node)->size;
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_push_tree_scalar(void *user, nbt_type type, nbt_value value) {
+    struct nbt_push_tree *t = user;
+
+    if (type == NBT_TAG_STRING) {
+        const struct nbt_string *in = value.tag_string;
+        struct nbt_string *str = nbt_push_tree_alloc(t, sizeof(struct nbt_string));
+        if (!str) return NBT_SAX_ABORT;
+
+        str->len = in->len;
+        str->buf = nbt_push_tree_alloc(t, (size_t)in->len + 1);
+        if (!str->buf) {
+            if (!t->arena) free(str);
+            return NBT_SAX_ABORT;
+        }
+        memcpy(str->buf, in->buf, in->len);
+        str->buf[in->len] = '\0';
+        value.tag_string = str;
+    }
+
+    /* numbers only ever land in compounds; lists of them come as chunks */
+    return nbt_push_tree_place(t, type, value);
+}
+
+int nbt_push_tree_begin_compound(void *user) {
+    struct nbt_push_tree *t = user;
+    nbt_value value;
+
+    value.tag_compound = nbt_push_tree_alloc(t, sizeof(struct nbt_compound));
+    if (!value.tag_compound) return NBT_SAX_ABORT;
+    memset(value.tag_compound, 0, sizeof(struct nbt_compound));
+
+    NBT_PUSH_CHECK(nbt_push_tree_place(t, NBT_TAG_COMPOUND, value));
+    return nbt_push_tree_open(t, NBT_TAG_COMPOUND, value.tag_compound);
+}
+
+int nbt_push_tree_begin_list(void *user, nbt_type elemtype, nbt_int length) {
+    struct nbt_push_tree *t = user;
+    nbt_value value;
+
+    if (length > t->listlimit) {
+        snprintf(t->message, sizeof(t->message), "NBT list is longer than the limit of %d: %d", t->listlimit, length);
+        t->failed = true;
+        return NBT_SAX_ABORT;
+    }
+
+    value.tag_list = nbt_push_tree_alloc(t, sizeof(struct nbt_list));
+    if (!value.tag_list) return NBT_SAX_ABORT;
+    memset(value.tag_list, 0, sizeof(struct nbt_list));
+    value.tag_list->type = elemtype;
+
+    NBT_PUSH_CHECK(nbt_push_tree_place(t, NBT_TAG_LIST, value));
+    return nbt_push_tree_open(t, NBT_TAG_LIST, value.tag_list);
+}
+
+int nbt_push_tree_begin_array(void *user, nbt_type type, nbt_int length) {
+    struct nbt_push_tree *t = user;
+    nbt_value value;
+
+    if (length > t->arraylimit) {
+        snprintf(t->message, sizeof(t->message), "NBT %s array is longer than the limit of %d: %d",
+                 type == NBT_TAG_BYTE_ARRAY ? "byte" : type == NBT_TAG_INT_ARRAY ? "int" : "long",
+                 t->arraylimit, length);
+        t->failed = true;
+        return NBT_SAX_ABORT;
+    }
+
+    switch (type) {
+        case NBT_TAG_BYTE_ARRAY:
+            value.tag_byte_array = nbt_push_tree_alloc(t, sizeof(struct nbt_byte_array));
+            if (!value.tag_byte_array) return NBT_SAX_ABORT;
+            memset(value.tag_byte_array, 0, sizeof(struct nbt_byte_array));
+            break;
+        case NBT_TAG_INT_ARRAY:
+            value.tag_int_array = nbt_push_tree_alloc(t, sizeof(struct nbt_int_array));
+            if (!value.tag_int_array) return NBT_SAX_ABORT;
+            memset(value.tag_int_array, 0, sizeof(struct nbt_int_array));
+            break;
+        default:
+            value.tag_long_array = nbt_push_tree_alloc(t, sizeof(struct nbt_long_array));
+            if (!value.tag_long_array) return NBT_SAX_ABORT;
+            memset(value.tag_long_array, 0, sizeof(struct nbt_long_array));
+            break;
+    }
+
+    NBT_PUSH_CHECK(nbt_push_tree_place(t, type, value));
+    return nbt_push_tree_open(t, type, value.tag_byte_array);
+}
+
+int nbt_push_tree_array_chunk(void *user, nbt_type elemtype, const void *data, size_t count) {
+    struct nbt_push_tree *t = user;
+    struct nbt_push_node *top = &t->stack[t->depth - 1];
+    size_t width = nbt_type_size(elemtype);
+    void **buf;
+    nbt_int *len;
+
+    switch (top->type) {
+        case NBT_TAG_LIST:
+            buf = &((struct nbt_list *)top->node)->data.raw;
+            len = &((struct nbt_list *)top->node)->length;
+            break;
+        case NBT_TAG_BYTE_ARRAY: {
+            struct nbt_byte_array *arr = top->node;
+            buf = (void **)&arr->buf;
+            len = &arr->len;
+            break;
+        }
+        case NBT_TAG_INT_ARRAY: {
+            struct nbt_int_array *arr = top->node;
+            buf = (void **)&arr->buf;
+            len = &arr->len;
+            break;
+        }
+        default: {
+            struct nbt_long_array *arr = top->node;
+            buf = (void **)&arr->buf;
+            len = &arr->len;
+            break;
+        }
+    }
+
+    if (nbt_push_tree_grow(t, top, buf, (size_t)*len, count, width) < 0)
+        return NBT_SAX_ABORT;
+
+    memcpy((unsigned char *)*buf + (size_t)*len * width, data, count * width);
+    *len += (nbt_int)count;
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_push_tree_end(void *user, nbt_type type) {
+    struct nbt_push_tree *t = user;
+    struct nbt_push_node *top = &t->stack[--t->depth];
+    (void)type;
+
+    if (top->type != NBT_TAG_COMPOUND) return NBT_SAX_CONTINUE;
+
+    /* as in nbt_read_compound(): arena trees get their index up front */
+    struct nbt_compound *compound = top->node;
+    if (t->arena && compound->size >= NBT_COMPOUND_INDEX_MIN) {
+        size_t indexlen = nbt_compound_index_slots(compound->size) * sizeof(struct nbt_compound_entry *);
+        struct nbt_compound_entry **index = nbt_push_tree_alloc(t, indexlen);
+        if (!index) return NBT_SAX_ABORT;
+
+        memset(index, 0, indexlen);
+        nbt_compound_fill_index(compound, index);
+    }
+
+    return NBT_SAX_CONTINUE;
+}
+
+/* Drops a partial (or unclaimed) tree. */
+void nbt_push_tree_clear(struct nbt_push_tree *t) {
+    nbt_free_parsed(&t->result);
+    t->result.arena = t->arena;
+    t->depth = 0;
+    t->failed = false;
+    t->allocated = 0;
+    t->nodes = 0;
+}
+
+struct nbt_push *nbt_push_new(const struct nbt_sax_handler *handler, struct nbt_error *error) {
+    struct nbt_push *p = calloc(1, sizeof(struct nbt_push));
+    if (!p) {
+        nbt_set_error("Unable to allocate memory for NBT push parser");
+        return NULL;
+    }
+
+    p->h = handler;
+    p->error = error;
+    p->maxdepth = NBT_DEFAULT_MAX_DEPTH;
+    p->state = NBT_PUSH_ST_ROOT_TYPE;
+    return p;
+}
+
+struct nbt_push *nbt_push_new_tree(const struct nbt_read_options *options) {
+    struct nbt_push_tree *t = calloc(1, sizeof(struct nbt_push_tree));
+    if (!t) {
+        nbt_set_error("Unable to allocate memory for NBT push parser");
+        return NULL;
+    }
+
+    struct nbt_push *p = nbt_push_new(NULL, options ? options->error : NULL);
+    if (!p) {
+        free(t);
+        return NULL;
+    }
+
+    t->alloclimit = SIZE_MAX;
+    t->nodelimit = SIZE_MAX;
+    t->arraylimit = INT32_MAX;
+    t->listlimit = INT32_MAX;
+    if (options) {
+        const struct nbt_limits *limits = &options->limits;
+        if (limits->max_depth) p->maxdepth = limits->max_depth;
+        if (limits->max_alloc_bytes) t->alloclimit = limits->max_alloc_bytes;
+        if (limits->max_nodes) t->nodelimit = limits->max_nodes;
+        if (limits->max_array_length) t->arraylimit = limits->max_array_length;
+        if (limits->max_list_length) t->listlimit = limits->max_list_length;
+    }
+
+    t->arena = options ? options->arena : NULL;
+    t->result.arena = t->arena;
+
+    p->tree = t;
+    p->treeh = (struct nbt_sax_handler){
+        .key = &nbt_push_tree_key,
+        .scalar = &nbt_push_tree_scalar,
+        .begin_compound = &nbt_push_tree_begin_compound,
+        .begin_list = &nbt_push_tree_begin_list,
+        .begin_array = &nbt_push_tree_begin_array,
+        .array_chunk = &nbt_push_tree_array_chunk,
+        .end = &nbt_push_tree_end,
+        .user = t,
+    };
+    p->h = &p->treeh;
+    return p;
+}
+
+void nbt_push_free(struct nbt_push *p) {
+    if (!p) return;
+
+    if (p->tree) {
+        nbt_push_tree_clear(p->tree);
+        free(p->tree->stack);
+        free(p->tree);
+    }
+
+    free(p->frames);
+    nbt_buffer_free(&p->keys);
+    nbt_buffer_free(&p->partial);
+    free(p);
+}
+
+int nbt_push_feed(struct nbt_push *p, const unsigned char *data, size_t length, size_t *used) {
+    p->start = p->cur = data;
+    p->end = data + length;
+
+    int r = nbt_push_run(p);
+
+    /* a failure in the tree builder surfaces as an abort */
+    if (r == NBT_SAX_ABORT && p->tree && p->tree->failed)
+        r = nbt_push_fail(p, "%s", p->tree->message);
+
+    if (used) *used = (size_t)(p->cur - p->start);
+    p->base += (size_t)(p->cur - p->start);
+
+    if (r < 0) {
+        nbt_push_report(p);
+        p->state = NBT_PUSH_ST_FAILED;
+    } else if (r == NBT_SAX_ABORT) {
+        p->state = NBT_PUSH_ST_FAILED;
+    }
+
+    return r;
+}
+
+int nbt_push_result(struct nbt_push *p, struct nbt_parsed *result) {
+    if (!p->tree) {
+        nbt_set_error("NBT push parser does not build a tree");
+        return -1;
+    }
+
+    if (p->state != NBT_PUSH_ST_DONE || !p->tree->result.root) {
+        nbt_set_error("NBT push parser has no complete document");
+        return -1;
+    }
+
+    *result = p->tree->result;
+    memset(&p->tree->result, 0, sizeof(struct nbt_parsed));
+    p->tree->result.arena = p->tree->arena;
+    return 0;
+}
+
+void nbt_push_reset(struct nbt_push *p) {
+    if (p->tree) nbt_push_tree_clear(p->tree);
+
+    p->state = NBT_PUSH_ST_ROOT_TYPE;
+    p->nframes = 0;
+    p->keys.length = 0;
+    p->partial.length = 0;
+    p->base = 0;
+}
@@ -0,0 +1,198 @@
+#include "nbt_region.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct nbt_region *nbt_region_open(const char *path, struct nbt_error *error) {
+    struct nbt_region *region = calloc(1, sizeof(struct nbt_region));
+    struct stat st;
+
+    if (!region) {
+        nbt_set_error("Unable to allocate memory for region");
+        goto open_error;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nbt_set_error("Failed to open region %s: %s", path, strerror(errno));
+        goto open_error;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        nbt_set_error("Failed to stat region %s: %s", path, strerror(errno));
+        close(fd);
+        goto open_error;
+    }
+
+    /* the game leaves empty files for regions it never wrote to */
+    if (st.st_size > 0) {
+        if (st.st_size < NBT_REGION_HEADER_SIZE) {
+            nbt_set_error("Region %s is truncated: %jd < %d bytes", path, (intmax_t)st.st_size, NBT_REGION_HEADER_SIZE);
+            close(fd);
+            goto open_error;
+        }
+
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            nbt_set_error("Failed to map region %s: %s", path, strerror(errno));
+            close(fd);
+            goto open_error;
+        }
+
+        region->map = map;
+        region->length = (size_t)st.st_size;
+    }
+
+    close(fd);
+    return region;
+
+open_error:
+    nbt_fill_error(error, 0, "");
+    free(region);
+    return NULL;
+}
+
+void nbt_region_close(struct nbt_region *region) {
+    if (!region) return;
+
+    if (region->map) munmap((void *)region->map, region->length);
+    free(region);
+}
+
+int nbt_region_has_chunk(const struct nbt_region *region, unsigned index) {
+    return region->map && index < NBT_REGION_CHUNKS && nbt_region_u32(region->map + 4 * index) != 0;
+}
+
+uint32_t nbt_region_timestamp(const struct nbt_region *region, unsigned index) {
+    if (!region->map || index >= NBT_REGION_CHUNKS) return 0;
+    return nbt_region_u32(region->map + NBT_REGION_SECTOR_SIZE + 4 * index);
+}
+
+/* Finds the payload of a chunk: [*data, *data + *length) of type *type. */
+int nbt_region_locate(const struct nbt_region *region, unsigned index, const unsigned char **data, size_t *length, int *type) {
+    if (!nbt_region_has_chunk(region, index)) {
+        nbt_set_error("Chunk %u is not present in the region", index);
+        return -1;
+    }
+
+    uint32_t loc = nbt_region_u32(region->map + 4 * index);
+    size_t offset = (size_t)(loc >> 8) * NBT_REGION_SECTOR_SIZE;
+    size_t sectors = loc & 0xff;
+
+    if (offset < NBT_REGION_HEADER_SIZE || sectors == 0 || offset > region->length - 5) {
+        nbt_set_error("Chunk %u has a bad location (sector %u, count %zu)", index, loc >> 8, sectors);
+        return -1;
+    }
+
+    /* the declared length counts the compression byte */
+    size_t chunklen = nbt_region_u32(region->map + offset);
+    if (chunklen < 1 || chunklen > region->length - offset - 4 || chunklen > sectors * NBT_REGION_SECTOR_SIZE - 4) {
+        nbt_set_error("Chunk %u has a bad length (%zu bytes in %zu sector(s))", index, chunklen, sectors);
+        return -1;
+    }
+
+    *type = region->map[offset + 4];
+    *data = region->map + offset + 5;
+    *length = chunklen - 1;
+    return 0;
+}
+
+int nbt_region_read_chunk(const struct nbt_region *region, unsigned index, struct nbt_parsed *result, const struct nbt_read_options *options) {
+    const unsigned char *data;
+    size_t length;
+    int type;
+
+    memset(result, 0, sizeof(struct nbt_parsed));
+
+    if (nbt_region_locate(region, index, &data, &length, &type) < 0)
+        goto chunk_error;
+
+    /* as for a mapped file: the chunk as stored counts as read */
+    if (options && options->stats) options->stats->bytes_read += length;
+
+    switch (type) {
+        case NBT_REGION_UNCOMPRESSED:
+            return nbt_read_ex(data, length, result, options);
+
+        case NBT_REGION_GZIP:
+        case NBT_REGION_ZLIB: {
+            unsigned char *inflated;
+            size_t inflatedlen;
+
+            int format = type == NBT_REGION_GZIP ? NBT_COMPRESSION_GZIP : NBT_COMPRESSION_ZLIB;
+            if (nbt_decompress_counted(data, length, format, &inflated, &inflatedlen, options) < 0) {
+                char msg[NBT_ERROR_MSG_SZ];
+                snprintf(msg, sizeof(msg), "%s", nbt_error());
+                nbt_set_error("Chunk %u: %s", index, msg);
+                goto chunk_error;
+            }
+
+            int ret = nbt_read_ex(inflated, inflatedlen, result, options);
+            free(inflated);
+            return ret;
+        }
+
+        default:
+            if (type & 0x80)
+                nbt_set_error("Chunk %u is stored in an external .mcc file, which is not supported", index);
+            else
+                nbt_set_error("Chunk %u has unsupported compression type %d", index, type);
+            goto chunk_error;
+    }
+
+chunk_error:
+    nbt_fill_error(options ? options->error : NULL, 0, "");
+    return -1;
+}
+
+struct nbt_region_batch {
+    const struct nbt_region *region;
+    struct nbt_parsed *results;
+    const struct nbt_region_batch_options *options;
+    atomic_int failed;
+};
+
+void nbt_region_batch_chunk(void *ctx, size_t index, unsigned thread) {
+    struct nbt_region_batch *batch = ctx;
+    struct nbt_read_options opts = { 0 };
+    (void)thread;
+
+    if (!nbt_region_has_chunk(batch->region, (unsigned)index)) {
+        memset(&batch->results[index], 0, sizeof(struct nbt_parsed));
+        return;
+    }
+
+    if (batch->options) {
+        opts.paths = batch->options->paths;
+        opts.npaths = batch->options->npaths;
+        opts.limits = batch->options->limits;
+        if (batch->options->errors) opts.error = &batch->options->errors[index];
+    }
+
+    if (nbt_region_read_chunk(batch->region, (unsigned)index, &batch->results[index], &opts) < 0)
+        atomic_fetch_add_explicit(&batch->failed, 1, memory_order_relaxed);
+}
+
+int nbt_region_read_all(const struct nbt_region *region, struct nbt_parsed *results, const struct nbt_region_batch_options *options) {
+    struct nbt_region_batch batch = {
+        .region = region,
+        .results = results,
+        .options = options,
+    };
+
+    nbt_pool_run(options ? options->pool : NULL, NBT_REGION_CHUNKS, &nbt_region_batch_chunk, &batch);
+
+    return atomic_load(&batch.failed);
+}
@@ -0,0 +1,417 @@
+#include "nbt_region.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <zlib.h>
+
+enum {
+    NBT_REGION_KEEP = 0,
+    NBT_REGION_PUT,
+    NBT_REGION_REMOVE,
+};
+
+struct nbt_region_update {
+    int op;                         /* NBT_REGION_KEEP/PUT/REMOVE */
+    const struct nbt_parsed *chunk;
+    uint32_t timestamp;
+};
+
+struct nbt_region_writer {
+    char *path;
+    struct nbt_region *old;         /* NULL if there is no file yet */
+    struct nbt_region_update updates[NBT_REGION_CHUNKS];
+};
+
+/* A run of sectors in the new file and where its bytes come from. */
+struct nbt_region_extent {
+    uint32_t sector;
+    uint32_t count;
+    const unsigned char *data;
+    size_t length;                  /* zero-padded to count sectors */
+};
+
+struct nbt_region_writer *nbt_region_writer_new(const char *path, struct nbt_error *error) {
+    struct nbt_region_writer *writer = calloc(1, sizeof(struct nbt_region_writer));
+    if (!writer || !(writer->path = strdup(path))) {
+        nbt_set_error("Unable to allocate memory for region writer");
+        goto new_error_cleanup;
+    }
+
+    if (access(path, F_OK) == 0 && !(writer->old = nbt_region_open(path, NULL)))
+        goto new_error_cleanup;
+
+    return writer;
+
+new_error_cleanup:
+    nbt_fill_error(error, 0, "");
+    nbt_region_writer_free(writer);
+    return NULL;
+}
+
+void nbt_region_writer_free(struct nbt_region_writer *writer) {
+    if (!writer) return;
+
+    nbt_region_close(writer->old);
+    free(writer->path);
+    free(writer);
+}
+
+int nbt_region_writer_put(struct nbt_region_writer *writer, unsigned index, const struct nbt_parsed *chunk, uint32_t timestamp) {
+    if (index >= NBT_REGION_CHUNKS) {
+        nbt_set_error("Chunk index %u out of range", index);
+        return -1;
+    }
+
+    writer->updates[index] = (struct nbt_region_update){ NBT_REGION_PUT, chunk, timestamp };
+    return 0;
+}
+
+int nbt_region_writer_remove(struct nbt_region_writer *writer, unsigned index) {
+    if (index >= NBT_REGION_CHUNKS) {
+        nbt_set_error("Chunk index %u out of range", index);
+        return -1;
+    }
+
+    writer->updates[index] = (struct nbt_region_update){ NBT_REGION_REMOVE, NULL, 0 };
+    return 0;
+}
+
+struct nbt_region_compress {
+    struct nbt_region_writer *writer;
+    struct nbt_buffer *out;
+    int level;
+
+    pthread_mutex_t lock;
+    size_t failed;                  /* lowest failed index + 1, or 0 */
+    char message[NBT_ERROR_MSG_SZ];
+};
+
+/* Each compressed chunk is preceded by its 5-byte sector header: length
+ * (counting the compression byte) and compression type. */
+void nbt_region_compress_chunk(void *ctx, size_t index, unsigned thread) {
+    struct nbt_region_compress *job = ctx;
+    const struct nbt_region_update *update = &job->writer->updates[index];
+    struct nbt_buffer *out = &job->out[index];
+    struct nbt_write_options opts = { NBT_COMPRESSION_ZLIB, job->level, NULL };
+    (void)thread;
+
+    if (update->op != NBT_REGION_PUT) return;
+
+    if (nbt_buffer_reserve(out, 5) < 0) {
+        nbt_set_error("Unable to allocate memory for chunk %zu", index);
+        goto compress_error;
+    }
+    out->length = 5;
+
+    if (nbt_write(update->chunk, out, &opts) < 0)
+        goto compress_error;
+
+    size_t length = out->length - 4;
+    if (length > 255 * NBT_REGION_SECTOR_SIZE - 4) {
+        nbt_set_error("Chunk %zu is too large for a region file (%zu bytes compressed)", index, out->length);
+        goto compress_error;
+    }
+
+    uint32_t be = nbt_endian_h2be_u32((uint32_t)length);
+    memcpy(out->data, &be, 4);
+    out->data[4] = NBT_REGION_ZLIB;
+    return;
+
+compress_error:
+    /* report the lowest failing index, as a serial run would */
+    pthread_mutex_lock(&job->lock);
+    if (job->failed == 0 || job->failed > index + 1) {
+        job->failed = index + 1;
+        snprintf(job->message, sizeof(job->message), "Chunk %zu: %s", index, nbt_error());
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+/* First fit over the sector map; grows the file if no hole is big enough. */
+uint32_t nbt_region_alloc_sectors(unsigned char *used, uint32_t *end, uint32_t count) {
+    uint32_t run = 0;
+
+    for (uint32_t s = 2; s < *end; ++s) {
+        run = used[s] ? 0 : run + 1;
+        if (run == count) {
+            memset(used + s + 1 - count, 1, count);
+            return s + 1 - count;
+        }
+    }
+
+    /* extend the file, reusing a free run at its tail */
+    uint32_t start = *end - run;
+    memset(used + start, 1, count);
+    *end = start + count;
+    return start;
+}
+
+int nbt_region_extent_cmp(const void *a, const void *b) {
+    const struct nbt_region_extent *x = a, *y = b;
+    return (x->sector > y->sector) - (x->sector < y->sector);
+}
+
+/* Writes the extents (sorted, non-overlapping) with as few pwritev() calls
+ * as possible: contiguous runs go out together, padding included. */
+int nbt_region_write_extents(int fd, const struct nbt_region_extent *extents, size_t count) {
+    static const unsigned char zeros[NBT_REGION_SECTOR_SIZE];
+    struct iovec iov[64];
+    int niov = 0;
+    off_t offset = 0;
+    size_t pending = 0;
+
+    for (size_t i = 0; i <= count; ++i) {
+        const struct nbt_region_extent *ext = i < count ? &extents[i] : NULL;
+        bool contiguous = ext && niov > 0 && (off_t)ext->sector * NBT_REGION_SECTOR_SIZE == offset + (off_t)pending;
+
+        if (niov > 0 && (!contiguous || niov + 2 > (int)(sizeof(iov) / sizeof(iov[0])))) {
+            /* flush; pwritev may write short, so continue where it left off */
+            struct iovec *cur = iov;
+            int left = niov;
+            while (pending > 0) {
+                ssize_t n = pwritev(fd, cur, left, offset);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    nbt_set_error("Failed to write region: %s", strerror(errno));
+                    return -1;
+                }
+
+                offset += n;
+                pending -= (size_t)n;
+                while (left > 0 && (size_t)n >= cur->iov_len) {
+                    n -= (ssize_t)cur->iov_len;
+                    ++cur;
+                    --left;
+                }
+                if (left > 0) {
+                    cur->iov_base = (unsigned char *)cur->iov_base + n;
+                    cur->iov_len -= (size_t)n;
+                }
+            }
+            niov = 0;
+        }
+
+        if (!ext) break;
+
+        if (niov == 0) offset = (off_t)ext->sector * NBT_REGION_SECTOR_SIZE;
+
+        size_t total = (size_t)ext->count * NBT_REGION_SECTOR_SIZE;
+        iov[niov++] = (struct iovec){ (void *)ext->data, ext->length };
+        if (total > ext->length)
+            iov[niov++] = (struct iovec){ (void *)zeros, total - ext->length };
+        pending += total;
+    }
+
+    return 0;
+}
+
+/* Opens the directory holding `path`: its entry for the file has to be
+ * synced as well for a rename over the file to survive a crash. */
+int nbt_region_open_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return open(".", O_RDONLY | O_DIRECTORY);
+    if (slash == path) return open("/", O_RDONLY | O_DIRECTORY);
+
+    char *dir = strndup(path, (size_t)(slash - path));
+    if (!dir) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    int saved = errno;
+    free(dir);
+    errno = saved;
+    return fd;
+}
+
+int nbt_region_writer_commit(struct nbt_region_writer *writer, const struct nbt_region_write_options *options) {
+    struct nbt_error *error = options ? options->error : NULL;
+    /* an empty file (one the game never wrote to) has no chunks to keep */
+    const struct nbt_region *old = writer->old && writer->old->map ? writer->old : NULL;
+    uint32_t oldend = old ? (uint32_t)((old->length + NBT_REGION_SECTOR_SIZE - 1) / NBT_REGION_SECTOR_SIZE) : 0;
+
+    unsigned char header[NBT_REGION_HEADER_SIZE];
+    struct nbt_region_extent extents[NBT_REGION_CHUNKS + 1];
+    size_t nextents = 0;
+
+    struct nbt_region_compress *job = NULL;
+    unsigned char *used = NULL;
+    char *tmppath = NULL;
+    int fd = -1, dirfd = -1;
+    int ret = -1;
+
+    job = calloc(1, sizeof(struct nbt_region_compress));
+    if (!job || !(job->out = calloc(NBT_REGION_CHUNKS, sizeof(struct nbt_buffer)))) {
+        nbt_set_error("Unable to allocate memory for region commit");
+        goto commit_cleanup;
+    }
+
+    job->writer = writer;
+    job->level = options ? options->level : 0;
+    pthread_mutex_init(&job->lock, NULL);
+    nbt_pool_run(options ? options->pool : NULL, NBT_REGION_CHUNKS, &nbt_region_compress_chunk, job);
+    pthread_mutex_destroy(&job->lock);
+
+    if (job->failed) {
+        nbt_set_error("%s", job->message);
+        goto commit_cleanup;
+    }
+
+    /* a chunk is at most 255 sectors, so this bounds every layout */
+    uint32_t maxsectors = (oldend > 2 ? oldend : 2) + 255u * NBT_REGION_CHUNKS;
+    used = calloc(maxsectors, 1);
+    if (!used) {
+        nbt_set_error("Unable to allocate memory for region commit");
+        goto commit_cleanup;
+    }
+
+    memset(header, 0, sizeof(header));
+    used[0] = used[1] = 1;
+    uint32_t end = 2;
+    uint32_t now = (uint32_t)time(NULL);
+
+    /* chunks left alone keep their sectors; ones outside the file are lost anyway */
+    for (unsigned i = 0; i < NBT_REGION_CHUNKS && old; ++i) {
+        uint32_t loc = nbt_region_u32(old->map + 4 * i);
+        uint32_t sector = loc >> 8, count = loc & 0xff;
+
+        if (writer->updates[i].op != NBT_REGION_KEEP || loc == 0) continue;
+        if (sector < 2 || count == 0 || sector >= oldend || count > oldend - sector) continue;
+
+        size_t start = (size_t)sector * NBT_REGION_SECTOR_SIZE;
+        size_t avail = old->length - start;
+        size_t length = (size_t)count * NBT_REGION_SECTOR_SIZE;
+
+        /* chunks sharing sectors (corrupt, but readable) are copied once */
+        bool overlaps = false;
+        for (uint32_t s = sector; s < sector + count; ++s) overlaps |= used[s];
+        if (!overlaps) {
+            extents[nextents++] = (struct nbt_region_extent){ sector, count, old->map + start, length < avail ? length : avail };
+            memset(used + sector, 1, count);
+        }
+
+        if (sector + count > end) end = sector + count;
+        memcpy(header + 4 * i, old->map + 4 * i, 4);
+        memcpy(header + NBT_REGION_SECTOR_SIZE + 4 * i, old->map + NBT_REGION_SECTOR_SIZE + 4 * i, 4);
+    }
+
+    for (unsigned i = 0; i < NBT_REGION_CHUNKS; ++i) {
+        const struct nbt_region_update *update = &writer->updates[i];
+        if (update->op != NBT_REGION_PUT) continue;
+
+        const struct nbt_buffer *buf = &job->out[i];
+        uint32_t count = (uint32_t)((buf->length + NBT_REGION_SECTOR_SIZE - 1) / NBT_REGION_SECTOR_SIZE);
+        uint32_t sector = nbt_region_alloc_sectors(used, &end, count);
+
+        extents[nextents++] = (struct nbt_region_extent){ sector, count, buf->data, buf->length };
+
+        uint32_t loc = nbt_endian_h2be_u32(sector << 8 | count);
+        uint32_t ts = nbt_endian_h2be_u32(update->timestamp ? update->timestamp : now);
+        memcpy(header + 4 * i, &loc, 4);
+        memcpy(header + NBT_REGION_SECTOR_SIZE + 4 * i, &ts, 4);
+    }
+
+    extents[nextents++] = (struct nbt_region_extent){ 0, 2, header, sizeof(header) };
+    qsort(extents, nextents, sizeof(struct nbt_region_extent), &nbt_region_extent_cmp);
+
+    /* write everything to a sibling file, then rename it over the region */
+    size_t pathlen = strlen(writer->path);
+    tmppath = malloc(pathlen + sizeof(".XXXXXX"));
+    if (!tmppath) {
+        nbt_set_error("Unable to allocate memory for region commit");
+        goto commit_cleanup;
+    }
+    memcpy(tmppath, writer->path, pathlen);
+    memcpy(tmppath + pathlen, ".XXXXXX", sizeof(".XXXXXX"));
+
+    fd = mkstemp(tmppath);
+    if (fd < 0) {
+        nbt_set_error("Failed to create %s: %s", tmppath, strerror(errno));
+        goto commit_cleanup;
+    }
+
+    struct stat st;
+    mode_t mode = writer->old && stat(writer->path, &st) == 0 ? st.st_mode & 07777 : 0644;
+
+    if (nbt_region_write_extents(fd, extents, nextents) < 0)
+        goto commit_cleanup;
+
+    if (ftruncate(fd, (off_t)end * NBT_REGION_SECTOR_SIZE) < 0 || fchmod(fd, mode) < 0 || fsync(fd) < 0) {
+        nbt_set_error("Failed to finish %s: %s", tmppath, strerror(errno));
+        goto commit_cleanup;
+    }
+
+    close(fd);
+    fd = -1;
+
+    dirfd = nbt_region_open_dir(writer->path);
+    if (dirfd < 0) {
+        nbt_set_error("Failed to open the directory of %s: %s", writer->path, strerror(errno));
+        unlink(tmppath);
+        goto commit_cleanup;
+    }
+
+    /* the next commit starts from what was just written; mapped before the
+     * rename so that nothing can fail once the file has been replaced */
+    struct nbt_region *region = nbt_region_open(tmppath, NULL);
+    if (!region) {
+        unlink(tmppath);
+        goto commit_cleanup;
+    }
+
+    if (rename(tmppath, writer->path) < 0) {
+        nbt_set_error("Failed to replace %s: %s", writer->path, strerror(errno));
+        nbt_region_close(region);
+        unlink(tmppath);
+        goto commit_cleanup;
+    }
+
+    nbt_region_close(writer->old);
+    writer->old = region;
+    memset(writer->updates, 0, sizeof(writer->updates));
+
+    /* the new file is in place either way, but may not stay there after a
+     * crash until the directory is synced */
+    if (fsync(dirfd) < 0) {
+        nbt_set_error("Failed to sync the directory of %s: %s", writer->path, strerror(errno));
+        goto commit_cleanup;
+    }
+    ret = 0;
+
+commit_cleanup:
+    if (fd >= 0) {
+        close(fd);
+        unlink(tmppath);
+    }
+    if (dirfd >= 0) close(dirfd);
+
+    if (ret < 0) nbt_fill_error(error, 0, "");
+
+    if (job && job->out) {
+        for (unsigned i = 0; i < NBT_REGION_CHUNKS; ++i)
+            nbt_buffer_free(&job->out[i]);
+        free(job->out);
+    }
+    free(job);
+    free(used);
+    free(tmppath);
+
+    return ret;
+}
@@ -0,0 +1,212 @@
+#include "nbt_sax.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_endian.h"
+#include "nbt_internal.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/* The SAX walker uses the same cursor and primitives as the tree reader;
+ * instead of allocating nodes it reports each value to the handler. A
+ * subtree the handler skips is stepped over with the nbt_skip_* helpers. */
+
+struct nbt_sax {
+    struct nbt_reader rd;
+    const struct nbt_sax_handler *h;
+    unsigned char chunk[NBT_SAX_CHUNK_BYTES];
+};
+
+/* Evaluates to the callback's verdict, or NBT_SAX_CONTINUE if it is unset. */
+#define NBT_SAX_CALL(_sax, _cb, ...) \
+    ((_sax)->h->_cb ? (_sax)->h->_cb((_sax)->h->user, ## __VA_ARGS__) : NBT_SAX_CONTINUE)
+
+/* Propagates errors (-1) and aborts; leaves CONTINUE/SKIP to the caller. */
+#define NBT_SAX_CHECK(_expr)                          \
+do {                                                  \
+    int _r = (_expr);                                 \
+    if (_r < 0 || _r == NBT_SAX_ABORT) return _r;     \
+} while (0)
+
+/* Delivers the end event of a container whose contents were walked. */
+#define NBT_SAX_END(_sax, _type) \
+    (NBT_SAX_CALL(_sax, end, _type) == NBT_SAX_ABORT ? NBT_SAX_ABORT : NBT_SAX_CONTINUE)
+
+int nbt_sax_value(struct nbt_sax *sax, nbt_type type);
+
+/* Streams `count` elements of `width` bytes through the chunk buffer. */
+int nbt_sax_elements(struct nbt_sax *sax, nbt_type elemtype, size_t width, nbt_int count) {
+    struct nbt_reader *rd = &sax->rd;
+
+    if (!sax->h->array_chunk)
+        return nbt_skip_elements(rd, elemtype, count);
+
+    NBT_READER_NEED(rd, (size_t)count * width, "array");
+
+    size_t per = NBT_SAX_CHUNK_BYTES / width;
+    for (size_t done = 0; done < (size_t)count; ) {
+        size_t n = (size_t)count - done < per ? (size_t)count - done : per;
+        const void *data = rd->cur;
+
+        /* bytes need no conversion and are handed over in place */
+        if (width > 1) {
+            memcpy(sax->chunk, rd->cur, n * width);
+            nbt_endian_be2h_array(sax->chunk, n, width);
+            data = sax->chunk;
+        }
+
+        rd->cur += n * width;
+        done += n;
+
+        NBT_SAX_CHECK(sax->h->array_chunk(sax->h->user, elemtype, data, n));
+    }
+
+    return NBT_SAX_CONTINUE;
+}
+
+int nbt_sax_array(struct nbt_sax *sax, nbt_type type, nbt_type elemtype, size_t width) {
+    struct nbt_reader *rd = &sax->rd;
+    nbt_int len;
+
+    if (nbt_read_int(rd, &len) < 0) return -1;
+    if (len < 0) NBT_READ_FAIL(rd, "NBT array has negative length: %d", len);
+
+    int r = NBT_SAX_CALL(sax, begin_array, type, len);
+    if (r == NBT_SAX_ABORT) return r;
+    if (r == NBT_SAX_SKIP) return nbt_skip_elements(rd, elemtype, len);
+
+    NBT_SAX_CHECK(nbt_sax_elements(sax, elemtype, width, len));
+    return NBT_SAX_END(sax, type);
+}
+
+int nbt_sax_list(struct nbt_sax *sax) {
+    struct nbt_reader *rd = &sax->rd;
+    nbt_type elemtype;
+    nbt_int len;
+
+    if (nbt_skip_list_header(rd, &elemtype, &len) < 0) return -1;
+
+    int r = NBT_SAX_CALL(sax, begin_list, elemtype, len);
+    if (r == NBT_SAX_ABORT) return r;
+    if (r == NBT_SAX_SKIP) return nbt_skip_elements(rd, elemtype, len);
+
+    if (len > 0 && elemtype <= NBT_TAG_DOUBLE) {
+        NBT_SAX_CHECK(nbt_sax_elements(sax, elemtype, nbt_type_size(elemtype), len));
+    } else {
+        for (nbt_int i = 0; i < len; ++i) {
+            r = nbt_sax_value(sax, elemtype);
+            if (r < 0) nbt_reader_error_index(rd, i);
+            if (r < 0 || r == NBT_SAX_ABORT) return r;
+        }
+    }
+
+    return NBT_SAX_END(sax, NBT_TAG_LIST);
+}
+
+int nbt_sax_compound(struct nbt_sax *sax) {
+    struct nbt_reader *rd = &sax->rd;
+
+    int r = NBT_SAX_CALL(sax, begin_compound);
+    if (r == NBT_SAX_ABORT) return r;
+    if (r == NBT_SAX_SKIP) return nbt_skip_value(rd, NBT_TAG_COMPOUND);
+
+    while (true) {
+        nbt_type type;
+        nbt_strlen namelen;
+
+        if (nbt_read_type(rd, &type) < 0) return -1;
+        if (type == NBT_TAG_END) break;
+
+        if (nbt_read_strlen(rd, &namelen) < 0) return -1;
+        NBT_READER_NEED(rd, namelen, "name");
+        const char *name = (const char *)rd->cur;
+        rd->cur += namelen;
+
+        r = NBT_SAX_CALL(sax, key, type, name, namelen);
+        if (r == NBT_SAX_ABORT) return r;
+
+        r = r == NBT_SAX_SKIP ? nbt_skip_value(rd, type) : nbt_sax_value(sax, type);
+        if (r < 0) nbt_reader_error_name(rd, name, namelen);
+        if (r < 0 || r == NBT_SAX_ABORT) return r;
+    }
+
+    return NBT_SAX_END(sax, NBT_TAG_COMPOUND);
+}
+
+int nbt_sax_value(struct nbt_sax *sax, nbt_type type) {
+    struct nbt_reader *rd = &sax->rd;
+    nbt_value value;
+    struct nbt_string str;
+
+    switch (type) {
+#define O(_ctype, _uname, _lname)                                              \
+        case NBT_TAG_ ## _uname:                                               \
+            if (nbt_read_ ## _lname(rd, &value.tag_ ## _lname) < 0) return -1; \
+            break;
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        case NBT_TAG_STRING:
+            if (nbt_read_strlen(rd, &str.len) < 0) return -1;
+            NBT_READER_NEED(rd, str.len, "string");
+            str.buf = (char *)rd->cur;
+            rd->cur += str.len;
+            value.tag_string = &str;
+            break;
+        case NBT_TAG_BYTE_ARRAY:
+            return nbt_sax_array(sax, type, NBT_TAG_BYTE, sizeof(nbt_byte));
+        case NBT_TAG_INT_ARRAY:
+            return nbt_sax_array(sax, type, NBT_TAG_INT, sizeof(nbt_int));
+        case NBT_TAG_LONG_ARRAY:
+            return nbt_sax_array(sax, type, NBT_TAG_LONG, sizeof(nbt_long));
+        case NBT_TAG_LIST:
+        case NBT_TAG_COMPOUND: {
+            if (nbt_reader_enter(rd) < 0) return -1;
+            int r = type == NBT_TAG_LIST ? nbt_sax_list(sax) : nbt_sax_compound(sax);
+            nbt_reader_leave(rd);
+            return r;
+        }
+        default:
+            NBT_READ_FAIL(rd, "Invalid NBT tag type %#02hhx", type);
+    }
+
+    return NBT_SAX_CALL(sax, scalar, type, value) == NBT_SAX_ABORT ? NBT_SAX_ABORT : NBT_SAX_CONTINUE;
+}
+
+int nbt_sax_parse(const unsigned char *data, size_t length, const struct nbt_sax_handler *handler, struct nbt_error *error) {
+    struct nbt_sax sax = {
+        .rd = { .start = data, .cur = data, .end = data + length, .depthlimit = NBT_DEFAULT_MAX_DEPTH },
+        .h = handler,
+    };
+    struct nbt_reader *rd = &sax.rd;
+    nbt_type roottype;
+    nbt_strlen namelen;
+    int r;
+
+    if (nbt_read_type(rd, &roottype) < 0) goto sax_error;
+    if (roottype != NBT_TAG_COMPOUND) {
+        nbt_reader_error(rd, "Root tag is not TAG_COMPOUND (%#02hhx)", roottype);
+        goto sax_error;
+    }
+
+    if (nbt_read_strlen(rd, &namelen) < 0) goto sax_error;
+    if (NBT_READER_LEFT(rd) < namelen) {
+        nbt_reader_error(rd, "Unexpected end of input reading NBT name: %zu < %zu", NBT_READER_LEFT(rd), (size_t)namelen);
+        goto sax_error;
+    }
+    const char *name = (const char *)rd->cur;
+    rd->cur += namelen;
+
+    r = NBT_SAX_CALL(&sax, key, roottype, name, namelen);
+    if (r == NBT_SAX_ABORT) return r;
+    if (r == NBT_SAX_SKIP) return 0;
+
+    r = nbt_sax_value(&sax, roottype);
+    if (r < 0) goto sax_error;
+
+    return r == NBT_SAX_ABORT ? NBT_SAX_ABORT : 0;
+
+sax_error:
+    nbt_reader_report(rd, error);
+    return -1;
+}
@@ -0,0 +1,277 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Skippers walk a value using only its length prefixes: nothing is
+ * allocated or byte-swapped, and runs of fixed-width data are stepped over
+ * with a single bounds check. The structure is still validated, so a
+ * skipped subtree fails exactly where reading it would have. */
+
+int nbt_skip_elements(struct nbt_reader *rd, nbt_type elemtype, nbt_int count) {
+    if (count == 0) return 0;
+
+    switch (elemtype) {
+#define O(_ctype, _uname, _lname) \
+        case NBT_TAG_ ## _uname:
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        {
+            size_t width = nbt_type_size(elemtype);
+            if ((size_t)count > SIZE_MAX / width)
+                NBT_READ_FAIL(rd, "NBT value is too long: %d elements", count);
+
+            NBT_READER_NEED(rd, (size_t)count * width, "numeric list");
+            rd->cur += (size_t)count * width;
+            return 0;
+        }
+
+        default:
+            for (nbt_int i = 0; i < count; ++i) {
+                if (nbt_skip_value(rd, elemtype) < 0) {
+                    nbt_reader_error_index(rd, i);
+                    return -1;
+                }
+            }
+            return 0;
+    }
+}
+
+int nbt_skip_list_header(struct nbt_reader *rd, nbt_type *elemtype, nbt_int *length) {
+    if (nbt_read_type(rd, elemtype) < 0 || nbt_read_int(rd, length) < 0) return -1;
+
+    if (*length < 0)
+        NBT_READ_FAIL(rd, "NBT list has negative length: %d", *length);
+    if (*length > 0 && *elemtype == NBT_TAG_END)
+        NBT_READ_FAIL(rd, "NBT list has %d (> 0) value(s) of type NBT_TAG_END", *length);
+    if (*length > 0 && nbt_type_size(*elemtype) == 0)
+        NBT_READ_FAIL(rd, "NBT list has invalid element type %#02hhx", *elemtype);
+
+    return 0;
+}
+
+/* Scalars, strings and arrays: values without children. */
+int nbt_skip_leaf(struct nbt_reader *rd, nbt_type type) {
+    nbt_strlen len16;
+    nbt_int len;
+
+    switch (type) {
+#define O(_ctype, _uname, _lname)                            \
+        case NBT_TAG_ ## _uname:                             \
+            NBT_READER_NEED(rd, sizeof(_ctype), #_lname);    \
+            rd->cur += sizeof(_ctype);                       \
+            return 0;
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        case NBT_TAG_STRING:
+            if (nbt_read_strlen(rd, &len16) < 0) return -1;
+            NBT_READER_NEED(rd, len16, "string");
+            rd->cur += len16;
+            return 0;
+
+        case NBT_TAG_BYTE_ARRAY:
+            if (nbt_read_int(rd, &len) < 0) return -1;
+            if (len < 0) NBT_READ_FAIL(rd, "NBT byte array has negative length: %d", len);
+            return nbt_skip_elements(rd, NBT_TAG_BYTE, len);
+        case NBT_TAG_INT_ARRAY:
+            if (nbt_read_int(rd, &len) < 0) return -1;
+            if (len < 0) NBT_READ_FAIL(rd, "NBT int array has negative length: %d", len);
+            return nbt_skip_elements(rd, NBT_TAG_INT, len);
+        case NBT_TAG_LONG_ARRAY:
+            if (nbt_read_int(rd, &len) < 0) return -1;
+            if (len < 0) NBT_READ_FAIL(rd, "NBT long array has negative length: %d", len);
+            return nbt_skip_elements(rd, NBT_TAG_LONG, len);
+
+        default:
+            NBT_READ_FAIL(rd, "Invalid NBT tag type %#02hhx", type);
+    }
+}
+
+/* A compound or list being stepped over by nbt_skip_value(). */
+struct nbt_skip_frame {
+    nbt_type type;
+
+    /* compounds: name of the entry being skipped, for errors */
+    const char *name;
+    nbt_strlen namelen;
+
+    /* lists of strings, arrays, lists or compounds */
+    nbt_type elemtype;
+    nbt_int index;
+    nbt_int length;
+};
+
+#define NBT_SKIP_FRAMES (32)
+
+/* Iterative like nbt_read_value(), so that filtered and lazy reads, which
+ * skip through whatever they do not decode, nest as deep as rd->depthlimit
+ * allows without using the stack of the calling thread. */
+int nbt_skip_value(struct nbt_reader *rd, nbt_type type) {
+    struct nbt_skip_frame frames[NBT_SKIP_FRAMES];
+    struct nbt_skip_frame *stack = frames, *top = NULL;
+    size_t depth = 0, capacity = NBT_SKIP_FRAMES;
+    int ret = -1;
+
+    while (true) {
+        /* skip a value of `type`, or open it */
+        if (type == NBT_TAG_COMPOUND || type == NBT_TAG_LIST) {
+            nbt_type elemtype = NBT_TAG_END;
+            nbt_int length = 0;
+
+            if (nbt_reader_enter(rd) < 0) goto skip_error_cleanup;
+
+            if (type == NBT_TAG_LIST) {
+                if (nbt_skip_list_header(rd, &elemtype, &length) < 0) {
+                    nbt_reader_leave(rd);
+                    goto skip_error_cleanup;
+                }
+
+                /* numbers or nothing: one step */
+                if (length == 0 || elemtype <= NBT_TAG_DOUBLE) {
+                    int r = nbt_skip_elements(rd, elemtype, length);
+                    nbt_reader_leave(rd);
+                    if (r < 0) goto skip_error_cleanup;
+                    goto skip_next;
+                }
+            }
+
+            if (depth == capacity) {
+                struct nbt_skip_frame *temp = stack == frames ? malloc(capacity * 2 * sizeof(struct nbt_skip_frame))
+                                                              : realloc(stack, capacity * 2 * sizeof(struct nbt_skip_frame));
+                if (!temp) {
+                    nbt_reader_error(rd, "Unable to allocate memory for NBT reader stack");
+                    nbt_reader_leave(rd);
+                    goto skip_error_cleanup;
+                }
+                if (stack == frames) memcpy(temp, frames, sizeof(frames));
+                stack = temp;
+                capacity *= 2;
+            }
+
+            top = &stack[depth++];
+            top->type = type;
+            top->name = NULL;
+            top->namelen = 0;
+            top->elemtype = elemtype;
+            top->index = -1;
+            top->length = length;
+        } else if (nbt_skip_leaf(rd, type) < 0) {
+            goto skip_error_cleanup;
+        }
+
+skip_next:
+        /* find the next value to skip, closing finished containers */
+        while (depth > 0) {
+            if (top->type == NBT_TAG_LIST) {
+                if (++top->index < top->length) {
+                    type = top->elemtype;
+                    break;
+                }
+            } else {
+                nbt_strlen namelen;
+
+                top->name = NULL;
+                if (nbt_read_type(rd, &type) < 0) goto skip_error_cleanup;
+
+                if (type != NBT_TAG_END) {
+                    if (nbt_read_strlen(rd, &namelen) < 0) goto skip_error_cleanup;
+                    if (NBT_READER_LEFT(rd) < namelen) {
+                        nbt_reader_error(rd, "Unexpected end of input reading NBT name: %zu < %zu",
+                                         NBT_READER_LEFT(rd), (size_t)namelen);
+                        goto skip_error_cleanup;
+                    }
+
+                    top->name = (const char *)rd->cur;
+                    top->namelen = namelen;
+                    rd->cur += namelen;
+                    break;
+                }
+            }
+
+            nbt_reader_leave(rd);
+            top = --depth > 0 ? &stack[depth - 1] : NULL;
+        }
+
+        if (depth == 0) break;
+    }
+
+    ret = 0;
+    goto skip_done;
+
+skip_error_cleanup:
+    /* the path of the failure, innermost first */
+    for (size_t i = depth; i-- > 0; ) {
+        if (stack[i].type == NBT_TAG_LIST)
+            nbt_reader_error_index(rd, stack[i].index);
+        else if (stack[i].name)
+            nbt_reader_error_name(rd, stack[i].name, stack[i].namelen);
+    }
+
+    rd->depth -= (unsigned)depth;
+
+skip_done:
+    if (stack != frames) free(stack);
+    return ret;
+}
+
+/* Looks for `name` among the selected paths that continue the current
+ * prefix. A path ending at `name` keeps the whole value; a path running
+ * past it means the value is a compound (or a list of them) to filter. */
+int nbt_filter_match(const struct nbt_read_filter *f, const char *name, nbt_strlen namelen, const char **next) {
+    int ret = NBT_FILTER_DROP;
+    size_t off = f->prefixlen ? f->prefixlen + 1 : 0;
+
+    for (size_t i = 0; i < f->npaths; ++i) {
+        const char *path = f->paths[i];
+        size_t pathlen = strlen(path);
+
+        if (pathlen < off + namelen) continue;
+        if (f->prefixlen && (memcmp(path, f->prefix, f->prefixlen) != 0 || path[f->prefixlen] != '.')) continue;
+        if (memcmp(path + off, name, namelen) != 0) continue;
+
+        if (path[off + namelen] == '\0') return NBT_FILTER_KEEP;
+        if (path[off + namelen] == '.') {
+            ret = NBT_FILTER_DESCEND;
+            *next = path;
+        }
+    }
+
+    return ret;
+}
+
+int nbt_filter_entry(struct nbt_reader *rd, nbt_type type) {
+    const unsigned char *entry = rd->cur;
+    nbt_strlen namelen;
+    const char *next = NULL;
+
+    if (nbt_read_strlen(rd, &namelen) < 0) return -1;
+    NBT_READER_NEED(rd, namelen, "name");
+    const char *name = (const char *)rd->cur;
+    rd->cur += namelen;
+
+    switch (nbt_filter_match(&rd->filter, name, namelen, &next)) {
+        case NBT_FILTER_KEEP:
+            rd->filter.active = false;
+            break;
+        case NBT_FILTER_DESCEND:
+            rd->filter.prefix = next;
+            rd->filter.prefixlen = (rd->filter.prefixlen ? rd->filter.prefixlen + 1 : 0) + namelen;
+            break;
+        default:
+            if (nbt_skip_value(rd, type) < 0) {
+                nbt_reader_error_name(rd, name, namelen);
+                return -1;
+            }
+            return 1;
+    }
+
+    /* kept: rewind so the caller reads the name itself */
+    rd->cur = entry;
+    return 0;
+}
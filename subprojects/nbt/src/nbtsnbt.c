@@ -0,0 +1,1122 @@
+#include "nbt_snbt.h"
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_internal.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Output is produced by reserving the most a piece can take (a number, an
+ * escaped string, a whole array of integers) and writing it through a raw
+ * pointer, so there is one capacity check per piece rather than one per
+ * character, and no printf outside of non-integral floats. */
+
+struct nbt_snbt_writer {
+    struct nbt_buffer *out;
+    bool pretty;
+    unsigned indent;
+    unsigned depth;
+};
+
+static const char nbt_digit_pairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char nbt_hex_digits[16] = "0123456789abcdef";
+
+/* Decimal, two digits per division; returns the end of the output. */
+char *nbt_format_u64(char *p, uint64_t v) {
+    char buf[20], *q = buf + sizeof(buf);
+
+    while (v >= 100) {
+        q -= 2;
+        memcpy(q, nbt_digit_pairs + (v % 100) * 2, 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        q -= 2;
+        memcpy(q, nbt_digit_pairs + v * 2, 2);
+    } else {
+        *--q = (char)('0' + v);
+    }
+
+    size_t len = (size_t)(buf + sizeof(buf) - q);
+    memcpy(p, q, len);
+    return p + len;
+}
+
+char *nbt_format_i64(char *p, int64_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        return nbt_format_u64(p, -(uint64_t)v);
+    }
+    return nbt_format_u64(p, (uint64_t)v);
+}
+
+/* Digits that read back as the same float or double: integral values
+ * (most counters and block coordinates) go through the integer path, the
+ * rest try the short precision before the one that is always exact.
+ * Needs NBT_FORMAT_DOUBLE_CHARS bytes at `p`. */
+char *nbt_format_double(char *p, double v, bool single) {
+    if (isnan(v)) {
+        memcpy(p, "NaN", 3);
+        return p + 3;
+    } else if (isinf(v)) {
+        if (v < 0) *p++ = '-';
+        memcpy(p, "Infinity", 8);
+        return p + 8;
+    }
+
+    if (v > -1e15 && v < 1e15 && v == (double)(int64_t)v) {
+        if (v == 0 && signbit(v)) *p++ = '-';
+        p = nbt_format_i64(p, (int64_t)v);
+        memcpy(p, ".0", 2);
+        return p + 2;
+    }
+
+    int len = snprintf(p, NBT_FORMAT_DOUBLE_CHARS, "%.*g", single ? 6 : 15, v);
+    if (single ? strtof(p, NULL) != (float)v : strtod(p, NULL) != v)
+        len = snprintf(p, NBT_FORMAT_DOUBLE_CHARS, "%.*g", single ? 9 : 17, v);
+
+    /* large integral values print without a point or an exponent */
+    if (!memchr(p, '.', (size_t)len) && !memchr(p, 'e', (size_t)len)) {
+        memcpy(p + len, ".0", 2);
+        len += 2;
+    }
+    return p + len;
+}
+
+static inline bool nbt_snbt_bare_char(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '_' || c == '-' || c == '.' || c == '+';
+}
+
+static inline char *nbt_snbt_reserve(struct nbt_snbt_writer *w, size_t n) {
+    if (nbt_buffer_reserve(w->out, n) < 0) {
+        nbt_set_error("Unable to allocate memory for SNBT output");
+        return NULL;
+    }
+    return (char *)w->out->data + w->out->length;
+}
+
+static inline void nbt_snbt_commit(struct nbt_snbt_writer *w, char *p) {
+    w->out->length = (size_t)((unsigned char *)p - w->out->data);
+}
+
+static inline int nbt_snbt_put(struct nbt_snbt_writer *w, const char *s, size_t len) {
+    char *p = nbt_snbt_reserve(w, len);
+    if (!p) return -1;
+    memcpy(p, s, len);
+    nbt_snbt_commit(w, p + len);
+    return 0;
+}
+
+/* Pretty output: a line break and the indentation of the current depth. */
+int nbt_snbt_newline(struct nbt_snbt_writer *w) {
+    if (!w->pretty) return 0;
+
+    size_t spaces = (size_t)w->depth * w->indent;
+    char *p = nbt_snbt_reserve(w, 1 + spaces);
+    if (!p) return -1;
+
+    *p++ = '\n';
+    memset(p, ' ', spaces);
+    nbt_snbt_commit(w, p + spaces);
+    return 0;
+}
+
+static inline int nbt_snbt_separator(struct nbt_snbt_writer *w) {
+    return w->pretty ? nbt_snbt_put(w, ", ", 2) : nbt_snbt_put(w, ",", 1);
+}
+
+/* Needs 4 * len + 2 bytes at `p`. */
+char *nbt_snbt_quote(char *p, const char *s, size_t len) {
+    *p++ = '"';
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f) {
+            *p++ = (char)c;
+            continue;
+        }
+
+        *p++ = '\\';
+        switch (c) {
+            case '"':
+            case '\\':
+                *p++ = (char)c;
+                break;
+            case '\b': *p++ = 'b'; break;
+            case '\f': *p++ = 'f'; break;
+            case '\n': *p++ = 'n'; break;
+            case '\r': *p++ = 'r'; break;
+            case '\t': *p++ = 't'; break;
+            default:
+                *p++ = 'x';
+                *p++ = nbt_hex_digits[c >> 4];
+                *p++ = nbt_hex_digits[c & 0xf];
+                break;
+        }
+    }
+    *p++ = '"';
+    return p;
+}
+
+int nbt_snbt_string(struct nbt_snbt_writer *w, const char *s, size_t len) {
+    char *p = nbt_snbt_reserve(w, 4 * len + 2);
+    if (!p) return -1;
+    nbt_snbt_commit(w, nbt_snbt_quote(p, s, len));
+    return 0;
+}
+
+int nbt_snbt_key(struct nbt_snbt_writer *w, const char *name, size_t len) {
+    char *p = nbt_snbt_reserve(w, 4 * len + 4);
+    if (!p) return -1;
+
+    bool bare = len > 0;
+    for (size_t i = 0; bare && i < len; ++i)
+        bare = nbt_snbt_bare_char((unsigned char)name[i]);
+
+    if (bare) {
+        memcpy(p, name, len);
+        p += len;
+    } else {
+        p = nbt_snbt_quote(p, name, len);
+    }
+
+    *p++ = ':';
+    if (w->pretty) *p++ = ' ';
+    nbt_snbt_commit(w, p);
+    return 0;
+}
+
+/* Most characters one integer element can take, suffix included. */
+static inline size_t nbt_snbt_int_chars(nbt_type type) {
+    switch (type) {
+        case NBT_TAG_BYTE: return 5;   /* -128b */
+        case NBT_TAG_SHORT: return 7;  /* -32768s */
+        case NBT_TAG_INT: return 11;   /* -2147483648 */
+        default: return 21;            /* -9223372036854775808L */
+    }
+}
+
+/* An array or a list of integers: the opening (e.g. "[I;") then every
+ * element, written after a single reservation for all of them. */
+int nbt_snbt_ints(struct nbt_snbt_writer *w, const char *open, nbt_type type, const void *data, nbt_int count) {
+    size_t each = nbt_snbt_int_chars(type) + 2;
+    if ((size_t)count > (SIZE_MAX - 8) / each) {
+        nbt_set_error("NBT array is too long for SNBT: %d", count);
+        return -1;
+    }
+
+    size_t openlen = strlen(open);
+    char *p = nbt_snbt_reserve(w, openlen + 2 + (size_t)count * each);
+    if (!p) return -1;
+
+    memcpy(p, open, openlen);
+    p += openlen;
+    if (w->pretty && count > 0 && open[openlen - 1] == ';') *p++ = ' ';
+
+#define NBT_SNBT_INTS(_ctype, _suffix)                           \
+    for (nbt_int i = 0; i < count; ++i) {                        \
+        if (i > 0) {                                             \
+            *p++ = ',';                                          \
+            if (w->pretty) *p++ = ' ';                           \
+        }                                                        \
+        p = nbt_format_i64(p, ((const _ctype *)data)[i]);        \
+        if (_suffix) *p++ = _suffix;                             \
+    }
+
+    switch (type) {
+        case NBT_TAG_BYTE:
+            NBT_SNBT_INTS(nbt_byte, 'b')
+            break;
+        case NBT_TAG_SHORT:
+            NBT_SNBT_INTS(nbt_short, 's')
+            break;
+        case NBT_TAG_INT:
+            NBT_SNBT_INTS(nbt_int, 0)
+            break;
+        default:
+            NBT_SNBT_INTS(nbt_long, 'L')
+            break;
+    }
+
+#undef NBT_SNBT_INTS
+
+    *p++ = ']';
+    nbt_snbt_commit(w, p);
+    return 0;
+}
+
+int nbt_snbt_float(struct nbt_snbt_writer *w, double v, bool single) {
+    char *p = nbt_snbt_reserve(w, NBT_FORMAT_DOUBLE_CHARS + 1);
+    if (!p) return -1;
+    p = nbt_format_double(p, v, single);
+    *p++ = single ? 'f' : 'd';
+    nbt_snbt_commit(w, p);
+    return 0;
+}
+
+int nbt_snbt_value(struct nbt_snbt_writer *w, nbt_type type, nbt_value value);
+
+int nbt_snbt_compound(struct nbt_snbt_writer *w, const struct nbt_compound *compound) {
+    if (!compound || !compound->first) return nbt_snbt_put(w, "{}", 2);
+
+    if (nbt_snbt_put(w, "{", 1) < 0) return -1;
+    ++w->depth;
+
+    for (struct nbt_compound_entry *cur = compound->first; cur; cur = cur->next) {
+        if (cur != compound->first && nbt_snbt_put(w, ",", 1) < 0) return -1;
+        if (nbt_snbt_newline(w) < 0) return -1;
+        if (nbt_snbt_key(w, cur->name, cur->namelen) < 0) return -1;
+        if (nbt_snbt_value(w, cur->tag.type, cur->tag.value) < 0) return -1;
+    }
+
+    --w->depth;
+    if (nbt_snbt_newline(w) < 0) return -1;
+    return nbt_snbt_put(w, "}", 1);
+}
+
+int nbt_snbt_list(struct nbt_snbt_writer *w, const struct nbt_list *list) {
+    if (!list || list->length == 0) return nbt_snbt_put(w, "[]", 2);
+
+    if (list->length < 0) {
+        nbt_set_error("NBT list has negative length: %d", list->length);
+        return -1;
+    }
+
+    switch (list->type) {
+        case NBT_TAG_BYTE:
+        case NBT_TAG_SHORT:
+        case NBT_TAG_INT:
+        case NBT_TAG_LONG:
+            return nbt_snbt_ints(w, "[", list->type, list->data.raw, list->length);
+        case NBT_TAG_FLOAT:
+        case NBT_TAG_DOUBLE:
+        case NBT_TAG_BYTE_ARRAY:
+        case NBT_TAG_STRING:
+        case NBT_TAG_INT_ARRAY:
+        case NBT_TAG_LONG_ARRAY:
+            /* on one line, like numbers */
+            if (nbt_snbt_put(w, "[", 1) < 0) return -1;
+            for (nbt_int i = 0; i < list->length; ++i) {
+                if (i > 0 && nbt_snbt_separator(w) < 0) return -1;
+                if (nbt_snbt_value(w, list->type, nbt_list_get(list, i)) < 0) return -1;
+            }
+            return nbt_snbt_put(w, "]", 1);
+        case NBT_TAG_LIST:
+        case NBT_TAG_COMPOUND:
+            /* one element per line */
+            if (nbt_snbt_put(w, "[", 1) < 0) return -1;
+            ++w->depth;
+            for (nbt_int i = 0; i < list->length; ++i) {
+                if (i > 0 && nbt_snbt_put(w, ",", 1) < 0) return -1;
+                if (nbt_snbt_newline(w) < 0) return -1;
+                if (nbt_snbt_value(w, list->type, nbt_list_get(list, i)) < 0) return -1;
+            }
+            --w->depth;
+            if (nbt_snbt_newline(w) < 0) return -1;
+            return nbt_snbt_put(w, "]", 1);
+        default:
+            nbt_set_error("NBT list has invalid element type %#02hhx", list->type);
+            return -1;
+    }
+}
+
+#define NBT_SNBT_ARRAY(_arr, _t, _open)                                               \
+do {                                                                                  \
+    if ((_arr) && (_arr)->len < 0) {                                                  \
+        nbt_set_error("NBT " #_t " array has negative length: %d", (_arr)->len);      \
+        return -1;                                                                    \
+    }                                                                                 \
+    return (_arr) ? nbt_snbt_ints(w, _open, NBT_TAG_ ## _t, (_arr)->buf, (_arr)->len) \
+                  : nbt_snbt_put(w, _open "]", sizeof(_open));                        \
+} while (0)
+
+int nbt_snbt_value(struct nbt_snbt_writer *w, nbt_type type, nbt_value value) {
+    switch (type) {
+        case NBT_TAG_BYTE:
+        case NBT_TAG_SHORT:
+        case NBT_TAG_INT:
+        case NBT_TAG_LONG: {
+            nbt_long v = type == NBT_TAG_BYTE ? value.tag_byte
+                       : type == NBT_TAG_SHORT ? value.tag_short
+                       : type == NBT_TAG_INT ? value.tag_int
+                       : value.tag_long;
+            char *p = nbt_snbt_reserve(w, 21);
+            if (!p) return -1;
+            p = nbt_format_i64(p, v);
+            if (type == NBT_TAG_BYTE) *p++ = 'b';
+            else if (type == NBT_TAG_SHORT) *p++ = 's';
+            else if (type == NBT_TAG_LONG) *p++ = 'L';
+            nbt_snbt_commit(w, p);
+            return 0;
+        }
+        case NBT_TAG_FLOAT:
+            return nbt_snbt_float(w, value.tag_float, true);
+        case NBT_TAG_DOUBLE:
+            return nbt_snbt_float(w, value.tag_double, false);
+        case NBT_TAG_BYTE_ARRAY:
+            NBT_SNBT_ARRAY(value.tag_byte_array, BYTE, "[B;");
+        case NBT_TAG_STRING:
+            if (!value.tag_string) return nbt_snbt_put(w, "\"\"", 2);
+            return nbt_snbt_string(w, value.tag_string->buf, value.tag_string->len);
+        case NBT_TAG_LIST:
+            return nbt_snbt_list(w, value.tag_list);
+        case NBT_TAG_COMPOUND:
+            return nbt_snbt_compound(w, value.tag_compound);
+        case NBT_TAG_INT_ARRAY:
+            NBT_SNBT_ARRAY(value.tag_int_array, INT, "[I;");
+        case NBT_TAG_LONG_ARRAY:
+            NBT_SNBT_ARRAY(value.tag_long_array, LONG, "[L;");
+        default:
+            nbt_set_error("Invalid NBT tag type %#02hhx", type);
+            return -1;
+    }
+}
+
+#undef NBT_SNBT_ARRAY
+
+int nbt_snbt_write_value(nbt_type type, nbt_value value, struct nbt_buffer *out, const struct nbt_snbt_options *options) {
+    struct nbt_snbt_writer w = {
+        .out = out,
+        .pretty = options && options->pretty,
+        .indent = options && options->indent ? options->indent : 4,
+    };
+    size_t start = out->length;
+
+    if (nbt_snbt_value(&w, type, value) < 0) {
+        out->length = start;
+        nbt_fill_error(options ? options->error : NULL, 0, "");
+        return -1;
+    }
+    return 0;
+}
+
+int nbt_snbt_write(const struct nbt_parsed *parsed, struct nbt_buffer *out, const struct nbt_snbt_options *options) {
+    nbt_value root = { .tag_compound = parsed->root };
+    return nbt_snbt_write_value(NBT_TAG_COMPOUND, root, out, options);
+}
+
+/* The parser is recursive descent over an nbt_reader, so it shares the
+ * tree reader's allocation, limits and error paths; offsets are bytes of
+ * text. Lists and arrays are gathered in a scratch buffer, since their
+ * length is only known at the closing bracket, then copied into the tree
+ * at their final size. */
+
+struct nbt_snbt_parser {
+    struct nbt_reader rd;
+    struct nbt_buffer text;  /* unescaped contents of the last quoted string */
+};
+
+struct nbt_snbt_number {
+    nbt_type type;
+    int64_t i;   /* integer types */
+    float f;
+    double d;
+};
+
+static inline void nbt_snbt_skip_space(struct nbt_reader *rd) {
+    while (rd->cur < rd->end && (*rd->cur == ' ' || *rd->cur == '\n' || *rd->cur == '\t' || *rd->cur == '\r'))
+        ++rd->cur;
+}
+
+static inline bool nbt_snbt_at(struct nbt_reader *rd, unsigned char c) {
+    return rd->cur < rd->end && *rd->cur == c;
+}
+
+int nbt_snbt_unexpected(struct nbt_reader *rd, const char *expected) {
+    if (rd->cur == rd->end)
+        NBT_READ_FAIL(rd, "Unexpected end of SNBT input, expected %s", expected);
+
+    unsigned char c = *rd->cur;
+    if (c >= 0x20 && c < 0x7f)
+        NBT_READ_FAIL(rd, "Unexpected '%c' in SNBT input, expected %s", c, expected);
+    NBT_READ_FAIL(rd, "Unexpected byte %#02hhx in SNBT input, expected %s", c, expected);
+}
+
+/* Called on a backslash, with room for 6 more bytes in sp->text. */
+int nbt_snbt_read_escape(struct nbt_snbt_parser *sp) {
+    struct nbt_reader *rd = &sp->rd;
+    const unsigned char *at = rd->cur++;
+    unsigned char *p = sp->text.data + sp->text.length;
+
+    if (rd->cur == rd->end) {
+        rd->cur = at;
+        NBT_READ_FAIL(rd, "Unterminated escape sequence in SNBT string");
+    }
+
+    unsigned char c = *rd->cur++;
+    size_t digits = 0;
+    switch (c) {
+        case '\\':
+        case '\'':
+        case '"':
+            *p++ = c;
+            break;
+        case 'b': *p++ = '\b'; break;
+        case 'f': *p++ = '\f'; break;
+        case 'n': *p++ = '\n'; break;
+        case 'r': *p++ = '\r'; break;
+        case 's': *p++ = ' '; break;
+        case 't': *p++ = '\t'; break;
+        case 'x': digits = 2; break;
+        case 'u': digits = 4; break;
+        case 'U': digits = 8; break;
+        default:
+            rd->cur = at;
+            NBT_READ_FAIL(rd, "Invalid escape sequence in SNBT string: \\%c", c);
+    }
+
+    if (digits) {
+        uint32_t cp = 0;
+        for (size_t i = 0; i < digits; ++i, ++rd->cur) {
+            unsigned char h = rd->cur < rd->end ? *rd->cur : 0;
+            unsigned v = h >= '0' && h <= '9' ? h - '0'
+                       : (h | 0x20) >= 'a' && (h | 0x20) <= 'f' ? (h | 0x20) - 'a' + 10
+                       : 16;
+            if (v == 16) {
+                rd->cur = at;
+                NBT_READ_FAIL(rd, "Invalid \\%c escape sequence in SNBT string", c);
+            }
+            cp = cp << 4 | v;
+        }
+
+        if (cp > 0x10ffff) {
+            rd->cur = at;
+            NBT_READ_FAIL(rd, "Escaped code point out of range in SNBT string: %#x", cp);
+        }
+        /* \x is a byte, which is how control characters are written */
+        if (digits == 2) *p++ = (unsigned char)cp;
+        else p = nbt_put_mutf8(p, cp);
+    }
+
+    sp->text.length = (size_t)(p - sp->text.data);
+    return 0;
+}
+
+/* Unescapes the string under the cursor into sp->text. */
+int nbt_snbt_read_quoted(struct nbt_snbt_parser *sp) {
+    struct nbt_reader *rd = &sp->rd;
+    const unsigned char *open = rd->cur;
+    unsigned char quote = *rd->cur++;
+
+    sp->text.length = 0;
+    while (true) {
+        const unsigned char *run = rd->cur;
+        while (rd->cur < rd->end && *rd->cur != quote && *rd->cur != '\\') ++rd->cur;
+
+        size_t runlen = (size_t)(rd->cur - run);
+        if (nbt_buffer_reserve(&sp->text, runlen + 6) < 0)
+            NBT_READ_FAIL(rd, "Unable to allocate memory for SNBT string");
+        memcpy(sp->text.data + sp->text.length, run, runlen);
+        sp->text.length += runlen;
+
+        if (rd->cur == rd->end) {
+            rd->cur = open;
+            NBT_READ_FAIL(rd, "Unterminated SNBT string");
+        } else if (*rd->cur == quote) {
+            ++rd->cur;
+            break;
+        }
+
+        if (nbt_snbt_read_escape(sp) < 0) return -1;
+    }
+
+    if (sp->text.length > UINT16_MAX) {
+        rd->cur = open;
+        NBT_READ_FAIL(rd, "SNBT string is longer than 65535 bytes: %zu", sp->text.length);
+    }
+    return 0;
+}
+
+/* true and false; NaN and the infinities, as this library writes them. */
+int nbt_snbt_special(const char *s, size_t len, struct nbt_snbt_number *num) {
+    if ((len == 4 && strncasecmp(s, "true", 4) == 0) || (len == 5 && strncasecmp(s, "false", 5) == 0)) {
+        num->type = NBT_TAG_BYTE;
+        num->i = len == 4;
+        return 0;
+    }
+
+    double v;
+    if (len == 4 && memcmp(s, "NaN", 3) == 0) v = NAN;
+    else if (len == 9 && memcmp(s, "Infinity", 8) == 0) v = INFINITY;
+    else if (len == 10 && memcmp(s, "-Infinity", 9) == 0) v = -INFINITY;
+    else return 1;
+
+    switch (s[len - 1]) {
+        case 'f': num->type = NBT_TAG_FLOAT; break;
+        case 'd': num->type = NBT_TAG_DOUBLE; break;
+        default: return 1;
+    }
+    num->f = (float)v;
+    num->d = v;
+    return 0;
+}
+
+/* Classifies a bare token the way Minecraft does: 1b, 2s, 3, 4L, 5f, 6d,
+ * and 7.0 or 8e0 as doubles; integers with leading zeros are strings.
+ * Returns 0 for a number, 1 for a string, and -1 (with the cursor on the
+ * token) for a number out of its type's range. */
+int nbt_snbt_number(struct nbt_snbt_parser *sp, const unsigned char *tok, size_t len, struct nbt_snbt_number *num) {
+    const unsigned char *p = tok, *end = tok + len;
+    bool neg = false, point = false, exp = false;
+
+    if (p < end && (*p == '+' || *p == '-')) neg = *p++ == '-';
+
+    const unsigned char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9') ++p;
+    size_t intlen = (size_t)(p - digits), fraclen = 0;
+
+    if (p < end && *p == '.') {
+        const unsigned char *frac = ++p;
+        while (p < end && *p >= '0' && *p <= '9') ++p;
+        fraclen = (size_t)(p - frac);
+        point = true;
+    }
+
+    if (intlen + fraclen == 0)
+        return point ? 1 : nbt_snbt_special((const char *)tok, len, num);
+
+    if (p < end && (*p | 0x20) == 'e') {
+        const unsigned char *q = p + 1;
+        if (q < end && (*q == '+' || *q == '-')) ++q;
+        const unsigned char *expdigits = q;
+        while (q < end && *q >= '0' && *q <= '9') ++q;
+        if (q == expdigits) return 1;
+        p = q;
+        exp = true;
+    }
+
+    unsigned char suffix = 0;
+    if (p < end) suffix = *p++ | 0x20;
+    if (p != end) return 1;
+
+    if (point || exp) {
+        if (suffix == 'f') num->type = NBT_TAG_FLOAT;
+        else if (suffix == 0 || suffix == 'd') num->type = NBT_TAG_DOUBLE;
+        else return 1;
+    } else {
+        switch (suffix) {
+            case 0: num->type = NBT_TAG_INT; break;
+            case 'b': num->type = NBT_TAG_BYTE; break;
+            case 's': num->type = NBT_TAG_SHORT; break;
+            case 'l': num->type = NBT_TAG_LONG; break;
+            case 'f': num->type = NBT_TAG_FLOAT; break;
+            case 'd': num->type = NBT_TAG_DOUBLE; break;
+            default: return 1;
+        }
+    }
+
+    if (num->type == NBT_TAG_FLOAT || num->type == NBT_TAG_DOUBLE) {
+        /* strtod() wants a terminated copy without the suffix */
+        size_t numlen = suffix ? len - 1 : len;
+        if (nbt_buffer_reserve(&sp->text, numlen + 1) < 0) {
+            sp->rd.cur = tok;
+            NBT_READ_FAIL(&sp->rd, "Unable to allocate memory for SNBT number");
+        }
+
+        char *copy = (char *)sp->text.data;
+        memcpy(copy, tok, numlen);
+        copy[numlen] = '\0';
+        if (num->type == NBT_TAG_FLOAT) num->f = strtof(copy, NULL);
+        else num->d = strtod(copy, NULL);
+        return 0;
+    }
+
+    if (intlen > 1 && digits[0] == '0') return 1;
+
+    uint64_t max;
+    switch (num->type) {
+        case NBT_TAG_BYTE: max = INT8_MAX; break;
+        case NBT_TAG_SHORT: max = INT16_MAX; break;
+        case NBT_TAG_INT: max = INT32_MAX; break;
+        default: max = INT64_MAX; break;
+    }
+    if (neg) ++max;
+
+    uint64_t v = 0;
+    for (const unsigned char *d = digits; d < digits + intlen; ++d) {
+        if (v > (max - (uint64_t)(*d - '0')) / 10) {
+            sp->rd.cur = tok;
+            NBT_READ_FAIL(&sp->rd, "Number out of range in SNBT: %.*s", (int)len, (const char *)tok);
+        }
+        v = v * 10 + (uint64_t)(*d - '0');
+    }
+
+    num->i = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return 0;
+}
+
+static inline const unsigned char *nbt_snbt_bare_token(struct nbt_reader *rd) {
+    const unsigned char *tok = rd->cur;
+    while (rd->cur < rd->end && nbt_snbt_bare_char(*rd->cur)) ++rd->cur;
+    return tok;
+}
+
+int nbt_snbt_read_bare(struct nbt_snbt_parser *sp, nbt_type *type, nbt_value *out) {
+    struct nbt_reader *rd = &sp->rd;
+    const unsigned char *tok = nbt_snbt_bare_token(rd);
+    size_t len = (size_t)(rd->cur - tok);
+    struct nbt_snbt_number num;
+
+    if (len == 0) return nbt_snbt_unexpected(rd, "a value");
+
+    int r = nbt_snbt_number(sp, tok, len, &num);
+    if (r < 0) return -1;
+
+    if (r > 0) {
+        if (len > UINT16_MAX) {
+            rd->cur = tok;
+            NBT_READ_FAIL(rd, "SNBT string is longer than 65535 bytes: %zu", len);
+        }
+        *type = NBT_TAG_STRING;
+        return nbt_reader_make_string(rd, tok, len, &out->tag_string);
+    }
+
+    *type = num.type;
+    switch (num.type) {
+        case NBT_TAG_BYTE: out->tag_byte = (nbt_byte)num.i; break;
+        case NBT_TAG_SHORT: out->tag_short = (nbt_short)num.i; break;
+        case NBT_TAG_INT: out->tag_int = (nbt_int)num.i; break;
+        case NBT_TAG_LONG: out->tag_long = num.i; break;
+        case NBT_TAG_FLOAT: out->tag_float = num.f; break;
+        default: out->tag_double = num.d; break;
+    }
+    return 0;
+}
+
+int nbt_snbt_read_value(struct nbt_snbt_parser *sp, nbt_type *type, nbt_value *out);
+
+int nbt_snbt_read_compound(struct nbt_snbt_parser *sp, struct nbt_compound **out) {
+    struct nbt_reader *rd = &sp->rd;
+    struct nbt_compound_entry *entry = NULL;
+
+    if (nbt_reader_enter(rd) < 0) return -1;
+    ++rd->cur;
+
+    struct nbt_compound *compound = nbt_reader_alloc(rd, sizeof(struct nbt_compound));
+    if (!compound) {
+        nbt_reader_error(rd, "Unable to allocate memory for new NBT compound");
+        nbt_reader_leave(rd);
+        return -1;
+    }
+    memset(compound, 0, sizeof(struct nbt_compound));
+    struct nbt_compound_entry **tail = &compound->first;
+
+    nbt_snbt_skip_space(rd);
+    if (nbt_snbt_at(rd, '}')) {
+        ++rd->cur;
+    } else {
+        while (true) {
+            /* the key */
+            const void *name;
+            size_t namelen;
+
+            nbt_snbt_skip_space(rd);
+            if (nbt_snbt_at(rd, '"') || nbt_snbt_at(rd, '\'')) {
+                if (nbt_snbt_read_quoted(sp) < 0) goto compound_error_cleanup;
+                name = sp->text.data;
+                namelen = sp->text.length;
+            } else {
+                name = nbt_snbt_bare_token(rd);
+                namelen = (size_t)(rd->cur - (const unsigned char *)name);
+                if (namelen == 0) {
+                    nbt_snbt_unexpected(rd, "a key");
+                    goto compound_error_cleanup;
+                } else if (namelen > UINT16_MAX) {
+                    rd->cur = name;
+                    nbt_reader_error(rd, "SNBT key is longer than 65535 bytes: %zu", namelen);
+                    goto compound_error_cleanup;
+                }
+            }
+
+            char *copy = nbt_reader_alloc(rd, namelen + 1);
+            if (!copy) {
+                nbt_reader_error(rd, "Failed to allocate space for NBT string");
+                goto compound_error_cleanup;
+            }
+            memcpy(copy, name, namelen);
+            copy[namelen] = '\0';
+
+            entry = nbt_reader_alloc(rd, sizeof(struct nbt_compound_entry));
+            if (!entry) {
+                if (!rd->arena) free(copy);
+                nbt_reader_error(rd, "Unable to allocate memory for NBT compound entry");
+                goto compound_error_cleanup;
+            }
+
+            /* TAG_End until its value is in */
+            memset(entry, 0, sizeof(struct nbt_compound_entry));
+            entry->name = copy;
+            entry->namelen = (nbt_strlen)namelen;
+            entry->hash = nbt_hash_name(copy, entry->namelen);
+            *tail = entry;
+            tail = &entry->next;
+            ++compound->size;
+
+            /* the value */
+            nbt_snbt_skip_space(rd);
+            if (!nbt_snbt_at(rd, ':')) {
+                nbt_snbt_unexpected(rd, "':'");
+                goto compound_error_cleanup;
+            }
+            ++rd->cur;
+
+            nbt_type type;
+            nbt_value value;
+            if (nbt_snbt_read_value(sp, &type, &value) < 0) goto compound_error_cleanup;
+            entry->tag.type = type;
+            entry->tag.value = value;
+            entry = NULL;
+
+            nbt_snbt_skip_space(rd);
+            if (nbt_snbt_at(rd, ',')) {
+                ++rd->cur;
+            } else if (nbt_snbt_at(rd, '}')) {
+                ++rd->cur;
+                break;
+            } else {
+                nbt_snbt_unexpected(rd, "',' or '}'");
+                goto compound_error_cleanup;
+            }
+        }
+    }
+
+    if (nbt_read_compound_close(rd, compound) < 0) goto compound_error_cleanup;
+
+    nbt_reader_leave(rd);
+    *out = compound;
+    return 0;
+
+compound_error_cleanup:
+    if (entry) nbt_reader_error_name(rd, entry->name, entry->namelen);
+    NBT_READER_FREE(rd, compound, compound);
+    nbt_reader_leave(rd);
+    return -1;
+}
+
+int nbt_snbt_read_list(struct nbt_snbt_parser *sp, struct nbt_list **out) {
+    struct nbt_reader *rd = &sp->rd;
+    struct nbt_buffer elems = { NULL, 0, 0 };
+
+    if (nbt_reader_enter(rd) < 0) return -1;
+    ++rd->cur;
+
+    struct nbt_list *list = nbt_reader_alloc(rd, sizeof(struct nbt_list));
+    if (!list) {
+        nbt_reader_error(rd, "Unable to allocate memory for new NBT list");
+        nbt_reader_leave(rd);
+        return -1;
+    }
+    memset(list, 0, sizeof(struct nbt_list));
+
+    nbt_snbt_skip_space(rd);
+    if (nbt_snbt_at(rd, ']')) {
+        ++rd->cur;
+    } else {
+        while (true) {
+            nbt_type type;
+            nbt_value value;
+
+            nbt_snbt_skip_space(rd);
+            const unsigned char *at = rd->cur;
+
+            if (list->length == rd->listlimit) {
+                nbt_reader_error(rd, "NBT list is longer than the limit of %d", rd->listlimit);
+                goto list_error_cleanup;
+            }
+
+            if (nbt_snbt_read_value(sp, &type, &value) < 0) {
+                nbt_reader_error_index(rd, list->length);
+                goto list_error_cleanup;
+            }
+
+            if (list->length == 0) {
+                list->type = type;
+            } else if (type != list->type) {
+                if (!rd->arena) nbt_free_value(type, value);
+                rd->cur = at;
+                nbt_reader_error(rd, "SNBT list mixes element types %#02hhx and %#02hhx", list->type, type);
+                nbt_reader_error_index(rd, list->length);
+                goto list_error_cleanup;
+            }
+
+            /* as in the binary reader, a list of numbers counts as one value */
+            if (type <= NBT_TAG_DOUBLE) {
+                --rd->nodes;
+                if (rd->stats) --rd->stats->nodes[type];
+            }
+
+            size_t width = nbt_type_size(type);
+            if (nbt_buffer_reserve(&elems, width) < 0) {
+                if (!rd->arena) nbt_free_value(type, value);
+                nbt_reader_error(rd, "Unable to allocate memory for NBT list");
+                goto list_error_cleanup;
+            }
+            memcpy(elems.data + elems.length, &value, width);
+            elems.length += width;
+            ++list->length;
+
+            nbt_snbt_skip_space(rd);
+            if (nbt_snbt_at(rd, ',')) {
+                ++rd->cur;
+            } else if (nbt_snbt_at(rd, ']')) {
+                ++rd->cur;
+                break;
+            } else {
+                nbt_snbt_unexpected(rd, "',' or ']'");
+                goto list_error_cleanup;
+            }
+        }
+
+        list->data.raw = nbt_reader_alloc(rd, elems.length);
+        if (!list->data.raw) {
+            nbt_reader_error(rd, "Unable to allocate %zu bytes for NBT list", elems.length);
+            goto list_error_cleanup;
+        }
+        memcpy(list->data.raw, elems.data, elems.length);
+    }
+
+    nbt_buffer_free(&elems);
+    nbt_reader_leave(rd);
+    *out = list;
+    return 0;
+
+list_error_cleanup:
+    if (!rd->arena) {
+        /* hand the gathered elements to the list to be freed with it */
+        list->data.raw = elems.data;
+        elems.data = NULL;
+        nbt_free_list(list);
+    }
+    nbt_buffer_free(&elems);
+    nbt_reader_leave(rd);
+    return -1;
+}
+
+/* [B;...], [I;...] and [L;...]. Elements may be any integer that fits. */
+int nbt_snbt_read_array(struct nbt_snbt_parser *sp, nbt_type type, nbt_value *out) {
+    struct nbt_reader *rd = &sp->rd;
+    struct nbt_buffer elems = { NULL, 0, 0 };
+    const char *what;
+    size_t width;
+    int64_t min, max;
+    nbt_int count = 0;
+
+    switch (type) {
+        case NBT_TAG_BYTE_ARRAY:
+            what = "byte";
+            width = 1;
+            min = INT8_MIN;
+            max = INT8_MAX;
+            break;
+        case NBT_TAG_INT_ARRAY:
+            what = "int";
+            width = 4;
+            min = INT32_MIN;
+            max = INT32_MAX;
+            break;
+        default:
+            what = "long";
+            width = 8;
+            min = INT64_MIN;
+            max = INT64_MAX;
+            break;
+    }
+
+    rd->cur += 3;
+    nbt_snbt_skip_space(rd);
+    if (nbt_snbt_at(rd, ']')) {
+        ++rd->cur;
+    } else {
+        while (true) {
+            struct nbt_snbt_number num;
+
+            nbt_snbt_skip_space(rd);
+            const unsigned char *tok = nbt_snbt_bare_token(rd);
+            size_t len = (size_t)(rd->cur - tok);
+
+            if (len == 0) {
+                nbt_snbt_unexpected(rd, "an array element");
+                goto array_error_cleanup;
+            }
+
+            int r = nbt_snbt_number(sp, tok, len, &num);
+            if (r < 0) goto array_error_cleanup;
+            if (r > 0 || num.type > NBT_TAG_LONG || num.i < min || num.i > max) {
+                rd->cur = tok;
+                nbt_reader_error(rd, "Invalid element in SNBT %s array: %.*s", what, (int)len, (const char *)tok);
+                goto array_error_cleanup;
+            }
+
+            if (count == rd->arraylimit) {
+                rd->cur = tok;
+                nbt_reader_error(rd, "NBT %s array is longer than the limit of %d", what, rd->arraylimit);
+                goto array_error_cleanup;
+            }
+
+            if (nbt_buffer_reserve(&elems, width) < 0) {
+                nbt_reader_error(rd, "Unable to allocate memory for NBT %s array", what);
+                goto array_error_cleanup;
+            }
+
+            unsigned char *p = elems.data + elems.length;
+            if (width == 1) {
+                *p = (unsigned char)(nbt_byte)num.i;
+            } else if (width == 4) {
+                nbt_int v = (nbt_int)num.i;
+                memcpy(p, &v, 4);
+            } else {
+                memcpy(p, &num.i, 8);
+            }
+            elems.length += width;
+            ++count;
+
+            nbt_snbt_skip_space(rd);
+            if (nbt_snbt_at(rd, ',')) {
+                ++rd->cur;
+            } else if (nbt_snbt_at(rd, ']')) {
+                ++rd->cur;
+                break;
+            } else {
+                nbt_snbt_unexpected(rd, "',' or ']'");
+                goto array_error_cleanup;
+            }
+        }
+    }
+
+    if (nbt_reader_make_array(rd, type, elems.data, count, out) < 0) goto array_error_cleanup;
+
+    nbt_buffer_free(&elems);
+    return 0;
+
+array_error_cleanup:
+    nbt_buffer_free(&elems);
+    return -1;
+}
+
+int nbt_snbt_read_value(struct nbt_snbt_parser *sp, nbt_type *type, nbt_value *out) {
+    struct nbt_reader *rd = &sp->rd;
+    int ret;
+
+    nbt_snbt_skip_space(rd);
+    if (rd->cur == rd->end) return nbt_snbt_unexpected(rd, "a value");
+
+    if (++rd->nodes > rd->nodelimit)
+        NBT_READ_FAIL(rd, "NBT data has more than the limit of %zu values", rd->nodelimit);
+
+    switch (*rd->cur) {
+        case '{':
+            *type = NBT_TAG_COMPOUND;
+            ret = nbt_snbt_read_compound(sp, &out->tag_compound);
+            break;
+        case '[':
+            if (NBT_READER_LEFT(rd) >= 3 && rd->cur[2] == ';' &&
+                (rd->cur[1] == 'B' || rd->cur[1] == 'I' || rd->cur[1] == 'L')) {
+                *type = rd->cur[1] == 'B' ? NBT_TAG_BYTE_ARRAY : rd->cur[1] == 'I' ? NBT_TAG_INT_ARRAY : NBT_TAG_LONG_ARRAY;
+                ret = nbt_snbt_read_array(sp, *type, out);
+            } else {
+                *type = NBT_TAG_LIST;
+                ret = nbt_snbt_read_list(sp, &out->tag_list);
+            }
+            break;
+        case '"':
+        case '\'':
+            *type = NBT_TAG_STRING;
+            ret = nbt_snbt_read_quoted(sp);
+            if (ret == 0) ret = nbt_reader_make_string(rd, sp->text.data, sp->text.length, &out->tag_string);
+            break;
+        default:
+            ret = nbt_snbt_read_bare(sp, type, out);
+            break;
+    }
+
+    if (ret == 0 && rd->stats) ++rd->stats->nodes[*type];
+    return ret;
+}
+
+int nbt_snbt_read(const char *text, size_t length, struct nbt_parsed *result, const struct nbt_read_options *options) {
+    struct nbt_snbt_parser sp;
+    struct nbt_reader *rd = &sp.rd;
+    nbt_type type;
+    nbt_value root = { .tag_compound = NULL };
+    int ret = -1;
+
+    nbt_reader_init(rd, (const unsigned char *)text, length, options);
+    rd->filter.active = false;
+    sp.text = (struct nbt_buffer){ NULL, 0, 0 };
+
+    uint64_t start = rd->stats ? nbt_now_ns() : 0;
+    NBT_TRACE_EVENT(NBT_TRACE_PARSE, true, length);
+
+    memset(result, 0, sizeof(struct nbt_parsed));
+    result->arena = rd->arena;
+
+    nbt_snbt_skip_space(rd);
+    if (!nbt_snbt_at(rd, '{')) {
+        nbt_snbt_unexpected(rd, "'{'");
+        goto parse_error_cleanup;
+    }
+
+    result->name = nbt_reader_alloc(rd, 1);
+    if (!result->name) {
+        nbt_reader_error(rd, "Failed to allocate space for NBT string");
+        goto parse_error_cleanup;
+    }
+    result->name[0] = '\0';
+
+    if (nbt_snbt_read_value(&sp, &type, &root) < 0)
+        goto parse_error_cleanup;
+
+    nbt_snbt_skip_space(rd);
+    if (rd->cur != rd->end) {
+        nbt_snbt_unexpected(rd, "the end of input");
+        NBT_READER_FREE(rd, compound, root.tag_compound);
+        goto parse_error_cleanup;
+    }
+
+    result->root = root.tag_compound;
+    ret = 0;
+    goto parse_done;
+
+parse_error_cleanup:
+    nbt_reader_report(rd, options ? options->error : NULL);
+
+    if (!rd->arena) free(result->name);
+    result->name = NULL;
+
+parse_done:
+    if (rd->stats) {
+        rd->stats->decode_ns += nbt_now_ns() - start;
+        rd->stats->bytes_parsed += (size_t)(rd->cur - rd->start);
+        if (rd->maxdepth > rd->stats->max_depth) rd->stats->max_depth = rd->maxdepth;
+    }
+
+    nbt_buffer_free(&sp.text);
+    NBT_TRACE_EVENT(NBT_TRACE_PARSE, false, ret < 0 ? 0 : (size_t)(rd->cur - rd->start));
+    return ret;
+}
+
+int nbt_snbt_read_file(FILE *file, struct nbt_parsed *result, const struct nbt_read_options *options) {
+    unsigned char *data;
+    size_t length;
+
+    if (nbt_read_whole_file(file, &data, &length) < 0) {
+        nbt_fill_error(options ? options->error : NULL, 0, "");
+        memset(result, 0, sizeof(struct nbt_parsed));
+        return -1;
+    }
+
+    int ret = nbt_snbt_read((const char *)data, length, result, options);
+    free(data);
+    return ret;
+}
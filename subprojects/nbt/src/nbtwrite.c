@@ -0,0 +1,461 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_endian.h"
+#include "nbt_internal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <zlib.h>
+
+/* Serialization runs in two passes: nbt_encoded_size() walks the tree to get
+ * the exact output size (validating it on the way), then nbt_encode_value()
+ * writes into a buffer of exactly that size with no further bounds checks. */
+
+/* A compound or list whose children are being sized or encoded. */
+struct nbt_write_frame {
+    nbt_type type;
+    union {
+        const struct nbt_compound *compound;
+        const struct nbt_list *list;
+    } node;
+    const struct nbt_compound_entry *next; /* compounds: next entry */
+    nbt_int index;                         /* lists: next element */
+};
+
+/* Frames kept on the C stack; deeper trees move them to the heap. */
+#define NBT_WRITE_FRAMES (32)
+
+/* Both passes walk the tree with an explicit stack, as nbt_read_value()
+ * builds it, so any tree the reader can produce can be written back
+ * whatever the stack of the calling thread. */
+struct nbt_write_stack {
+    struct nbt_write_frame frames[NBT_WRITE_FRAMES];
+    struct nbt_write_frame *base;
+    size_t depth;
+    size_t capacity;
+};
+
+static inline void nbt_write_stack_init(struct nbt_write_stack *st) {
+    st->base = st->frames;
+    st->depth = 0;
+    st->capacity = NBT_WRITE_FRAMES;
+}
+
+static inline void nbt_write_stack_free(struct nbt_write_stack *st) {
+    if (st->base != st->frames) free(st->base);
+}
+
+/* Opens a frame over the children of a (non-NULL) compound or list. */
+static inline int nbt_write_push(struct nbt_write_stack *st, nbt_type type, nbt_value value) {
+    if (st->depth == st->capacity) {
+        struct nbt_write_frame *temp = st->base == st->frames ? malloc(st->capacity * 2 * sizeof(struct nbt_write_frame))
+                                                              : realloc(st->base, st->capacity * 2 * sizeof(struct nbt_write_frame));
+        if (!temp) {
+            nbt_set_error("Unable to allocate memory for NBT writer stack");
+            return -1;
+        }
+        if (st->base == st->frames) memcpy(temp, st->frames, sizeof(st->frames));
+        st->base = temp;
+        st->capacity *= 2;
+    }
+
+    struct nbt_write_frame *top = &st->base[st->depth++];
+    *top = (struct nbt_write_frame){ .type = type };
+    if (type == NBT_TAG_LIST) {
+        top->node.list = value.tag_list;
+    } else {
+        top->node.compound = value.tag_compound;
+        top->next = value.tag_compound->first;
+    }
+    return 0;
+}
+
+#define NBT_ARRAY_SIZE(_arr, _t)                                                      \
+do {                                                                                  \
+    *size += 4;                                                                       \
+    if (!(_arr)) break;                                                               \
+    if ((_arr)->len < 0) {                                                            \
+        nbt_set_error("NBT " #_t " array has negative length: %d", (_arr)->len);      \
+        goto size_error_cleanup;                                                      \
+    }                                                                                 \
+    *size += (size_t)(_arr)->len * sizeof(nbt_ ## _t);                                \
+} while (0)
+
+/* Adds the encoded size of a value to `*size`, validating it on the way. */
+int nbt_encoded_size(nbt_type type, nbt_value value, size_t *size) {
+    struct nbt_write_stack st;
+    int ret = -1;
+
+    nbt_write_stack_init(&st);
+
+    while (true) {
+        switch (type) {
+#define O(_ctype, _uname, _lname)        \
+            case NBT_TAG_ ## _uname:     \
+                *size += sizeof(_ctype); \
+                break;
+
+            NBT_FOREACH_NUM_TYPE(O)
+#undef O
+            case NBT_TAG_BYTE_ARRAY:
+                NBT_ARRAY_SIZE(value.tag_byte_array, byte);
+                break;
+            case NBT_TAG_STRING:
+                *size += 2 + (value.tag_string ? value.tag_string->len : 0);
+                break;
+            case NBT_TAG_LIST: {
+                const struct nbt_list *list = value.tag_list;
+
+                *size += 1 + 4; /* element type, length */
+                if (!list || list->length == 0) break;
+
+                if (list->length < 0) {
+                    nbt_set_error("NBT list has negative length: %d", list->length);
+                    goto size_error_cleanup;
+                }
+                if (list->type == NBT_TAG_END || list->type > NBT_TAG_LONG_ARRAY) {
+                    nbt_set_error("NBT list has invalid element type %#02hhx", list->type);
+                    goto size_error_cleanup;
+                }
+
+                if (list->type <= NBT_TAG_DOUBLE)
+                    *size += (size_t)list->length * nbt_type_size(list->type);
+                else if (nbt_write_push(&st, type, value) < 0)
+                    goto size_error_cleanup;
+                break;
+            }
+            case NBT_TAG_COMPOUND:
+                *size += 1; /* TAG_End */
+                if (value.tag_compound && nbt_write_push(&st, type, value) < 0) goto size_error_cleanup;
+                break;
+            case NBT_TAG_INT_ARRAY:
+                NBT_ARRAY_SIZE(value.tag_int_array, int);
+                break;
+            case NBT_TAG_LONG_ARRAY:
+                NBT_ARRAY_SIZE(value.tag_long_array, long);
+                break;
+            default:
+                nbt_set_error("Invalid NBT tag type %#02hhx", type);
+                goto size_error_cleanup;
+        }
+
+        /* the next child of the innermost open container */
+        while (st.depth > 0) {
+            struct nbt_write_frame *top = &st.base[st.depth - 1];
+
+            if (top->type == NBT_TAG_LIST) {
+                if (top->index < top->node.list->length) {
+                    type = top->node.list->type;
+                    value = nbt_list_get(top->node.list, top->index++);
+                    break;
+                }
+            } else if (top->next) {
+                const struct nbt_compound_entry *entry = top->next;
+                top->next = entry->next;
+                *size += 1 + 2 + entry->namelen; /* type, name */
+                type = entry->tag.type;
+                value = entry->tag.value;
+                break;
+            }
+
+            --st.depth;
+        }
+
+        if (st.depth == 0) break;
+    }
+
+    ret = 0;
+
+size_error_cleanup:
+    nbt_write_stack_free(&st);
+    return ret;
+}
+
+#undef NBT_ARRAY_SIZE
+
+size_t nbt_write_size(const struct nbt_parsed *parsed) {
+    size_t size = 1 + 2 + parsed->namelen;
+    if (nbt_encoded_size(NBT_TAG_COMPOUND, (nbt_value){ .tag_compound = parsed->root }, &size) < 0) return 0;
+    return size;
+}
+
+static inline unsigned char *nbt_encode_u16(unsigned char *p, uint16_t v) {
+    v = nbt_endian_h2be_u16(v);
+    memcpy(p, &v, 2);
+    return p + 2;
+}
+
+static inline unsigned char *nbt_encode_u32(unsigned char *p, uint32_t v) {
+    v = nbt_endian_h2be_u32(v);
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+static inline unsigned char *nbt_encode_u64(unsigned char *p, uint64_t v) {
+    v = nbt_endian_h2be_u64(v);
+    memcpy(p, &v, 8);
+    return p + 8;
+}
+
+static inline unsigned char *nbt_encode_name(unsigned char *p, const char *name, nbt_strlen len) {
+    p = nbt_encode_u16(p, len);
+    if (len) memcpy(p, name, len);
+    return p + len;
+}
+
+/* copy then swap in place: one bulk kernel call instead of one per element */
+static inline unsigned char *nbt_encode_bulk(unsigned char *p, const void *src, size_t count, size_t width) {
+    if (count == 0) return p;
+    memcpy(p, src, count * width);
+    nbt_endian_h2be_array(p, count, width);
+    return p + count * width;
+}
+
+#define NBT_ENCODE_ARRAY(_arr, _t)                                             \
+do {                                                                           \
+    nbt_int len = (_arr) ? (_arr)->len : 0;                                    \
+    p = nbt_encode_u32(p, (uint32_t)len);                                      \
+    if (len) p = nbt_encode_bulk(p, (_arr)->buf, len, sizeof(nbt_ ## _t));     \
+} while (0)
+
+/* Writes a value sized by nbt_encoded_size() at `p`, returning the end of
+ * it, or NULL if the stack could not grow. */
+unsigned char *nbt_encode_value(unsigned char *p, nbt_type type, nbt_value value) {
+    struct nbt_write_stack st;
+
+    nbt_write_stack_init(&st);
+
+    while (true) {
+        switch (type) {
+            case NBT_TAG_BYTE:
+                *p++ = (unsigned char)value.tag_byte;
+                break;
+            case NBT_TAG_SHORT:
+                p = nbt_encode_u16(p, (uint16_t)value.tag_short);
+                break;
+            case NBT_TAG_INT:
+                p = nbt_encode_u32(p, (uint32_t)value.tag_int);
+                break;
+            case NBT_TAG_LONG:
+                p = nbt_encode_u64(p, (uint64_t)value.tag_long);
+                break;
+            case NBT_TAG_FLOAT: {
+                uint32_t bits;
+                memcpy(&bits, &value.tag_float, 4);
+                p = nbt_encode_u32(p, bits);
+                break;
+            }
+            case NBT_TAG_DOUBLE: {
+                uint64_t bits;
+                memcpy(&bits, &value.tag_double, 8);
+                p = nbt_encode_u64(p, bits);
+                break;
+            }
+            case NBT_TAG_BYTE_ARRAY:
+                NBT_ENCODE_ARRAY(value.tag_byte_array, byte);
+                break;
+            case NBT_TAG_STRING:
+                if (value.tag_string)
+                    p = nbt_encode_name(p, value.tag_string->buf, value.tag_string->len);
+                else
+                    p = nbt_encode_u16(p, 0);
+                break;
+            case NBT_TAG_LIST: {
+                const struct nbt_list *list = value.tag_list;
+
+                if (!list || list->length == 0) {
+                    *p++ = list ? list->type : NBT_TAG_END;
+                    p = nbt_encode_u32(p, 0);
+                    break;
+                }
+
+                *p++ = list->type;
+                p = nbt_encode_u32(p, (uint32_t)list->length);
+
+                if (list->type <= NBT_TAG_DOUBLE)
+                    p = nbt_encode_bulk(p, list->data.raw, list->length, nbt_type_size(list->type));
+                else if (nbt_write_push(&st, type, value) < 0)
+                    goto encode_error_cleanup;
+                break;
+            }
+            case NBT_TAG_COMPOUND:
+                if (!value.tag_compound)
+                    *p++ = NBT_TAG_END;
+                else if (nbt_write_push(&st, type, value) < 0)
+                    goto encode_error_cleanup;
+                break;
+            case NBT_TAG_INT_ARRAY:
+                NBT_ENCODE_ARRAY(value.tag_int_array, int);
+                break;
+            case NBT_TAG_LONG_ARRAY:
+                NBT_ENCODE_ARRAY(value.tag_long_array, long);
+                break;
+        }
+
+        /* the next child of the innermost open container, closing the
+         * compounds that are finished */
+        while (st.depth > 0) {
+            struct nbt_write_frame *top = &st.base[st.depth - 1];
+
+            if (top->type == NBT_TAG_LIST) {
+                if (top->index < top->node.list->length) {
+                    type = top->node.list->type;
+                    value = nbt_list_get(top->node.list, top->index++);
+                    break;
+                }
+            } else if (top->next) {
+                const struct nbt_compound_entry *entry = top->next;
+                top->next = entry->next;
+                *p++ = entry->tag.type;
+                p = nbt_encode_name(p, entry->name, entry->namelen);
+                type = entry->tag.type;
+                value = entry->tag.value;
+                break;
+            } else {
+                *p++ = NBT_TAG_END;
+            }
+
+            --st.depth;
+        }
+
+        if (st.depth == 0) break;
+    }
+
+    nbt_write_stack_free(&st);
+    return p;
+
+encode_error_cleanup:
+    nbt_write_stack_free(&st);
+    return NULL;
+}
+
+#undef NBT_ENCODE_ARRAY
+
+/* Encodes `parsed` into exactly nbt_write_size() bytes at `p`. */
+int nbt_encode_parsed(unsigned char *p, const struct nbt_parsed *parsed) {
+    *p++ = NBT_TAG_COMPOUND;
+    p = nbt_encode_name(p, parsed->name, parsed->namelen);
+    return nbt_encode_value(p, NBT_TAG_COMPOUND, (nbt_value){ .tag_compound = parsed->root }) ? 0 : -1;
+}
+
+#define NBT_DEFLATE_CHUNK (65536)
+
+/* Deflates `in` onto the end of `out` as a gzip or zlib stream. Output space
+ * is reserved up front from deflateBound(), so this is normally a single
+ * deflate(Z_FINISH) call; the loop only exists because avail_in/avail_out
+ * are 32 bits wide. */
+int nbt_deflate(const unsigned char *in, size_t inlen, struct nbt_buffer *out, int compression, int level) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+
+    int windowbits = compression == NBT_COMPRESSION_GZIP ? 15 + 16 : 15;
+    int zret = deflateInit2(&strm, level, Z_DEFLATED, windowbits, 8, Z_DEFAULT_STRATEGY);
+    if (zret != Z_OK) {
+        nbt_set_error("Failed to initialize deflate: %s", zError(zret));
+        return -1;
+    }
+
+    uLong bound = deflateBound(&strm, (uLong)inlen);
+    if (nbt_buffer_reserve(out, bound) < 0) {
+        deflateEnd(&strm);
+        nbt_set_error("Unable to allocate %lu bytes for compressed NBT data", (unsigned long)bound);
+        return -1;
+    }
+
+    size_t inleft = inlen;
+    strm.next_in = (Bytef *)in;
+
+    do {
+        if (out->capacity == out->length && nbt_buffer_reserve(out, NBT_DEFLATE_CHUNK) < 0) {
+            deflateEnd(&strm);
+            nbt_set_error("Unable to grow buffer for compressed NBT data");
+            return -1;
+        }
+
+        if (strm.avail_in == 0 && inleft) {
+            strm.avail_in = inleft > UINT_MAX ? UINT_MAX : (uInt)inleft;
+            inleft -= strm.avail_in;
+        }
+
+        size_t outleft = out->capacity - out->length;
+        strm.next_out = out->data + out->length;
+        strm.avail_out = outleft > UINT_MAX ? UINT_MAX : (uInt)outleft;
+
+        zret = deflate(&strm, inleft ? Z_NO_FLUSH : Z_FINISH);
+        out->length = (size_t)(strm.next_out - out->data);
+    } while (zret == Z_OK || zret == Z_BUF_ERROR);
+
+    deflateEnd(&strm);
+
+    if (zret != Z_STREAM_END) {
+        nbt_set_error("Failed to deflate NBT data: %s", zError(zret));
+        return -1;
+    }
+
+    return 0;
+}
+
+int nbt_write_buffer(const struct nbt_parsed *parsed, struct nbt_buffer *out, const struct nbt_write_options *options) {
+    int compression = options ? options->compression : NBT_COMPRESSION_NONE;
+    int level = options && options->level ? options->level : Z_DEFAULT_COMPRESSION;
+
+    size_t size = nbt_write_size(parsed);
+    if (size == 0) return -1;
+
+    if (compression == NBT_COMPRESSION_NONE) {
+        /* encode straight into the caller's buffer */
+        if (nbt_buffer_reserve(out, size) < 0) {
+            nbt_set_error("Unable to allocate %zu bytes for NBT data", size);
+            return -1;
+        }
+
+        if (nbt_encode_parsed(out->data + out->length, parsed) < 0) return -1;
+        out->length += size;
+        return 0;
+    } else if (compression != NBT_COMPRESSION_GZIP && compression != NBT_COMPRESSION_ZLIB) {
+        nbt_set_error("Unknown NBT compression type %d", compression);
+        return -1;
+    }
+
+    unsigned char *raw = malloc(size);
+    if (!raw) {
+        nbt_set_error("Unable to allocate %zu bytes for NBT data", size);
+        return -1;
+    }
+
+    int ret = nbt_encode_parsed(raw, parsed) < 0 ? -1 : nbt_deflate(raw, size, out, compression, level);
+    free(raw);
+
+    return ret;
+}
+
+int nbt_write(const struct nbt_parsed *parsed, struct nbt_buffer *out, const struct nbt_write_options *options) {
+    if (nbt_write_buffer(parsed, out, options) < 0) {
+        nbt_fill_error(options ? options->error : NULL, 0, "");
+        return -1;
+    }
+    return 0;
+}
+
+int nbt_write_file(FILE *file, const struct nbt_parsed *parsed, const struct nbt_write_options *options) {
+    struct nbt_buffer buf = { NULL, 0, 0 };
+
+    if (nbt_write(parsed, &buf, options) < 0) {
+        nbt_buffer_free(&buf);
+        return -1;
+    }
+
+    if (fwrite(buf.data, 1, buf.length, file) < buf.length) {
+        nbt_set_error("Failed to write NBT data: %s", strerror(errno));
+        nbt_fill_error(options ? options->error : NULL, 0, "");
+        nbt_buffer_free(&buf);
+        return -1;
+    }
+
+    nbt_buffer_free(&buf);
+    return 0;
+}
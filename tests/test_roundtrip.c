@@ -0,0 +1,846 @@
+#include "nbt.h"
+#include "nbt_def.h"
+#include "nbt_flat.h"
+#include "nbt_json.h"
+#include "nbt_push.h"
+#include "nbt_region.h"
+#include "nbt_snbt.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+/* Round-trips each NBT file named on the command line: the decoded tree
+ * must encode back to exactly the uncompressed bytes of the file, and so
+ * must the tree read back from a gzip and a zlib copy of it, from typed
+ * JSON in every encoding, and from chunks of a region file as it is
+ * rewritten, and so must a flat document of it and its copies, and the
+ * trees push parsers build from it fed in randomly split pieces, and the
+ * tree read back from its SNBT, up to what SNBT leaves out. Files after
+ * --bad must instead fail to parse, with an error message. Three generated
+ * documents are checked too: one of arrays too large for a single NBT
+ * string once in base64, a shallow one read as a tree and as a flat
+ * document with depth limits below and above its nesting, and one
+ * nested far deeper than the default limit, which is read, filtered and
+ * written on a thread with a small stack. */
+
+#define LARGE_ELEMS (40000)
+#define PUSH_SPLITS (16)
+
+#define DEPTH_LEVELS (8)
+#define DEEP_LEVELS  (1000000)
+#define DEEP_STACK   (256 * 1024)
+
+static const char *current;
+static int failures;
+static char regionpath[64];
+static char flatpath[64];
+
+static void fail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void fail(const char *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    fprintf(stderr, "FAIL %s: ", current);
+    vfprintf(stderr, fmt, va);
+    fputc('\n', stderr);
+    va_end(va);
+    ++failures;
+}
+
+static unsigned char *slurp(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    size_t cap = 4096, n = 0;
+    unsigned char *buf = malloc(cap);
+    size_t nread;
+    while ((nread = fread(buf + n, 1, cap - n, fp)) > 0) {
+        n += nread;
+        if (n == cap) buf = realloc(buf, cap *= 2);
+    }
+    fclose(fp);
+
+    *len = n;
+    return buf;
+}
+
+/* gzip or zlib input inflated with zlib itself, so the check does not
+ * depend on the library's own decompression */
+static unsigned char *inflate_all(const unsigned char *data, size_t len, size_t *outlen) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) return NULL;
+
+    size_t cap = len * 4 + 4096, n = 0;
+    unsigned char *out = malloc(cap);
+    zs.next_in = (unsigned char *)data;
+    zs.avail_in = (uInt)len;
+
+    int ret;
+    do {
+        if (n == cap) out = realloc(out, cap *= 2);
+        zs.next_out = out + n;
+        zs.avail_out = (uInt)(cap - n);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        n = cap - zs.avail_out;
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+
+    if (ret != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    *outlen = n;
+    return out;
+}
+
+static bool same(const char *what, const struct nbt_buffer *buf, const unsigned char *raw, size_t rawlen) {
+    if (buf->length == rawlen && !memcmp(buf->data, raw, rawlen)) return true;
+
+    size_t at = 0;
+    while (at < buf->length && at < rawlen && buf->data[at] == raw[at]) ++at;
+    fail("%s: %zu bytes, expected %zu, first difference at byte %zu", what, buf->length, rawlen, at);
+    return false;
+}
+
+/* encodes `nbt` uncompressed and compares it against `raw` */
+static void check_encode(const char *what, const struct nbt_parsed *nbt, const unsigned char *raw, size_t rawlen) {
+    struct nbt_buffer out = { NULL, 0, 0 };
+
+    size_t size = nbt_write_size(nbt);
+    if (size != rawlen) fail("%s: nbt_write_size() is %zu, expected %zu", what, size, rawlen);
+
+    if (nbt_write(nbt, &out, NULL) < 0) fail("%s: nbt_write: %s", what, nbt_error());
+    else same(what, &out, raw, rawlen);
+
+    nbt_buffer_free(&out);
+}
+
+static void check_tree(const unsigned char *raw, size_t rawlen) {
+    struct nbt_parsed nbt;
+
+    if (nbt_read(raw, rawlen, &nbt) < 0) {
+        fail("nbt_read: %s", nbt_error());
+        return;
+    }
+    check_encode("tree", &nbt, raw, rawlen);
+    nbt_free_parsed(&nbt);
+
+    struct nbt_arena *arena = nbt_arena_new(0);
+    struct nbt_read_options opts = { .arena = arena };
+    if (nbt_read_ex(raw, rawlen, &nbt, &opts) < 0) fail("nbt_read_ex (arena): %s", nbt_error());
+    else check_encode("arena tree", &nbt, raw, rawlen);
+    nbt_arena_free(arena);
+}
+
+/* writes the tree compressed to a file, reads that back and re-encodes it */
+static void check_compressed(const unsigned char *raw, size_t rawlen) {
+    static const struct { int compression; const char *name; } modes[] = {
+        { NBT_COMPRESSION_GZIP, "gzip" },
+        { NBT_COMPRESSION_ZLIB, "zlib" },
+    };
+
+    struct nbt_parsed nbt;
+    if (nbt_read(raw, rawlen, &nbt) < 0) return; /* reported by check_tree */
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(*modes); ++m) {
+        FILE *fp = tmpfile();
+        if (!fp) {
+            fail("tmpfile failed");
+            break;
+        }
+
+        struct nbt_write_options wopts = { .compression = modes[m].compression };
+        struct nbt_parsed back;
+        if (nbt_write_file(fp, &nbt, &wopts) < 0) {
+            fail("nbt_write_file (%s): %s", modes[m].name, nbt_error());
+        } else {
+            rewind(fp);
+            if (nbt_read_file(fp, &back) < 0) {
+                fail("nbt_read_file (%s): %s", modes[m].name, nbt_error());
+            } else {
+                check_encode(modes[m].name, &back, raw, rawlen);
+                nbt_free_parsed(&back);
+            }
+        }
+        fclose(fp);
+    }
+
+    nbt_free_parsed(&nbt);
+}
+
+/* Feeds the document in pieces of 1 to `maxpiece` bytes, split at random
+ * (seeded, so failures repeat), and then what follows it. */
+static void check_push_split(const unsigned char *raw, size_t rawlen, size_t maxpiece, unsigned seed,
+                             struct nbt_arena *arena) {
+    struct nbt_read_options opts = { .arena = arena };
+    struct nbt_push *push = nbt_push_new_tree(&opts);
+    struct nbt_parsed nbt;
+    char what[64];
+    int r = NBT_PUSH_MORE;
+    size_t at = 0, used;
+
+    snprintf(what, sizeof(what), "push (pieces up to %zu bytes, seed %u%s)", maxpiece, seed, arena ? ", arena" : "");
+    if (!push) {
+        fail("%s: nbt_push_new_tree: %s", what, nbt_error());
+        return;
+    }
+
+    while (at < rawlen && r == NBT_PUSH_MORE) {
+        size_t piece = 1 + (size_t)rand_r(&seed) % maxpiece;
+        if (piece > rawlen - at) piece = rawlen - at;
+
+        r = nbt_push_feed(push, raw + at, piece, &used);
+        if (r != NBT_PUSH_DONE && used != piece) fail("%s: %zu of %zu bytes used at byte %zu", what, used, piece, at);
+        at += used;
+    }
+
+    if (r != NBT_PUSH_DONE || at != rawlen) {
+        fail("%s: ended with %d after %zu of %zu bytes: %s", what, r, at, rawlen, nbt_error());
+    } else if (nbt_push_feed(push, raw, rawlen, &used) != NBT_PUSH_DONE || used != 0) {
+        fail("%s: input after the end was consumed", what);
+    } else if (nbt_push_result(push, &nbt) < 0) {
+        fail("%s: nbt_push_result: %s", what, nbt_error());
+    } else {
+        check_encode(what, &nbt, raw, rawlen);
+        nbt_free_parsed(&nbt);
+    }
+
+    nbt_push_free(push);
+}
+
+static void check_push(const unsigned char *raw, size_t rawlen) {
+    struct nbt_arena *arena = nbt_arena_new(0);
+
+    /* byte by byte cuts every field; larger pieces land anywhere */
+    if (rawlen <= 65536) check_push_split(raw, rawlen, 1, 0, NULL);
+    for (unsigned seed = 1; seed <= PUSH_SPLITS; ++seed) {
+        check_push_split(raw, rawlen, seed * seed * 16, seed, seed % 2 ? arena : NULL);
+        nbt_arena_reset(arena);
+    }
+
+    nbt_arena_free(arena);
+}
+
+/* typed JSON, with every array and long encoding, compact and pretty */
+static void check_json(const unsigned char *raw, size_t rawlen) {
+    for (int mode = 0; mode < 8; ++mode) {
+        struct nbt_json_options opts = {
+            .typed = true,
+            .pretty = mode & 1,
+            .arrays = mode & 2 ? NBT_JSON_ARRAY_BASE64 : NBT_JSON_ARRAY_NUMBERS,
+            .longs = mode & 4 ? NBT_JSON_LONG_STRING : NBT_JSON_LONG_NUMBER,
+        };
+        struct nbt_buffer text = { NULL, 0, 0 };
+        struct nbt_parsed back;
+        char what[64];
+
+        snprintf(what, sizeof(what), "typed JSON (%s, %s arrays, %s longs)", opts.pretty ? "pretty" : "compact",
+                 opts.arrays ? "base64" : "number", opts.longs ? "string" : "number");
+
+        if (nbt_json_write(raw, rawlen, &text, &opts) < 0) {
+            fail("%s: nbt_json_write: %s", what, nbt_error());
+        } else if (nbt_json_read((const char *)text.data, text.length, &back, &opts) < 0) {
+            fail("%s: nbt_json_read: %s", what, nbt_error());
+        } else {
+            check_encode(what, &back, raw, rawlen);
+            nbt_free_parsed(&back);
+        }
+
+        nbt_buffer_free(&text);
+    }
+}
+
+/* what SNBT keeps of a tree: it has no type for empty lists */
+static void snbt_normalize(nbt_type type, nbt_value value) {
+    if (type == NBT_TAG_COMPOUND) {
+        for (struct nbt_compound_entry *entry = value.tag_compound->first; entry; entry = entry->next)
+            snbt_normalize(entry->tag.type, entry->tag.value);
+    } else if (type == NBT_TAG_LIST) {
+        struct nbt_list *list = value.tag_list;
+        if (!list->length) list->type = NBT_TAG_END;
+        else if (list->type == NBT_TAG_COMPOUND)
+            for (nbt_int i = 0; i < list->length; ++i)
+                snbt_normalize(NBT_TAG_COMPOUND, (nbt_value){ .tag_compound = list->data.tag_compound[i] });
+        else if (list->type == NBT_TAG_LIST)
+            for (nbt_int i = 0; i < list->length; ++i)
+                snbt_normalize(NBT_TAG_LIST, (nbt_value){ .tag_list = list->data.tag_list[i] });
+    }
+}
+
+/* SNBT, compact and pretty: the tree read back must encode like the
+ * original one as SNBT keeps it, and its text must read back to itself */
+static void check_snbt(const unsigned char *raw, size_t rawlen) {
+    struct nbt_parsed nbt;
+    struct nbt_buffer expect = { NULL, 0, 0 };
+
+    if (nbt_read(raw, rawlen, &nbt) < 0) {
+        fail("SNBT: nbt_read: %s", nbt_error());
+        return;
+    }
+
+    for (int pretty = 0; pretty < 2; ++pretty) {
+        struct nbt_snbt_options opts = { .pretty = pretty };
+        struct nbt_buffer text = { NULL, 0, 0 }, again = { NULL, 0, 0 };
+        struct nbt_parsed back;
+        const char *what = pretty ? "pretty SNBT" : "compact SNBT";
+
+        if (nbt_snbt_write(&nbt, &text, &opts) < 0) {
+            fail("%s: nbt_snbt_write: %s", what, nbt_error());
+        } else if (nbt_snbt_read((const char *)text.data, text.length, &back, NULL) < 0) {
+            fail("%s: nbt_snbt_read: %s", what, nbt_error());
+        } else {
+            if (nbt_snbt_write(&back, &again, &opts) < 0)
+                fail("%s: nbt_snbt_write (again): %s", what, nbt_error());
+            else if (again.length != text.length || memcmp(again.data, text.data, text.length))
+                fail("%s: does not read back to itself", what);
+
+            if (!expect.data) {
+                snbt_normalize(NBT_TAG_COMPOUND, (nbt_value){ .tag_compound = nbt.root });
+                nbt.namelen = 0; /* nor a root name */
+                if (nbt_write(&nbt, &expect, NULL) < 0) fail("%s: nbt_write: %s", what, nbt_error());
+            }
+            if (expect.data) check_encode(what, &back, expect.data, expect.length);
+            nbt_free_parsed(&back);
+        }
+
+        nbt_buffer_free(&again);
+        nbt_buffer_free(&text);
+    }
+
+    nbt_buffer_free(&expect);
+    nbt_free_parsed(&nbt);
+}
+
+static void check_chunk(const char *what, const struct nbt_region *region, unsigned index,
+                        const unsigned char *raw, size_t rawlen) {
+    struct nbt_parsed back;
+    struct nbt_stats stats = { 0 };
+    struct nbt_read_options opts = { .stats = &stats };
+
+    if (nbt_region_read_chunk(region, index, &back, &opts) < 0) {
+        fail("%s: chunk %u: %s", what, index, nbt_error());
+        return;
+    }
+    check_encode(what, &back, raw, rawlen);
+    nbt_free_parsed(&back);
+
+    /* the writer compresses, so the stats see both inflating and decoding */
+    if (!stats.bytes_read || stats.bytes_inflated != rawlen || stats.bytes_parsed != rawlen)
+        fail("%s: chunk %u: stats show %zu bytes read, %zu inflated and %zu parsed, expected %zu",
+             what, index, stats.bytes_read, stats.bytes_inflated, stats.bytes_parsed, rawlen);
+}
+
+/* the game leaves empty files for regions it never wrote to; a writer must
+ * treat one as a region without chunks */
+static void check_region_empty(const struct nbt_parsed *nbt, const unsigned char *raw, size_t rawlen) {
+    struct nbt_region_writer *writer = NULL;
+    struct nbt_region *region = NULL;
+
+    FILE *file = fopen(regionpath, "w");
+    if (!file) {
+        fail("empty region: unable to create %s", regionpath);
+        return;
+    }
+    fclose(file);
+
+    if (!(writer = nbt_region_writer_new(regionpath, NULL))) {
+        fail("nbt_region_writer_new (empty file): %s", nbt_error());
+        goto empty_done;
+    }
+
+    nbt_region_writer_put(writer, 7, nbt, 1);
+    if (nbt_region_writer_commit(writer, NULL) < 0) {
+        fail("nbt_region_writer_commit (empty file): %s", nbt_error());
+        goto empty_done;
+    }
+
+    if (!(region = nbt_region_open(regionpath, NULL))) {
+        fail("nbt_region_open (empty file): %s", nbt_error());
+        goto empty_done;
+    }
+    check_chunk("empty region", region, 7, raw, rawlen);
+
+empty_done:
+    nbt_region_close(region);
+    nbt_region_writer_free(writer);
+    unlink(regionpath);
+}
+
+/* stores the document as three chunks of a new region, then moves one of
+ * them into the hole left by removing another */
+static void check_region(const unsigned char *raw, size_t rawlen) {
+    struct nbt_parsed nbt;
+    struct nbt_region_writer *writer = NULL;
+    struct nbt_region *region = NULL;
+    struct stat before, after;
+
+    if (nbt_read(raw, rawlen, &nbt) < 0) return; /* reported by check_tree */
+
+    check_region_empty(&nbt, raw, rawlen);
+    if (!(writer = nbt_region_writer_new(regionpath, NULL))) {
+        fail("nbt_region_writer_new: %s", nbt_error());
+        goto region_done;
+    }
+
+    nbt_region_writer_put(writer, 0, &nbt, 1);
+    nbt_region_writer_put(writer, 5, &nbt, 2);
+    nbt_region_writer_put(writer, NBT_REGION_CHUNKS - 1, &nbt, 3);
+    if (nbt_region_writer_commit(writer, NULL) < 0) {
+        fail("nbt_region_writer_commit: %s", nbt_error());
+        goto region_done;
+    }
+    stat(regionpath, &before);
+
+    nbt_region_writer_remove(writer, 5);
+    nbt_region_writer_put(writer, 1, &nbt, 4);
+    if (nbt_region_writer_commit(writer, NULL) < 0) {
+        fail("nbt_region_writer_commit (rewrite): %s", nbt_error());
+        goto region_done;
+    }
+    stat(regionpath, &after);
+    if (after.st_size != before.st_size)
+        fail("region: rewrite grew the file from %lld to %lld bytes",
+             (long long)before.st_size, (long long)after.st_size);
+
+    if (!(region = nbt_region_open(regionpath, NULL))) {
+        fail("nbt_region_open: %s", nbt_error());
+        goto region_done;
+    }
+
+    static const unsigned present[] = { 0, 1, NBT_REGION_CHUNKS - 1 };
+    static const uint32_t stamps[] = { 1, 4, 3 };
+    for (size_t i = 0; i < sizeof(present) / sizeof(*present); ++i) {
+        check_chunk("region", region, present[i], raw, rawlen);
+        if (nbt_region_timestamp(region, present[i]) != stamps[i])
+            fail("region: chunk %u has timestamp %u, expected %u",
+                 present[i], nbt_region_timestamp(region, present[i]), stamps[i]);
+    }
+    if (nbt_region_has_chunk(region, 5)) fail("region: removed chunk 5 is still there");
+
+region_done:
+    nbt_region_close(region);
+    nbt_region_writer_free(writer);
+    nbt_free_parsed(&nbt);
+    unlink(regionpath);
+}
+
+static void put(struct nbt_buffer *out, const void *data, size_t len) {
+    if (nbt_buffer_reserve(out, len) < 0) {
+        fail("out of memory");
+        return;
+    }
+    memcpy(out->data + out->length, data, len);
+    out->length += len;
+}
+
+/* `count` host-order elements `width` bytes wide, big-endian */
+static void put_be(struct nbt_buffer *out, const void *host, size_t count, size_t width) {
+    const unsigned char *p = host;
+    for (size_t i = 0; i < count; ++i, p += width) {
+        uint64_t v = 0;
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        switch (width) {
+            case 1: memcpy(&u8, p, 1); v = u8; break;
+            case 2: memcpy(&u16, p, 2); v = u16; break;
+            case 4: memcpy(&u32, p, 4); v = u32; break;
+            default: memcpy(&v, p, 8); break;
+        }
+
+        unsigned char be[8];
+        for (size_t b = 0; b < width; ++b) be[b] = (unsigned char)(v >> (8 * (width - 1 - b)));
+        put(out, be, width);
+    }
+}
+
+/* Re-encodes the subtree at `node` from the flat document alone. */
+static void encode_flat(struct nbt_buffer *out, const struct nbt_flat *flat, uint32_t node, bool named) {
+    const struct nbt_flat_node *n = &nbt_flat_nodes(flat)[node];
+    unsigned char u32[4] = { (unsigned char)(n->length >> 24), (unsigned char)(n->length >> 16),
+                             (unsigned char)(n->length >> 8), (unsigned char)n->length };
+
+    if (named) {
+        unsigned char head[3] = { n->type, (unsigned char)(n->namelen >> 8), (unsigned char)n->namelen };
+        put(out, head, 3);
+        put(out, nbt_flat_name(flat, node), n->namelen);
+    }
+
+    switch (n->type) {
+#define O(_ctype, _uname, _lname)                                     \
+        case NBT_TAG_ ## _uname:                                      \
+            put_be(out, &n->value.tag_ ## _lname, 1, sizeof(_ctype)); \
+            break;
+
+        NBT_FOREACH_NUM_TYPE(O)
+#undef O
+        case NBT_TAG_STRING:
+            put(out, u32 + 2, 2);
+            put(out, nbt_flat_payload(flat, node), n->length);
+            break;
+        case NBT_TAG_BYTE_ARRAY:
+        case NBT_TAG_INT_ARRAY:
+        case NBT_TAG_LONG_ARRAY: {
+            size_t width = n->type == NBT_TAG_BYTE_ARRAY ? 1 : n->type == NBT_TAG_INT_ARRAY ? 4 : 8;
+            put(out, u32, 4);
+            put_be(out, nbt_flat_payload(flat, node), n->length, width);
+            break;
+        }
+        case NBT_TAG_LIST:
+            put(out, &n->elemtype, 1);
+            put(out, u32, 4);
+            if (n->elemtype != NBT_TAG_END && n->elemtype <= NBT_TAG_DOUBLE) {
+                put_be(out, nbt_flat_payload(flat, node), n->length, nbt_type_size(n->elemtype));
+                break;
+            }
+            NBT_FLAT_FOREACH_CHILD(flat, node, child)
+                encode_flat(out, flat, child, false);
+            break;
+        case NBT_TAG_COMPOUND:
+            NBT_FLAT_FOREACH_CHILD(flat, node, child)
+                encode_flat(out, flat, child, true);
+            put(out, (const unsigned char[]){ NBT_TAG_END }, 1);
+            break;
+    }
+}
+
+/* writes the flat document out and maps it back, as it is */
+static struct nbt_flat *map_flat(const struct nbt_flat *flat) {
+    FILE *file = fopen(flatpath, "wb");
+    if (!file) return NULL;
+    size_t written = fwrite(flat, 1, flat->footprint, file);
+    if (fclose(file) != 0 || written != flat->footprint) return NULL;
+
+    FILE *in = fopen(flatpath, "rb");
+    if (!in) return NULL;
+    void *map = mmap(NULL, flat->footprint, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+    fclose(in);
+    unlink(flatpath);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/* a flat document holds exactly the original, and so do its clone, a plain
+ * copy of its bytes and the same bytes mapped back from a file */
+static void check_flat(const unsigned char *raw, size_t rawlen) {
+    struct nbt_flat *flat = nbt_flat_read(raw, rawlen, NULL);
+    if (!flat) {
+        fail("nbt_flat_read: %s", nbt_error());
+        return;
+    }
+
+    struct nbt_flat *clone = nbt_flat_clone(flat);
+    if (!clone) fail("nbt_flat_clone: %s", nbt_error());
+
+    struct nbt_buffer out = { NULL, 0, 0 };
+    encode_flat(&out, flat, 0, true);
+    same("flat", &out, raw, rawlen);
+
+    if (clone) {
+        out.length = 0;
+        encode_flat(&out, clone, 0, true);
+        same("flat clone", &out, raw, rawlen);
+    }
+
+    struct nbt_flat *copy = malloc(flat->footprint);
+    if (!copy) {
+        fail("out of memory");
+    } else {
+        memcpy(copy, flat, flat->footprint);
+        out.length = 0;
+        encode_flat(&out, copy, 0, true);
+        same("flat copy", &out, raw, rawlen);
+        free(copy);
+    }
+
+    struct nbt_flat *mapped = map_flat(flat);
+    if (!mapped) {
+        fail("flat: unable to write out and map back %s", flatpath);
+    } else {
+        out.length = 0;
+        encode_flat(&out, mapped, 0, true);
+        same("mapped flat", &out, raw, rawlen);
+        munmap(mapped, flat->footprint);
+    }
+
+    nbt_buffer_free(&out);
+    nbt_flat_free(clone);
+    nbt_flat_free(flat);
+}
+
+/* every round trip of one uncompressed document */
+static void check_document(const unsigned char *raw, size_t rawlen) {
+    check_tree(raw, rawlen);
+    check_compressed(raw, rawlen);
+    check_push(raw, rawlen);
+    check_flat(raw, rawlen);
+    check_json(raw, rawlen);
+    check_snbt(raw, rawlen);
+    check_region(raw, rawlen);
+}
+
+static void check_file(const char *path) {
+    size_t len, rawlen;
+    unsigned char *data = slurp(path, &len), *raw = data;
+
+    if (!data) {
+        fail("cannot read file");
+        return;
+    }
+
+    rawlen = len;
+    if (nbt_detect_compression(data, len) != NBT_COMPRESSION_NONE) {
+        raw = inflate_all(data, len, &rawlen);
+        if (!raw) {
+            fail("zlib cannot inflate the file");
+            free(data);
+            return;
+        }
+    }
+
+    /* the file as nbt_read_file() sees it, decompression included */
+    FILE *fp = fopen(path, "rb");
+    struct nbt_parsed nbt;
+    if (nbt_read_file(fp, &nbt) < 0) {
+        fail("nbt_read_file: %s", nbt_error());
+    } else {
+        check_encode("file", &nbt, raw, rawlen);
+        nbt_free_parsed(&nbt);
+    }
+    fclose(fp);
+
+    check_document(raw, rawlen);
+
+    if (raw != data) free(raw);
+    free(data);
+}
+
+static void check_bad(const char *path) {
+    size_t len;
+    unsigned char *data = slurp(path, &len);
+    struct nbt_parsed nbt;
+    struct nbt_error err;
+    struct nbt_read_options opts = { .error = &err };
+
+    if (!data) {
+        fail("cannot read file");
+        return;
+    }
+
+    if (nbt_read_ex(data, len, &nbt, &opts) == 0) {
+        fail("malformed input parsed");
+        nbt_free_parsed(&nbt);
+    } else if (!err.message[0]) {
+        fail("no error message");
+    }
+
+    free(data);
+}
+
+static unsigned char *put_u16(unsigned char *p, uint16_t v) {
+    *p++ = (unsigned char)(v >> 8);
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+static unsigned char *put_u32(unsigned char *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)(v >> 16));
+    return put_u16(p, (uint16_t)v);
+}
+
+static unsigned char *put_header(unsigned char *p, nbt_type type, const char *name) {
+    *p++ = type;
+    p = put_u16(p, (uint16_t)strlen(name));
+    memcpy(p, name, strlen(name));
+    return p + strlen(name);
+}
+
+/* root { bytes: [B; ...], ints: [I; ...], longs: [L; ...], shorts: [...] }
+ * with LARGE_ELEMS pseudo-random elements each */
+static unsigned char *gen_large(size_t *len) {
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    size_t cap = 3 + 4 * (3 + 6 + 4 + 1) + (size_t)LARGE_ELEMS * (1 + 4 + 8 + 2) + 1;
+    unsigned char *doc = malloc(cap), *p = doc;
+    if (!doc) return NULL;
+
+    static const struct { nbt_type type; const char *name; size_t width; } fields[] = {
+        { NBT_TAG_BYTE_ARRAY, "bytes", 1 },
+        { NBT_TAG_INT_ARRAY, "ints", 4 },
+        { NBT_TAG_LONG_ARRAY, "longs", 8 },
+        { NBT_TAG_LIST, "shorts", 2 },
+    };
+
+    p = put_header(p, NBT_TAG_COMPOUND, "");
+    for (size_t f = 0; f < sizeof(fields) / sizeof(*fields); ++f) {
+        p = put_header(p, fields[f].type, fields[f].name);
+        if (fields[f].type == NBT_TAG_LIST) *p++ = NBT_TAG_SHORT;
+        p = put_u32(p, LARGE_ELEMS);
+
+        for (int i = 0; i < LARGE_ELEMS; ++i) {
+            /* xorshift64* */
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            uint64_t v = state * 0x2545F4914F6CDD1Dull;
+            for (size_t b = 0; b < fields[f].width; ++b) *p++ = (unsigned char)(v >> (8 * b));
+        }
+    }
+    *p++ = NBT_TAG_END;
+
+    *len = (size_t)(p - doc);
+    return doc;
+}
+
+/* root { "deep": [[[...[]...]]] } with `levels` lists */
+static unsigned char *gen_deep(int levels, size_t *len) {
+    *len = 3 + 3 + 4 + (size_t)levels * 5 + 1;
+    unsigned char *doc = malloc(*len), *p = doc;
+    if (!doc) return NULL;
+
+    static const unsigned char head[] = { 0x0a, 0x00, 0x00, 0x09, 0x00, 0x04, 'd', 'e', 'e', 'p' };
+    memcpy(p, head, sizeof(head));
+    p += sizeof(head);
+    for (int i = 0; i < levels; ++i) {
+        static const unsigned char inner[] = { 0x09, 0x00, 0x00, 0x00, 0x01 };
+        static const unsigned char empty[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
+        memcpy(p, i == levels - 1 ? empty : inner, 5);
+        p += 5;
+    }
+    *p = 0x00;
+
+    return doc;
+}
+
+/* a caller's max_depth, above or below the default, holds for trees and
+ * flat documents alike */
+static void check_depth_limit(void) {
+    size_t len;
+    unsigned char *doc = gen_deep(DEPTH_LEVELS, &len);
+    if (!doc) {
+        fail("out of memory");
+        return;
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        bool fits = pass == 1;
+        unsigned limit = fits ? DEPTH_LEVELS + 1 : DEPTH_LEVELS / 2;
+        struct nbt_read_options opts = { .limits = { .max_depth = limit } };
+        struct nbt_parsed nbt;
+
+        int ret = nbt_read_ex(doc, len, &nbt, &opts);
+        if (ret == 0) nbt_free_parsed(&nbt);
+        if ((ret == 0) != fits) fail("nbt_read_ex with max_depth %u: %s", limit, fits ? nbt_error() : "parsed");
+
+        struct nbt_flat *flat = nbt_flat_read(doc, len, &opts);
+        if (!flat != !fits) fail("nbt_flat_read with max_depth %u: %s", limit, fits ? nbt_error() : "parsed");
+        nbt_flat_free(flat);
+    }
+
+    free(doc);
+}
+
+/* none of this may recurse once per level */
+static void *check_deep(void *arg) {
+    size_t len;
+    unsigned char *doc = gen_deep(DEEP_LEVELS, &len);
+    (void)arg;
+
+    if (!doc) {
+        fail("out of memory");
+        return NULL;
+    }
+
+    struct nbt_parsed nbt;
+    const char *const paths[] = { "other" };
+    struct nbt_read_options opts = { .limits = { .max_depth = DEEP_LEVELS + 1 } };
+
+    if (nbt_read_ex(doc, len, &nbt, &opts) < 0) {
+        fail("nbt_read_ex: %s", nbt_error());
+    } else {
+        check_encode("deep", &nbt, doc, len);
+        nbt_free_parsed(&nbt);
+    }
+
+    /* the deep list is skipped rather than read */
+    opts.paths = paths;
+    opts.npaths = 1;
+    if (nbt_read_ex(doc, len, &nbt, &opts) < 0) {
+        fail("nbt_read_ex (filtered): %s", nbt_error());
+    } else {
+        if (nbt.root->first) fail("filtered read kept an entry");
+        nbt_free_parsed(&nbt);
+    }
+
+    opts.npaths = 0;
+    opts.limits.max_depth = 0;
+    if (nbt_read_ex(doc, len, &nbt, &opts) == 0) {
+        fail("nesting beyond the default limit parsed");
+        nbt_free_parsed(&nbt);
+    }
+
+    free(doc);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    bool bad = false;
+
+    char dir[] = "/tmp/nbt-test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(regionpath, sizeof(regionpath), "%s/r.0.0.mca", dir);
+    snprintf(flatpath, sizeof(flatpath), "%s/doc.flat", dir);
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--bad")) {
+            bad = true;
+            continue;
+        }
+
+        current = argv[i];
+        int before = failures;
+        if (bad) check_bad(argv[i]);
+        else check_file(argv[i]);
+        printf("%s %s\n", failures == before ? "ok  " : "FAIL", argv[i]);
+    }
+
+    size_t largelen;
+    unsigned char *large = gen_large(&largelen);
+    int before = failures;
+    current = "large arrays";
+    if (!large) fail("out of memory");
+    else check_document(large, largelen);
+    free(large);
+    printf("%s %s\n", failures == before ? "ok  " : "FAIL", current);
+
+    before = failures;
+    current = "depth limit";
+    check_depth_limit();
+    printf("%s %s\n", failures == before ? "ok  " : "FAIL", current);
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    before = failures;
+    current = "deep nesting";
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, DEEP_STACK);
+    if (pthread_create(&thread, &attr, &check_deep, NULL) != 0) fail("pthread_create failed");
+    else pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+    printf("%s %s\n", failures == before ? "ok  " : "FAIL", current);
+
+    rmdir(dir);
+    return failures ? 1 : 0;
+}